@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+#
+# Controllo di non regressione del server.
+#
+# 1. Trascrizione: gioca una partita fissa nella stanza 0 con l'utente di users.txt, affiancata dalle richieste
+#    di un supervisore, e confronta le risposte con check/golden.txt. I secondi rimanenti vengono sostituiti da T,
+#    così come i tempi di vittoria nelle statistiche della stanza chieste alla fine. Prima dell'ultimo comando
+#    il supervisore si iscrive agli aggiornamenti della sessione, e vengono confrontati anche quelli ricevuti.
+# 2. Replay: 40 giocatori inviano comandi casuali (con seme fisso), 20 si disconnettono e 10 riprendono la partita;
+#    il log degli eventi viene poi rieseguito con ./replay, che non deve riportare divergenze.
+#
+# Entrambe le prove girano in cartelle temporanee con una copia di rooms/, rooms.pack e users.txt.
+#
+# Uso (dalla cartella del repository, dopo make): python3 check/golden.py [porta] [--update]
+#
+
+import os, random, re, shutil, socket, struct, subprocess, sys, tempfile, time, difflib
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+GOLDEN = os.path.join(REPO, 'check', 'golden.txt')
+
+#---Protocollo---#
+
+def msg_types():
+    src = open(os.path.join(REPO, 'lib', 'game', 'shared.h')).read()
+    body = src[src.index('typedef enum msg_type'):]
+    body = body[body.index('{') + 1:body.index('} msg_type')]
+    body = re.sub(r'//.*', '', body)
+    names = [n.strip().split('=')[0].strip() for n in body.split(',') if n.strip()]
+    return {n: i for i, n in enumerate(names)}
+
+TYPES = msg_types()
+NAMES = {v: k for k, v in TYPES.items()}
+
+class Conn:
+    def __init__(self, port):
+        self.s = socket.create_connection(('127.0.0.1', port))
+        self.s.settimeout(5)
+
+    def send(self, t, p=''):
+        b = p.encode()
+        self.s.sendall(struct.pack('!BH', TYPES[t], len(b)) + b)
+
+    def recv_all(self, n):
+        d = b''
+        while len(d) < n:
+            c = self.s.recv(n - len(d))
+            if not c:
+                raise EOFError
+            d += c
+        return d
+
+    def recv(self):
+        t, l = struct.unpack('!BH', self.recv_all(3))
+        return NAMES[t], self.recv_all(l).decode(errors='replace') if l else ''
+
+    # Messaggi arrivati entro t secondi dall'ultimo
+    def drain(self, t=0.25):
+        out = []
+        self.s.settimeout(t)
+        while True:
+            try:
+                out.append(self.recv())
+            except Exception:
+                break
+        self.s.settimeout(5)
+        return out
+
+    def close(self):
+        self.s.close()
+
+def su_conn(port):
+    c = Conn(port)
+    c.send('MSG_SU_REQ_HELLO')
+    r = c.recv()
+    if r[0] != 'MSG_SUCCESS':
+        raise RuntimeError('supervisor hello refused: %s' % (r,))
+    return c
+
+def work_dir():
+    d = tempfile.mkdtemp(prefix='escape-check-')
+    shutil.copytree(os.path.join(REPO, 'rooms'), os.path.join(d, 'rooms'))
+    shutil.copy(os.path.join(REPO, 'rooms.pack'), d)
+    shutil.copy(os.path.join(REPO, 'users.txt'), d)
+    return d
+
+def start_server(port, args, cwd):
+    p = subprocess.Popen([os.path.join(REPO, 'server'), *args, str(port)], stdin=subprocess.PIPE,
+        stdout=open(os.path.join(cwd, 'server.log'), 'w'), stderr=subprocess.STDOUT, cwd=cwd)
+    p.stdin.write(b'start\n')
+    p.stdin.flush()
+    time.sleep(0.3)
+    return p
+
+def stop_server(p):
+    try:
+        p.stdin.write(b'stop\n')
+        p.stdin.flush()
+        p.wait(timeout=3)
+    except Exception:
+        p.kill()
+        p.wait()
+
+#---Trascrizione---#
+
+def masked(r, types):
+    return [(x, re.sub(r'^\d+ ', 'T ', y) if x in types else y) for x, y in r]
+
+# Negli aggiornamenti delle sessioni osservate il tempo rimanente segue username e stato completo. Gli aggiornamenti
+# senza oggetti cambiati, inviati ogni secondo per il solo tempo rimanente, dipendono dal momento e vengono ignorati
+def updates(r):
+    r = [(x, y) for x, y in r if x != 'MSG_SU_SESSION_UPDATE' or not re.match(r'^\S+ 0 .* 0$', y)]
+    return [(x, re.sub(r'^(\S+ \d+) \d+ ', r'\1 T ', y) if x == 'MSG_SU_SESSION_UPDATE' else y) for x, y in r]
+
+def transcript(port):
+    d = work_dir()
+    p = start_server(port, ['-g', '0', '-e', 'ev.bin'], d)
+    lines = []
+    try:
+        c = Conn(port)
+        su = su_conn(port)
+
+        def cmd(t, a=''):
+            c.send(t, a)
+            lines.append('%s %s => %s' % (t, a, masked(c.drain(), ('MSG_GAME_STATE',))))
+
+        def sup(t, a=''):
+            su.send(t, a)
+            lines.append('SU %s %s => %s' % (t, a, updates(masked(su.drain(), ('MSG_SU_USER_SESSION_DATA', 'MSG_GAME_STATE')))))
+
+        def pushed(t):
+            lines.append('SU pushed => %s' % updates(su.drain(t)))
+
+        cmd('MSG_REQ_LOGIN', 'user 1234')
+        c.send('MSG_REQ_START_GAME', '0')
+        lines.append(str([x[0] for x in c.drain()]))
+
+        L = 'MSG_GAME_CMD_LOOK'; T = 'MSG_GAME_CMD_TAKE'; U = 'MSG_GAME_CMD_USE'; D = 'MSG_GAME_CMD_DROP'
+        O = 'MSG_GAME_CMD_OBJS'; S = 'MSG_GAME_PUZZLE_SOL'
+        for a in ['', 'studio', 'scrivania', 'computer', 'maschera', 'nonexistent', 'camera', 'finestra', 'armadio',
+                  'letto', 'bagno', 'specchio', 'doccia', 'santuario', 'teca', 'cassa']:
+            cmd(L, a)
+        cmd(O); cmd(T, 'chiave'); cmd(T, 'maschera'); cmd(T, 'computer'); cmd(U, 'interruttore'); cmd(U, 'interruttore')
+        cmd(L, 'computer'); cmd(U, 'lucchetto'); cmd(U, 'chiave lucchetto'); cmd(L, 'lucchetto'); cmd(U, 'lucchetto')
+        cmd(L, 'cassetto'); cmd(L, 'scrivania'); cmd(T, 'maschera'); cmd(O); cmd(T, 'tessera'); cmd(T, 'vaso')
+        cmd(T, 'cassa'); cmd(S, 'cassa 1111'); cmd(T, 'cassa'); cmd(S, 'cassa 4242'); cmd(L, 'cassa')
+        sup('MSG_SU_REQ_USER_SESSION_OBJS', 'user'); sup('MSG_SU_REQ_USER_SESSION_BAG', 'user')
+        sup('MSG_SU_REQ_USER_SESSION_DATA', 'user')
+        cmd(T, 'vaso'); cmd(D, 'tessera'); cmd(D, 'tessera'); cmd(T, 'vaso'); cmd(U, 'maschera manichino')
+        cmd(U, 'maschera manichino'); cmd(T, 'tessera'); cmd(U, 'vaso teca'); cmd(U, 'tessera specchio')
+        cmd(U, 'tessera fessura'); cmd(L, 'pareti'); cmd(L, 'doccia'); cmd(T, 'statuetta'); cmd(D, 'statuetta')
+        cmd(T, 'statuetta'); cmd(O)
+        cmd('MSG_GAME_CMD_HELP', '0')
+        sup('MSG_SU_REQ_USER_SESSION_SET_HELP', 'user prova aiuto'); cmd('MSG_GAME_CMD_HELP', '0')
+        cmd('MSG_GAME_CMD_HELP', '1')
+        sup('MSG_SU_REQ_USER_SESSION_OBJS', 'user'); sup('MSG_SU_REQ_USER_SESSION_BAG', 'user')
+
+        # Ogni comando è seguito da un intervallo più lungo di SUBSCRIPTION_TICK_MS, quindi da un solo aggiornamento
+        sup('MSG_SU_REQ_SUBSCRIBE', 'user')
+        for t, a in [(D, 'statuetta'), (T, 'statuetta'), (U, 'statuetta piedistallo')]:
+            cmd(t, a)
+            pushed(0.6)
+        sup('MSG_SU_REQ_UNSUBSCRIBE', 'user')
+        cmd(O)
+
+        su.send('MSG_SU_REQ_ROOM_STATS')
+        r = [(x, re.sub(r'\d+ s\b', 'T s', y)) for x, y in su.drain()]
+        lines.append('SU MSG_SU_REQ_ROOM_STATS  => %s' % r)
+    finally:
+        p.kill()
+        p.wait()
+        shutil.rmtree(d, ignore_errors=True)
+    return [l + '\n' for l in lines]
+
+#---Replay---#
+
+def replay_check(port):
+    d = work_dir()
+    p = start_server(port, ['-g', '2', '-e', 'ev.bin'], d)
+    try:
+        random.seed(1)
+        cs = {}; tokens = {}
+        for i in range(40):
+            c = Conn(port)
+            c.send('MSG_REQ_SIGNUP', 'u%d pw' % i); c.drain(0.05)
+            c.send('MSG_REQ_START_GAME', '0')
+            tokens[i] = [y for x, y in c.drain(0.05) if x == 'MSG_GAME_INIT'][0].split()[-1]
+            cs[i] = c
+        su = su_conn(port)
+        cmds = [('MSG_GAME_CMD_TAKE', 'chiave'), ('MSG_GAME_CMD_USE', 'interruttore'),
+                ('MSG_GAME_CMD_USE', 'chiave lucchetto'), ('MSG_GAME_CMD_TAKE', 'tessera'),
+                ('MSG_GAME_CMD_DROP', 'tessera'), ('MSG_GAME_PUZZLE_SOL', 'cassa 4242'),
+                ('MSG_GAME_CMD_LOOK', 'cassa'), ('MSG_GAME_CMD_OBJS', '')]
+        for k in range(400):
+            i = random.randrange(40)
+            t, a = random.choice(cmds)
+            cs[i].send(t, a); cs[i].drain(0.01)
+            if k % 50 == 0:
+                su.send('MSG_SU_REQ_USER_SESSION_ALTER_TIME', 'u%d 30 +' % i); su.drain(0.01)
+                su.send('MSG_SU_REQ_USER_SESSION_SET_HELP', 'u%d aiuto %d' % (i, k)); su.drain(0.01)
+        for i in range(20):
+            cs[i].close()
+        time.sleep(1)
+        for i in range(10):
+            c = Conn(port)
+            c.send('MSG_REQ_LOGIN', 'u%d pw' % i); c.drain(0.05)
+            c.send('MSG_REQ_RESUME_GAME', tokens[i]); c.drain(0.05)
+            cs[i] = c
+        time.sleep(3)
+        for i in range(10):
+            cs[i].send('MSG_GAME_CMD_END'); cs[i].drain(0.05)
+        stop_server(p)
+
+        out = subprocess.run([os.path.join(REPO, 'replay'), 'ev.bin'], cwd=d, capture_output=True, text=True).stdout
+        m = re.search(r'Diverged:\s*(\d+)', out)
+        if m is None:
+            print('Error:\treplay output not recognized\n' + out)
+            return False
+        print('Replay:     %s divergences' % m.group(1))
+        return m.group(1) == '0'
+    finally:
+        if p.poll() is None:
+            p.kill()
+        shutil.rmtree(d, ignore_errors=True)
+
+def main():
+    args = [a for a in sys.argv[1:] if a != '--update']
+    port = int(args[0]) if args else 4950
+
+    lines = transcript(port)
+    if '--update' in sys.argv:
+        open(GOLDEN, 'w').writelines(lines)
+        print('Transcript: %s updated' % GOLDEN)
+        ok = True
+    else:
+        diff = list(difflib.unified_diff(open(GOLDEN).readlines(), lines, 'golden.txt', 'server'))
+        ok = not diff
+        print('Transcript: %s' % ('unchanged' if ok else 'changed'))
+        sys.stdout.writelines(diff)
+
+    return 0 if replay_check(port + 1) and ok else 1
+
+if __name__ == '__main__':
+    sys.exit(main())
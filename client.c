@@ -94,6 +94,8 @@ static int init_client(int server_port)
         }
     }
 
+    // L'indirizzo viene riusato per riprendere la partita se la connessione si interrompe
+    setServerAddress((struct sockaddr*)&server_addr, sizeof(server_addr));
     return sd;
 }
 
@@ -499,13 +501,13 @@ static bool askRetry()
 static bool show_main_menu(int sd) 
 {
     char buffer[MAX_INPUT_DIM * 2], cmd[MAX_INPUT_DIM];
-    char** room_names;
-    int i, n;
+    const room_catalog_cache* catalog;
+    int i;
 
     // Chiede le stanze disponibili al server
     plog(LOG_INFO, "Recupero la lista delle stanze...");
     sleep(1);
-    switch(reqRoomNames(sd, &room_names, &n))
+    switch(reqRoomNames(sd, &catalog))
     {
         case OK: {
             plog(LOG_OK, "Pronti!");
@@ -531,8 +533,8 @@ static bool show_main_menu(int sd)
         
         // Mostra le stanze disponibili
         printf("\nStanze disponibili:\n");
-        for (i = 0; i < n; i++) {
-            printf("%d) %s\n", i+1, room_names[i]);
+        for (i = 0; i < catalog->n; i++) {
+            printf("%d) %s\n", i+1, catalog->names[i]);
         }
         printf("\n");
 
@@ -545,7 +547,6 @@ static bool show_main_menu(int sd)
 
         if (strcmp("quit", cmd) == 0)
         {
-            freeList(room_names, n);
             return false;
         } 
         else if (strcmp("start", cmd) == 0) 
@@ -553,7 +554,7 @@ static bool show_main_menu(int sd)
             int room_id = 0;
             sscanf(buffer, "%s %d", cmd, &room_id);
 
-            if (room_id <= 0 || room_id > n) 
+            if (room_id <= 0 || room_id > catalog->n) 
             {
                 plog(LOG_CUSTOM_ERROR, "Numero della stanza non valido");
                 pressEnterToContinue();
@@ -565,12 +566,9 @@ static bool show_main_menu(int sd)
             switch (reqStartGame(sd, room_id))
             {
                 case OK: {
-                    freeList(room_names, n);
                     return true;
                 }
                 case NET_ERR_REMOTE_SOCKET_CLOSED: {
-                    freeList(room_names, n);
-
                     plog(LOG_CUSTOM_ERROR, "Server disconnesso");
                     pressEnterToContinue();
                     return false;
@@ -580,6 +578,11 @@ static bool show_main_menu(int sd)
                     pressEnterToContinue();
                     break;
                 }
+                case GAME_ERR_SERVER_FULL: {
+                    plog(LOG_CUSTOM_ERROR, "Il server è pieno, riprova più tardi");
+                    pressEnterToContinue();
+                    break;
+                }
                 case AUTH_ERR_NO_AUTH: {
                     plog(LOG_CUSTOM_ERROR, "Non sei autenticato");
                     pressEnterToContinue();
@@ -594,7 +597,6 @@ static bool show_main_menu(int sd)
         }
     }
 
-    freeList(room_names, n);
     return true;
 }
 
@@ -0,0 +1,110 @@
+#include "bloom.h"
+
+static _Atomic uint64_t* block_of(const bloom_filter* bf, uint64_t h);
+
+/*
+ * Inizializza un filtro vuoto dimensionato per contenere capacity elementi.
+ *
+ * Restituisce:
+ *   - true se l'allocazione è riuscita, false altrimenti.
+ */
+bool bloom_init(bloom_filter* bf, size_t capacity)
+{
+    size_t bits;
+
+    if (capacity == 0)
+        capacity = 1;
+
+    // Numero di blocchi necessari, arrotondato per eccesso
+    bits = capacity * BLOOM_BITS_PER_ITEM;
+    bf->n_blocks = (bits + BLOOM_BLOCK_WORDS * 64 - 1) / (BLOOM_BLOCK_WORDS * 64);
+
+    bf->blocks = calloc(bf->n_blocks * BLOOM_BLOCK_WORDS, sizeof(uint64_t));
+    if (bf->blocks == NULL) {
+        bf->n_blocks = 0;
+        return false;
+    }
+
+    bf->n_items = 0;
+    bf->capacity = capacity;
+    return true;
+}
+
+/*
+ * Libera la memoria associata al filtro.
+ */
+void bloom_free(bloom_filter* bf)
+{
+    free(bf->blocks);
+    bf->blocks = NULL;
+    bf->n_blocks = 0;
+    bf->n_items = 0;
+    bf->capacity = 0;
+}
+
+/*
+ * Inserisce una chiave nel filtro.
+ * Il blocco è scelto con i 32 bit alti dell'hash rimescolato, le posizioni all'interno del blocco
+ * sono derivate dai 32 bit bassi dell'hash con la tecnica del doppio hashing.
+ */
+void bloom_add(bloom_filter* bf, uint64_t h)
+{
+    _Atomic uint64_t* block;
+    uint32_t h2 = (uint32_t)h, i;
+
+    if (bf->n_blocks == 0)
+        return;
+
+    block = block_of(bf, h);
+    for (i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint32_t bit = (h2 + i * ((h2 >> 9) | 1)) & (BLOOM_BLOCK_WORDS * 64 - 1);
+        atomic_fetch_or_explicit(&block[bit >> 6], 1ULL << (bit & 63), memory_order_relaxed);
+    }
+    bf->n_items++;
+}
+
+/*
+ * Verifica se una chiave può essere contenuta nel filtro.
+ *
+ * Restituisce:
+ *   - false se la chiave non è sicuramente presente.
+ *   - true se la chiave è probabilmente presente (va confermato sull'archivio reale).
+ */
+bool bloom_may_contain(const bloom_filter* bf, uint64_t h)
+{
+    const _Atomic uint64_t* block;
+    uint32_t h2 = (uint32_t)h, i;
+
+    if (bf->n_blocks == 0)
+        // Filtro non disponibile, non è possibile escludere nulla
+        return true;
+
+    block = block_of(bf, h);
+    for (i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint32_t bit = (h2 + i * ((h2 >> 9) | 1)) & (BLOOM_BLOCK_WORDS * 64 - 1);
+        if ((atomic_load_explicit(&block[bit >> 6], memory_order_relaxed) & (1ULL << (bit & 63))) == 0)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Restituisce:
+ *   - true se il filtro ha raggiunto la capacità per cui è stato dimensionato, false altrimenti.
+ */
+bool bloom_is_full(const bloom_filter* bf)
+{
+    return bf->n_items >= bf->capacity;
+}
+
+/*
+ * L'hash viene rimescolato prima di scegliere il blocco: chi usa già i bit alti dell'hash per dividere
+ * le chiavi (come gli shard dell'archivio utenti) userebbe altrimenti solo una parte dei blocchi.
+ */
+static _Atomic uint64_t* block_of(const bloom_filter* bf, uint64_t h)
+{
+    uint64_t x = h * 0x9e3779b97f4a7c15ULL;
+    return &bf->blocks[((x >> 32) % bf->n_blocks) * BLOOM_BLOCK_WORDS];
+}
@@ -0,0 +1,446 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+#define FRAME_DIM   12                              // Lunghezza (4), tipo (1), riservati (3), checksum (4)
+
+static uint32_t checksum(const unsigned char* data, size_t len, uint32_t h);
+static bool record_reserve(checkpoint_record* record, size_t len);
+static void frame_record(checkpoint_record* record, checkpoint_record_type type);
+static void write_batch(checkpoint_log* log);
+static bool replay_file(const char* path, checkpoint_apply apply, void* ctx);
+static void path_of(const checkpoint_log* log, const char* file, char* path, size_t dim);
+static int open_private(const char* path, int flags);
+
+uint64_t checkpoint_clock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// FNV-1a a 32 bit, sufficiente a riconoscere un record scritto solo in parte
+static uint32_t checksum(const unsigned char* data, size_t len, uint32_t h)
+{
+    size_t i;
+    for (i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void path_of(const checkpoint_log* log, const char* file, char* path, size_t dim)
+{
+    snprintf(path, dim, "%s/%s", log->dir, file);
+}
+
+// I record contengono i token di ripresa delle sessioni: i file sono leggibili solo dal proprietario,
+// anche se esistevano già con permessi più ampi
+static int open_private(const char* path, int flags)
+{
+    int fd = open(path, flags | O_CREAT, 0600);
+    if (fd >= 0 && fchmod(fd, 0600) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Prepara il log di checkpoint nella cartella dir, creandola se non esiste.
+ * Il log resta disattivato fino al primo snapshot: prima va eseguita checkpoint_replay,
+ * perché lo stato ricostruito non venga registrato di nuovo.
+ *
+ * Restituisce:
+ *   - true se la cartella è utilizzabile, false altrimenti.
+ */
+bool checkpoint_open(checkpoint_log* log, const char* dir)
+{
+    memset(log, 0, sizeof(checkpoint_log));
+    log->fd = -1;
+    strncpy(log->dir, dir, sizeof(log->dir) - 1);
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+        return false;
+    return true;
+}
+
+void checkpoint_close(checkpoint_log* log)
+{
+    if (log->fd >= 0)
+        close(log->fd);
+    log->fd = -1;
+    free(log->record.data);
+    log->record.data = NULL;
+    log->record.capacity = 0;
+    free(log->batch.data);
+    log->batch.data = NULL;
+    log->batch.capacity = 0;
+}
+
+bool checkpoint_enabled(const checkpoint_log* log)
+{
+    return log->fd >= 0;
+}
+
+/*
+ * Legge un file di record, chiamando apply per ciascun record valido.
+ *
+ * Restituisce:
+ *   - true se il file è stato letto fino alla fine o fino al primo record non valido, false in caso di errore di lettura.
+ */
+static bool replay_file(const char* path, checkpoint_apply apply, void* ctx)
+{
+    unsigned char frame[FRAME_DIM];
+    checkpoint_record buffer = { 0 };
+    FILE* fd = fopen(path, "rb");
+
+    if (fd == NULL)
+        return errno == ENOENT;
+
+    while (fread(frame, 1, FRAME_DIM, fd) == FRAME_DIM)
+    {
+        checkpoint_record record;
+        uint32_t len, stored, h;
+
+        memcpy(&len, frame, 4);
+        memcpy(&stored, frame + 8, 4);
+        if (len > CHECKPOINT_MAX_RECORD || !record_reserve(&buffer, len))
+            break;
+        if (fread(buffer.data, 1, len, fd) != len)
+            break;
+
+        h = checksum(frame, 8, 2166136261u);
+        h = checksum(buffer.data, len, h);
+        if (h != stored)
+            break;
+
+        // Il record viene letto dall'inizio del payload, fino a len byte
+        record.data = buffer.data;
+        record.len = 0;
+        record.capacity = len;
+        record.error = false;
+        apply((checkpoint_record_type)frame[4], &record, ctx);
+    }
+
+    free(buffer.data);
+    fclose(fd);
+    return true;
+}
+
+/*
+ * Ricostruisce lo stato salvato leggendo prima lo snapshot e poi il log.
+ * Un record non valido interrompe la lettura del suo file: i record successivi di un log corrotto vengono scartati
+ * con il primo snapshot.
+ *
+ * Parametri:
+ *   - apply: Funzione chiamata per ogni record, con il record posizionato all'inizio del payload.
+ *   - ctx: Contesto passato ad apply.
+ *
+ * Restituisce:
+ *   - true se i file sono stati letti, false in caso di errore di lettura.
+ */
+bool checkpoint_replay(checkpoint_log* log, checkpoint_apply apply, void* ctx)
+{
+    char path[256];
+
+    path_of(log, CHECKPOINT_SNAPSHOT_FILE, path, sizeof(path));
+    if (!replay_file(path, apply, ctx))
+        return false;
+
+    path_of(log, CHECKPOINT_LOG_FILE, path, sizeof(path));
+    return replay_file(path, apply, ctx);
+}
+
+static bool record_reserve(checkpoint_record* record, size_t len)
+{
+    unsigned char* data;
+    size_t capacity = record->capacity > 0 ? record->capacity : 256;
+
+    if (len <= record->capacity)
+        return true;
+
+    while (capacity < len)
+        capacity *= 2;
+    data = realloc(record->data, capacity);
+    if (data == NULL)
+        return false;
+
+    record->data = data;
+    record->capacity = capacity;
+    return true;
+}
+
+void record_put_bytes(checkpoint_record* record, const void* data, size_t len)
+{
+    if (record->error || !record_reserve(record, record->len + len)) {
+        record->error = true;
+        return;
+    }
+    memcpy(record->data + record->len, data, len);
+    record->len += len;
+}
+
+void record_put_u8(checkpoint_record* record, uint8_t value)
+{
+    record_put_bytes(record, &value, 1);
+}
+
+void record_put_u32(checkpoint_record* record, uint32_t value)
+{
+    record_put_bytes(record, &value, 4);
+}
+
+void record_put_i64(checkpoint_record* record, int64_t value)
+{
+    record_put_bytes(record, &value, 8);
+}
+
+// Le stringhe sono scritte con la loro lunghezza e senza terminatore
+void record_put_str(checkpoint_record* record, const char* str)
+{
+    uint32_t len = strlen(str);
+    record_put_u32(record, len);
+    record_put_bytes(record, str, len);
+}
+
+void record_get_bytes(checkpoint_record* record, void* out, size_t len)
+{
+    if (record->error || len > record->capacity - record->len) {
+        record->error = true;
+        memset(out, 0, len);
+        return;
+    }
+    memcpy(out, record->data + record->len, len);
+    record->len += len;
+}
+
+uint8_t record_get_u8(checkpoint_record* record)
+{
+    uint8_t value;
+    record_get_bytes(record, &value, 1);
+    return value;
+}
+
+uint32_t record_get_u32(checkpoint_record* record)
+{
+    uint32_t value;
+    record_get_bytes(record, &value, 4);
+    return value;
+}
+
+int64_t record_get_i64(checkpoint_record* record)
+{
+    int64_t value;
+    record_get_bytes(record, &value, 8);
+    return value;
+}
+
+// Legge una stringa, troncandola a dim - 1 caratteri
+void record_get_str(checkpoint_record* record, char* out, size_t dim)
+{
+    uint32_t len = record_get_u32(record);
+
+    if (record->error || len > record->capacity - record->len) {
+        record->error = true;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, record->data + record->len, len < dim ? len : dim - 1);
+    out[len < dim ? len : dim - 1] = '\0';
+    record->len += len;
+}
+
+/*
+ * Inizia un nuovo record nel buffer del log. Il payload va scritto con le funzioni record_put_*.
+ */
+void checkpoint_begin(checkpoint_log* log, checkpoint_record_type type)
+{
+    unsigned char frame[FRAME_DIM] = { 0 };
+
+    log->record.len = 0;
+    log->record.error = false;
+    frame[4] = (unsigned char)type;
+    record_put_bytes(&log->record, frame, FRAME_DIM);
+}
+
+// Completa l'intestazione del record nel buffer con lunghezza e checksum
+static void frame_record(checkpoint_record* record, checkpoint_record_type type)
+{
+    uint32_t len = record->len - FRAME_DIM, h;
+
+    memcpy(record->data, &len, 4);
+    record->data[4] = (unsigned char)type;
+    h = checksum(record->data, 8, 2166136261u);
+    h = checksum(record->data + FRAME_DIM, len, h);
+    memcpy(record->data + 8, &h, 4);
+}
+
+/*
+ * Aggiunge al log il record costruito dall'ultima checkpoint_begin: durante un comando il record viene accodato
+ * a quelli del comando, altrimenti viene scritto subito, con una sola write.
+ * Se il log è disattivato il record viene scartato; se la scrittura fallisce il prossimo snapshot diventa obbligatorio.
+ */
+void checkpoint_commit(checkpoint_log* log)
+{
+    uint64_t start;
+
+    if (log->fd < 0 || log->record.error)
+    {
+        if (log->record.error)
+            log->failed = true;
+        return;
+    }
+
+    start = checkpoint_clock_ns();
+    frame_record(&log->record, (checkpoint_record_type)log->record.data[4]);
+    record_put_bytes(&log->batch, log->record.data, log->record.len);
+    if (log->batch.error)
+    {
+        // Senza memoria per il comando i suoi record vanno persi: lo snapshot obbligatorio li sostituisce
+        log->batch.error = false;
+        log->batch.len = 0;
+        log->failed = true;
+        return;
+    }
+    log->n_records++;
+    log->batch_ns += checkpoint_clock_ns() - start;
+
+    if (!log->batching)
+        write_batch(log);
+}
+
+/*
+ * Inizia un comando: i record aggiunti con checkpoint_commit fino a checkpoint_batch_end vengono scritti insieme.
+ */
+void checkpoint_batch_begin(checkpoint_log* log)
+{
+    log->batching = true;
+}
+
+/*
+ * Termina il comando iniziato con checkpoint_batch_begin, aggiungendo al log i suoi record con una sola write.
+ */
+void checkpoint_batch_end(checkpoint_log* log)
+{
+    log->batching = false;
+    write_batch(log);
+}
+
+// Scrive i record accumulati e misura il costo complessivo del log per il comando
+static void write_batch(checkpoint_log* log)
+{
+    uint64_t start, elapsed;
+
+    if (log->batch.len == 0)
+        return;
+
+    start = checkpoint_clock_ns();
+    if (log->fd < 0 || write(log->fd, log->batch.data, log->batch.len) != (ssize_t)log->batch.len) {
+        #ifdef VERBOSE
+            printf("↳ Scrittura del log di checkpoint non riuscita, verrà scritto uno snapshot\n");
+        #endif
+        log->failed = true;
+    }
+
+    elapsed = log->batch_ns + checkpoint_clock_ns() - start;
+    log->write_ns += elapsed;
+    if (elapsed > log->max_write_ns)
+        log->max_write_ns = elapsed;
+    log->log_bytes += log->batch.len;
+    log->n_writes++;
+    log->batch.len = 0;
+    log->batch_ns = 0;
+}
+
+/*
+ * Apre il file temporaneo di un nuovo snapshot.
+ *
+ * Restituisce:
+ *   - Il file aperto, o NULL in caso di errore.
+ */
+FILE* checkpoint_snapshot_begin(checkpoint_log* log)
+{
+    char path[256];
+    int fd;
+    FILE* file;
+
+    path_of(log, CHECKPOINT_SNAPSHOT_FILE ".tmp", path, sizeof(path));
+    fd = open_private(path, O_WRONLY | O_TRUNC);
+    file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+
+    if (file == NULL && fd >= 0)
+        close(fd);
+    log->snapshot_error = false;
+    return file;
+}
+
+/*
+ * Scrive nello snapshot il record costruito dall'ultima checkpoint_begin.
+ * Un record non costruito o non scritto fa fallire l'intero snapshot, perché la sessione non ci sarebbe.
+ */
+void checkpoint_snapshot_write(checkpoint_log* log, FILE* fd)
+{
+    if (log->record.error) {
+        log->snapshot_error = true;
+        return;
+    }
+    frame_record(&log->record, (checkpoint_record_type)log->record.data[4]);
+    if (fwrite(log->record.data, 1, log->record.len, fd) != log->record.len)
+        log->snapshot_error = true;
+}
+
+/*
+ * Rende definitivo lo snapshot: lo sincronizza su disco, lo sostituisce al precedente e svuota il log,
+ * attivandolo se non lo era ancora.
+ *
+ * Parametri:
+ *   - fd: File restituito da checkpoint_snapshot_begin, viene chiuso in ogni caso.
+ *   - start_ns: Istante di inizio dello snapshot, per la misura della sua durata.
+ *
+ * Restituisce:
+ *   - true se lo snapshot è stato scritto, false altrimenti: se anche un solo record non è stato scritto
+ *     lo snapshot viene scartato e il log non viene svuotato.
+ */
+bool checkpoint_snapshot_commit(checkpoint_log* log, FILE* fd, uint64_t start_ns)
+{
+    char tmp_path[256], path[256];
+    int dir_fd;
+    bool ok = !log->snapshot_error && !ferror(fd);
+
+    ok = fflush(fd) == 0 && ok;
+    ok = fsync(fileno(fd)) == 0 && ok;
+    ok = fclose(fd) == 0 && ok;
+
+    path_of(log, CHECKPOINT_SNAPSHOT_FILE ".tmp", tmp_path, sizeof(tmp_path));
+    path_of(log, CHECKPOINT_SNAPSHOT_FILE, path, sizeof(path));
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+
+    // Sincronizza la cartella, perché la rinomina sopravviva a un crash della macchina
+    dir_fd = open(log->dir, O_RDONLY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    // Lo snapshot contiene tutto lo stato: il log riparte vuoto
+    path_of(log, CHECKPOINT_LOG_FILE, path, sizeof(path));
+    if (log->fd < 0)
+        log->fd = open_private(path, O_WRONLY | O_APPEND | O_TRUNC);
+    else if (ftruncate(log->fd, 0) != 0) {
+        close(log->fd);
+        log->fd = open_private(path, O_WRONLY | O_APPEND | O_TRUNC);
+    }
+
+    log->log_bytes = 0;
+    log->failed = log->fd < 0;
+    log->last_snapshot = getTimestamp();
+    log->last_snapshot_ns = checkpoint_clock_ns() - start_ns;
+    log->n_snapshots++;
+    return log->fd >= 0;
+}
@@ -0,0 +1,113 @@
+#ifndef GAME_CHECKPOINT
+#define GAME_CHECKPOINT
+
+#include <stdint.h>
+
+#include "shared.h"
+
+/*
+ * Log di checkpoint delle sessioni di gioco.
+ *
+ * Ogni modifica allo stato di una sessione viene aggiunta in coda al log come un record compatto.
+ * I record prodotti da un comando vengono accumulati e aggiunti al log con una sola write alla fine del comando:
+ * il comando sopravvive così alla terminazione improvvisa del processo, tranne che nel breve intervallo
+ * tra la risposta al client e la write, e una cascata di modifiche costa una sola chiamata di sistema.
+ * Il costo del log viene misurato per comando.
+ * Periodicamente lo stato completo di tutte le sessioni viene scritto in uno snapshot, con lo stesso formato
+ * di record, e il log viene svuotato. Lo snapshot viene scritto in un file temporaneo, sincronizzato su disco
+ * e poi rinominato, così che sul disco ci sia sempre uno snapshot completo.
+ *
+ * Ogni record è preceduto da lunghezza e checksum: la lettura si ferma al primo record incompleto o corrotto,
+ * che può essere solo l'ultimo scritto prima di un crash.
+ * I record descrivono valori assoluti e non incrementi, perciò riapplicare un record già presente nello snapshot
+ * non cambia lo stato; questo rende sicuro un crash tra la scrittura dello snapshot e lo svuotamento del log.
+ */
+#define CHECKPOINT_DIR              "sessions"
+#define CHECKPOINT_LOG_FILE         "checkpoint.log"
+#define CHECKPOINT_SNAPSHOT_FILE    "snapshot.bin"
+#define CHECKPOINT_SNAPSHOT_BYTES   (1 << 20)           // Dimensione del log oltre la quale viene scritto uno snapshot
+#define CHECKPOINT_SNAPSHOT_SECONDS 60                  // Intervallo massimo tra due snapshot, se il log non è vuoto
+#define CHECKPOINT_MAX_RECORD       (16 << 20)          // Dimensione massima di un record
+
+typedef enum                                        // Tipi di record
+{
+    CKPT_SESSION,                                   // Stato completo di una sessione, creata o sostituita
+    CKPT_STOP,                                      // Sessione terminata
+    CKPT_OBJ,                                       // Bit di un insieme di oggetti della sessione
+    CKPT_TOKEN,                                     // Token ottenuti
+    CKPT_TIME,                                      // Millisecondi rimanenti e motivi di pausa
+    CKPT_HELP                                       // Messaggio di aiuto
+}
+checkpoint_record_type;
+
+typedef enum                                        // Insiemi di oggetti di una sessione
+{
+    CKPT_SET_LOCKED,
+    CKPT_SET_HIDDEN,
+    CKPT_SET_CONSUMED,
+    CKPT_SET_BAG
+}
+checkpoint_obj_set;
+
+typedef struct                                      // Record in costruzione o in lettura
+{
+    unsigned char* data;
+    size_t len;                                     // Byte scritti, o posizione di lettura
+    size_t capacity;                                // Byte allocati, o byte disponibili in lettura
+    bool error;                                     // Lettura oltre la fine del record o allocazione fallita
+}
+checkpoint_record;
+
+typedef struct                                      // Log di checkpoint aperto
+{
+    char dir[128];
+    int fd;                                         // Log aperto in append, -1 se il checkpoint è disattivato
+    size_t log_bytes;                               // Byte scritti nel log dall'ultimo snapshot
+    time_t last_snapshot;                           // Timestamp dell'ultimo snapshot
+    bool failed;                                    // Una scrittura nel log è fallita: il prossimo snapshot è obbligatorio
+    bool snapshot_error;                            // Un record dello snapshot in corso non è stato scritto
+    checkpoint_record record;                       // Buffer riutilizzato per i record in scrittura
+    checkpoint_record batch;                        // Record completati del comando in corso, non ancora scritti
+    bool batching;                                  // I record vengono accumulati fino a checkpoint_batch_end
+    uint64_t batch_ns;                              // Tempo speso finora per i record del comando in corso
+
+    unsigned long n_records;                        // Record scritti dall'avvio
+    unsigned long n_writes;                         // Write nel log dall'avvio, una per comando
+    unsigned long n_snapshots;                      // Snapshot scritti dall'avvio
+    uint64_t write_ns;                              // Tempo totale speso per il log dai comandi
+    uint64_t max_write_ns;                          // Tempo massimo speso per il log da un singolo comando
+    uint64_t last_snapshot_ns;                      // Durata dell'ultimo snapshot
+}
+checkpoint_log;
+
+typedef void (*checkpoint_apply)(checkpoint_record_type type, checkpoint_record* record, void* ctx);
+
+bool checkpoint_open(checkpoint_log* log, const char* dir);
+void checkpoint_close(checkpoint_log* log);
+bool checkpoint_replay(checkpoint_log* log, checkpoint_apply apply, void* ctx);
+bool checkpoint_enabled(const checkpoint_log* log);
+
+void checkpoint_begin(checkpoint_log* log, checkpoint_record_type type);
+void checkpoint_commit(checkpoint_log* log);
+void checkpoint_batch_begin(checkpoint_log* log);
+void checkpoint_batch_end(checkpoint_log* log);
+
+FILE* checkpoint_snapshot_begin(checkpoint_log* log);
+void checkpoint_snapshot_write(checkpoint_log* log, FILE* fd);
+bool checkpoint_snapshot_commit(checkpoint_log* log, FILE* fd, uint64_t start_ns);
+
+void record_put_u8(checkpoint_record* record, uint8_t value);
+void record_put_u32(checkpoint_record* record, uint32_t value);
+void record_put_i64(checkpoint_record* record, int64_t value);
+void record_put_str(checkpoint_record* record, const char* str);
+void record_put_bytes(checkpoint_record* record, const void* data, size_t len);
+
+uint8_t record_get_u8(checkpoint_record* record);
+uint32_t record_get_u32(checkpoint_record* record);
+int64_t record_get_i64(checkpoint_record* record);
+void record_get_str(checkpoint_record* record, char* out, size_t dim);
+void record_get_bytes(checkpoint_record* record, void* out, size_t len);
+
+uint64_t checkpoint_clock_ns();
+
+#endif
@@ -2,6 +2,9 @@
 
 static op_result receive_list(int sd, char*** list, int* n);
 static op_result receiveState(int sd);
+static op_result send_command(int sd, desc_msg* msg, bool with_state);
+static bool resume_session(int sd);
+static bool read_catalog_names(const char* payload, int first, char** names, int n);
 
 /*
  * Contiene le informazioni di stato sulla sessione di gioco corrente
@@ -13,6 +16,21 @@ static game_state state = {
     .game_finished = FINISHED_NO
 };
 
+/*
+ * Indirizzo del server, usato per ristabilire la connessione e riprendere la sessione
+ */
+static struct sockaddr_storage server_addr;
+static socklen_t server_addr_len = 0;
+
+/*
+ * Catalogo delle stanze ricevuto dal server, rivalidato a ogni richiesta
+ */
+static room_catalog_cache catalog_cache = {
+    .version = 0,
+    .n = 0,
+    .names = NULL
+};
+
 /*
  * Riceve una lista di elementi.
  * Restituisce la lista degli elementi e il numero totale di elementi ricevuti.
@@ -192,37 +210,126 @@ op_result reqSignup(int sd, const char* username, const char* password)
 }
 
 /*
- * Richiede al server i nomi delle stanze disponibili.
+ * Richiede al server il catalogo delle stanze disponibili. Se il client ha già il catalogo in cache, il server
+ * risponde con un solo messaggio quando non è cambiato; altrimenti il catalogo viene letto pagina per pagina
+ * e sostituisce quello in cache.
  *
  * Parametri:
  *   - sd: Descrittore del socket per la comunicazione con il server.
- *   - room_names: Puntatore a un array di stringhe per memorizzare i nomi delle stanze.
- *   - n: Puntatore al numero totale di stanze ricevute.
+ *   - catalog: Puntatore al catalogo in cache, valido fino alla prossima richiesta. Non deve essere liberato.
  *
  * Restituisce:
  *   - OK se la richiesta e la ricezione sono riuscite.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto si è chiuso durante la comunicazione con il server.
  *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al server.
  *   - NET_ERR_RECV in caso di errori nella ricezione dei messaggi dal server.
- *
- * La funzione recupera i nomi delle stanze inviando una richiesta al server.
- * Riceve il numero totale di stanze e procede a ricevere i nomi delle stanze, memorizzandoli in room_names.
- * Il numero totale di stanze ricevute è restituito attraverso il puntatore n.
- * La memoria allocata per room_names deve essere liberata dall'utente dopo l'uso.
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto non è del tipo atteso.
+ *   - ERR_OTHER se una pagina non è valida, se il catalogo cambia troppe volte durante la lettura
+ *     o in caso di errori di allocazione. Il catalogo in cache resta quello precedente.
  */
-op_result reqRoomNames(int sd, char*** room_names, int* n) 
+op_result reqRoomNames(int sd, const room_catalog_cache** catalog) 
 {
     op_result ret;
     desc_msg msg;
+    char** names = NULL;
+    unsigned int version = 0, page_version;
+    int n = 0, page = 0, n_pages = 1, restarts = 0;
+    int n_rooms, got_page, got_pages, first, i;
 
-    // Invia la richiesta al server per ottenere i nomi delle stanze
-    init_msg(&msg, MSG_REQ_ROOM_NAMES);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
+    while (page < n_pages)
+    {
+        // La prima pagina viene chiesta con la versione in cache, le altre con quella della prima pagina
+        init_msg(&msg, MSG_REQ_ROOM_NAMES, page == 0 ? catalog_cache.version : version, page);
+        ret = send_to_socket(sd, &msg);
+        if (ret == OK)
+            ret = receive_from_socket(sd, &msg);
+        if (ret != OK)
+            goto err;
+
+        // Il catalogo in cache è ancora valido
+        if (page == 0 && msg.type == MSG_ROOM_CATALOG_NOT_MODIFIED) {
+            *catalog = &catalog_cache;
+            return OK;
+        }
+        if (msg.type != MSG_ROOM_CATALOG_PAGE) {
+            ret = ERR_UNEXPECTED_MSG_TYPE;
+            goto err;
+        }
 
-    // Riceve i nomi delle stanze
-    return receive_list(sd, room_names, n);
+        ret = ERR_OTHER;
+        if (sscanf(msg.payload, "%u %d %d %d %d", &page_version, &n_rooms, &got_page, &got_pages, &first) != 5 ||
+            n_rooms < 0 || got_pages <= 0 || first < 0 || first > n_rooms)
+            goto err;
+
+        // Il catalogo è cambiato durante la lettura, si ricomincia dalla prima pagina
+        if (got_page != page || (page > 0 && (page_version != version || n_rooms != n))) {
+            if (++restarts > CATALOG_MAX_RESTARTS)
+                goto err;
+            freeList(names, n);
+            names = NULL;
+            n = page = 0;
+            n_pages = 1;
+            continue;
+        }
+
+        // La prima pagina indica la versione e la dimensione del catalogo
+        if (page == 0) {
+            names = calloc(n_rooms > 0 ? n_rooms : 1, sizeof(char*));
+            if (names == NULL)
+                goto err;
+            version = page_version;
+            n_pages = got_pages;
+            n = n_rooms;
+        }
+        if (!read_catalog_names(msg.payload, first, names, n))
+            goto err;
+        page++;
+    }
+
+    // Ogni stanza deve essere in una pagina
+    ret = ERR_OTHER;
+    for (i = 0; i < n; i++)
+        if (names[i] == NULL)
+            goto err;
+
+    // Il catalogo letto sostituisce quello in cache
+    freeList(catalog_cache.names, catalog_cache.n);
+    catalog_cache.version = version;
+    catalog_cache.n = n;
+    catalog_cache.names = names;
+    *catalog = &catalog_cache;
+    return OK;
+
+err:
+    // Il catalogo in cache resta quello precedente
+    freeList(names, n);
+    return ret;
+}
+
+/*
+ * Copia i nomi di una pagina del catalogo delle stanze nella lista, a partire dall'indice first.
+ * I nomi seguono l'intestazione della pagina, ognuno preceduto da '\n'.
+ *
+ * Restituisce:
+ *   - true se i nomi sono stati copiati, false in caso di errori di allocazione.
+ */
+static bool read_catalog_names(const char* payload, int first, char** names, int n)
+{
+    const char* name = strchr(payload, '\n');
+    const char* end;
+    int i;
+
+    for (i = first; name != NULL && i < n; i++)
+    {
+        name++;
+        end = strchr(name, '\n');
+        free(names[i]);
+        names[i] = strndup(name, end != NULL ? (size_t)(end - name) : strlen(name));
+        if (names[i] == NULL)
+            return false;
+        name = end;
+    }
+    return true;
 }
 
 /*
@@ -248,6 +355,7 @@ const game_state* getGameState()
  *   - NET_ERR_RECV in caso di errori nella ricezione dai messaggi del server.
  *   - AUTH_ERR_NO_AUTH se l'utente non si è autenticato.
  *   - GAME_ERR_INVALID_ROOM se la stanza specificata non è valida.
+ *   - GAME_ERR_SERVER_FULL se il server ha raggiunto il limite di sessioni o di memoria.
  *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto dal server ha un tipo inaspettato.
  *
  * La funzione invia al server la richiesta di avviare la sessione di gioco nella stanza specificata.
@@ -266,7 +374,7 @@ op_result reqStartGame(int sd, unsigned short room)
     }
 
     // Invia al server la richiesta di avviare la sessione di gioco nella stanza indicata
-    init_msg(&msg, MSG_REQ_START_GAME, state.username, room);
+    init_msg(&msg, MSG_REQ_START_GAME, room);
     ret = send_to_socket(sd, &msg);
     if (ret != OK)
         return ret;
@@ -288,13 +396,20 @@ op_result reqStartGame(int sd, unsigned short room)
         case MSG_GAME_ERR_INIT: {
             return GAME_ERR_INIT;
         }
+        case MSG_GAME_ERR_SERVER_FULL: {
+            return GAME_ERR_SERVER_FULL;
+        }
+        case MSG_AUTH_ERR_NO_AUTH: {
+            return AUTH_ERR_NO_AUTH;
+        }
         default: {
             return ERR_UNEXPECTED_MSG_TYPE;
         }
     }
 
     // Recupero dei dati dal payload e memorizzazione nella struttura game_state
-    sscanf(msg.payload, "%lld %d %d", (long long*) &state.remaining_time, &state.bag_size, &state.room_token);
+    memset(state.resume_token, '\0', 1);
+    sscanf(msg.payload, "%lld %d %d %32s", (long long*) &state.remaining_time, &state.bag_size, &state.room_token, state.resume_token);
     state.room = room;
     state.user_token = 0;
     state.objs_in_bag = 0;
@@ -314,6 +429,60 @@ op_result reqStartGame(int sd, unsigned short room)
     return ret;
 }
 
+/*
+ * Chiede al server di riprendere la sessione di gioco corrente dopo una disconnessione, usando il token di ripresa
+ * ricevuto all'avvio della partita. Il socket deve essere una nuova connessione al server.
+ *
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ *
+ * Restituisce:
+ *   - OK se la sessione è stata ripresa e lo stato è stato aggiornato.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio al server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione dai messaggi del server.
+ *   - GAME_ERR_RESUME se non c'è una sessione da riprendere, il token non è valido o la sessione è scaduta.
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto dal server ha un tipo inaspettato.
+ */
+op_result reqResumeGame(int sd) 
+{
+    op_result ret;
+    desc_msg msg;
+
+    // Controlla che ci sia una sessione da riprendere
+    if (strlen(state.resume_token) == 0 || state.game_finished != FINISHED_NO)
+        return GAME_ERR_RESUME;
+
+    // Invia al server il token di ripresa
+    init_msg(&msg, MSG_REQ_RESUME_GAME, state.resume_token);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    // Riceve lo stato della sessione
+    ret = receive_from_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    switch (msg.type)
+    {
+        case MSG_GAME_RESUMED: {
+            break;
+        }
+        case MSG_GAME_ERR_RESUME: {
+            return GAME_ERR_RESUME;
+        }
+        default: {
+            return ERR_UNEXPECTED_MSG_TYPE;
+        }
+    }
+
+    // Recupero dei dati dal payload e memorizzazione nella struttura game_state
+    sscanf(msg.payload, "%d %d %d %lld %d %d %d", &state.room, &state.bag_size, &state.room_token,
+        (long long*) &state.remaining_time, &state.user_token, &state.objs_in_bag, &state.last_help_msg_id);
+    return ret;
+}
+
 /*
  * Riceve lo stato attuale del gioco inviato dal server e aggiorna lo stato del client.
  * Gestisce anche i messaggi di fine gioco (vittoria o timeout).
@@ -376,6 +545,93 @@ static op_result receiveState(int sd)
     return ret;
 }
 
+/*
+ * Invia un comando di gioco e riceve la prima risposta. Se la connessione con il server si è interrotta,
+ * la ristabilisce, riprende la sessione con il token di ripresa e invia di nuovo il comando, una sola volta.
+ * Il server risponde a un comando appena lo esegue, quindi un comando rimasto senza alcuna risposta di norma
+ * non è stato eseguito; nel caso peggiore viene ripetuto e il server risponde con una notifica (oggetto già raccolto, ...).
+ *
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server, sostituito dalla nuova connessione se necessario.
+ *   - msg: Comando da inviare; se with_state è false contiene poi la risposta.
+ *   - with_state: La prima risposta è lo stato della sessione, letto con receiveState.
+ *
+ * Restituisce:
+ *   - Il risultato di receiveState, oppure OK se la risposta è stata ricevuta in msg.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se la connessione si è interrotta e non è stato possibile riprendere la sessione.
+ *   - NET_ERR_SEND in caso di errori nell'invio del comando al server.
+ */
+static op_result send_command(int sd, desc_msg* msg, bool with_state)
+{
+    desc_msg request = *msg;
+    op_result ret;
+    int attempt;
+
+    for (attempt = 0; ; attempt++)
+    {
+        *msg = request;
+        ret = send_to_socket(sd, msg);
+        if (ret == OK)
+            ret = with_state ? receiveState(sd) : receive_from_socket(sd, msg);
+
+        // Un errore di ricezione lascia il flusso non allineato ai messaggi, come una connessione chiusa
+        if ((ret != NET_ERR_REMOTE_SOCKET_CLOSED && ret != NET_ERR_RECV) || attempt > 0)
+            return ret;
+        if (!resume_session(sd))
+            return NET_ERR_REMOTE_SOCKET_CLOSED;
+    }
+}
+
+/*
+ * Ristabilisce la connessione con il server e riprende la sessione di gioco corrente.
+ * Il nuovo socket prende il posto del descrittore sd, così che il chiamante possa continuare a usarlo.
+ *
+ * Restituisce:
+ *   - true se la sessione è stata ripresa, false se manca l'indirizzo del server, la connessione fallisce
+ *     o il server non ha più la sessione.
+ */
+static bool resume_session(int sd)
+{
+    int new_sd;
+
+    if (server_addr_len == 0 || strlen(state.resume_token) == 0 || state.game_finished != FINISHED_NO)
+        return false;
+
+    // Creazione del nuovo socket e connessione al server, allo stesso indirizzo della prima connessione
+    new_sd = socket(server_addr.ss_family, SOCK_STREAM, 0);
+    if (new_sd < 0)
+        return false;
+    if (connect(new_sd, (struct sockaddr*)&server_addr, server_addr_len) < 0) {
+        close(new_sd);
+        return false;
+    }
+
+    // Il nuovo socket sostituisce quello chiuso
+    if (dup2(new_sd, sd) < 0) {
+        close(new_sd);
+        return false;
+    }
+    close(new_sd);
+
+    return reqResumeGame(sd) == OK;
+}
+
+/*
+ * Memorizza l'indirizzo del server a cui il client si è connesso, per ristabilire la connessione
+ * se si interrompe durante una partita.
+ *
+ * Parametri:
+ *   - addr: Indirizzo usato per la connessione.
+ *   - addr_len: Dimensione dell'indirizzo.
+ */
+void setServerAddress(const struct sockaddr* addr, socklen_t addr_len)
+{
+    if (addr_len > sizeof(server_addr))
+        return;
+    memcpy(&server_addr, addr, addr_len);
+    server_addr_len = addr_len;
+}
+
 /*
  * Invia al server il comando "look" per ottenere la descrizione di un oggetto, una locazione o dell'intera stanza.
  *
@@ -405,12 +661,9 @@ op_result cmdLook(int sd, const char* what)
 
     // Invia il comando "look" specificando l'oggetto o la locazione di interesse
     init_msg(&msg, MSG_GAME_CMD_LOOK, what);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
-    
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
     
@@ -464,12 +717,9 @@ op_result cmdObjs(int sd, char*** objs_names, int* n)
 
     // Invia al server il comando "objs" per richiedere la lista degli oggetti nello zaino
     init_msg(&msg, MSG_GAME_CMD_OBJS);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
 
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
 
@@ -510,12 +760,9 @@ op_result cmdUse(int sd, const char* obj1_name, const char* obj2_name, char** ou
 
     // Invia al server il comando "use"
     init_msg(&msg, MSG_GAME_CMD_USE, obj1_name, obj2_name);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
 
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
 
@@ -606,12 +853,9 @@ op_result cmdTake(int sd, const char* obj_name, char** puzzle_text)
 
     // Invia al server il comando "take"
     init_msg(&msg, MSG_GAME_CMD_TAKE, obj_name);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
 
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
 
@@ -699,12 +943,9 @@ op_result cmdDrop(int sd, const char* obj_name)
 
     // Invia al server il comando "drop"
     init_msg(&msg, MSG_GAME_CMD_DROP, obj_name);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
 
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
 
@@ -758,12 +999,9 @@ op_result cmdHelp(int sd)
 
     // Invia il comando "help" specificando il numero dell'ultimo messaggio ricevuto
     init_msg(&msg, MSG_GAME_CMD_HELP, state.current_help_msg_id);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
-    
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
     
@@ -812,14 +1050,9 @@ op_result cmdEnd(int sd)
     op_result ret;
     desc_msg msg;
 
-    // Invia al server il comando "end"
+    // Invia al server il comando "end" e riceve il risultato dell'esecuzione del comando
     init_msg(&msg, MSG_GAME_CMD_END);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
-
-    // Riceve il risultato dell'esecuzione del comando
-    ret = receive_from_socket(sd, &msg);
+    ret = send_command(sd, &msg, false);
     if (ret != OK)
         return ret;
 
@@ -871,12 +1104,9 @@ op_result sendPuzzleSolution(int sd, const char* obj_name, const char* solution)
 
     // Invia al server le informazioni
     init_msg(&msg, MSG_GAME_PUZZLE_SOL, obj_name, solution);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
 
-    // Riceve lo stato aggiornato della sessione di gioco
-    ret = receiveState(sd);
+    // Riceve lo stato aggiornato della sessione di gioco, riprendendo la sessione se la connessione si è interrotta
+    ret = send_command(sd, &msg, true);
     if (ret != OK)
         return ret;
 
@@ -3,6 +3,16 @@
 
 #include "shared.h"
 
+#define CATALOG_MAX_RESTARTS    4               // Volte in cui la lettura del catalogo ricomincia perché il catalogo è cambiato
+
+typedef struct                                  // Catalogo delle stanze ricevuto dal server, tenuto in cache tra le richieste
+{
+    uint32_t version;                           // Versione del catalogo, 0 se non è ancora stato ricevuto
+    int n;                                      // Numero di stanze
+    char** names;                               // Nomi delle stanze
+}
+room_catalog_cache;
+
 typedef struct                                  // Struttura che definisce lo stato della sessione di gioco
 {
     char username[MAX_USR_DIM];                 // Username del giocatore
@@ -14,6 +24,7 @@ typedef struct                                  // Struttura che definisce lo st
     int room_token;                             // Numero di token necessari per vincere
     int user_token;                             // Numero di token che il giocatore possiede
     int room;                                   // Room nella quale l'utente sta giocando 
+    char resume_token[RESUME_TOKEN_DIM];        // Token per riprendere la sessione dopo una disconnessione
     char current_description[MAX_DESCR_DIM];    // Ultima descrizione ricevuta dal server (storia della stanza, descrizione oggetto/location/stanza o messaggio di fine gioco)
     char current_help_msg[MAX_HELP_DIM];        // Ultimo messaggio di aiuto ricevuto
     enum  {
@@ -26,11 +37,14 @@ typedef struct                                  // Struttura che definisce lo st
 }
 game_state;
 
+void setServerAddress(const struct sockaddr* addr, socklen_t addr_len);
+
 op_result reqLogin(int sd, const char* username, const char* password);
 op_result reqSignup(int sd, const char* username, const char* password);
 
-op_result reqRoomNames(int sd, char*** room_names, int* n);
+op_result reqRoomNames(int sd, const room_catalog_cache** catalog);
 op_result reqStartGame(int sd, unsigned short room);
+op_result reqResumeGame(int sd);
 
 op_result cmdLook(int sd, const char* what);
 op_result cmdObjs(int sd, char*** objs_names, int* n);
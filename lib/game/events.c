@@ -0,0 +1,169 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "events.h"
+
+static bool valid_header(const game_event_file_header* header);
+static void init_header(game_event_file_header* header, int grace_seconds);
+
+static void init_header(game_event_file_header* header, int grace_seconds)
+{
+    memset(header, 0, sizeof(game_event_file_header));
+    header->magic = EVENT_FILE_MAGIC;
+    header->version = EVENT_FILE_VERSION;
+    header->event_size = sizeof(game_event);
+    header->grace_seconds = grace_seconds;
+}
+
+static bool valid_header(const game_event_file_header* header)
+{
+    return header->magic == EVENT_FILE_MAGIC && header->version == EVENT_FILE_VERSION &&
+        header->event_size == sizeof(game_event);
+}
+
+/*
+ * Attiva la persistenza degli eventi in coda al file specificato, creandolo se non esiste.
+ * Un file già esistente deve essere stato scritto da un server con lo stesso formato degli eventi.
+ * Gli eventi contengono i token di ripresa delle sessioni, quindi il file è leggibile solo dal proprietario.
+ *
+ * Parametri:
+ *   - path: Percorso del file di eventi.
+ *   - grace_seconds: Periodo di attesa delle sessioni senza connessione, scritto nell'intestazione di un nuovo file.
+ *
+ * Restituisce:
+ *   - true se il file è pronto, false altrimenti.
+ */
+bool event_log_persist(event_log* log, const char* path, int grace_seconds)
+{
+    game_event_file_header header;
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) != 0 || fchmod(fd, 0600) != 0) {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0)
+    {
+        // File nuovo: viene scritta l'intestazione
+        init_header(&header, grace_seconds);
+        if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+            close(fd);
+            return false;
+        }
+    }
+    else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || !valid_header(&header))
+    {
+        // Il file esiste ma non è un file di eventi di questo formato
+        close(fd);
+        return false;
+    }
+
+    if (log->fd >= 0)
+        close(log->fd);
+    log->fd = fd;
+    return true;
+}
+
+void event_log_close(event_log* log)
+{
+    if (log->fd >= 0)
+        close(log->fd);
+    log->fd = -1;
+}
+
+/*
+ * Restituisce la posizione del buffer in cui scrivere il prossimo evento, sovrascrivendo il più vecchio
+ * se il buffer è pieno. L'evento va completato e poi registrato con event_log_commit.
+ */
+game_event* event_log_next(event_log* log)
+{
+    game_event* event = &log->ring[log->n_events % EVENT_RING_DIM];
+
+    memset(event, 0, sizeof(game_event));
+    event->seq = log->n_events;
+    return event;
+}
+
+/*
+ * Registra l'evento restituito dall'ultima event_log_next e, se la persistenza è attiva, lo aggiunge al file.
+ */
+void event_log_commit(event_log* log, game_event* event)
+{
+    log->n_events++;
+
+    if (log->fd >= 0 && write(log->fd, event, sizeof(game_event)) != sizeof(game_event))
+        log->n_write_errors++;
+}
+
+/*
+ * Scrive in un file di eventi il contenuto del buffer, dal più vecchio al più recente.
+ * Come il file di persistenza, è leggibile solo dal proprietario.
+ *
+ * Restituisce:
+ *   - true se il file è stato scritto, false altrimenti.
+ */
+bool event_log_dump(const event_log* log, const char* path, int grace_seconds)
+{
+    game_event_file_header header;
+    uint64_t seq = log->n_events > EVENT_RING_DIM ? log->n_events - EVENT_RING_DIM : 0;
+    bool ok = true;
+    int raw = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    FILE* fd = raw >= 0 ? fdopen(raw, "wb") : NULL;
+
+    if (fd == NULL) {
+        if (raw >= 0)
+            close(raw);
+        return false;
+    }
+
+    init_header(&header, grace_seconds);
+    ok = fwrite(&header, sizeof(header), 1, fd) == 1;
+    for (; ok && seq < log->n_events; seq++)
+        ok = fwrite(&log->ring[seq % EVENT_RING_DIM], sizeof(game_event), 1, fd) == 1;
+
+    ok = fclose(fd) == 0 && ok;
+    return ok;
+}
+
+/*
+ * Apre un file di eventi in lettura e ne verifica l'intestazione.
+ *
+ * Restituisce:
+ *   - Il file posizionato sul primo evento, o NULL se il file non esiste o non è un file di eventi di questo formato.
+ */
+FILE* event_file_open(const char* path, game_event_file_header* header)
+{
+    FILE* fd = fopen(path, "rb");
+
+    if (fd == NULL)
+        return NULL;
+
+    if (fread(header, sizeof(game_event_file_header), 1, fd) != 1 || !valid_header(header)) {
+        fclose(fd);
+        return NULL;
+    }
+    return fd;
+}
+
+/*
+ * Legge il prossimo evento dal file.
+ *
+ * Restituisce:
+ *   - true se è stato letto un evento completo, false alla fine del file.
+ */
+bool event_file_read(FILE* fd, game_event* event)
+{
+    if (fread(event, sizeof(game_event), 1, fd) != 1)
+        return false;
+
+    // Le stringhe vengono terminate anche se il file è stato alterato
+    event->username[MAX_USR_DIM - 1] = '\0';
+    event->args[EVENT_ARGS_DIM - 1] = '\0';
+    event->state.resume_token[RESUME_TOKEN_DIM - 1] = '\0';
+    return true;
+}
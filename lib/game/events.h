@@ -0,0 +1,101 @@
+#ifndef GAME_EVENTS
+#define GAME_EVENTS
+
+#include <stdint.h>
+
+#include "shared.h"
+
+/*
+ * Registro degli eventi delle sessioni di gioco.
+ *
+ * Ogni comando che può modificare una sessione produce un evento con il comando, i suoi argomenti così come sono
+ * arrivati dal client, l'istante in cui è stato eseguito e lo stato della sessione che ne è risultato, insieme alle
+ * differenze rispetto allo stato precedente. Gli eventi più recenti restano in un buffer circolare in memoria
+ * e, se è stato indicato un file, vengono anche aggiunti in coda al file con una sola write ciascuno.
+ *
+ * Un file di eventi può essere rieseguito dallo strumento replay, che passa ogni comando agli stessi gestori
+ * del server con un orologio virtuale e confronta lo stato ottenuto con quello registrato.
+ */
+#define EVENT_RING_DIM      1024                    // Eventi conservati in memoria
+#define EVENT_ARGS_DIM      (MAX_USR_DIM + MAX_HELP_DIM)
+#define EVENT_DUMP_FILE     "events.dump"           // File in cui viene scritto il buffer su richiesta da standard input
+#define EVENT_FILE_MAGIC    0x54564545              // "EEVT" in little endian
+#define EVENT_FILE_VERSION  2
+
+typedef enum                                        // Tipi di evento
+{
+    EV_BOOT,                                        // Avvio del server, le sessioni ripristinate sono senza connessione
+    EV_START,                                       // Argomenti: numero della stanza
+    EV_RESUME,                                      // Argomenti: token di ripresa
+    EV_DETACH,                                      // Disconnessione del client durante la partita
+    EV_EXPIRE,                                      // Sessione senza connessione terminata da expireSessions
+    EV_LOOK,                                        // Argomenti: nome di una location o di un oggetto
+    EV_OBJS,
+    EV_USE,                                         // Argomenti: nomi di uno o due oggetti
+    EV_TAKE,                                        // Argomenti: nome dell'oggetto
+    EV_DROP,                                        // Argomenti: nome dell'oggetto
+    EV_PUZZLE,                                      // Argomenti: nome dell'oggetto e risposta
+    EV_HELP,                                        // Argomenti: numero dell'ultimo messaggio di aiuto ricevuto
+    EV_END,
+    EV_SU_TIME,                                     // Argomenti: username, secondi e operazione (+, -, =, p, r)
+    EV_SU_HELP                                      // Argomenti: username e messaggio di aiuto
+}
+game_event_type;
+
+typedef struct                                      // Stato di una sessione dopo un evento
+{
+    int32_t room;                                   // Stanza della sessione, -1 se la sessione non esiste
+    int32_t token;
+    int32_t n_bag_objs;
+    int32_t help_msg_id;
+    int32_t paused;                                 // Motivi per cui il tempo è fermo (SESSION_PAUSE_*)
+    int64_t remaining;                              // Millisecondi rimanenti all'istante dell'evento
+    uint32_t objs_hash;                             // Hash dei quattro insiemi di oggetti
+    char resume_token[RESUME_TOKEN_DIM];
+}
+game_event_state;
+
+typedef struct                                      // Evento registrato
+{
+    uint64_t seq;                                   // Numero progressivo dall'avvio del server
+    int64_t timestamp;                              // Istante dell'evento in ms sull'orologio monotono del gioco
+    int32_t type;                                   // game_event_type
+    char username[MAX_USR_DIM];                     // Giocatore della sessione interessata
+    char args[EVENT_ARGS_DIM];                      // Payload del comando
+
+    game_event_state state;                         // Stato della sessione dopo l'evento
+    int32_t d_token;                                // Differenze rispetto allo stato prima dell'evento
+    int32_t d_bag_objs;
+    int64_t d_remaining;                            // Millisecondi aggiunti o tolti, esclusi quelli trascorsi
+    uint32_t d_objs;                                // Bit degli insiemi di oggetti cambiati
+}
+game_event;
+
+typedef struct                                      // Intestazione di un file di eventi
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t event_size;                            // sizeof(game_event), per riconoscere file di un'altra build
+    int32_t grace_seconds;                          // Periodo di attesa delle sessioni senza connessione del server
+}
+game_event_file_header;
+
+typedef struct                                      // Registro degli eventi
+{
+    game_event ring[EVENT_RING_DIM];
+    uint64_t n_events;                              // Eventi registrati dall'avvio
+    int fd;                                         // File di persistenza aperto in append, -1 se disattivata
+    unsigned long n_write_errors;
+}
+event_log;
+
+bool event_log_persist(event_log* log, const char* path, int grace_seconds);
+void event_log_close(event_log* log);
+game_event* event_log_next(event_log* log);
+void event_log_commit(event_log* log, game_event* event);
+bool event_log_dump(const event_log* log, const char* path, int grace_seconds);
+
+FILE* event_file_open(const char* path, game_event_file_header* header);
+bool event_file_read(FILE* fd, game_event* event);
+
+#endif
@@ -0,0 +1,817 @@
+#include "room.h"
+
+typedef struct                                      // Codice in costruzione durante la compilazione
+{
+    const room_view* view;
+    const uint32_t* lock_first;                     // Azioni di sblocco di ogni oggetto, nella sezione delle azioni
+    const uint32_t* lock_n;
+    uint64_t* unlocking;                            // Oggetti di cui si sta espandendo la cascata
+    room_op* ops;
+    size_t n_ops;
+    size_t dim;
+    bool failed;                                    // Memoria esaurita o troppe istruzioni
+}
+room_code;
+
+static size_t align8(size_t n);
+static uint32_t add_string(char* strings, size_t* used, const char* str);
+static void build_name_index(room_view* view, room_name_slot* names, const game_room_def* def);
+static uint32_t resolve_obj(const room_view* view, const char* name);
+static void build_use_index(room_view* view, room_use_slot* slots);
+static void* compile_code(char* image, const uint32_t* lock_first, const uint32_t* lock_n);
+static void emit_action(room_code* code, const room_action* action);
+static void emit_unlock(room_code* code, uint32_t obj);
+static void emit_op(room_code* code, uint32_t type, uint32_t obj);
+static bool check_str(const room_header* header, uint32_t off);
+static bool check_section(const room_header* header, uint32_t off, size_t count, size_t elem_size);
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * Copia una stringa in coda alla tabella delle stringhe.
+ *
+ * Restituisce:
+ *   - L'offset della stringa nella tabella.
+ */
+static uint32_t add_string(char* strings, size_t* used, const char* str)
+{
+    size_t len = strlen(str) + 1;
+    uint32_t off = (uint32_t)*used;
+
+    memcpy(strings + off, str, len);
+    *used += len;
+    return off;
+}
+
+/*
+ * Compila la definizione di una room nella sua immagine.
+ * L'immagine è allocata con malloc e va liberata con free.
+ *
+ * Parametri:
+ *   - def: Definizione della room.
+ *   - size: Variabile in cui scrivere la dimensione dell'immagine.
+ *
+ * Restituisce:
+ *   - Il puntatore all'immagine, o NULL in caso di errore nell'allocazione di memoria
+ *     o se la room è troppo grande per essere rappresentata.
+ */
+void* room_compile(const game_room_def* def, size_t* size)
+{
+    size_t n_objs = 0, n_uses = 0, n_actions = 0, n_names, n_slots = 1, n_use_slots = 1, n_words;
+    size_t strings_size = 1, strings_used = 1, total;
+    size_t off_objs, off_texts, off_uses, off_actions, off_locations, off_names, off_use_slots, off_locked, off_hidden, off_strings;
+    size_t use_i = 0, action_i = 0;
+    uint32_t* lock_first;
+    uint32_t* lock_n;
+    room_header* header;
+    room_view view;
+    char* image;
+    char* strings;
+    uint32_t id;
+    int i, j, k, u;
+
+    // Conteggio degli elementi e dello spazio occupato dai testi
+    strings_size += strlen(def->name) + strlen(def->story) + strlen(def->descr) + 3;
+    strings_size += strlen(def->timeout_text) + strlen(def->quit_text) + strlen(def->win_text) + 3;
+    for (i = 0; i < def->n_locations; i++)
+    {
+        const game_location* loc = &def->locations[i];
+        strings_size += strlen(loc->name) + strlen(loc->descr) + 2;
+
+        for (j = 0; j < loc->n_objs; j++)
+        {
+            const game_obj* obj = &loc->objs[j];
+            n_objs++;
+            if (obj->n_uses > UINT16_MAX)
+                return NULL;
+            strings_size += strlen(obj->name) + strlen(obj->locked_descr) + strlen(obj->unlocked_descr) + 3;
+            if (obj->isLocked) {
+                n_actions += obj->lock.n_actions;
+                if (obj->lock.type == LOCK_PUZZLE)
+                    strings_size += strlen(obj->lock.puzzle.text) + strlen(obj->lock.puzzle.solution) + 2;
+            }
+
+            n_uses += obj->n_uses;
+            for (u = 0; u < obj->n_uses; u++) {
+                n_actions += obj->uses[u].n_actions;
+                strings_size += strlen(obj->uses[u].use_descr) + 1;
+            }
+        }
+    }
+
+    n_names = n_objs + def->n_locations;
+    while (n_slots < 2 * n_names)
+        n_slots *= 2;
+    while (n_use_slots <= 2 * n_uses)
+        n_use_slots *= 2;
+    n_words = OBJ_SET_WORDS(n_objs);
+
+    // Disposizione delle sezioni
+    off_objs = align8(sizeof(room_header));
+    off_texts = align8(off_objs + n_objs * sizeof(room_obj));
+    off_uses = align8(off_texts + n_objs * sizeof(room_obj_text));
+    off_actions = align8(off_uses + n_uses * sizeof(room_use));
+    off_locations = align8(off_actions + n_actions * sizeof(room_action));
+    off_names = align8(off_locations + def->n_locations * sizeof(room_location));
+    off_use_slots = align8(off_names + n_slots * sizeof(room_name_slot));
+    off_locked = align8(off_use_slots + n_use_slots * sizeof(room_use_slot));
+    off_hidden = off_locked + n_words * sizeof(uint64_t);
+    off_strings = off_hidden + n_words * sizeof(uint64_t);
+    total = align8(off_strings + strings_size);
+
+    if (total > UINT32_MAX)
+        return NULL;
+
+    image = calloc(1, total);
+    lock_first = calloc(n_objs + 1, sizeof(uint32_t));
+    lock_n = calloc(n_objs + 1, sizeof(uint32_t));
+    if (image == NULL || lock_first == NULL || lock_n == NULL) {
+        free(image);
+        free(lock_first);
+        free(lock_n);
+        return NULL;
+    }
+
+    header = (room_header*)image;
+    header->magic = ROOM_IMAGE_MAGIC;
+    header->version = ROOM_IMAGE_VERSION;
+    header->size = total;
+    header->dim_bag = def->dim_bag;
+    header->token = def->token;
+    header->seconds = def->seconds;
+    header->n_locations = def->n_locations;
+    header->n_objs = n_objs;
+    header->n_uses = n_uses;
+    header->n_actions = n_actions;
+    header->n_name_slots = n_slots;
+    header->n_use_slots = n_use_slots;
+    header->n_obj_words = n_words;
+    header->strings_size = strings_size;
+    header->objs_off = off_objs;
+    header->obj_texts_off = off_texts;
+    header->uses_off = off_uses;
+    header->actions_off = off_actions;
+    header->locations_off = off_locations;
+    header->names_off = off_names;
+    header->use_slots_off = off_use_slots;
+    header->initial_locked_off = off_locked;
+    header->initial_hidden_off = off_hidden;
+    header->strings_off = off_strings;
+
+    // Le sezioni vengono scritte attraverso la stessa vista usata per leggerle
+    strings = image + off_strings;
+    view.header = header;
+    view.objs = (room_obj*)(image + off_objs);
+    view.obj_texts = (room_obj_text*)(image + off_texts);
+    view.uses = (room_use*)(image + off_uses);
+    view.actions = (room_action*)(image + off_actions);
+    view.code = NULL;
+    view.locations = (room_location*)(image + off_locations);
+    view.names = (room_name_slot*)(image + off_names);
+    view.use_slots = (room_use_slot*)(image + off_use_slots);
+    view.initial_locked = (uint64_t*)(image + off_locked);
+    view.initial_hidden = (uint64_t*)(image + off_hidden);
+    view.strings = strings;
+
+    header->name = add_string(strings, &strings_used, def->name);
+    header->story = add_string(strings, &strings_used, def->story);
+    header->descr = add_string(strings, &strings_used, def->descr);
+    header->timeout_text = add_string(strings, &strings_used, def->timeout_text);
+    header->quit_text = add_string(strings, &strings_used, def->quit_text);
+    header->win_text = add_string(strings, &strings_used, def->win_text);
+
+    // Locazioni e oggetti, con gli id assegnati nell'ordine di definizione
+    id = 0;
+    for (i = 0; i < def->n_locations; i++)
+    {
+        const game_location* loc = &def->locations[i];
+        room_location* rloc = (room_location*)&view.locations[i];
+
+        rloc->name = add_string(strings, &strings_used, loc->name);
+        rloc->descr = add_string(strings, &strings_used, loc->descr);
+        rloc->first_obj = id;
+        rloc->n_objs = loc->n_objs;
+
+        for (j = 0; j < loc->n_objs; j++, id++)
+        {
+            const game_obj* obj = &loc->objs[j];
+            room_obj* robj = (room_obj*)&view.objs[id];
+            room_obj_text* rtext = (room_obj_text*)&view.obj_texts[id];
+
+            robj->name_hash = (uint32_t)hash_string(obj->name);
+            robj->location = i;
+            robj->n_uses = obj->n_uses;
+            if (obj->isLocked) {
+                robj->flags |= ROOM_OBJ_LOCKED;
+                ((uint64_t*)view.initial_locked)[id >> 6] |= 1ULL << (id & 63);
+                if (obj->lock.type == LOCK_PUZZLE)
+                    robj->flags |= ROOM_OBJ_LOCK_PUZZLE;
+            }
+            if (obj->isHidden) {
+                robj->flags |= ROOM_OBJ_HIDDEN;
+                ((uint64_t*)view.initial_hidden)[id >> 6] |= 1ULL << (id & 63);
+            }
+            if (obj->takeable)
+                robj->flags |= ROOM_OBJ_TAKEABLE;
+            if (obj->consumable)
+                robj->flags |= ROOM_OBJ_CONSUMABLE;
+            if (obj->isLocked || obj->isHidden || obj->consumable)
+                header->n_special_objs++;
+
+            rtext->name = add_string(strings, &strings_used, obj->name);
+            rtext->locked_descr = add_string(strings, &strings_used, obj->locked_descr);
+            rtext->unlocked_descr = add_string(strings, &strings_used, obj->unlocked_descr);
+            if (obj->isLocked && obj->lock.type == LOCK_PUZZLE) {
+                rtext->puzzle_text = add_string(strings, &strings_used, obj->lock.puzzle.text);
+                rtext->puzzle_solution = add_string(strings, &strings_used, obj->lock.puzzle.solution);
+            }
+        }
+    }
+
+    // L'indice dei nomi serve a risolvere i target di usi e azioni
+    build_name_index(&view, (room_name_slot*)view.names, def);
+
+    // Usi e azioni, con i nomi degli oggetti risolti in id
+    id = 0;
+    for (i = 0; i < def->n_locations; i++)
+    {
+        for (j = 0; j < def->locations[i].n_objs; j++, id++)
+        {
+            const game_obj* obj = &def->locations[i].objs[j];
+            room_obj* robj = (room_obj*)&view.objs[id];
+
+            lock_first[id] = action_i;
+            if (obj->isLocked) {
+                lock_n[id] = obj->lock.n_actions;
+                for (k = 0; k < obj->lock.n_actions; k++, action_i++) {
+                    room_action* raction = (room_action*)&view.actions[action_i];
+                    raction->type = obj->lock.actions[k].type;
+                    raction->obj = obj->lock.actions[k].type == ACTION_TOKEN ? ROOM_NO_OBJ : resolve_obj(&view, obj->lock.actions[k].obj_name);
+                }
+            }
+
+            robj->first_use = use_i;
+            for (u = 0; u < obj->n_uses; u++, use_i++)
+            {
+                const game_use* use = &obj->uses[u];
+                room_use* ruse = (room_use*)&view.uses[use_i];
+
+                ruse->type = use->type;
+                ruse->other_obj = use->type == USE_COMBINE ? resolve_obj(&view, use->otherObj) : ROOM_NO_OBJ;
+                ruse->descr = add_string(strings, &strings_used, use->use_descr);
+                ruse->first_action = action_i;
+                ruse->n_actions = use->n_actions;
+                for (k = 0; k < use->n_actions; k++, action_i++) {
+                    room_action* raction = (room_action*)&view.actions[action_i];
+                    raction->type = use->actions[k].type;
+                    raction->obj = use->actions[k].type == ACTION_TOKEN ? ROOM_NO_OBJ : resolve_obj(&view, use->actions[k].obj_name);
+                }
+            }
+        }
+    }
+
+    build_use_index(&view, (room_use_slot*)view.use_slots);
+
+    // Il codice si scrive per ultimo, perché la sua dimensione è nota solo dopo aver espanso le cascate
+    image = compile_code(image, lock_first, lock_n);
+    free(lock_first);
+    free(lock_n);
+    if (image != NULL)
+        *size = ((room_header*)image)->size;
+    return image;
+}
+
+/*
+ * Compila il codice di ogni sblocco e di ogni uso e lo aggiunge in coda all'immagine.
+ *
+ * Parametri:
+ *   - image: Immagine con tutte le altre sezioni già scritte, liberata in caso di errore.
+ *   - lock_first, lock_n: Azioni di sblocco di ogni oggetto.
+ *
+ * Restituisce:
+ *   - Il puntatore all'immagine, eventualmente spostata, o NULL in caso di errore nell'allocazione di memoria
+ *     o se il codice supera ROOM_MAX_OPS istruzioni.
+ */
+static void* compile_code(char* image, const uint32_t* lock_first, const uint32_t* lock_n)
+{
+    room_header* header = (room_header*)image;
+    room_code code = { .lock_first = lock_first, .lock_n = lock_n };
+    room_view view;
+    room_obj* objs = (room_obj*)(image + header->objs_off);
+    room_use* uses = (room_use*)(image + header->uses_off);
+    size_t off_code = header->size, total;
+    uint32_t i, k;
+    char* grown;
+
+    view.header = header;
+    view.objs = objs;
+    view.actions = (const room_action*)(image + header->actions_off);
+    code.view = &view;
+    code.unlocking = calloc(header->n_obj_words + 1, sizeof(uint64_t));
+    code.failed = code.unlocking == NULL;
+
+    // Lo sblocco di un oggetto, usato quando si risolve il suo enigma
+    for (i = 0; i < header->n_objs && !code.failed; i++) {
+        objs[i].first_unlock_op = code.n_ops;
+        emit_unlock(&code, i);
+        objs[i].n_unlock_ops = code.n_ops - objs[i].first_unlock_op;
+    }
+    for (i = 0; i < header->n_uses && !code.failed; i++) {
+        uses[i].first_op = code.n_ops;
+        for (k = 0; k < uses[i].n_actions; k++)
+            emit_action(&code, &view.actions[uses[i].first_action + k]);
+        uses[i].n_ops = code.n_ops - uses[i].first_op;
+    }
+    free(code.unlocking);
+
+    total = align8(off_code + code.n_ops * sizeof(room_op));
+    grown = code.failed || total > UINT32_MAX ? NULL : realloc(image, total);
+    if (grown == NULL) {
+        free(code.ops);
+        free(image);
+        return NULL;
+    }
+
+    header = (room_header*)grown;
+    header->size = total;
+    header->n_ops = code.n_ops;
+    header->code_off = off_code;
+    memset(grown + off_code, 0, total - off_code);
+    if (code.n_ops > 0)
+        memcpy(grown + off_code, code.ops, code.n_ops * sizeof(room_op));
+    free(code.ops);
+    return grown;
+}
+
+// Compila un'azione, scartandola se non può avere effetto in nessuno stato della partita
+static void emit_action(room_code* code, const room_action* action)
+{
+    const room_view* view = code->view;
+    uint32_t obj = action->obj;
+
+    switch (action->type)
+    {
+        case ACTION_TOKEN:
+            emit_op(code, ACTION_TOKEN, ROOM_NO_OBJ);
+            break;
+        case ACTION_UNLOCK:
+            emit_unlock(code, obj);
+            break;
+        case ACTION_REVEAL:
+            if (obj != ROOM_NO_OBJ && (view->objs[obj].flags & ROOM_OBJ_HIDDEN))
+                emit_op(code, ACTION_REVEAL, obj);
+            break;
+        case ACTION_CONSUME:
+            if (obj != ROOM_NO_OBJ && (view->objs[obj].flags & ROOM_OBJ_CONSUMABLE))
+                emit_op(code, ACTION_CONSUME, obj);
+            break;
+    }
+}
+
+/*
+ * Compila lo sblocco di un oggetto seguito dalla sua cascata. Nessuna azione blocca un oggetto, quindi uno sblocco
+ * non ha effetto se l'oggetto non è bloccato a inizio partita o se è già stato sbloccato più in alto nella stessa
+ * cascata; questo rende anche finita l'espansione delle cascate cicliche.
+ */
+static void emit_unlock(room_code* code, uint32_t obj)
+{
+    size_t at = code->n_ops;
+    uint32_t k;
+
+    if (obj == ROOM_NO_OBJ || (code->view->objs[obj].flags & ROOM_OBJ_LOCKED) == 0 ||
+        (code->unlocking[obj >> 6] >> (obj & 63)) & 1)
+        return;
+
+    emit_op(code, ACTION_UNLOCK, obj);
+    code->unlocking[obj >> 6] |= 1ULL << (obj & 63);
+    for (k = 0; k < code->lock_n[obj] && !code->failed; k++)
+        emit_action(code, &code->view->actions[code->lock_first[obj] + k]);
+    code->unlocking[obj >> 6] &= ~(1ULL << (obj & 63));
+
+    if (!code->failed)
+        code->ops[at].skip = code->n_ops - at - 1;
+}
+
+static void emit_op(room_code* code, uint32_t type, uint32_t obj)
+{
+    room_op* op;
+
+    if (code->failed)
+        return;
+    if (code->n_ops == code->dim) {
+        size_t dim = code->dim == 0 ? 64 : code->dim * 2;
+        room_op* grown = code->n_ops < ROOM_MAX_OPS ? realloc(code->ops, dim * sizeof(room_op)) : NULL;
+        if (grown == NULL) {
+            code->failed = true;
+            return;
+        }
+        code->ops = grown;
+        code->dim = dim;
+    }
+
+    op = &code->ops[code->n_ops++];
+    op->type = type;
+    op->obj = obj;
+    op->skip = 0;
+}
+
+/*
+ * Costruisce l'indice dei nomi. A parità di nome viene indicizzato il primo oggetto e la prima locazione
+ * nell'ordine di definizione, scandendo per ogni locazione prima il suo nome e poi i suoi oggetti.
+ */
+static void build_name_index(room_view* view, room_name_slot* names, const game_room_def* def)
+{
+    uint32_t mask = view->header->n_name_slots - 1;
+    uint32_t id = 0;
+    int i, j;
+
+    for (i = 0; i < def->n_locations; i++)
+    {
+        for (j = -1; j < def->locations[i].n_objs; j++)
+        {
+            // j = -1 indica la locazione stessa, j >= 0 i suoi oggetti
+            uint32_t name_off = j < 0 ? view->locations[i].name : view->obj_texts[id].name;
+            const char* name = room_str(view, name_off);
+            uint32_t hash = (uint32_t)hash_string(name);
+            uint32_t slot;
+
+            // Ricerca della cella del nome, o della prima cella libera
+            for (slot = hash & mask; names[slot].name != 0; slot = (slot + 1) & mask)
+            {
+                if (names[slot].name_hash == hash && strcmp(room_str(view, names[slot].name), name) == 0)
+                    break;
+            }
+
+            if (names[slot].name == 0) {
+                names[slot].name_hash = hash;
+                names[slot].name = name_off;
+                names[slot].obj = ROOM_NO_OBJ;
+                names[slot].location = ROOM_NO_OBJ;
+            }
+
+            if (j < 0 && names[slot].location == ROOM_NO_OBJ)
+                names[slot].location = i;
+            else if (j >= 0 && names[slot].obj == ROOM_NO_OBJ)
+                names[slot].obj = id;
+
+            if (j >= 0)
+                id++;
+        }
+    }
+}
+
+/*
+ * Costruisce la tabella degli usi. Per ogni coppia di oggetti viene indicizzato solo il primo uso definito,
+ * che è quello eseguito dal comando use.
+ */
+static void build_use_index(room_view* view, room_use_slot* slots)
+{
+    uint32_t mask = view->header->n_use_slots - 1;
+    uint32_t obj, u, slot;
+
+    for (slot = 0; slot <= mask; slot++)
+        slots[slot].obj = ROOM_NO_OBJ;
+
+    for (obj = 0; obj < view->header->n_objs; obj++)
+    {
+        for (u = view->objs[obj].first_use; u < view->objs[obj].first_use + view->objs[obj].n_uses; u++)
+        {
+            uint32_t other = view->uses[u].type == USE_ALONE ? ROOM_NO_OBJ : view->uses[u].other_obj;
+
+            if (view->uses[u].type == USE_COMBINE && other == ROOM_NO_OBJ)
+                continue;
+            for (slot = room_use_hash(obj, other) & mask; slots[slot].obj != ROOM_NO_OBJ; slot = (slot + 1) & mask)
+            {
+                if (slots[slot].obj == obj && slots[slot].other_obj == other)
+                    break;
+            }
+            if (slots[slot].obj == ROOM_NO_OBJ) {
+                slots[slot].obj = obj;
+                slots[slot].other_obj = other;
+                slots[slot].use = u;
+            }
+        }
+    }
+}
+
+static uint32_t resolve_obj(const room_view* view, const char* name)
+{
+    const room_name_slot* slot = room_find_name(view, name);
+    return slot == NULL ? ROOM_NO_OBJ : slot->obj;
+}
+
+static bool check_str(const room_header* header, uint32_t off)
+{
+    return off < header->strings_size;
+}
+
+static bool check_section(const room_header* header, uint32_t off, size_t count, size_t elem_size)
+{
+    return off % 8 == 0 && off <= header->size && count * elem_size <= header->size - off;
+}
+
+/*
+ * Prepara la vista su un'immagine compilata, verificando che tutti gli offset e gli indici
+ * restino all'interno dell'immagine. L'immagine non viene copiata e deve restare valida finché la vista è in uso.
+ *
+ * Parametri:
+ *   - view: Vista da inizializzare.
+ *   - image: Immagine, allineata almeno a 8 byte.
+ *   - size: Dimensione del buffer che contiene l'immagine.
+ *
+ * Restituisce:
+ *   - true se l'immagine è valida, false altrimenti.
+ */
+bool room_attach(room_view* view, const void* image, size_t size)
+{
+    const room_header* header = image;
+    const char* base = image;
+    uint32_t i, k, n_used_slots = 0;
+
+    if (size < sizeof(room_header) || ((uintptr_t)image & 7) != 0)
+        return false;
+    if (header->magic != ROOM_IMAGE_MAGIC || header->version != ROOM_IMAGE_VERSION || header->size > size)
+        return false;
+    if (header->n_obj_words != OBJ_SET_WORDS(header->n_objs) || header->n_name_slots == 0 ||
+        (header->n_name_slots & (header->n_name_slots - 1)) != 0 || header->strings_size == 0 ||
+        header->n_use_slots == 0 || (header->n_use_slots & (header->n_use_slots - 1)) != 0)
+        return false;
+
+    if (!check_section(header, header->objs_off, header->n_objs, sizeof(room_obj)) ||
+        !check_section(header, header->obj_texts_off, header->n_objs, sizeof(room_obj_text)) ||
+        !check_section(header, header->uses_off, header->n_uses, sizeof(room_use)) ||
+        !check_section(header, header->actions_off, header->n_actions, sizeof(room_action)) ||
+        !check_section(header, header->code_off, header->n_ops, sizeof(room_op)) ||
+        !check_section(header, header->locations_off, header->n_locations, sizeof(room_location)) ||
+        !check_section(header, header->names_off, header->n_name_slots, sizeof(room_name_slot)) ||
+        !check_section(header, header->use_slots_off, header->n_use_slots, sizeof(room_use_slot)) ||
+        !check_section(header, header->initial_locked_off, header->n_obj_words, sizeof(uint64_t)) ||
+        !check_section(header, header->initial_hidden_off, header->n_obj_words, sizeof(uint64_t)) ||
+        header->strings_off > header->size || header->strings_size > header->size - header->strings_off)
+        return false;
+
+    view->header = header;
+    view->objs = (const room_obj*)(base + header->objs_off);
+    view->obj_texts = (const room_obj_text*)(base + header->obj_texts_off);
+    view->uses = (const room_use*)(base + header->uses_off);
+    view->actions = (const room_action*)(base + header->actions_off);
+    view->code = (const room_op*)(base + header->code_off);
+    view->locations = (const room_location*)(base + header->locations_off);
+    view->names = (const room_name_slot*)(base + header->names_off);
+    view->use_slots = (const room_use_slot*)(base + header->use_slots_off);
+    view->initial_locked = (const uint64_t*)(base + header->initial_locked_off);
+    view->initial_hidden = (const uint64_t*)(base + header->initial_hidden_off);
+    view->strings = base + header->strings_off;
+
+    // Ogni stringa termina entro la tabella e l'offset 0 è la stringa vuota
+    if (view->strings[0] != '\0' || view->strings[header->strings_size - 1] != '\0')
+        return false;
+    if (!check_str(header, header->name) || !check_str(header, header->story) || !check_str(header, header->descr) ||
+        !check_str(header, header->timeout_text) || !check_str(header, header->quit_text) || !check_str(header, header->win_text))
+        return false;
+
+    for (i = 0; i < header->n_locations; i++)
+    {
+        const room_location* loc = &view->locations[i];
+        if (!check_str(header, loc->name) || !check_str(header, loc->descr) ||
+            loc->first_obj > header->n_objs || loc->n_objs > header->n_objs - loc->first_obj)
+            return false;
+    }
+
+    for (i = 0; i < header->n_objs; i++)
+    {
+        const room_obj* obj = &view->objs[i];
+        const room_obj_text* text = &view->obj_texts[i];
+        if (obj->location >= header->n_locations ||
+            obj->first_use > header->n_uses || obj->n_uses > header->n_uses - obj->first_use ||
+            obj->first_unlock_op > header->n_ops || obj->n_unlock_ops > header->n_ops - obj->first_unlock_op)
+            return false;
+        if (!check_str(header, text->name) || !check_str(header, text->locked_descr) || !check_str(header, text->unlocked_descr) ||
+            !check_str(header, text->puzzle_text) || !check_str(header, text->puzzle_solution))
+            return false;
+    }
+
+    for (i = 0; i < header->n_uses; i++)
+    {
+        const room_use* use = &view->uses[i];
+        if ((use->other_obj != ROOM_NO_OBJ && use->other_obj >= header->n_objs) || !check_str(header, use->descr) ||
+            use->first_action > header->n_actions || use->n_actions > header->n_actions - use->first_action ||
+            use->first_op > header->n_ops || use->n_ops > header->n_ops - use->first_op)
+            return false;
+    }
+
+    for (i = 0; i < header->n_actions; i++)
+    {
+        const room_action* action = &view->actions[i];
+        if (action->type > ACTION_TOKEN || (action->obj != ROOM_NO_OBJ && action->obj >= header->n_objs))
+            return false;
+    }
+
+    // Un salto non esce dal codice, e l'unico target assente ammesso è quello dei token
+    for (i = 0; i < header->n_ops; i++)
+    {
+        const room_op* op = &view->code[i];
+        if (op->type > ACTION_TOKEN || op->skip > header->n_ops - i - 1 ||
+            (op->obj == ROOM_NO_OBJ ? op->type != ACTION_TOKEN : op->obj >= header->n_objs))
+            return false;
+    }
+
+    // Almeno una cella libera, perché la ricerca di un nome assente termini
+    for (k = 0; k < header->n_name_slots; k++)
+    {
+        const room_name_slot* slot = &view->names[k];
+        if (slot->name == 0)
+            continue;
+        n_used_slots++;
+        if (!check_str(header, slot->name) ||
+            (slot->obj != ROOM_NO_OBJ && slot->obj >= header->n_objs) ||
+            (slot->location != ROOM_NO_OBJ && slot->location >= header->n_locations))
+            return false;
+    }
+    if (n_used_slots == header->n_name_slots)
+        return false;
+
+    // Anche la tabella degli usi ha almeno una cella libera
+    for (k = 0, n_used_slots = 0; k < header->n_use_slots; k++)
+    {
+        const room_use_slot* slot = &view->use_slots[k];
+        if (slot->obj == ROOM_NO_OBJ)
+            continue;
+        n_used_slots++;
+        if (slot->obj >= header->n_objs || (slot->other_obj != ROOM_NO_OBJ && slot->other_obj >= header->n_objs) ||
+            slot->use >= header->n_uses)
+            return false;
+    }
+    return n_used_slots < header->n_use_slots;
+}
+
+/*
+ * Cerca un nome nell'indice della room.
+ *
+ * Restituisce:
+ *   - La cella dell'indice, o NULL se nella room non c'è né un oggetto né una locazione con quel nome.
+ */
+const room_name_slot* room_find_name(const room_view* view, const char* name)
+{
+    uint32_t mask = view->header->n_name_slots - 1;
+    uint32_t hash = (uint32_t)hash_string(name);
+    uint32_t slot;
+
+    for (slot = hash & mask; view->names[slot].name != 0; slot = (slot + 1) & mask)
+    {
+        if (view->names[slot].name_hash == hash && strcmp(room_str(view, view->names[slot].name), name) == 0)
+            return &view->names[slot];
+    }
+    return NULL;
+}
+
+/*
+ * Legge l'intestazione e il nome di un'immagine senza verificarne il resto, che può non essere ancora
+ * in memoria. Prima di usare l'immagine va comunque chiamata room_attach.
+ *
+ * Parametri:
+ *   - name: Restituisce il nome della room.
+ *
+ * Restituisce:
+ *   - L'intestazione dell'immagine, o NULL se l'intestazione o il nome non sono validi.
+ */
+const room_header* room_peek(const void* image, size_t size, const char** name)
+{
+    const room_header* header = image;
+    const char* strings;
+
+    if (size < sizeof(room_header) || ((uintptr_t)image & 7) != 0)
+        return NULL;
+    if (header->magic != ROOM_IMAGE_MAGIC || header->version != ROOM_IMAGE_VERSION || header->size > size ||
+        header->n_obj_words != OBJ_SET_WORDS(header->n_objs) ||
+        header->strings_off > header->size || header->strings_size > header->size - header->strings_off ||
+        !check_str(header, header->name))
+        return NULL;
+
+    strings = (const char*)image + header->strings_off;
+    if (memchr(strings + header->name, '\0', header->strings_size - header->name) == NULL)
+        return NULL;
+
+    *name = strings + header->name;
+    return header;
+}
+
+/*
+ * Calcola un hash FNV-1a dell'immagine, a parole di 64 bit. Le immagini di room_compile hanno dimensione
+ * multipla di 8 byte; gli eventuali byte finali sono comunque inclusi.
+ */
+uint64_t room_image_hash(const void* image, size_t size)
+{
+    const uint64_t* words = image;
+    const unsigned char* tail = (const unsigned char*)image + (size & ~(size_t)7);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < size / 8; i++)
+        hash = (hash ^ words[i]) * 0x100000001b3ULL;
+    for (i = 0; i < size % 8; i++)
+        hash = (hash ^ tail[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+/*
+ * Scrive un pacchetto con le immagini specificate, nello stesso ordine. Il pacchetto viene scritto in un file
+ * temporaneo e poi rinominato, così che un server in avvio non possa mappare un pacchetto scritto a metà.
+ *
+ * Parametri:
+ *   - path: Percorso del pacchetto.
+ *   - images: Immagini compilate.
+ *   - sizes: Dimensioni delle immagini, multiple di 8 byte come quelle prodotte da room_compile.
+ *   - n: Numero di immagini.
+ *
+ * Restituisce:
+ *   - true se il pacchetto è stato scritto, false altrimenti.
+ */
+bool room_pack_write(const char* path, void* const* images, const size_t* sizes, uint32_t n)
+{
+    room_pack_header header;
+    room_pack_entry entry;
+    char tmp_path[256];
+    uint64_t off;
+    uint32_t i;
+    bool ok;
+    FILE* fd;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ROOM_PACK_MAGIC;
+    header.version = ROOM_PACK_VERSION;
+    header.image_version = ROOM_IMAGE_VERSION;
+    header.n_rooms = n;
+    header.size = align8(sizeof(header) + (uint64_t)n * sizeof(room_pack_entry));
+    for (i = 0; i < n; i++)
+        header.size += sizes[i];
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    fd = fopen(tmp_path, "wb");
+    if (fd == NULL)
+        return false;
+
+    ok = fwrite(&header, sizeof(header), 1, fd) == 1;
+    off = align8(sizeof(header) + (uint64_t)n * sizeof(room_pack_entry));
+    for (i = 0; ok && i < n; i++) {
+        entry.off = off;
+        entry.size = sizes[i];
+        entry.hash = room_image_hash(images[i], sizes[i]);
+        ok = fwrite(&entry, sizeof(entry), 1, fd) == 1;
+        off += sizes[i];
+    }
+
+    // Riempimento fino all'offset della prima immagine
+    for (off = sizeof(header) + (uint64_t)n * sizeof(room_pack_entry); ok && off % 8 != 0; off++)
+        ok = fputc(0, fd) != EOF;
+    for (i = 0; ok && i < n; i++)
+        ok = fwrite(images[i], 1, sizes[i], fd) == sizes[i];
+
+    ok = fclose(fd) == 0 && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Verifica l'intestazione e la tabella delle immagini di un pacchetto.
+ *
+ * Restituisce:
+ *   - Il numero di room del pacchetto, o 0 se il pacchetto non è valido.
+ */
+uint32_t room_pack_count(const void* pack, size_t size)
+{
+    const room_pack_header* header = pack;
+    const room_pack_entry* entries = (const room_pack_entry*)(header + 1);
+    uint32_t i;
+
+    if (size < sizeof(room_pack_header) || ((uintptr_t)pack & 7) != 0)
+        return 0;
+    if (header->magic != ROOM_PACK_MAGIC || header->version != ROOM_PACK_VERSION ||
+        header->image_version != ROOM_IMAGE_VERSION || header->size != size ||
+        header->n_rooms > (size - sizeof(room_pack_header)) / sizeof(room_pack_entry))
+        return 0;
+
+    for (i = 0; i < header->n_rooms; i++)
+        if (entries[i].off % 8 != 0 || entries[i].off > size || entries[i].size > size - entries[i].off)
+            return 0;
+    return header->n_rooms;
+}
+
+/*
+ * Restituisce l'immagine i-esima di un pacchetto già verificato con room_pack_count, con la sua dimensione
+ * e il suo hash. L'immagine va poi preparata con room_attach, che ne verifica il contenuto.
+ */
+const void* room_pack_image(const void* pack, uint32_t i, size_t* size, uint64_t* hash)
+{
+    const room_pack_entry* entry = (const room_pack_entry*)((const room_pack_header*)pack + 1) + i;
+
+    *size = entry->size;
+    *hash = entry->hash;
+    return (const char*)pack + entry->off;
+}
@@ -0,0 +1,355 @@
+#ifndef GAME_ROOM
+#define GAME_ROOM
+
+#include <stdint.h>
+
+#include "shared.h"
+
+//---Definizione delle room---//
+
+typedef enum                                        // Enumeratore che definisce i tipi di blocchi su un oggetto
+{
+    LOCK_OBJ,                                       // Indica se per sbloccare l'oggetto è necessario l'uso di un altro oggetto
+    LOCK_PUZZLE                                     // Indica se per sbloccare l'oggetto è necessario risolvere un enigma
+}
+game_lock_type;
+
+typedef enum                                        // Enumeratore che definisce i tipi di azioni
+{
+    ACTION_REVEAL,                                  // Azione che permette di rendere visibile un'oggetto nascosto
+    ACTION_UNLOCK,                                  // Azione che permette di sbloccare un'oggetto bloccato
+    ACTION_CONSUME,                                 // Azione che consuma un oggetto
+    ACTION_TOKEN                                    // Azione che assegna un token al giocatore
+}
+game_action_type;
+
+typedef enum                                        // Enumeratore che definisce i tipo di usi possibli
+{
+    USE_ALONE,                                      // L'oggetto può essere usato da solo
+    USE_COMBINE                                     // L'oggetto può essere combinato con un altro oggetto
+}
+game_use_type;
+
+typedef struct                                      // Struttura che definisce un'azione da eseguire su un oggetto
+{
+    game_action_type type;                          // Tipo di azione da eseguire
+    char obj_name[MAX_NAME_DIM];                    // Nome dell'oggetto target (se richiesto)
+}
+game_action;
+
+typedef struct                                      // Struttura che definisce un enigma
+{
+    char text[MAX_PUZZLE_DIM];                      // Contiene il testo dell'enigma
+    char solution[MAX_PUZZLE_SOL_DIM];              // Contiene la risposta corretta all'enigma
+}
+game_puzzle;
+
+typedef struct                                      // Struttura che definisce un lock su un oggetto
+{
+    game_lock_type type;                            // Specifica il tipo di blocco
+    int n_actions;                                  // Numero di azioni
+    game_action* actions;                           // Array di azioni da eseguire una volta sbloccato l'oggetto
+
+    game_puzzle puzzle;                             // Specifica l'enigma da risolvere, significativo quando type = LOCK_PUZZLE
+}
+game_lock;
+
+typedef struct                                      // Struttura che definisce un modo d'uso di un oggetto
+{
+    game_use_type type;                             // Specifia il tipo di uso
+    char otherObj[MAX_NAME_DIM];                    // Specifica il nome dell'oggetto con il quale è possibile combinarlo, significativo solo se type = USE_COMBINE
+
+    int n_actions;                                  // Numero di azioni
+    game_action* actions;                           // Array di azioni
+
+    char use_descr[MAX_DESCR_DIM];                  // Messaggio dopo aver usato l'oggetto
+}
+game_use;
+
+typedef struct                                      // Struttura che definisce un oggetto di gioco
+{
+    char name[MAX_NAME_DIM];                        // Nome dell'oggetto
+
+    bool isLocked;                                  // Specifica se l'oggetto è bloccato o meno
+    game_lock lock;                                 // Indica come sbloccare l'oggetto, significativo solo se isLocked = true
+
+    bool isHidden;                                  // Specifica se l'oggetto è visibile o meno
+    bool takeable;                                  // Indica se è possibile raccogliere l'oggetto
+    bool consumable;                                // Indica che l'oggetto non può essere riottenuto dopo averlo usato, significativo solo se takeable = true
+
+    int n_uses;                                     // Numero di usi possibili
+    game_use* uses;                                 // Array di modi d'uso
+
+    char locked_descr[MAX_DESCR_DIM];               // Descrizione dell'oggetto quando è bloccato
+    char unlocked_descr[MAX_DESCR_DIM];             // Descrizione dell'oggetto quando è sbloccato
+}
+game_obj;
+
+typedef struct                                      // Struttura che definisce una location della room
+{
+    char name[MAX_NAME_DIM];                        // Nome della location
+    char descr[MAX_DESCR_DIM];                      // Descrizione della location
+
+    int n_objs;                                     // Numero di oggetti nella location
+    game_obj* objs;                                 // Oggetti nella location
+}
+game_location;
+
+typedef struct                                      // Struttura che definisce una room, così come viene scritta
+{
+    char name[MAX_ROOM_NAME_DIM];                   // Nome della room
+    char story[MAX_DESCR_DIM];                      // Storia del gioco
+    char descr[MAX_DESCR_DIM];                      // Descrizione della room
+
+    char timeout_text[MAX_DESCR_DIM];               // Messaggio da mostrare al giocatore quando scade il tempo massimo
+    char quit_text[MAX_DESCR_DIM];                  // Messaggio da mostrare al giocatore quando abbandona la partita
+    char win_text[MAX_DESCR_DIM];                   // Messaggio da mostrare al giocatore quando ottiene tutti i token
+
+    int dim_bag;                                    // Dimensione dello zaino del giocatore
+    int token;                                      // Numero di token necessari per vincere
+    time_t seconds;                                 // Tempo in secondi che il giocatore ha a disposizione
+
+    int n_locations;                                // Numero di locazioni della room
+    game_location* locations;                       // Locations della room
+}
+game_room_def;
+
+//-------------------------//
+
+//---Immagine compilata delle room---//
+
+/*
+ * Una room viene compilata in un unico buffer rilocabile: ogni riferimento interno è un indice o un offset,
+ * mai un puntatore, così che l'immagine possa essere copiata, salvata su file o mappata in memoria così com'è.
+ *
+ * I dati consultati a ogni comando (flag, hash del nome, indici di usi e azioni) sono separati dai testi:
+ * gli oggetti caldi occupano 24 byte ciascuno, mentre descrizioni ed enigmi stanno in una tabella di stringhe
+ * a cui si accede solo quando un testo deve essere inviato al client.
+ * I nomi degli oggetti target di usi e azioni sono risolti in id durante la compilazione.
+ *
+ * Le azioni di ogni uso e lo sblocco di ogni oggetto sono compilati anche in codice: un array piatto di istruzioni
+ * in cui ogni sblocco è seguito dalle istruzioni della sua cascata, cioè dalle azioni di sblocco dell'oggetto,
+ * a loro volta espanse. Un uso si esegue così con un solo ciclo, senza ricorsione. Le azioni che non possono
+ * avere effetto in nessuno stato della partita (sblocco di un oggetto mai bloccato o già in corso di sblocco
+ * nella stessa cascata, rivelazione di un oggetto mai nascosto, consumo di un oggetto non consumabile)
+ * vengono scartate durante la compilazione.
+ *
+ * Una tabella hash indicizza gli usi per coppia (oggetto, oggetto con cui è combinato), con ROOM_NO_OBJ
+ * come secondo oggetto per l'uso da solo: trovare l'uso di un comando use costa una sola ricerca, qualunque sia
+ * il numero di usi definiti per l'oggetto.
+ */
+#define ROOM_IMAGE_MAGIC    0x4d4f4f52              // "ROOM" in little endian
+#define ROOM_IMAGE_VERSION  3
+#define ROOM_NO_OBJ         UINT32_MAX              // Riferimento a un oggetto assente
+#define OBJ_SET_WORDS(n)    (((n) + 63) / 64)       // Parole da 64 bit necessarie per un insieme di n oggetti
+#define ROOM_MAX_OPS        (1 << 20)               // Istruzioni oltre le quali la room viene rifiutata, contro cascate troppo ramificate
+
+#define ROOM_OBJ_LOCKED         (1 << 0)            // Bloccato a inizio partita
+#define ROOM_OBJ_HIDDEN         (1 << 1)            // Nascosto a inizio partita
+#define ROOM_OBJ_TAKEABLE       (1 << 2)            // Può essere raccolto
+#define ROOM_OBJ_CONSUMABLE     (1 << 3)            // Può essere consumato
+#define ROOM_OBJ_LOCK_PUZZLE    (1 << 4)            // Sbloccato da un enigma invece che da un altro oggetto
+
+typedef struct                                      // Intestazione dell'immagine, all'offset 0
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                                  // Dimensione totale dell'immagine in byte
+
+    uint32_t name;                                  // Offset dei testi della room nella tabella delle stringhe
+    uint32_t story;
+    uint32_t descr;
+    uint32_t timeout_text;
+    uint32_t quit_text;
+    uint32_t win_text;
+
+    uint32_t dim_bag;
+    uint32_t token;
+    uint32_t seconds;
+
+    uint32_t n_locations;
+    uint32_t n_objs;
+    uint32_t n_special_objs;                        // Oggetti bloccati, nascosti o consumabili
+    uint32_t n_uses;
+    uint32_t n_actions;
+    uint32_t n_ops;                                 // Istruzioni del codice di usi e sblocchi
+    uint32_t n_name_slots;                          // Potenza di 2
+    uint32_t n_use_slots;                           // Potenza di 2
+    uint32_t n_obj_words;                           // Parole da 64 bit di un insieme di oggetti
+    uint32_t strings_size;
+
+    uint32_t objs_off;                              // Offset delle sezioni, allineati a 8 byte
+    uint32_t obj_texts_off;
+    uint32_t uses_off;
+    uint32_t actions_off;
+    uint32_t locations_off;
+    uint32_t names_off;
+    uint32_t use_slots_off;
+    uint32_t initial_locked_off;
+    uint32_t initial_hidden_off;
+    uint32_t strings_off;
+    uint32_t code_off;                              // Il codice è in coda all'immagine, scritto dopo aver risolto i nomi
+}
+room_header;
+
+typedef struct                                      // Dati caldi di un oggetto
+{
+    uint32_t name_hash;                             // 32 bit bassi di hash_string(nome)
+    uint16_t flags;                                 // ROOM_OBJ_*
+    uint16_t n_uses;
+    uint32_t first_use;                             // Usi in [first_use, first_use + n_uses)
+    uint32_t first_unlock_op;                       // Codice dello sblocco, cascata compresa, in [first_unlock_op, first_unlock_op + n_unlock_ops)
+    uint32_t n_unlock_ops;
+    uint32_t location;                              // Locazione che contiene l'oggetto
+}
+room_obj;
+
+typedef struct                                      // Testi di un oggetto, offset nella tabella delle stringhe
+{
+    uint32_t name;
+    uint32_t locked_descr;
+    uint32_t unlocked_descr;
+    uint32_t puzzle_text;
+    uint32_t puzzle_solution;
+}
+room_obj_text;
+
+typedef struct                                      // Modo d'uso di un oggetto
+{
+    uint32_t type;                                  // game_use_type
+    uint32_t other_obj;                             // Id dell'oggetto da combinare, ROOM_NO_OBJ se assente
+    uint32_t first_action;                          // Azioni così come sono definite, senza cascate
+    uint32_t n_actions;
+    uint32_t first_op;                              // Codice dell'uso in [first_op, first_op + n_ops)
+    uint32_t n_ops;
+    uint32_t descr;
+}
+room_use;
+
+typedef struct                                      // Azione su un oggetto
+{
+    uint32_t type;                                  // game_action_type
+    uint32_t obj;                                   // Id dell'oggetto target, ROOM_NO_OBJ se assente o non richiesto
+}
+room_action;
+
+typedef struct                                      // Istruzione del codice di usi e sblocchi
+{
+    uint32_t type;                                  // game_action_type
+    uint32_t obj;                                   // Id dell'oggetto target, ROOM_NO_OBJ per ACTION_TOKEN
+    uint32_t skip;                                  // Per ACTION_UNLOCK, istruzioni della cascata da saltare se l'oggetto non viene sbloccato
+}
+room_op;
+
+typedef struct                                      // Locazione della room
+{
+    uint32_t name;
+    uint32_t descr;
+    uint32_t first_obj;                             // Oggetti in [first_obj, first_obj + n_objs)
+    uint32_t n_objs;
+}
+room_location;
+
+typedef struct                                      // Cella dell'indice dei nomi (indirizzamento aperto)
+{
+    uint32_t name_hash;
+    uint32_t name;                                  // Offset del nome, 0 per le celle libere
+    uint32_t obj;                                   // Id del primo oggetto con questo nome, ROOM_NO_OBJ se nessuno
+    uint32_t location;                              // Indice della prima locazione con questo nome, ROOM_NO_OBJ se nessuna
+}
+room_name_slot;
+
+typedef struct                                      // Cella della tabella degli usi (indirizzamento aperto)
+{
+    uint32_t obj;                                   // Oggetto usato, ROOM_NO_OBJ per le celle libere
+    uint32_t other_obj;                             // Oggetto con cui è combinato, ROOM_NO_OBJ per l'uso da solo
+    uint32_t use;                                   // Primo uso dell'oggetto con questa combinazione, come nella definizione
+}
+room_use_slot;
+
+typedef struct                                      // Vista su un'immagine compilata, con i puntatori alle sezioni
+{
+    const room_header* header;
+    const room_obj* objs;
+    const room_obj_text* obj_texts;
+    const room_use* uses;
+    const room_action* actions;
+    const room_op* code;
+    const room_location* locations;
+    const room_name_slot* names;
+    const room_use_slot* use_slots;
+    const uint64_t* initial_locked;
+    const uint64_t* initial_hidden;
+    const char* strings;                            // Il primo byte è sempre '\0', così l'offset 0 è la stringa vuota
+}
+room_view;
+
+/*
+ * Un pacchetto raccoglie le immagini compilate di più room in un solo file, scritto dal compilatore roomc.
+ * Il server lo mappa in memoria in sola lettura e usa le immagini sul posto: le pagine sono condivise
+ * tra tutti i processi che mappano lo stesso file. Gli offset delle immagini sono allineati a 8 byte,
+ * come richiesto da room_attach.
+ */
+#define ROOM_PACK_MAGIC     0x4b504d52              // "RMPK" in little endian
+#define ROOM_PACK_VERSION   2
+
+typedef struct                                      // Intestazione del pacchetto, all'offset 0
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t image_version;                         // ROOM_IMAGE_VERSION delle immagini contenute
+    uint32_t n_rooms;
+    uint64_t size;                                  // Dimensione totale del pacchetto in byte
+}
+room_pack_header;
+
+typedef struct                                      // Posizione di un'immagine nel pacchetto, in coda all'intestazione
+{
+    uint64_t off;
+    uint64_t size;
+    uint64_t hash;                                  // room_image_hash dell'immagine, per confrontarla senza leggerla
+}
+room_pack_entry;
+
+void* room_compile(const game_room_def* def, size_t* size);
+bool room_attach(room_view* view, const void* image, size_t size);
+const room_name_slot* room_find_name(const room_view* view, const char* name);
+const room_header* room_peek(const void* image, size_t size, const char** name);
+uint64_t room_image_hash(const void* image, size_t size);
+
+bool room_pack_write(const char* path, void* const* images, const size_t* sizes, uint32_t n);
+uint32_t room_pack_count(const void* pack, size_t size);
+const void* room_pack_image(const void* pack, uint32_t i, size_t* size, uint64_t* hash);
+
+static inline const char* room_str(const room_view* view, uint32_t off)
+{
+    return view->strings + off;
+}
+
+static inline uint32_t room_use_hash(uint32_t obj, uint32_t other_obj)
+{
+    return (uint32_t)((((uint64_t)obj << 32) | other_obj) * 0x9e3779b97f4a7c15ULL >> 32);
+}
+
+/*
+ * Cerca l'uso di un oggetto da solo (other_obj = ROOM_NO_OBJ) o combinato con un altro oggetto.
+ *
+ * Restituisce:
+ *   - Il primo uso definito per la combinazione, o NULL se non ce n'è nessuno.
+ */
+static inline const room_use* room_find_use(const room_view* view, uint32_t obj, uint32_t other_obj)
+{
+    uint32_t mask = view->header->n_use_slots - 1;
+    uint32_t slot;
+
+    for (slot = room_use_hash(obj, other_obj) & mask; view->use_slots[slot].obj != ROOM_NO_OBJ; slot = (slot + 1) & mask)
+    {
+        if (view->use_slots[slot].obj == obj && view->use_slots[slot].other_obj == other_obj)
+            return &view->uses[view->use_slots[slot].use];
+    }
+    return NULL;
+}
+
+//-------------------------//
+
+#endif
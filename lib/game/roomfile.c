@@ -0,0 +1,629 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+
+#include "roomfile.h"
+
+#define ROOM_LINE_DIM       1024                    // Lunghezza massima di una riga, con le sequenze di escape
+#define ROOM_FILE_MAX_BYTES (1 << 20)               // Dimensione massima di un file di definizione
+
+typedef enum                                        // Elemento a cui si riferiscono le righe successive
+{
+    CTX_ROOM,
+    CTX_LOCATION,
+    CTX_OBJECT,
+    CTX_LOCK,
+    CTX_USE
+}
+parse_context;
+
+typedef struct                                      // Stato della lettura di un file di definizione
+{
+    game_room_def* def;                             // Room in costruzione
+    parse_context ctx;
+    const char* path;                               // File letto, per i messaggi di errore
+    int line;                                       // Riga letta, 0 durante la validazione finale
+    char* error;
+    size_t error_dim;
+}
+room_parser;
+
+typedef struct                                      // Indice temporaneo degli oggetti per nome, per la validazione
+{
+    const game_obj** slots;
+    uint32_t mask;
+}
+obj_index;
+
+static bool fail(room_parser* p, const char* fmt, ...);
+static bool grow(void** array, int n, size_t elem_size);
+static bool copy_value(room_parser* p, char* out, size_t dim, const char* value);
+static bool copy_name(room_parser* p, char* out, const char* value);
+static bool parse_number(room_parser* p, const char* value, long min, long max, long* out);
+static bool parse_action(room_parser* p, game_action** actions, int* n_actions, char* value);
+static bool parse_line(room_parser* p, char* key, char* value);
+static bool validate(room_parser* p);
+static bool index_objs(room_parser* p, obj_index* index);
+static const game_obj* find_obj(const obj_index* index, const char* name);
+static bool check_actions(room_parser* p, const obj_index* index, const game_obj* obj, const game_action* actions, int n, int* n_token);
+static int compare_paths(const void* a, const void* b);
+
+// Scrive il messaggio di errore preceduto da file e riga e restituisce false
+static bool fail(room_parser* p, const char* fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (p->line > 0)
+        n = snprintf(p->error, p->error_dim, "%s:%d: ", p->path, p->line);
+    else
+        n = snprintf(p->error, p->error_dim, "%s: ", p->path);
+
+    if (n >= 0 && (size_t)n < p->error_dim) {
+        va_start(args, fmt);
+        vsnprintf(p->error + n, p->error_dim - n, fmt, args);
+        va_end(args);
+    }
+    return false;
+}
+
+/*
+ * Fa spazio per un nuovo elemento in coda a un array di n elementi.
+ * La capacità raddoppia quando n è una potenza di 2, così non serve memorizzarla.
+ */
+static bool grow(void** array, int n, size_t elem_size)
+{
+    void* new_array;
+
+    if (n != 0 && (n & (n - 1)) != 0)
+        return true;
+
+    new_array = realloc(*array, (n == 0 ? 1 : 2 * (size_t)n) * elem_size);
+    if (new_array == NULL)
+        return false;
+    *array = new_array;
+    return true;
+}
+
+// Copia un valore risolvendo le sequenze di escape e verificando che stia in dim byte
+static bool copy_value(room_parser* p, char* out, size_t dim, const char* value)
+{
+    size_t len = 0;
+
+    for (; *value != '\0'; value++)
+    {
+        char c = *value;
+
+        if (c == '\\')
+        {
+            value++;
+            if (*value == 'n')
+                c = '\n';
+            else if (*value == '\\')
+                c = '\\';
+            else
+                return fail(p, "sequenza di escape non valida");
+        }
+
+        if (len + 1 >= dim)
+            return fail(p, "testo più lungo di %zu caratteri", dim - 1);
+        out[len++] = c;
+    }
+    out[len] = '\0';
+    return true;
+}
+
+// I nomi vengono digitati dal giocatore come una sola parola
+static bool copy_name(room_parser* p, char* out, const char* value)
+{
+    if (value[0] == '\0' || strpbrk(value, " \t\\") != NULL)
+        return fail(p, "un nome deve essere una sola parola");
+    return copy_value(p, out, MAX_NAME_DIM, value);
+}
+
+static bool parse_number(room_parser* p, const char* value, long min, long max, long* out)
+{
+    char* end;
+    long n;
+
+    errno = 0;
+    n = strtol(value, &end, 10);
+    if (value[0] == '\0' || *end != '\0' || errno != 0 || n < min || n > max)
+        return fail(p, "numero non valido \"%s\"", value);
+    *out = n;
+    return true;
+}
+
+/*
+ * Aggiunge un'azione, nella forma "<tipo> [<oggetto>]", in coda alle azioni di un lock o di un modo d'uso.
+ */
+static bool parse_action(room_parser* p, game_action** actions, int* n_actions, char* value)
+{
+    static const char* names[] = { "reveal", "unlock", "consume", "token" };
+    char* target = value + strcspn(value, " \t");
+    game_action* action;
+    int type;
+
+    if (*target != '\0') {
+        *target++ = '\0';
+        target += strspn(target, " \t");
+    }
+
+    for (type = ACTION_REVEAL; type <= ACTION_TOKEN; type++)
+        if (strcmp(value, names[type]) == 0)
+            break;
+    if (type > ACTION_TOKEN)
+        return fail(p, "tipo di azione sconosciuto \"%s\"", value);
+    if (type == ACTION_TOKEN && *target != '\0')
+        return fail(p, "l'azione token non ha un oggetto");
+    if (type != ACTION_TOKEN && *target == '\0')
+        return fail(p, "l'azione %s richiede un oggetto", value);
+
+    if (!grow((void**)actions, *n_actions, sizeof(game_action)))
+        return fail(p, "memoria esaurita");
+    action = &(*actions)[(*n_actions)++];
+    memset(action, 0, sizeof(game_action));
+    action->type = type;
+    return type == ACTION_TOKEN || copy_name(p, action->obj_name, target);
+}
+
+/*
+ * Applica una riga alla room in costruzione.
+ *
+ * Parametri:
+ *   - key: Chiave della riga.
+ *   - value: Resto della riga, stringa vuota se assente.
+ *
+ * Restituisce:
+ *   - true se la riga è valida, false altrimenti con il messaggio di errore già scritto.
+ */
+static bool parse_line(room_parser* p, char* key, char* value)
+{
+    game_room_def* def = p->def;
+    game_location* loc = def->n_locations > 0 ? &def->locations[def->n_locations - 1] : NULL;
+    game_obj* obj = p->ctx >= CTX_OBJECT ? &loc->objs[loc->n_objs - 1] : NULL;
+    long n;
+
+    // Campi della room
+    if (strcmp(key, "room") == 0)
+        return copy_value(p, def->name, MAX_ROOM_NAME_DIM, value);
+    if (strcmp(key, "story") == 0)
+        return copy_value(p, def->story, MAX_DESCR_DIM, value);
+    if (strcmp(key, "timeout") == 0)
+        return copy_value(p, def->timeout_text, MAX_DESCR_DIM, value);
+    if (strcmp(key, "quit") == 0)
+        return copy_value(p, def->quit_text, MAX_DESCR_DIM, value);
+    if (strcmp(key, "win") == 0)
+        return copy_value(p, def->win_text, MAX_DESCR_DIM, value);
+    if (strcmp(key, "bag") == 0) {
+        if (!parse_number(p, value, 0, INT_MAX, &n))
+            return false;
+        def->dim_bag = n;
+        return true;
+    }
+    if (strcmp(key, "token") == 0) {
+        if (!parse_number(p, value, 1, INT_MAX, &n))
+            return false;
+        def->token = n;
+        return true;
+    }
+    if (strcmp(key, "seconds") == 0) {
+        if (!parse_number(p, value, 1, INT_MAX, &n))
+            return false;
+        def->seconds = n;
+        return true;
+    }
+
+    if (strcmp(key, "descr") == 0)
+    {
+        if (p->ctx == CTX_ROOM)
+            return copy_value(p, def->descr, MAX_DESCR_DIM, value);
+        if (p->ctx == CTX_LOCATION)
+            return copy_value(p, loc->descr, MAX_DESCR_DIM, value);
+        if (p->ctx == CTX_USE)
+            return copy_value(p, obj->uses[obj->n_uses - 1].use_descr, MAX_DESCR_DIM, value);
+        return fail(p, "descr deve seguire room, location o use");
+    }
+
+    if (strcmp(key, "location") == 0)
+    {
+        if (!grow((void**)&def->locations, def->n_locations, sizeof(game_location)))
+            return fail(p, "memoria esaurita");
+        loc = &def->locations[def->n_locations++];
+        memset(loc, 0, sizeof(game_location));
+        p->ctx = CTX_LOCATION;
+        return copy_name(p, loc->name, value);
+    }
+
+    if (strcmp(key, "object") == 0)
+    {
+        if (loc == NULL)
+            return fail(p, "object deve seguire una location");
+        if (!grow((void**)&loc->objs, loc->n_objs, sizeof(game_obj)))
+            return fail(p, "memoria esaurita");
+        obj = &loc->objs[loc->n_objs++];
+        memset(obj, 0, sizeof(game_obj));
+        p->ctx = CTX_OBJECT;
+        return copy_name(p, obj->name, value);
+    }
+
+    // Da qui in poi le chiavi si riferiscono all'ultimo oggetto
+    if (obj == NULL)
+        return fail(p, "chiave sconosciuta o fuori da un oggetto \"%s\"", key);
+
+    if (strcmp(key, "hidden") == 0 || strcmp(key, "takeable") == 0 || strcmp(key, "consumable") == 0)
+    {
+        if (value[0] != '\0')
+            return fail(p, "%s non ha un valore", key);
+        if (key[0] == 'h')
+            obj->isHidden = true;
+        else if (key[0] == 't')
+            obj->takeable = true;
+        else
+            obj->consumable = true;
+        return true;
+    }
+    if (strcmp(key, "locked") == 0)
+        return copy_value(p, obj->locked_descr, MAX_DESCR_DIM, value);
+    if (strcmp(key, "unlocked") == 0)
+        return copy_value(p, obj->unlocked_descr, MAX_DESCR_DIM, value);
+
+    if (strcmp(key, "lock") == 0)
+    {
+        if (obj->isLocked)
+            return fail(p, "l'oggetto \"%s\" ha già un lock", obj->name);
+        if (strcmp(value, "obj") == 0)
+            obj->lock.type = LOCK_OBJ;
+        else if (strcmp(value, "puzzle") == 0)
+            obj->lock.type = LOCK_PUZZLE;
+        else
+            return fail(p, "tipo di lock sconosciuto \"%s\"", value);
+        obj->isLocked = true;
+        p->ctx = CTX_LOCK;
+        return true;
+    }
+    if (strcmp(key, "puzzle") == 0 || strcmp(key, "solution") == 0)
+    {
+        if (p->ctx != CTX_LOCK || obj->lock.type != LOCK_PUZZLE)
+            return fail(p, "%s deve seguire lock puzzle", key);
+        if (key[0] == 'p')
+            return copy_value(p, obj->lock.puzzle.text, MAX_PUZZLE_DIM, value);
+        return copy_value(p, obj->lock.puzzle.solution, MAX_PUZZLE_SOL_DIM, value);
+    }
+
+    if (strcmp(key, "use") == 0)
+    {
+        game_use* use;
+
+        if (!grow((void**)&obj->uses, obj->n_uses, sizeof(game_use)))
+            return fail(p, "memoria esaurita");
+        use = &obj->uses[obj->n_uses++];
+        memset(use, 0, sizeof(game_use));
+        p->ctx = CTX_USE;
+        if (value[0] == '\0') {
+            use->type = USE_ALONE;
+            return true;
+        }
+        use->type = USE_COMBINE;
+        return copy_name(p, use->otherObj, value);
+    }
+
+    if (strcmp(key, "action") == 0)
+    {
+        if (p->ctx == CTX_LOCK)
+            return parse_action(p, &obj->lock.actions, &obj->lock.n_actions, value);
+        if (p->ctx == CTX_USE)
+            return parse_action(p, &obj->uses[obj->n_uses - 1].actions, &obj->uses[obj->n_uses - 1].n_actions, value);
+        return fail(p, "action deve seguire lock o use");
+    }
+
+    return fail(p, "chiave sconosciuta \"%s\"", key);
+}
+
+// Indicizza gli oggetti per nome, rifiutando i nomi ripetuti che non sarebbero raggiungibili
+static bool index_objs(room_parser* p, obj_index* index)
+{
+    const game_room_def* def = p->def;
+    size_t n_objs = 0, n_slots = 1;
+    int i, j;
+
+    for (i = 0; i < def->n_locations; i++)
+        n_objs += def->locations[i].n_objs;
+    while (n_slots < 2 * n_objs)
+        n_slots *= 2;
+
+    index->mask = n_slots - 1;
+    index->slots = calloc(n_slots, sizeof(game_obj*));
+    if (index->slots == NULL)
+        return fail(p, "memoria esaurita");
+
+    for (i = 0; i < def->n_locations; i++)
+    {
+        for (j = 0; j < def->locations[i].n_objs; j++)
+        {
+            const game_obj* obj = &def->locations[i].objs[j];
+            uint32_t slot = (uint32_t)hash_string(obj->name) & index->mask;
+
+            for (; index->slots[slot] != NULL; slot = (slot + 1) & index->mask)
+                if (strcmp(index->slots[slot]->name, obj->name) == 0)
+                    return fail(p, "l'oggetto \"%s\" è definito più volte", obj->name);
+            index->slots[slot] = obj;
+        }
+    }
+    return true;
+}
+
+static const game_obj* find_obj(const obj_index* index, const char* name)
+{
+    uint32_t slot = (uint32_t)hash_string(name) & index->mask;
+
+    for (; index->slots[slot] != NULL; slot = (slot + 1) & index->mask)
+        if (strcmp(index->slots[slot]->name, name) == 0)
+            return index->slots[slot];
+    return NULL;
+}
+
+// Verifica che gli oggetti delle azioni esistano e conta i token assegnati
+static bool check_actions(room_parser* p, const obj_index* index, const game_obj* obj, const game_action* actions, int n, int* n_token)
+{
+    int k;
+
+    for (k = 0; k < n; k++)
+    {
+        if (actions[k].type == ACTION_TOKEN)
+            (*n_token)++;
+        else if (find_obj(index, actions[k].obj_name) == NULL)
+            return fail(p, "un'azione di \"%s\" si riferisce all'oggetto inesistente \"%s\"", obj->name, actions[k].obj_name);
+    }
+    return true;
+}
+
+/*
+ * Verifica la room completa: campi obbligatori, nomi degli oggetti univoci, riferimenti a oggetti esistenti
+ * ed enigmi completi. Una room che assegna meno token di quelli necessari non può essere vinta e viene rifiutata.
+ */
+static bool validate(room_parser* p)
+{
+    const game_room_def* def = p->def;
+    obj_index index;
+    int i, j, u, n_token = 0;
+    bool ok = true;
+
+    p->line = 0;
+    if (def->name[0] == '\0')
+        return fail(p, "manca il nome della room (room)");
+    if (def->seconds == 0)
+        return fail(p, "manca il tempo a disposizione (seconds)");
+    if (def->token == 0)
+        return fail(p, "manca il numero di token necessari per vincere (token)");
+    if (def->n_locations == 0)
+        return fail(p, "la room non ha nessuna location");
+
+    if (!index_objs(p, &index)) {
+        free(index.slots);
+        return false;
+    }
+
+    for (i = 0; ok && i < def->n_locations; i++)
+    {
+        for (j = 0; ok && j < def->locations[i].n_objs; j++)
+        {
+            const game_obj* obj = &def->locations[i].objs[j];
+
+            if (obj->isLocked && obj->lock.type == LOCK_PUZZLE &&
+                (obj->lock.puzzle.text[0] == '\0' || obj->lock.puzzle.solution[0] == '\0'))
+                ok = fail(p, "l'enigma di \"%s\" non ha testo o soluzione", obj->name);
+            if (ok && obj->isLocked)
+                ok = check_actions(p, &index, obj, obj->lock.actions, obj->lock.n_actions, &n_token);
+
+            for (u = 0; ok && u < obj->n_uses; u++)
+            {
+                const game_use* use = &obj->uses[u];
+                if (use->type == USE_COMBINE && find_obj(&index, use->otherObj) == NULL)
+                    ok = fail(p, "\"%s\" si combina con l'oggetto inesistente \"%s\"", obj->name, use->otherObj);
+                else
+                    ok = check_actions(p, &index, obj, use->actions, use->n_actions, &n_token);
+            }
+        }
+    }
+
+    if (ok && n_token < def->token)
+        ok = fail(p, "la room assegna %d token, ne servono %d per vincere", n_token, def->token);
+
+    free(index.slots);
+    return ok;
+}
+
+/*
+ * Costruisce la definizione di una room a partire dal testo di un file di definizione.
+ *
+ * Parametri:
+ *   - text: Contenuto del file, non necessariamente terminato da '\0'.
+ *   - len: Lunghezza del contenuto.
+ *   - path: Nome del file, usato nei messaggi di errore.
+ *   - error: Buffer in cui scrivere il messaggio di errore, con file e riga.
+ *   - error_dim: Dimensione del buffer.
+ *
+ * Restituisce:
+ *   - La definizione da liberare con room_def_free, o NULL se il testo non è valido.
+ */
+game_room_def* room_def_parse(const char* text, size_t len, const char* path, char* error, size_t error_dim)
+{
+    room_parser p = { .ctx = CTX_ROOM, .path = path, .line = 0, .error = error, .error_dim = error_dim };
+    char line[ROOM_LINE_DIM];
+    size_t start = 0;
+
+    p.def = calloc(1, sizeof(game_room_def));
+    if (p.def == NULL) {
+        fail(&p, "memoria esaurita");
+        return NULL;
+    }
+
+    while (start < len)
+    {
+        size_t end = start, line_len;
+        char *key, *value;
+
+        while (end < len && text[end] != '\n')
+            end++;
+        line_len = end - start;
+        p.line++;
+
+        // Gli spazi in coda, compreso il ritorno a capo dei file scritti su Windows, vengono scartati
+        while (line_len > 0 && strchr(" \t\r", text[start + line_len - 1]) != NULL)
+            line_len--;
+        if (line_len >= ROOM_LINE_DIM) {
+            fail(&p, "riga più lunga di %d caratteri", ROOM_LINE_DIM - 1);
+            room_def_free(p.def);
+            return NULL;
+        }
+        memcpy(line, text + start, line_len);
+        line[line_len] = '\0';
+        start = end + 1;
+
+        key = line + strspn(line, " \t");
+        if (key[0] == '\0' || key[0] == '#')
+            continue;
+        value = key + strcspn(key, " \t");
+        if (*value != '\0') {
+            *value++ = '\0';
+            value += strspn(value, " \t");
+        }
+
+        if (!parse_line(&p, key, value)) {
+            room_def_free(p.def);
+            return NULL;
+        }
+    }
+
+    if (!validate(&p)) {
+        room_def_free(p.def);
+        return NULL;
+    }
+    return p.def;
+}
+
+/*
+ * Legge e valida un file di definizione.
+ *
+ * Restituisce:
+ *   - La definizione da liberare con room_def_free, o NULL con il messaggio di errore in error.
+ */
+game_room_def* room_def_load(const char* path, char* error, size_t error_dim)
+{
+    game_room_def* def;
+    struct stat st;
+    char* text;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        snprintf(error, error_dim, "%s: %s", path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size > ROOM_FILE_MAX_BYTES) {
+        snprintf(error, error_dim, "%s: file illeggibile o più grande di %d byte", path, ROOM_FILE_MAX_BYTES);
+        close(fd);
+        return NULL;
+    }
+
+    // Il file viene letto con una sola read, senza il buffer di stdio
+    text = malloc(st.st_size + 1);
+    if (text == NULL || read(fd, text, st.st_size) != st.st_size) {
+        snprintf(error, error_dim, "%s: lettura non riuscita", path);
+        free(text);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    def = room_def_parse(text, st.st_size, path, error, error_dim);
+    free(text);
+    return def;
+}
+
+void room_def_free(game_room_def* def)
+{
+    int i, j, u;
+
+    if (def == NULL)
+        return;
+
+    for (i = 0; i < def->n_locations; i++)
+    {
+        game_location* loc = &def->locations[i];
+        for (j = 0; j < loc->n_objs; j++)
+        {
+            game_obj* obj = &loc->objs[j];
+            free(obj->lock.actions);
+            for (u = 0; u < obj->n_uses; u++)
+                free(obj->uses[u].actions);
+            free(obj->uses);
+        }
+        free(loc->objs);
+    }
+    free(def->locations);
+    free(def);
+}
+
+static int compare_paths(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+ * Elenca i file di definizione contenuti in una cartella, in ordine alfabetico: l'indice di una room
+ * è la sua posizione nell'elenco, quindi resta lo stesso tra un avvio e l'altro finché i file non cambiano.
+ *
+ * Parametri:
+ *   - dir: Cartella da leggere.
+ *   - paths: Variabile in cui scrivere l'array dei percorsi, da liberare con room_dir_free.
+ *
+ * Restituisce:
+ *   - Il numero di file trovati, o -1 in caso di errore.
+ */
+int room_dir_list(const char* dir, char*** paths)
+{
+    struct dirent* entry;
+    char** list = NULL;
+    int n = 0;
+    DIR* d = opendir(dir);
+
+    if (d == NULL)
+        return -1;
+
+    while ((entry = readdir(d)) != NULL)
+    {
+        size_t len = strlen(entry->d_name), ext_len = strlen(ROOM_FILE_EXT);
+        char* path;
+
+        if (entry->d_name[0] == '.' || len <= ext_len || strcmp(entry->d_name + len - ext_len, ROOM_FILE_EXT) != 0)
+            continue;
+
+        path = malloc(strlen(dir) + len + 2);
+        if (path == NULL || !grow((void**)&list, n, sizeof(char*))) {
+            free(path);
+            room_dir_free(list, n);
+            closedir(d);
+            return -1;
+        }
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        list[n++] = path;
+    }
+    closedir(d);
+
+    if (n > 0)
+        qsort(list, n, sizeof(char*), compare_paths);
+    *paths = list;
+    return n;
+}
+
+void room_dir_free(char** paths, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        free(paths[i]);
+    free(paths);
+}
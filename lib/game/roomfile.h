@@ -0,0 +1,33 @@
+#ifndef GAME_ROOMFILE
+#define GAME_ROOMFILE
+
+#include "room.h"
+
+/*
+ * File di definizione delle room.
+ *
+ * Ogni room è descritta da un file di testo con estensione ROOM_FILE_EXT, una riga per campo nella forma
+ * "<chiave> <valore>". Le righe vuote e quelle che iniziano con '#' vengono ignorate, così come l'indentazione.
+ * Nei valori "\n" indica un a capo e "\\" una barra rovesciata.
+ *
+ * Campi della room:            room, story, descr, timeout, quit, win, bag, token, seconds
+ * Inizio di una locazione:     location <nome>, seguita dalla sua descr
+ * Inizio di un oggetto:        object <nome>, nell'ultima locazione
+ * Campi dell'oggetto:          hidden, takeable, consumable, locked <descrizione>, unlocked <descrizione>
+ * Blocco dell'oggetto:         lock (obj | puzzle), seguito da puzzle <testo> e solution <risposta> se è un enigma
+ * Modo d'uso dell'oggetto:     use [<oggetto da combinare>], seguito dalla sua descr
+ * Azione:                      action (reveal | unlock | consume | token) [<oggetto>], dell'ultimo lock o use
+ *
+ * La chiave descr si riferisce alla room, all'ultima locazione o all'ultimo modo d'uso, a seconda di dove si trova.
+ */
+#define ROOM_FILE_EXT       ".room"
+#define ROOM_ERROR_DIM      256                     // Dimensione dei messaggi di errore del caricamento
+
+game_room_def* room_def_load(const char* path, char* error, size_t error_dim);
+game_room_def* room_def_parse(const char* text, size_t len, const char* path, char* error, size_t error_dim);
+void room_def_free(game_room_def* def);
+
+int room_dir_list(const char* dir, char*** paths);
+void room_dir_free(char** paths, int n);
+
+#endif
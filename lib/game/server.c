@@ -1,716 +1,2819 @@
 #include "server.h"
 
-static game_session* create_session(int sd, const char* username, int room);
+static game_session* create_session(int sd, const char* username, int room, const char* resume_token);
 static bool start_session(int sd, const char* username, int room);
-static void stop_session(int sd);
+static bool add_session(game_session* session);
+static checkpoint_record* log_begin(checkpoint_record_type type, game_session* session);
+static void put_session(checkpoint_record* record, game_session* session);
+static void log_session(game_session* session);
+static void log_stop(game_session* session);
+static void log_obj_state(game_session* session, checkpoint_obj_set set, uint32_t obj, bool value);
+static void log_token(game_session* session);
+static void log_time(game_session* session);
+static void log_help(game_session* session);
+static void restore_session(checkpoint_record* record, const char* username, const room_name_index* index);
+static int find_room_by_name(const room_name_index* index, const char* name);
+static void apply_record(checkpoint_record_type type, checkpoint_record* record, void* ctx);
+static bool write_snapshot();
+static void mem_add(mem_tag tag, size_t size);
+static void mem_sub(mem_tag tag, size_t size);
+static void* mem_alloc(mem_tag tag, size_t size);
+static void* mem_calloc(mem_tag tag, size_t n, size_t size);
+static void* mem_realloc(mem_tag tag, void* ptr, size_t old_size, size_t size);
+static void mem_free(mem_tag tag, void* ptr, size_t size);
+static void* reload_worker(void* arg);
+static void load_rooms(room_load* load);
+static bool alloc_load(room_load* load, int n);
+static bool add_loaded_room(room_load* load, int* index, uint32_t index_mask, const void* image, size_t size, uint64_t hash, const char* path);
+static int* index_room_names(uint32_t* mask);
+static bool map_rooms(room_load* load, int fd);
+static bool compile_rooms(room_load* load);
+static void discard_load(room_load* load);
+static bool publish_rooms(room_load* load);
+static void release_version(room_version* version);
+static void reclaim_versions();
+static bool acquire_body(room_version* version);
+static bool load_body(room_version* version);
+static void park_body(room_version* version);
+static void drop_body(room_version* version);
+static void lru_unlink(room_version* version);
+static void trim_bodies();
+static bool build_catalog();
+static void release_session(game_session* session);
+static size_t pool_slab_size(const session_pool* pool);
+static bool session_fits(int room);
+static void session_event_state(game_session* session, game_event_state* state);
+static void event_begin(game_event_type type, const char* username, const char* args);
+static void event_end();
+static int64_t game_now();
+static void pause_session(game_session* session, int reason);
+static void unpause_session(game_session* session, int reason);
+static void add_remaining_ms(game_session* session, int64_t delta);
+static void count_start(int room);
+static void count_outcome(game_session* session, room_outcome outcome);
+static void count_puzzle(game_session* session, uint32_t obj, bool solved);
+static int win_time_bucket(uint64_t seconds);
+static double win_time_value(int bucket);
+static double win_time_quantile(const room_stats* stats, uint32_t percent);
+static bool read_room_stats(const char* path);
+static bool write_room_stats();
+static uint32_t count_finished(const room_stats* stats);
+static void end_subscriptions(game_session* session);
+static void drop_subscriptions(int sd);
+static op_result push_update(su_subscription* sub);
+static op_result push_frame(int sd, desc_msg* msg);
+static op_result push_flush(int sd);
+static uint8_t su_obj_flags(game_session* session, uint32_t obj);
+static int64_t get_remaining_ms(game_session* session);
+static void stop_session(game_session* session);
+static void park_session(game_session* session, int64_t expires_at);
+static void unpark_session(game_session* session);
+static bool generate_resume_token(char* token);
+static game_session* pool_get(session_pool* pool);
+static void pool_put(session_pool* pool, game_session* session);
+static game_session* find_session_by_resume_token(const char* resume_token);
 static time_t get_remaining_time(game_session* session);
 static game_session* find_session_by_sd(int sd);
 static game_session* find_session_by_username(const char* username);
-
-static bool is_obj_consumed(game_session* session, game_obj* obj);
-static bool is_obj_taken(game_session* session, game_obj* obj);
-static bool is_obj_locked(game_session* session, game_obj* obj);
-static bool is_obj_hidden(game_session* session, game_obj* obj);
-static bool consume_obj(game_session* session, const char* obj_name);
-static bool take_obj(game_session* session, game_obj* obj);
-static bool drop_obj(game_session* session, game_obj* obj);
-static void unlock_obj(game_session* session, const char* obj_name);
-static void reveal_obj(game_session* session, const char* obj_name);
-static void compute_action(game_session* session, game_action* action);
-
-static game_obj* find_obj(game_session* session, const char* name, bool checkVisibility);
+static bool index_session(game_session* session);
+static void unindex_session(game_session* session);
+static game_conn* get_conn(int sd);
+static bool check_supervisor(int sd);
+static bool is_local_peer(int sd);
+
+static const char* get_obj_name(game_session* session, uint32_t obj);
+static bool is_obj_consumed(game_session* session, uint32_t obj);
+static bool is_obj_taken(game_session* session, uint32_t obj);
+static bool is_obj_locked(game_session* session, uint32_t obj);
+static bool is_obj_hidden(game_session* session, uint32_t obj);
+static bool consume_obj(game_session* session, uint32_t obj);
+static bool take_obj(game_session* session, uint32_t obj);
+static bool drop_obj(game_session* session, uint32_t obj);
+static void reveal_obj(game_session* session, uint32_t obj);
+static void run_code(game_session* session, uint32_t first, uint32_t n);
+
+static uint32_t find_obj(game_session* session, const char* name, bool checkVisibility);
+
+static inline bool obj_set_test(const uint64_t* set, uint32_t id);
+static inline void obj_set_add(uint64_t* set, uint32_t id);
+static inline void obj_set_remove(uint64_t* set, uint32_t id);
 
 static op_result sendUserSessionState(int sd, game_session* session);
 static op_result sendGameState(game_session* session);
-static op_result cmdUseAlone(game_session* session, game_obj* obj);
-static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj* obj2);
-
-static game_room rooms[MAX_ROOMS] = 
-{
-    {
-        .name = "La stanza dei tre manufatti\0",
-        .story = "In una stanza piena di segreti, devi trovare tre manufatti per uscire.\nNiente di epico, trova i manufatti, mettili nei posti giusti, e via.\0",
-        .descr = "Ti trovi in una stanza dalle pareti bianche, illuminate da una luce soffusa.\nLa stanza è divisa in quattro piccole locazioni:\n++studio++, ++camera++ da letto, ++bagno++ e il ++santuario++\0",
-        .timeout_text = "Il tempo è scaduto, resterai bloccato qui per sempre!\0",
-        .quit_text = "Addio, avventuriero! Speriamo di rivederti presto\0",
-        .win_text = "Complimenti, sei riuscito a scappare!\0",
-        .dim_bag = 2,
-        .token = 3,
-        .seconds = 3600,
-        .n_locations = 10,
-        .locations = (game_location[])
-        {
-            {
-                .name = "studio\0",
-                .descr = "Un angolo con una ++scrivania++ disordinata\0",
-                .n_objs = 0
-            },
-            {
-                .name = "scrivania\0",
-                .descr = "Sulla scrivania sul piano superiore riposa un **computer**.\nAl di sotto, si intravede un **interruttore** ed un **cassetto**\0",
-                .n_objs = 5,
-                .objs = (game_obj[])
-                {
-                    {
-                        .name = "computer\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 0
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Un vecchio computer, peccato che sia senza corrente.\0",
-                        .unlocked_descr = "Sullo schermo lampeggia un codice: 4242\0"
-                    },
-                    {
-                        .name = "interruttore\0",
-                        .isLocked = false,
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[])
-                        {
-                            {
-                                .type = USE_ALONE,
-                                .n_actions = 2,
-                                .actions = (game_action[])
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "computer\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "interruttore\0"
-                                    }
-                                },
-                                .use_descr = "Ho sentito un BIP provenire dal computer\0",
-                            }
-                        },
-                        .unlocked_descr = "Grosso pulsante rosso\0"
-                    },
-                    {
-                        .name = "cassetto\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 1,
-                            .actions = (game_action[]) 
-                            {
-                                {
-                                    .type = ACTION_REVEAL,
-                                    .obj_name = "maschera\0"
-                                }
-                            }
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Il cassetto è bloccato da un **lucchetto**\0",
-                        .unlocked_descr = "Al suo interno un'antica **maschera**\0"
-                    },
-                    {
-                        .name = "maschera\0",
-                        .isLocked = false,
-                        .isHidden = true,
-                        .takeable = true,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[]) 
-                        {
-                            {
-                                .type = USE_COMBINE,
-                                .otherObj = "manichino\0",
-                                .n_actions = 2,
-                                .actions = (game_action[]) 
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "manichino\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "maschera\0"
-                                    }
-                                },
-                                .use_descr = "Gli occhi della maschera si sono illuminati!\0"
-                            }
-                        },
-                        .unlocked_descr = "Una maschera antica, dalle fattezze enigmatiche e dettagli intricati,\nevoca un senso di mistero\0"
-                    },
-                    {
-                        .name = "lucchetto\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 0
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[])
-                        {
-                            {
-                                .type = USE_ALONE,
-                                .n_actions = 2,
-                                .actions = (game_action[])
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "cassetto\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "lucchetto\0"
-                                    }
-                                },
-                                .use_descr = "Il cassetto si è aperto\0",
-                            }
-                        },
-                        .locked_descr = "Piccolo lucchetto con una serratura\0",
-                        .unlocked_descr = "Piccolo lucchetto con una serratura, ormai aperto\0"
-                    }
-                }
-            },
-            {
-                .name = "camera\0",
-                .descr = "La camera da letto è semplice e accogliente.\nUn ++letto++ disfatto al centro della stanza, un ++armadio++ semiaperto\ne una ++finestra++ con tende leggermente svolazzanti.",
-                .n_objs = 0
-            },
-            {
-                .name = "finestra\0",
-                .descr = "Sul davanzale, una piccola **chiave**\0",
-                .n_objs = 1,
-                .objs = (game_obj[])
-                {
-                    {
-                        .name = "chiave\0",
-                        .isLocked = false,
-                        .isHidden = false,
-                        .takeable = true,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[]) 
-                        {
-                            {
-                                .type = USE_COMBINE,
-                                .otherObj = "lucchetto\0",
-                                .n_actions = 2,
-                                .actions = (game_action[]) 
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "lucchetto\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "chiave\0"
-                                    }
-                                },
-                                .use_descr = "Lucchetto sbloccato!\0"
-                            }
-                        },
-                        .unlocked_descr = "Piccola chiave in ottone\0"
-                    }
-                }
-            },
-            {
-                .name = "armadio\0",
-                .descr = "Abiti appesi e oggetti sparsi sui ripiani. Una **cassa** si nasconde tra gli indumenti\0",
-                .n_objs = 2,
-                .objs = (game_obj[]) 
-                {
-                    {
-                        .name = "cassa\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_PUZZLE,
-                            .puzzle = 
-                            {
-                                .text = "Mmmh... è bloccata da un codice. Chissà quale sarà?\0",
-                                .solution = "4242\0"
-                            },
-                            .n_actions = 1,
-                            .actions = (game_action[]) 
-                            {
-                                {
-                                    .type = ACTION_REVEAL,
-                                    .obj_name = "vaso\0"
-                                }
-                            }
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Scatola di legno robusta e segnata dal tempo\0",
-                        .unlocked_descr = "Scatola di legno robusta e segnata dal tempo, al suo interno un antico **vaso**\0"
-                    },
-                    {
-                        .name = "vaso\0",
-                        .isLocked = false,
-                        .isHidden = true,
-                        .takeable = true,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[])
-                        {
-                            {
-                                .type = USE_COMBINE,
-                                .otherObj = "teca\0",
-                                .n_actions = 2,
-                                .actions = (game_action[]) 
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "teca\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "vaso\0"
-                                    }
-                                },
-                                .use_descr = "La teca si è illuminata!\0"
-                            }
-                        },
-                        .unlocked_descr = "Un vaso antico a base circolare, con forme eleganti e superficie screpolata\0"
-                    }
-                }
-            },
-            {
-                .name = "letto\0",
-                .descr = "Tra le lenzuola si intravede una **tessera** magnetica\0",
-                .n_objs = 1,
-                .objs = (game_obj[]) 
-                {
-                    {
-                        .name = "tessera\0",
-                        .isLocked = false,
-                        .isHidden = false,
-                        .takeable = true,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[]) 
-                        {
-                            {
-                                .type = USE_COMBINE,
-                                .otherObj = "fessura\0",
-                                .n_actions = 2,
-                                .actions = (game_action[]) 
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "pareti\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "tessera\0"
-                                    }
-                                },
-                                .use_descr = "Hmm... un rumore sembra provenire dalla doccia\0"
-                            }
-                        },
-                        .unlocked_descr = "Ha una superficie molto riflettente\0"
-                    }
-                }
-            },
-            {
-                .name = "bagno\0",
-                .descr = "L'atmosfera è semplice e pulita, con una sensazione di tranquillità che pervade l'ambiente.\nUn grosso ++specchio++ domina uno dei muri, mentre una ++doccia++ si erge accanto al lavandino\0",
-                .n_objs = 0
-            },
-            {
-                .name = "specchio\0",
-                .descr = "Un grosso specchio, incorniciato da un'elegante cornice dorata,\nsul lato c'è una piccola **fessura**\0",
-                .n_objs = 1,
-                .objs = (game_obj[]) 
-                {
-                    {
-                        .name = "fessura\0",
-                        .isLocked = false,
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .unlocked_descr = "Una sottile fessura, appena visibile sul lato della cornice dorata dello specchio.\nSembra appositamente progettata per accogliere qualcosa di piccolo e sottile\0"
-                    }
-                }
-            },
-            {
-                .name = "doccia\0",
-                .descr = "La doccia è una cabina con **pareti** bianche e un **rubinetto** metallico\0",
-                .n_objs = 3,
-                .objs = (game_obj[])
-                {
-                    {
-                        .name = "pareti\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 1,
-                            .actions = (game_action[]) 
-                            {
-                                {
-                                    .type = ACTION_REVEAL,
-                                    .obj_name = "statuetta\0"
-                                }
-                            }
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Le pareti bianche, rivestite con mattonelle lucide,\nriflettono la luce e creano un ambiente luminoso e pulito\0",
-                        .unlocked_descr = "Hmm... una mattonella si è staccata dal muro, lasciando un buco vuoto nel rivestimento.\nSi intravede una **statuetta**\0"
-                    },
-                    {
-                        .name = "statuetta\0",
-                        .isLocked = false,
-                        .isHidden = true,
-                        .takeable = true,
-                        .consumable = true,
-                        .n_uses = 1,
-                        .uses = (game_use[]) 
-                        {
-                            {
-                                .type = USE_COMBINE,
-                                .otherObj = "piedistallo\0",
-                                .n_actions = 2,
-                                .actions = (game_action[]) 
-                                {
-                                    {
-                                        .type = ACTION_UNLOCK,
-                                        .obj_name = "piedistallo\0"
-                                    },
-                                    {
-                                        .type = ACTION_CONSUME,
-                                        .obj_name = "statuetta\0"
-                                    }
-                                },
-                                .use_descr = "Il piedistallo si è appena illuminato!\0"
-                            }
-                        },
-                        .unlocked_descr = "Un'antica statuetta a base quadrata, scolpita con precisione, emana un fascino misterioso.\nLe sue forme levigate e l'espressione del viso incutono un senso di meraviglia e curiosità\0"
-                    },
-                    {
-                        .name = "rubinetto\0",
-                        .isLocked = false,
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .unlocked_descr = "Di metallo lucido, con una semplice manopola per regolare l'acqua,\nanche se sembra non sia di grande utilità.\0"
-                    }
-                }
-            },
-            {
-                .name = "santuario\0",
-                .descr = "Nel santuario, c'è una **teca** di vetro vuota e un **piedistallo**.\nAccanto, un **manichino** senza testa",
-                .n_objs = 3,
-                .objs = (game_obj[]) 
-                {
-                    {
-                        .name = "teca\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 1,
-                            .actions = (game_action[]) 
-                            {
-                                {
-                                    .type = ACTION_TOKEN
-                                }
-                            }
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Scatola di vetro trasparente con un alloggio circolare\0",
-                        .unlocked_descr = "Scatola di vetro trasparente con un alloggio circolare\0"
-                    },
-                    {
-                        .name = "piedistallo\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 1,
-                            .actions = (game_action[]) 
-                            {
-                                {
-                                    .type = ACTION_TOKEN
-                                }
-                            }
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Base solida e stabile, con una superficie piana e un alloggio a base quadrata al centro\0",
-                        .unlocked_descr = "Base solida e stabile, con una superficie piana e un alloggio a base quadrata al centro\0"
-                    },
-                    {
-                        .name = "manichino\0",
-                        .isLocked = true,
-                        .lock = 
-                        {
-                            .type = LOCK_OBJ,
-                            .n_actions = 1,
-                            .actions = (game_action[]) 
-                            {
-                                {
-                                    .type = ACTION_TOKEN
-                                }
-                            }
-                        },
-                        .isHidden = false,
-                        .takeable = false,
-                        .consumable = false,
-                        .n_uses = 0,
-                        .locked_descr = "Figura umana senza testa, con le braccia e le gambe estese\0",
-                        .unlocked_descr = "Il manichino, con la maschera in testa, assume un'aria ancora più enigmatica.\nGli occhi illuminati della maschera, emanano una luce intensa\0"
-                    }
-                }
-            }
-        }
+static op_result cmdUseAlone(game_session* session, uint32_t obj);
+static op_result cmdUseCombine(game_session* session, uint32_t obj1, uint32_t obj2);
+
+//---Memory Accounting---//
+
+// Memoria allocata da questo modulo, per sottosistema
+static mem_counter mem_counters[MEM_TAGS];
+static size_t mem_total = 0;                        // Byte allocati da tutti i sottosistemi
+static size_t mem_peak = 0;                         // Massimo di mem_total dall'avvio
+static size_t max_memory_bytes = MAX_MEMORY_BYTES;  // Memoria allocata oltre la quale le allocazioni falliscono
+static unsigned long n_rejected_games = 0;          // Partite rifiutate per i limiti di sessioni o di memoria
+
+static const char* mem_tag_names[MEM_TAGS] = { "Room", "Sessioni", "Indici sessioni", "Eventi" };
+
+// Attribuisce al sottosistema una nuova allocazione di size byte
+static void mem_add(mem_tag tag, size_t size)
+{
+    mem_counter* counter = &mem_counters[tag];
+
+    counter->bytes += size;
+    counter->n_allocs++;
+    if (counter->bytes > counter->peak)
+        counter->peak = counter->bytes;
+
+    mem_total += size;
+    if (mem_total > mem_peak)
+        mem_peak = mem_total;
+}
+
+// Toglie al sottosistema un'allocazione di size byte
+static void mem_sub(mem_tag tag, size_t size)
+{
+    mem_counters[tag].bytes -= size;
+    mem_counters[tag].n_allocs--;
+    mem_total -= size;
+}
+
+/*
+ * Alloca memoria attribuendola al sottosistema specificato.
+ * L'allocazione fallisce se porterebbe la memoria allocata oltre il limite impostato.
+ * 
+ * Restituisce:
+ *   - Puntatore alla memoria allocata, o NULL in caso di errore o se il limite verrebbe superato.
+ */
+static void* mem_alloc(mem_tag tag, size_t size)
+{
+    void* ptr;
+
+    if (mem_total + size > max_memory_bytes)
+        return NULL;
+
+    ptr = malloc(size);
+    if (ptr != NULL)
+        mem_add(tag, size);
+    return ptr;
+}
+
+static void* mem_calloc(mem_tag tag, size_t n, size_t size)
+{
+    void* ptr;
+
+    if (mem_total + n * size > max_memory_bytes)
+        return NULL;
+
+    ptr = calloc(n, size);
+    if (ptr != NULL)
+        mem_add(tag, n * size);
+    return ptr;
+}
+
+/*
+ * Ridimensiona un'allocazione del sottosistema specificato, da old_size a size byte.
+ * In caso di errore l'allocazione originale resta valida.
+ */
+static void* mem_realloc(mem_tag tag, void* ptr, size_t old_size, size_t size)
+{
+    void* new_ptr;
+
+    if (size > old_size && mem_total + (size - old_size) > max_memory_bytes)
+        return NULL;
+
+    new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL)
+        return NULL;
+
+    if (ptr != NULL)
+        mem_sub(tag, old_size);
+    mem_add(tag, size);
+    return new_ptr;
+}
+
+static void mem_free(mem_tag tag, void* ptr, size_t size)
+{
+    if (ptr == NULL)
+        return;
+    mem_sub(tag, size);
+    free(ptr);
+}
+
+//-------------------------//
+
+//---Rooms Management---//
+
+// Room caricate, nell'ordine dei file di definizione; quelle aggiunte da un ricaricamento vanno in coda
+static game_room* rooms = NULL;
+static int n_rooms = 0;
+
+static int n_old_versions = 0;                      // Versioni sostituite ma ancora usate da partite in corso
+static size_t mapped_bytes = 0;                     // Byte dei pacchetti mappati, condivisi e fuori dal conteggio
+
+// Ricaricamento in background: il thread riempie reload e poi imposta reload_done
+static room_load reload;
+static pthread_t reload_thread;
+static atomic_bool reload_done;
+static bool reload_running = false;
+
+// Versioni non più usate, liberate a poco a poco a ogni iterazione del ciclo principale
+static room_version* retired_versions = NULL;
+
+// Corpi caricati delle versioni correnti senza partite, dal meno recente, rimossi quando si supera il budget
+static room_version* lru_head = NULL;
+static room_version* lru_tail = NULL;
+static size_t room_body_budget = ROOM_BODY_BUDGET_BYTES;
+static room_body_stats body_stats;
+
+static room_catalog catalog;                        // Catalogo inviato ai client, ricostruito quando vengono aggiunte room
+
+/*
+ * Carica le room all'avvio del server. Se esiste il pacchetto prodotto da roomc, lo mappa in memoria in sola
+ * lettura e ne legge solo la tabella e le intestazioni delle immagini; altrimenti carica i file di definizione
+ * della cartella specificata e compila ognuno per verificarlo, tenendo solo il percorso. In entrambi i casi
+ * restano in memoria solo i metadati: il corpo di una room viene caricato alla sua prima partita.
+ * Deve essere chiamata una volta all'avvio del server.
+ * 
+ * Parametri:
+ *   - pack_path: Percorso del pacchetto, o NULL per usare sempre i file di definizione.
+ *   - dir: Cartella dei file di definizione, usata se il pacchetto non esiste.
+ *   - error: Buffer in cui scrivere il motivo dell'errore.
+ *   - error_dim: Dimensione del buffer.
+ * 
+ * Restituisce:
+ *   - true se l'inizializzazione è avvenuta con successo, false se il pacchetto o una definizione non sono validi
+ *     o in caso di errore nell'allocazione di memoria.
+ */
+bool initRooms(const char* pack_path, const char* dir, char* error, size_t error_dim)
+{
+    uint64_t start = checkpoint_clock_ns();
+    room_load load;
+
+    memset(&load, 0, sizeof(load));
+    load.pack_path = pack_path;
+    load.dir = dir;
+    load_rooms(&load);
+    if (!load.ok) {
+        snprintf(error, error_dim, "%s", load.error);
+        return false;
+    }
+    if (!publish_rooms(&load) || catalog.n_pages == 0) {
+        snprintf(error, error_dim, "memoria esaurita");
+        return false;
     }
-};
 
-//---Sessions Management---//
+    #ifdef VERBOSE
+        printf("Caricate %d room da %s in %.3f ms\n", n_rooms, mapped_bytes > 0 ? pack_path : dir,
+            (checkpoint_clock_ns() - start) / 1e6);
+    #endif
+    return true;
+}
 
-// Lista delle sessioni di gioco
-static game_session* sessions_list = NULL;
-static int n_sessions = 0;
+/*
+ * Avvia in background il caricamento di nuove versioni delle room, dal pacchetto se esiste o altrimenti dalla
+ * cartella dei file di definizione. Il thread legge e compila senza toccare lo stato del server; le nuove versioni
+ * vengono pubblicate da pollRoomReload. Le room sono abbinate a quelle caricate per nome: quelle con l'immagine
+ * invariata vengono ignorate e quelle con un nome nuovo vengono aggiunte in coda.
+ * 
+ * Restituisce:
+ *   - true se il caricamento è stato avviato, false se ce n'è già uno in corso o il thread non può essere creato.
+ */
+bool reloadRooms(const char* pack_path, const char* dir)
+{
+    if (reload_running)
+        return false;
+
+    memset(&reload, 0, sizeof(reload));
+    reload.pack_path = pack_path;
+    reload.dir = dir;
+    atomic_store(&reload_done, false);
+    if (pthread_create(&reload_thread, NULL, reload_worker, NULL) != 0)
+        return false;
+
+    reload_running = true;
+    return true;
+}
 
 /*
- * Crea una nuova sessione di gioco e restituisce il puntatore ad essa.
+ * Pubblica le versioni caricate dall'ultimo reloadRooms, se il caricamento è terminato. La pubblicazione sostituisce
+ * solo i puntatori alle versioni correnti: le nuove partite usano le nuove versioni, mentre quelle in corso restano
+ * sulla versione con cui sono iniziate, che viene liberata dopo il termine dell'ultima di esse.
+ * Deve essere chiamata a ogni iterazione del ciclo principale, anche per liberare le versioni non più usate.
  * 
  * Parametri:
- *   - sd: Descrittore del socket associato all'utente.
- *   - username: nome dell'utente.
- *   - room: Numero della stanza in cui l'utente vuole giocare.
+ *   - msg: Buffer in cui scrivere il riepilogo o il motivo dell'errore.
+ *   - msg_dim: Dimensione del buffer.
  * 
  * Restituisce:
- *   - Puntatore alla nuova sessione creata, o NULL in caso di errore nell'allocazione di memoria.
+ *   - Lo stato del ricaricamento; msg è significativo solo per ROOM_RELOAD_DONE e ROOM_RELOAD_FAILED.
  */
-static game_session* create_session(int sd, const char* username, int room) 
+room_reload_state pollRoomReload(char* msg, size_t msg_dim)
 {
-    int i, n_locked_objs = 0, n_hidden_objs = 0, n_consumable_objs = 0;
-    game_session* session = (game_session*)malloc(sizeof(game_session));
-    if (session == NULL) {
-        return NULL;
+    uint64_t start;
+    int n_changed, n_added, n_unchanged;
+
+    reclaim_versions();
+    if (!reload_running)
+        return ROOM_RELOAD_IDLE;
+    if (!atomic_load(&reload_done))
+        return ROOM_RELOAD_RUNNING;
+
+    pthread_join(reload_thread, NULL);
+    reload_running = false;
+    if (!reload.ok) {
+        snprintf(msg, msg_dim, "%s", reload.error);
+        return ROOM_RELOAD_FAILED;
     }
-    
-    // Alloca memoria per lo zaino del giocatore
-    session->bag_objs = malloc(sizeof(game_room*) * rooms[room].dim_bag);
-    if (session->bag_objs == NULL) {
-        free(session);
-        return NULL;
+
+    n_added = reload.n_added;
+    n_changed = reload.n_versions - n_added;
+    n_unchanged = reload.n_loaded - reload.n_versions;
+    start = checkpoint_clock_ns();
+    if (!publish_rooms(&reload)) {
+        snprintf(msg, msg_dim, "Ricaricamento delle room non riuscito: memoria esaurita");
+        return ROOM_RELOAD_FAILED;
+    }
+
+    snprintf(msg, msg_dim, "Room ricaricate: %d modificate, %d nuove, %d invariate, pubblicate in %.3f ms",
+        n_changed, n_added, n_unchanged, (checkpoint_clock_ns() - start) / 1e6);
+    return ROOM_RELOAD_DONE;
+}
+
+static void* reload_worker(void* arg)
+{
+    (void)arg;
+    load_rooms(&reload);
+    atomic_store(&reload_done, true);
+    return NULL;
+}
+
+/*
+ * Legge le room dal pacchetto o dalla cartella e prepara le versioni delle room nuove o modificate.
+ * Può essere eseguita da un thread diverso da quello principale: alloca solo memoria non attribuita ai sottosistemi,
+ * che viene attribuita alla pubblicazione, e legge soltanto le versioni correnti, che cambiano solo pubblicando.
+ * In caso di errore load->ok è false e tutto ciò che è stato caricato viene liberato.
+ */
+static void load_rooms(room_load* load)
+{
+    int fd = load->pack_path != NULL ? open(load->pack_path, O_RDONLY) : -1;
+
+    if (fd >= 0)
+        load->ok = map_rooms(load, fd);
+    else if (load->pack_path == NULL || errno == ENOENT)
+        load->ok = compile_rooms(load);
+    else {
+        snprintf(load->error, sizeof(load->error), "%s: pacchetto non leggibile", load->pack_path);
+        load->ok = false;
+    }
+
+    if (!load->ok)
+        discard_load(load);
+}
+
+// Alloca lo spazio per n versioni caricate
+static bool alloc_load(room_load* load, int n)
+{
+    load->versions = malloc(n * sizeof(room_version*));
+    load->slots = malloc(n * sizeof(int));
+    if (load->versions == NULL || load->slots == NULL) {
+        snprintf(load->error, sizeof(load->error), "memoria esaurita");
+        return false;
     }
-    memset(session->bag_objs, 0, sizeof(game_room*) * rooms[room].dim_bag);
+    return true;
+}
+
+/*
+ * Aggiunge al caricamento i metadati di una room, abbinandola per nome a una room già caricata. Dell'immagine
+ * vengono lette solo l'intestazione e il nome; se ha la stessa dimensione e lo stesso hash dell'immagine
+ * della versione corrente viene ignorata.
+ * 
+ * Parametri:
+ *   - load: Caricamento in corso.
+ *   - index: Indice delle room caricate per nome, costruito da index_room_names.
+ *   - index_mask: Dimensione dell'indice meno uno.
+ *   - image: Immagine della room, nel pacchetto mappato se load->mapping non è NULL.
+ *   - size: Dimensione dell'immagine.
+ *   - hash: room_image_hash dell'immagine.
+ *   - path: File di definizione da cui ricompilare l'immagine, significativo se load->mapping è NULL.
+ * 
+ * Restituisce:
+ *   - true se l'immagine è valida, false altrimenti.
+ */
+static bool add_loaded_room(room_load* load, int* index, uint32_t index_mask, const void* image, size_t size, uint64_t hash, const char* path)
+{
+    room_version* version;
+    const room_header* header;
+    const char* name;
+    uint32_t slot;
+    int r = -1;
+
+    header = room_peek(image, size, &name);
+    if (header == NULL || strlen(name) >= MAX_ROOM_NAME_DIM)
+        return false;
+    load->n_loaded++;
 
-    // Conta il numero di oggetti bloccati, nascosti e consumabili all'interno della stanza
-    session->n_special_objects = 0;
-    for (i = 0; i < rooms[room].n_locations; i++) 
+    // Ricerca della room con lo stesso nome, ogni room già caricata può essere abbinata una sola volta
+    for (slot = (uint32_t)hash_string(name) & index_mask; index != NULL && index[slot] != 0; slot = (slot + 1) & index_mask)
     {
-        int j;
-        for (j = 0; j < rooms[room].locations[i].n_objs; j++) 
-        {
-            if (rooms[room].locations[i].objs[j].isLocked ||
-                rooms[room].locations[i].objs[j].isHidden ||
-                rooms[room].locations[i].objs[j].consumable)
-                    session->n_special_objects++;
-            
-            if (rooms[room].locations[i].objs[j].isLocked)
-                n_locked_objs++;
-            if (rooms[room].locations[i].objs[j].isHidden)
-                n_hidden_objs++;
-            if (rooms[room].locations[i].objs[j].consumable)
-                n_consumable_objs++;
+        int candidate = index[slot] > 0 ? index[slot] - 1 : -index[slot] - 1;
+
+        if (index[slot] > 0 && strcmp(rooms[candidate].current->name, name) == 0) {
+            index[slot] = -index[slot];
+            r = candidate;
+            break;
         }
     }
-    session->n_locked_objs = n_locked_objs;
-    session->n_hidden_objs = n_hidden_objs;
-    session->n_consumable_objs = n_consumable_objs;
 
-    // Alloca memoria per gli oggetti sbloccabili
-    session->unlocked_objs = malloc(sizeof(game_obj*) * n_locked_objs);
-    if (session->unlocked_objs == NULL) {
-        free(session->bag_objs);
-        free(session);
-        return NULL;
+    if (r >= 0 && rooms[r].current->image_size == size && rooms[r].current->image_hash == hash)
+        return true;
+    if (r < 0) {
+        if (n_rooms + load->n_added >= MAX_ROOMS) {
+            snprintf(load->error, sizeof(load->error), "room oltre il massimo di %d", MAX_ROOMS);
+            return false;
+        }
+        r = n_rooms + load->n_added++;
     }
-    memset(session->unlocked_objs, 0, sizeof(game_obj*) * n_locked_objs);
 
-    // Alloca memoria per gli oggetti nascosti
-    session->revealed_objs = malloc(sizeof(game_obj*) * n_hidden_objs);
-    if (session->revealed_objs == NULL) {
-        free(session->bag_objs);
-        free(session->unlocked_objs);
-        free(session);
-        return NULL;
+    version = calloc(1, sizeof(room_version));
+    if (version == NULL || (load->mapping == NULL && (version->path = strdup(path)) == NULL)) {
+        snprintf(load->error, sizeof(load->error), "memoria esaurita");
+        free(version);
+        return false;
+    }
+    strcpy(version->name, name);
+    version->n_objs = header->n_objs;
+    version->image_hash = hash;
+    version->image_size = size;
+    version->mapping = load->mapping;
+    if (load->mapping != NULL) {
+        version->image = image;
+        load->mapping->refs++;
     }
-    memset(session->revealed_objs, 0, sizeof(game_obj*) * n_hidden_objs);
+    version->refs = 1;
+
+    // Dimensione di una sessione, calcolata una volta sola per tutte le sessioni della versione
+    version->pool.block_size = sizeof(game_session) + 4 * header->n_obj_words * sizeof(uint64_t);
+
+    load->versions[load->n_versions] = version;
+    load->slots[load->n_versions] = r;
+    load->n_versions++;
+    return true;
+}
+
+/*
+ * Costruisce un indice a indirizzamento aperto delle room caricate per nome, con gli indici aumentati di uno
+ * (0 indica uno slot vuoto). Restituisce NULL se non ci sono room caricate o in caso di errore di allocazione,
+ * nel qual caso tutte le room lette vengono considerate nuove.
+ */
+static int* index_room_names(uint32_t* mask)
+{
+    uint32_t dim = 16, slot;
+    int* index;
+    int r;
 
-    // Alloca memoria per gli oggetti consumabili
-    session->consumed_objs = malloc(sizeof(game_obj*) * n_consumable_objs);
-    if (session->consumed_objs == NULL) {
-        free(session->bag_objs);
-        free(session->unlocked_objs);
-        free(session->revealed_objs);
-        free(session);
+    if (n_rooms == 0)
         return NULL;
+    while (dim < 2 * (uint32_t)n_rooms)
+        dim *= 2;
+    index = calloc(dim, sizeof(int));
+    if (index == NULL)
+        return NULL;
+
+    *mask = dim - 1;
+    for (r = 0; r < n_rooms; r++) {
+        slot = (uint32_t)hash_string(rooms[r].current->name) & *mask;
+        while (index[slot] != 0)
+            slot = (slot + 1) & *mask;
+        index[slot] = r + 1;
     }
-    memset(session->consumed_objs, 0, sizeof(game_obj*) * n_consumable_objs);
+    return index;
+}
 
-    // Inizializza gli altri campi
-    strncpy(session->username, username, MAX_USR_DIM);
-    session->username[MAX_USR_DIM - 1] = '\0';
-    
-    session->sd = sd;
-    session->room = room;
-    session->help_msg_id = 0;
-    memset(session->help_msg, '\0', 1);
-    session->seconds = rooms[room].seconds;
-    session->start_time = getTimestamp();
-    session->token = 0;
-    session->dim_bag = rooms[room].dim_bag;
-    session->n_bag_objs = 0;
-    session->next = NULL;
+// Mappa il pacchetto aperto in fd, le cui immagini verranno usate sul posto. Chiude fd.
+static bool map_rooms(room_load* load, int fd)
+{
+    struct stat st;
+    void* pack;
+    int* index;
+    uint32_t i, n, mask = 0;
+    bool ok = true;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        snprintf(load->error, sizeof(load->error), "%s: pacchetto non leggibile", load->pack_path);
+        close(fd);
+        return false;
+    }
+    pack = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pack == MAP_FAILED) {
+        snprintf(load->error, sizeof(load->error), "%s: pacchetto non mappabile", load->pack_path);
+        return false;
+    }
 
-    return session;
+    n = room_pack_count(pack, st.st_size);
+    if (n == 0 || n > MAX_ROOMS) {
+        snprintf(load->error, sizeof(load->error), "%s: pacchetto non valido, va ricompilato con roomc", load->pack_path);
+        munmap(pack, st.st_size);
+        return false;
+    }
+    load->mapping = malloc(sizeof(room_mapping));
+    if (load->mapping == NULL) {
+        snprintf(load->error, sizeof(load->error), "memoria esaurita");
+        munmap(pack, st.st_size);
+        return false;
+    }
+    load->mapping->base = pack;
+    load->mapping->size = st.st_size;
+    load->mapping->refs = 0;
+    if (!alloc_load(load, n))
+        return false;
+
+    index = index_room_names(&mask);
+    for (i = 0; i < n && ok; i++)
+    {
+        size_t size;
+        uint64_t hash;
+        const void* image = room_pack_image(pack, i, &size, &hash);
+
+        load->error[0] = '\0';
+        ok = add_loaded_room(load, index, mask, image, size, hash, NULL);
+        if (!ok && load->error[0] == '\0')
+            snprintf(load->error, sizeof(load->error), "%s: immagine della room %u non valida, va ricompilato con roomc",
+                load->pack_path, i);
+    }
+    free(index);
+    return ok;
+}
+
+// Carica e compila i file di definizione della cartella, tenendo delle immagini solo i metadati
+static bool compile_rooms(room_load* load)
+{
+    char** paths;
+    int* index;
+    int r, n_paths = room_dir_list(load->dir, &paths);
+    uint32_t mask = 0;
+    bool ok = true;
+
+    if (n_paths < 0) {
+        snprintf(load->error, sizeof(load->error), "%s: cartella delle room non leggibile", load->dir);
+        return false;
+    }
+    if (n_paths == 0 || n_paths > MAX_ROOMS) {
+        snprintf(load->error, sizeof(load->error), "%s: %d file di definizione, ne servono da 1 a %d",
+            load->dir, n_paths, MAX_ROOMS);
+        room_dir_free(paths, n_paths);
+        return false;
+    }
+    if (!alloc_load(load, n_paths)) {
+        room_dir_free(paths, n_paths);
+        return false;
+    }
+
+    index = index_room_names(&mask);
+    for (r = 0; r < n_paths && ok; r++)
+    {
+        game_room_def* def = room_def_load(paths[r], load->error, sizeof(load->error));
+        room_view view;
+        size_t size;
+        void* image;
+
+        if (def == NULL) {
+            ok = false;
+            break;
+        }
+        image = room_compile(def, &size);
+        room_def_free(def);
+
+        load->error[0] = '\0';
+        if (image == NULL || !room_attach(&view, image, size) ||
+            !add_loaded_room(load, index, mask, image, size, room_image_hash(image, size), paths[r])) {
+            if (load->error[0] == '\0')
+                snprintf(load->error, sizeof(load->error), "%s: compilazione non riuscita", paths[r]);
+            ok = false;
+        }
+        free(image);
+    }
+    free(index);
+    room_dir_free(paths, n_paths);
+    return ok;
+}
+
+// Libera tutto ciò che è stato letto da un caricamento non pubblicato
+static void discard_load(room_load* load)
+{
+    int i;
+
+    for (i = 0; i < load->n_versions; i++) {
+        free(load->versions[i]->path);
+        free(load->versions[i]);
+    }
+    if (load->mapping != NULL) {
+        munmap(load->mapping->base, load->mapping->size);
+        free(load->mapping);
+    }
+    free(load->versions);
+    free(load->slots);
+    load->versions = NULL;
+    load->slots = NULL;
+    load->mapping = NULL;
+    load->n_versions = 0;
 }
 
 /*
- * Avvia una nuova sessione di gioco per l'utente.
+ * Rende correnti le versioni di un caricamento terminato con successo, attribuendo ai sottosistemi la memoria
+ * allocata durante il caricamento. Le versioni sostituite restano in uso finché le loro partite non terminano.
  * 
- * Parametri:
- *   - sd: Descrittore del socket associato all'utente.
- *   - username: nome dell'utente.
- *   - room: Numero della stanza in cui si trova l'utente.
+ * Restituisce:
+ *   - true se le versioni sono state pubblicate, false in caso di errore nell'allocazione di memoria,
+ *     nel qual caso il caricamento viene scartato.
+ */
+static bool publish_rooms(room_load* load)
+{
+    int i, n = n_rooms + load->n_added;
+
+    if (n > n_rooms) {
+        game_room* grown = mem_realloc(MEM_ROOMS, rooms, n_rooms * sizeof(game_room), n * sizeof(game_room));
+        if (grown == NULL) {
+            discard_load(load);
+            return false;
+        }
+        memset(grown + n_rooms, 0, load->n_added * sizeof(game_room));
+        rooms = grown;
+    }
+
+    // Un pacchetto di cui nessuna immagine è cambiata non serve più
+    if (load->mapping != NULL && load->mapping->refs == 0) {
+        munmap(load->mapping->base, load->mapping->size);
+        free(load->mapping);
+    }
+    else if (load->mapping != NULL) {
+        mem_add(MEM_ROOMS, sizeof(room_mapping));
+        mapped_bytes += load->mapping->size;
+    }
+
+    for (i = 0; i < load->n_versions; i++)
+    {
+        room_version* version = load->versions[i];
+        game_room* room = &rooms[load->slots[i]];
+
+        mem_add(MEM_ROOMS, sizeof(room_version));
+        if (version->path != NULL)
+            mem_add(MEM_ROOMS, strlen(version->path) + 1);
+
+        version->number = room->current != NULL ? room->current->number + 1 : 1;
+        if (room->current != NULL) {
+            if (room->current->idle)
+                lru_unlink(room->current);
+            n_old_versions++;
+            release_version(room->current);
+        }
+        room->current = version;
+    }
+    n_rooms = n;
+
+    // I nomi cambiano solo quando vengono aggiunte room; se il catalogo non può essere ricostruito resta quello precedente
+    if (load->n_added > 0 && !build_catalog()) {
+        #ifdef VERBOSE
+            printf("↳ Memoria esaurita, il catalogo delle stanze non include le room aggiunte\n");
+        #endif
+    }
+
+    free(load->versions);
+    free(load->slots);
+    return true;
+}
+
+/*
+ * Ricostruisce il catalogo dei nomi delle room con una nuova versione. Le pagine vengono riempite di nomi fino
+ * alla dimensione massima del payload e codificate una volta sola, così che sendRoomNames invii ogni pagina
+ * con una sola chiamata di sistema. La prima versione dipende dall'istante di avvio, così che la cache di un client
+ * non risulti valida per il catalogo di un altro avvio del server.
  * 
  * Restituisce:
- *   - true se la sessione è stata avviata con successo, altrimenti false.
+ *   - true se il catalogo è stato ricostruito, false in caso di errore di allocazione (il catalogo resta invariato).
  */
-static bool start_session(int sd, const char* username, int room) 
+static bool build_catalog()
 {
-    game_session* session = create_session(sd, username, room);
-    if (session == NULL)
+    const size_t budget = MAX_PAYLOAD_DIM - 1 - CATALOG_HEADER_DIM;
+    room_catalog next;
+    desc_msg msg;
+    size_t used = 0, len, capacity;
+    int* firsts;
+    int r, p, n_pages = 0;
+
+    // Divide le room in pagine, ognuna con i nomi che entrano nel payload dopo l'intestazione
+    firsts = malloc((n_rooms + 2) * sizeof(int));
+    if (firsts == NULL)
+        return false;
+    firsts[0] = 0;
+    for (r = 0; r < n_rooms; r++) {
+        len = strlen(rooms[r].current->name) + 1;
+        if (used + len > budget) {
+            firsts[++n_pages] = r;
+            used = 0;
+        }
+        used += len;
+    }
+    firsts[++n_pages] = n_rooms;
+
+    memset(&next, 0, sizeof(next));
+    next.version = catalog.version != 0 ? catalog.version + 1 : (uint32_t)getTimestamp();
+    if (next.version == 0)
+        next.version = 1;
+    next.n_pages = n_pages;
+    capacity = (size_t)n_pages * (MSG_HEADER_DIM + MAX_PAYLOAD_DIM);
+    next.data = mem_alloc(MEM_ROOMS, capacity);
+    next.offs = mem_alloc(MEM_ROOMS, (n_pages + 1) * sizeof(size_t));
+    if (next.data == NULL || next.offs == NULL) {
+        mem_free(MEM_ROOMS, next.data, capacity);
+        mem_free(MEM_ROOMS, next.offs, (n_pages + 1) * sizeof(size_t));
+        free(firsts);
         return false;
+    }
 
-    session->next = sessions_list;
-    sessions_list = session;
-    n_sessions++;
-    return true;
+    for (p = 0; p < n_pages; p++)
+    {
+        msg.type = MSG_ROOM_CATALOG_PAGE;
+        len = snprintf(msg.payload, CATALOG_HEADER_DIM, "%u %d %d %d %d", next.version, n_rooms, p, n_pages, firsts[p]);
+        for (r = firsts[p]; r < firsts[p + 1]; r++)
+            len += sprintf(msg.payload + len, "\n%s", rooms[r].current->name);
+
+        next.offs[p] = next.size;
+        next.size += encode_msg(&msg, next.data + next.size);
+    }
+    next.offs[n_pages] = next.size;
+    free(firsts);
+
+    if (catalog.n_pages > 0) {
+        mem_free(MEM_ROOMS, catalog.data, (size_t)catalog.n_pages * (MSG_HEADER_DIM + MAX_PAYLOAD_DIM));
+        mem_free(MEM_ROOMS, catalog.offs, (catalog.n_pages + 1) * sizeof(size_t));
+    }
+    catalog = next;
+
+    #ifdef VERBOSE
+        printf("↳ Catalogo delle stanze alla versione %u: %d room in %d pagine, %zu byte\n", catalog.version, n_rooms, n_pages, catalog.size);
+    #endif
+    return true;
+}
+
+/*
+ * Rilascia un riferimento a una versione di una room. All'ultimo riferimento la versione, che non è più corrente,
+ * viene messa in attesa di essere liberata da reclaim_versions, così che la pubblicazione di molte room
+ * non debba liberarle tutte insieme.
+ */
+static void release_version(room_version* version)
+{
+    if (--version->refs > 0)
+        return;
+
+    version->next_retired = retired_versions;
+    retired_versions = version;
+}
+
+/*
+ * Libera le versioni non più usate, insieme ai loro corpi, per al massimo
+ * ROOM_RECLAIM_BUDGET_US microsecondi. Il pacchetto che conteneva una versione viene smappato quando
+ * non ne contiene altre in uso.
+ */
+static void reclaim_versions()
+{
+    uint64_t deadline = checkpoint_clock_ns() + ROOM_RECLAIM_BUDGET_US * 1000ULL;
+    int n = 0;
+
+    while (retired_versions != NULL)
+    {
+        room_version* version = retired_versions;
+
+        // Il tempo viene controllato ogni 16 versioni, liberarne una costa molto meno di leggere l'orologio
+        if (++n % 16 == 0 && checkpoint_clock_ns() > deadline)
+            break;
+        retired_versions = version->next_retired;
+
+        if (version->loaded)
+            drop_body(version);
+        if (version->mapping == NULL)
+            mem_free(MEM_ROOMS, version->path, strlen(version->path) + 1);
+        else if (--version->mapping->refs == 0) {
+            mapped_bytes -= version->mapping->size;
+            munmap(version->mapping->base, version->mapping->size);
+            mem_free(MEM_ROOMS, version->mapping, sizeof(room_mapping));
+        }
+
+        mem_free(MEM_ROOMS, version, sizeof(room_version));
+        n_old_versions--;
+    }
+}
+
+/*
+ * Prepara il corpo di una versione corrente per una nuova partita, togliendolo dalla lista dei corpi
+ * senza partite o caricandolo se è stato rimosso o non è mai stato usato.
+ * 
+ * Restituisce:
+ *   - true se il corpo è utilizzabile, false se non può essere caricato.
+ */
+static bool acquire_body(room_version* version)
+{
+    if (version->idle)
+        lru_unlink(version);
+    if (version->loaded) {
+        body_stats.n_hits++;
+        return true;
+    }
+    if (!load_body(version))
+        return false;
+
+    trim_bodies();
+    return true;
+}
+
+/*
+ * Carica il corpo di una versione. L'immagine nel pacchetto viene verificata sul posto, mentre quella di un file
+ * di definizione viene ricompilata e deve essere identica a quella letta dal caricamento della versione.
+ * 
+ * Restituisce:
+ *   - true se il corpo è stato caricato, false se l'immagine non è valida, se il file di definizione è cambiato
+ *     o se la memoria supererebbe il limite.
+ */
+static bool load_body(room_version* version)
+{
+    uint64_t start = checkpoint_clock_ns(), elapsed;
+
+    if (version->mapping == NULL)
+    {
+        char error[ROOM_ERROR_DIM];
+        game_room_def* def = room_def_load(version->path, error, sizeof(error));
+        void* image = NULL;
+        size_t size = 0;
+
+        if (def != NULL) {
+            image = room_compile(def, &size);
+            room_def_free(def);
+        }
+        if (image == NULL || size != version->image_size || room_image_hash(image, size) != version->image_hash ||
+            mem_total + size > max_memory_bytes) {
+            #ifdef VERBOSE
+                printf("↳ La room \"%s\" non può essere caricata da %s\n", version->name, version->path);
+            #endif
+            free(image);
+            body_stats.n_failed++;
+            return false;
+        }
+        mem_add(MEM_ROOMS, size);
+        version->image = image;
+    }
+
+    if (!room_attach(&version->view, version->image, version->image_size)) {
+        #ifdef VERBOSE
+            printf("↳ L'immagine della room \"%s\" non è valida\n", version->name);
+        #endif
+        if (version->mapping == NULL) {
+            mem_free(MEM_ROOMS, (void*)version->image, version->image_size);
+            version->image = NULL;
+        }
+        body_stats.n_failed++;
+        return false;
+    }
+    version->loaded = true;
+
+    elapsed = checkpoint_clock_ns() - start;
+    body_stats.bytes += version->image_size;
+    body_stats.n_loaded++;
+    body_stats.n_loads++;
+    body_stats.load_ns += elapsed;
+    if (elapsed > body_stats.max_load_ns)
+        body_stats.max_load_ns = elapsed;
+    return true;
+}
+
+// Mette in coda alla lista LRU il corpo di una versione corrente rimasta senza partite
+static void park_body(room_version* version)
+{
+    version->idle = true;
+    body_stats.n_idle++;
+    version->lru_next = NULL;
+    version->lru_prev = lru_tail;
+    if (lru_tail != NULL)
+        lru_tail->lru_next = version;
+    else
+        lru_head = version;
+    lru_tail = version;
+
+    trim_bodies();
+}
+
+static void lru_unlink(room_version* version)
+{
+    if (version->lru_prev != NULL)
+        version->lru_prev->lru_next = version->lru_next;
+    else
+        lru_head = version->lru_next;
+    if (version->lru_next != NULL)
+        version->lru_next->lru_prev = version->lru_prev;
+    else
+        lru_tail = version->lru_prev;
+
+    version->lru_prev = NULL;
+    version->lru_next = NULL;
+    version->idle = false;
+    body_stats.n_idle--;
+}
+
+// Rimuove i corpi senza partite usati meno di recente finché le immagini caricate non rientrano nel budget
+static void trim_bodies()
+{
+    while (body_stats.bytes > room_body_budget && lru_head != NULL) {
+        room_version* version = lru_head;
+        lru_unlink(version);
+        drop_body(version);
+        body_stats.n_evictions++;
+    }
+}
+
+/*
+ * Libera il corpo di una versione senza partite: i blocchi del pool e l'immagine. Delle immagini nel pacchetto
+ * vengono restituite al sistema le pagine che contengono solo l'immagine; il file resta mappato
+ * e le pagine vengono rilette al prossimo caricamento.
+ */
+static void drop_body(room_version* version)
+{
+    session_pool* pool = &version->pool;
+
+    while (pool->slabs != NULL) {
+        void* next = *(void**)pool->slabs;
+        mem_free(MEM_SESSIONS, pool->slabs, pool_slab_size(pool));
+        pool->slabs = next;
+    }
+    pool->free_list = NULL;
+    pool->n_free = 0;
+    pool->n_slabs = 0;
+
+    if (version->mapping == NULL) {
+        mem_free(MEM_ROOMS, (void*)version->image, version->image_size);
+        version->image = NULL;
+    }
+    else {
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t first = ((uintptr_t)version->image + page - 1) & ~(page - 1);
+        uintptr_t last = ((uintptr_t)version->image + version->image_size) & ~(page - 1);
+        if (last > first)
+            madvise((void*)first, last - first, MADV_DONTNEED);
+    }
+
+    version->loaded = false;
+    body_stats.bytes -= version->image_size;
+    body_stats.n_loaded--;
+}
+
+static inline bool obj_set_test(const uint64_t* set, uint32_t id)
+{
+    return (set[id >> 6] >> (id & 63)) & 1;
+}
+static inline void obj_set_add(uint64_t* set, uint32_t id)
+{
+    set[id >> 6] |= 1ULL << (id & 63);
+}
+static inline void obj_set_remove(uint64_t* set, uint32_t id)
+{
+    set[id >> 6] &= ~(1ULL << (id & 63));
+}
+
+//-------------------------//
+
+//---Connections Management---//
+
+// Tabella delle connessioni, indicizzata per descrittore del socket
+static game_conn conns[MAX_CONNS];
+
+/*
+ * Restituisce il riferimento allo stato della connessione associata al descrittore del socket specificato.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket.
+ * 
+ * Restituisce:
+ *   - Puntatore allo stato della connessione, o NULL se il descrittore non è valido.
+ */
+static game_conn* get_conn(int sd)
+{
+    if (sd < 0 || sd >= MAX_CONNS)
+        return NULL;
+    return &conns[sd];
+}
+
+/*
+ * Restituisce il buffer da usare per la ricezione dei messaggi sulla connessione specificata.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket.
+ * 
+ * Restituisce:
+ *   - Puntatore al buffer della connessione, o NULL se il descrittore non è valido.
+ */
+desc_msg* connMsgBuffer(int sd)
+{
+    game_conn* conn = get_conn(sd);
+    if (conn == NULL)
+        return NULL;
+
+    // Ogni richiesta ricevuta passa per il buffer della connessione
+    conn->n_requests++;
+    conn->last_activity = getTimestamp();
+    return &conn->msg;
+}
+
+/*
+ * Verifica se la connessione specificata ha superato il numero di richieste rifiutate consentite,
+ * ad esempio per tentativi ripetuti di indovinare un token di ripresa.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket.
+ * 
+ * Restituisce:
+ *   - true se la connessione va chiusa, false altrimenti.
+ */
+bool connTooManyErrors(int sd)
+{
+    game_conn* conn = get_conn(sd);
+    return conn != NULL && conn->n_errors >= MAX_CONN_ERRORS;
+}
+
+/*
+ * Verifica se la connessione può eseguire richieste da supervisore, cioè se si è identificata
+ * come supervisore con MSG_SU_REQ_HELLO (authSupervisor).
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket.
+ * 
+ * Restituisce:
+ *   - true se la richiesta è consentita, false altrimenti.
+ */
+static bool check_supervisor(int sd)
+{
+    game_conn* conn = get_conn(sd);
+    if (conn == NULL)
+        return false;
+
+    if (conn->state != CONN_SUPERVISOR) {
+        #ifdef VERBOSE
+            printf("↳ La connessione sul socket %d non è di un supervisore\n", sd);
+        #endif
+        conn->n_errors++;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Verifica che il client sia sulla stessa macchina del server: socket locale, oppure indirizzo di loopback.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket.
+ */
+static bool is_local_peer(int sd)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+
+    if (getpeername(sd, (struct sockaddr*)&addr, &addr_len) != 0)
+        return false;
+
+    switch (addr.ss_family)
+    {
+        case AF_UNIX:
+            return true;
+        case AF_INET:
+            return (ntohl(((struct sockaddr_in*)&addr)->sin_addr.s_addr) >> 24) == 127;
+        case AF_INET6:
+        {
+            const struct in6_addr* in6 = &((struct sockaddr_in6*)&addr)->sin6_addr;
+            if (IN6_IS_ADDR_V4MAPPED(in6))
+                return in6->s6_addr[12] == 127;
+            return IN6_IS_ADDR_LOOPBACK(in6);
+        }
+        default:
+            return false;
+    }
+}
+
+//-------------------------//
+
+//---Sessions Management---//
+
+static su_subscription subscriptions[MAX_SUBSCRIPTIONS];
+static int n_subscriptions = 0;
+
+// Lista delle sessioni di gioco
+static game_session* sessions_list = NULL;
+static int n_sessions = 0;
+static int max_sessions = MAX_SESSIONS;             // Sessioni oltre le quali le nuove partite vengono rifiutate
+
+// Indici delle sessioni per username e per token di ripresa, tabelle hash con liste di trabocco e lo stesso numero di bucket
+// (la ricerca per socket passa dalla tabella delle connessioni)
+static game_session** sessions_by_username = NULL;
+static game_session** sessions_by_token = NULL;
+static size_t n_session_buckets = 0;
+
+// Secondi per cui una sessione senza connessione resta in attesa di essere ripresa
+static int session_grace_seconds = SESSION_GRACE_SECONDS;
+
+// Sessioni senza connessione, dalla prima che scade: con un periodo di attesa fisso vengono sempre aggiunte in coda
+static game_session* parked_head = NULL;
+static game_session* parked_tail = NULL;
+static int n_parked = 0;
+
+/*
+ * Genera un token di ripresa casuale, composto da RESUME_TOKEN_DIM - 1 cifre esadecimali.
+ * Il token vale come credenziale della sessione, quindi senza /dev/urandom non viene generato.
+ * 
+ * Parametri:
+ *   - token: Buffer di almeno RESUME_TOKEN_DIM caratteri in cui scrivere il token.
+ * 
+ * Restituisce:
+ *   - true se il token è stato generato, false se /dev/urandom non può essere letto.
+ */
+static bool generate_resume_token(char* token)
+{
+    unsigned char bytes[(RESUME_TOKEN_DIM - 1) / 2];
+    size_t i, n = 0;
+    FILE* fd = fopen("/dev/urandom", "r");
+
+    if (fd != NULL) {
+        n = fread(bytes, 1, sizeof(bytes), fd);
+        fclose(fd);
+    }
+    if (n != sizeof(bytes))
+        return false;
+
+    for (i = 0; i < sizeof(bytes); i++)
+        sprintf(&token[i * 2], "%02x", bytes[i]);
+    token[RESUME_TOKEN_DIM - 1] = '\0';
+    return true;
+}
+
+/*
+ * Crea una nuova sessione di gioco e restituisce il puntatore ad essa.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket associato all'utente.
+ *   - username: nome dell'utente.
+ *   - room: Numero della stanza in cui l'utente vuole giocare.
+ *   - resume_token: Token di ripresa della sessione.
+ * 
+ * Restituisce:
+ *   - Puntatore alla nuova sessione creata, o NULL se la room non può essere caricata
+ *     o in caso di errore nell'allocazione di memoria.
+ */
+static game_session* create_session(int sd, const char* username, int room, const char* resume_token) 
+{
+    room_version* version = rooms[room].current;
+    const room_view* view = &version->view;
+    game_session* session;
+    int n_words;
+
+    // Il corpo della room viene caricato alla prima partita, o dopo essere stato rimosso
+    if (!acquire_body(version))
+        return NULL;
+    session = pool_get(&version->pool);
+    if (session == NULL) {
+        if (version->refs == 1)
+            park_body(version);
+        return NULL;
+    }
+    n_words = view->header->n_obj_words;
+
+    // La partita resta sulla versione corrente della room fino al suo termine
+    session->version = version;
+    version->refs++;
+
+    // I quattro insiemi che descrivono lo stato degli oggetti sono in coda alla sessione
+    session->locked = session->obj_state;
+    session->hidden = session->locked + n_words;
+    session->consumed = session->hidden + n_words;
+    session->bag = session->consumed + n_words;
+
+    // All'inizio della partita gli oggetti bloccati e nascosti sono quelli definiti dalla stanza
+    memcpy(session->locked, view->initial_locked, n_words * sizeof(uint64_t));
+    memcpy(session->hidden, view->initial_hidden, n_words * sizeof(uint64_t));
+    memset(session->consumed, 0, 2 * n_words * sizeof(uint64_t));
+
+    // Inizializza gli altri campi
+    strncpy(session->username, username, MAX_USR_DIM);
+    session->username[MAX_USR_DIM - 1] = '\0';
+    
+    session->sd = sd;
+    session->room = room;
+    strcpy(session->resume_token, resume_token);
+    session->detached_at = 0;
+    session->expires_at = 0;
+    session->help_msg_id = 0;
+    memset(session->help_msg, '\0', 1);
+    session->deadline = game_now() + (int64_t)view->header->seconds * 1000;
+    session->remaining = 0;
+    session->paused = 0;
+    session->token = 0;
+    session->dim_bag = view->header->dim_bag;
+    session->n_bag_objs = 0;
+    session->next = NULL;
+    session->prev = NULL;
+    session->next_by_username = NULL;
+    session->next_by_token = NULL;
+    session->next_parked = NULL;
+    session->prev_parked = NULL;
+
+    return session;
+}
+
+/*
+ * Avvia una nuova sessione di gioco per l'utente.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket associato all'utente.
+ *   - username: nome dell'utente.
+ *   - room: Numero della stanza in cui si trova l'utente.
+ * 
+ * Restituisce:
+ *   - true se la sessione è stata avviata con successo, altrimenti false.
+ */
+static bool start_session(int sd, const char* username, int room) 
+{
+    game_conn* conn = get_conn(sd);
+    game_session* session;
+    char resume_token[RESUME_TOKEN_DIM];
+    if (conn == NULL)
+        return false;
+
+    if (!generate_resume_token(resume_token)) {
+        #ifdef VERBOSE
+            printf("↳ Impossibile leggere /dev/urandom, la partita non viene avviata senza un token di ripresa sicuro\n");
+        #endif
+        return false;
+    }
+    session = create_session(sd, username, room, resume_token);
+    if (session == NULL)
+        return false;
+
+    if (!add_session(session))
+        return false;
+    log_session(session);
+
+    // Associa la sessione alla connessione
+    conn->session = session;
+    conn->state = CONN_IN_GAME;
+    return true;
+}
+
+/*
+ * Inserisce una sessione appena creata nell'indice per username e nella lista delle sessioni.
+ * In caso di errore la sessione viene restituita al pool.
+ * 
+ * Restituisce:
+ *   - true se la sessione è stata inserita, false in caso di errore nell'allocazione di memoria.
+ */
+static bool add_session(game_session* session)
+{
+    if (!index_session(session)) {
+        release_session(session);
+        return false;
+    }
+
+    session->next = sessions_list;
+    if (sessions_list != NULL)
+        sessions_list->prev = session;
+    sessions_list = session;
+    n_sessions++;
+    return true;
+}
+
+/*
+ * Termina una sessione di gioco.
+ * 
+ * Parametri:
+ *   - session: Puntatore alla sessione di gioco da terminare.
+ */
+static void stop_session(game_session* session) 
+{
+    game_conn* conn;
+
+    if (session == NULL)
+        return;
+    log_stop(session);
+    if (n_subscriptions > 0)
+        end_subscriptions(session);
+
+    conn = get_conn(session->sd);
+    if (conn != NULL && conn->session == session) {
+        // La connessione torna nello stato di utente autenticato
+        conn->session = NULL;
+        conn->state = CONN_AUTH;
+    }
+
+    // Rimozione dall'indice e dalle liste, in tempo costante grazie al collegamento doppio
+    unindex_session(session);
+    unpark_session(session);
+    if (session->prev == NULL)
+        sessions_list = session->next;
+    else
+        session->prev->next = session->next;
+    if (session->next != NULL)
+        session->next->prev = session->prev;
+
+    release_session(session);
+
+    n_sessions--;
+}
+
+/*
+ * Preleva una sessione dal pool, allocando un nuovo blocco di SESSION_SLAB_DIM sessioni se il pool è vuoto.
+ * 
+ * Restituisce:
+ *   - Puntatore alla sessione, o NULL in caso di errore nell'allocazione di memoria.
+ */
+static game_session* pool_get(session_pool* pool)
+{
+    game_session* session;
+
+    if (pool->free_list == NULL)
+    {
+        // Il blocco inizia con il puntatore al blocco precedente, seguito dalle sessioni
+        size_t header = (sizeof(void*) + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+        char* slab = mem_alloc(MEM_SESSIONS, pool_slab_size(pool));
+        int i;
+        if (slab == NULL)
+            return NULL;
+
+        *(void**)slab = pool->slabs;
+        pool->slabs = slab;
+        pool->n_slabs++;
+
+        for (i = SESSION_SLAB_DIM - 1; i >= 0; i--) {
+            session = (game_session*)(slab + header + i * pool->block_size);
+            session->next = pool->free_list;
+            pool->free_list = session;
+        }
+        pool->n_free += SESSION_SLAB_DIM;
+    }
+
+    session = pool->free_list;
+    pool->free_list = session->next;
+    pool->n_free--;
+    return session;
+}
+
+// Dimensione di un blocco del pool: il puntatore al blocco precedente, allineato a 8 byte, e SESSION_SLAB_DIM sessioni
+static size_t pool_slab_size(const session_pool* pool)
+{
+    size_t header = (sizeof(void*) + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    return header + pool->block_size * SESSION_SLAB_DIM;
+}
+
+/*
+ * Restituisce una sessione al pool, per essere riusata dalla prossima partita nella stessa room.
+ */
+static void pool_put(session_pool* pool, game_session* session)
+{
+    session->next = pool->free_list;
+    pool->free_list = session;
+    pool->n_free++;
+}
+
+// Restituisce una sessione al pool della sua versione e rilascia il riferimento alla versione
+static void release_session(game_session* session)
+{
+    room_version* version = session->version;
+
+    pool_put(&version->pool, session);
+    release_version(version);
+
+    // Senza partite il corpo della versione corrente può essere rimosso se le immagini superano il budget
+    if (version->refs == 1 && rooms[session->room].current == version)
+        park_body(version);
+}
+
+/*
+ * Verifica se una nuova sessione nella room specificata rientra nei limiti di sessioni e di memoria,
+ * considerando il caricamento dell'immagine, un eventuale nuovo blocco del pool e la crescita degli indici.
+ * 
+ * Restituisce:
+ *   - true se la sessione può essere creata, false altrimenti.
+ */
+static bool session_fits(int room)
+{
+    room_version* version = rooms[room].current;
+    size_t needed = 0;
+
+    if (n_sessions >= max_sessions)
+        return false;
+
+    if (!version->loaded && version->mapping == NULL)
+        needed += version->image_size;
+    if (version->pool.free_list == NULL)
+        needed += pool_slab_size(&version->pool);
+    if ((size_t)n_sessions + 1 > n_session_buckets)
+        needed += 2 * (n_session_buckets == 0 ? SESSION_INDEX_MIN_BUCKETS : n_session_buckets * 2) * sizeof(game_session*);
+
+    return mem_total + needed <= max_memory_bytes;
+}
+
+/*
+ * Inserisce una sessione negli indici per username e per token di ripresa, raddoppiando il numero di bucket
+ * quando le sessioni li superano.
+ * 
+ * Restituisce:
+ *   - true se l'inserimento è avvenuto, false in caso di errore nell'allocazione di memoria.
+ */
+static bool index_session(game_session* session)
+{
+    size_t bucket;
+
+    if ((size_t)n_sessions + 1 > n_session_buckets)
+    {
+        size_t n_buckets = n_session_buckets == 0 ? SESSION_INDEX_MIN_BUCKETS : n_session_buckets * 2;
+        game_session** buckets = mem_calloc(MEM_INDEX, n_buckets, sizeof(game_session*));
+        game_session** token_buckets = mem_calloc(MEM_INDEX, n_buckets, sizeof(game_session*));
+        game_session* current;
+        if (buckets == NULL || token_buckets == NULL) {
+            mem_free(MEM_INDEX, buckets, n_buckets * sizeof(game_session*));
+            mem_free(MEM_INDEX, token_buckets, n_buckets * sizeof(game_session*));
+            return false;
+        }
+
+        // Ridistribuzione delle sessioni esistenti
+        for (current = sessions_list; current != NULL; current = current->next)
+        {
+            bucket = hash_string(current->username) & (n_buckets - 1);
+            current->next_by_username = buckets[bucket];
+            buckets[bucket] = current;
+
+            bucket = hash_string(current->resume_token) & (n_buckets - 1);
+            current->next_by_token = token_buckets[bucket];
+            token_buckets[bucket] = current;
+        }
+
+        mem_free(MEM_INDEX, sessions_by_username, n_session_buckets * sizeof(game_session*));
+        mem_free(MEM_INDEX, sessions_by_token, n_session_buckets * sizeof(game_session*));
+        sessions_by_username = buckets;
+        sessions_by_token = token_buckets;
+        n_session_buckets = n_buckets;
+    }
+
+    bucket = hash_string(session->username) & (n_session_buckets - 1);
+    session->next_by_username = sessions_by_username[bucket];
+    sessions_by_username[bucket] = session;
+
+    bucket = hash_string(session->resume_token) & (n_session_buckets - 1);
+    session->next_by_token = sessions_by_token[bucket];
+    sessions_by_token[bucket] = session;
+    return true;
+}
+
+/*
+ * Rimuove una sessione dagli indici per username e per token di ripresa.
+ */
+static void unindex_session(game_session* session)
+{
+    game_session** link;
+
+    if (n_session_buckets == 0)
+        return;
+
+    link = &sessions_by_username[hash_string(session->username) & (n_session_buckets - 1)];
+    while (*link != NULL && *link != session)
+        link = &(*link)->next_by_username;
+    if (*link != NULL)
+        *link = session->next_by_username;
+
+    link = &sessions_by_token[hash_string(session->resume_token) & (n_session_buckets - 1)];
+    while (*link != NULL && *link != session)
+        link = &(*link)->next_by_token;
+    if (*link != NULL)
+        *link = session->next_by_token;
+}
+
+/*
+ * Imposta per quanti secondi una sessione rimasta senza connessione resta in attesa di essere ripresa.
+ * Con 0 le sessioni vengono terminate alla disconnessione.
+ * 
+ * Parametri:
+ *   - seconds: Durata del periodo di attesa, in secondi.
+ */
+void setSessionGracePeriod(int seconds)
+{
+    session_grace_seconds = seconds < 0 ? 0 : seconds;
+}
+
+/*
+ * Imposta la memoria delle immagini caricate oltre la quale i corpi delle room senza partite vengono rimossi,
+ * dal meno recente. Con 0 ogni corpo viene rimosso appena termina la sua ultima partita.
+ * 
+ * Parametri:
+ *   - bytes: Budget in byte.
+ */
+void setRoomBodyBudget(size_t bytes)
+{
+    room_body_budget = bytes;
+    trim_bodies();
+}
+
+/*
+ * Imposta il numero di sessioni oltre il quale le nuove partite vengono rifiutate.
+ * Le sessioni già in corso non vengono terminate.
+ * 
+ * Parametri:
+ *   - sessions: Numero massimo di sessioni.
+ */
+void setMaxSessions(int sessions)
+{
+    max_sessions = sessions < 0 ? 0 : sessions;
+}
+
+/*
+ * Imposta la memoria allocata dal server oltre la quale le nuove partite vengono rifiutate
+ * e le allocazioni falliscono. La memoria già allocata non viene liberata.
+ * 
+ * Parametri:
+ *   - bytes: Limite in byte.
+ */
+void setMaxMemory(size_t bytes)
+{
+    max_memory_bytes = bytes;
+}
+
+/*
+ * Termina le sessioni senza connessione il cui periodo di attesa è trascorso o il cui tempo di gioco è scaduto.
+ * Deve essere chiamata periodicamente dal ciclo principale del server; scorre solo le sessioni già scadute.
+ */
+void expireSessions()
+{
+    int64_t now = game_now();
+
+    while (parked_head != NULL && parked_head->expires_at <= now)
+    {
+        game_session* current = parked_head;
+
+        #ifdef VERBOSE
+            printf("↳ La sessione di %s senza connessione è scaduta e viene terminata\n", current->username);
+        #endif
+        event_begin(EV_EXPIRE, current->username, "");
+        count_outcome(current, get_remaining_ms(current) <= 0 ? ROOM_OUTCOME_TIMEOUT : ROOM_OUTCOME_ABANDONED);
+        stop_session(current);
+        event_end();
+    }
+}
+
+/*
+ * Inserisce una sessione senza connessione nella lista di quelle in attesa, ordinata per istante di scadenza.
+ * La lista viene scorsa dalla coda, dove finiscono le sessioni appena disconnesse; se la sessione è già
+ * nella lista viene spostata. Una sessione il cui tempo di gioco è finito scade subito.
+ * 
+ * Parametri:
+ *   - session: Sessione, con sd = -1.
+ *   - expires_at: Istante in ms sull'orologio del gioco in cui il periodo di attesa termina.
+ */
+static void park_session(game_session* session, int64_t expires_at)
+{
+    game_session* after;
+
+    unpark_session(session);
+    session->expires_at = get_remaining_ms(session) <= 0 ? game_now() : expires_at;
+
+    after = parked_tail;
+    while (after != NULL && after->expires_at > session->expires_at)
+        after = after->prev_parked;
+
+    session->prev_parked = after;
+    session->next_parked = after != NULL ? after->next_parked : parked_head;
+    if (session->next_parked != NULL)
+        session->next_parked->prev_parked = session;
+    else
+        parked_tail = session;
+    if (after != NULL)
+        after->next_parked = session;
+    else
+        parked_head = session;
+    n_parked++;
+}
+
+// Rimuove la sessione dalla lista di quelle in attesa, se vi si trova
+static void unpark_session(game_session* session)
+{
+    if (session->prev_parked == NULL && parked_head != session)
+        return;
+
+    if (session->prev_parked != NULL)
+        session->prev_parked->next_parked = session->next_parked;
+    else
+        parked_head = session->next_parked;
+    if (session->next_parked != NULL)
+        session->next_parked->prev_parked = session->prev_parked;
+    else
+        parked_tail = session->prev_parked;
+
+    session->next_parked = NULL;
+    session->prev_parked = NULL;
+    n_parked--;
+}
+
+/*
+ * Restituisce il riferimento alla sessione associata al descrittore del socket specificato.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket dell'utente.
+ * 
+ * Restituisce:
+ *   - Puntatore alla sessione, o NULL se non trovata.
+ */
+static game_session* find_session_by_sd(int sd) 
+{
+    game_conn* conn = get_conn(sd);
+
+    // La sessione è memorizzata nello stato della connessione
+    if (conn == NULL || conn->state != CONN_IN_GAME)
+        return NULL;
+    return conn->session;
+}
+
+/*
+ * Restituisce il riferimento alla sessione associata al nome utente specificato.
+ * 
+ * Parametri:
+ *   - username: Nome utente del giocatore.
+ * 
+ * Restituisce:
+ *   - Puntatore alla sessione, o NULL se non trovata.
+ */
+static game_session* find_session_by_username(const char* username) 
+{
+    game_session* session;
+
+    if (n_session_buckets == 0)
+        return NULL;
+
+    // Cerca la sessione nel bucket dell'username
+    session = sessions_by_username[hash_string(username) & (n_session_buckets - 1)];
+    while (session != NULL && strcmp(session->username, username) != 0) {
+        session = session->next_by_username;
+    }
+
+    // Restituisce il riferimento alla sessione se trovata, altrimenti NULL
+    return session;
+}
+
+/*
+ * Restituisce il riferimento alla sessione senza connessione associata al token di ripresa specificato.
+ * 
+ * Parametri:
+ *   - resume_token: Token di ripresa fornito dal client.
+ * 
+ * Restituisce:
+ *   - Puntatore alla sessione, o NULL se non trovata.
+ */
+static game_session* find_session_by_resume_token(const char* resume_token) 
+{
+    game_session* session;
+
+    if (n_session_buckets == 0 || resume_token == NULL || strlen(resume_token) != RESUME_TOKEN_DIM - 1)
+        return NULL;
+
+    // Cerca la sessione nel bucket del token, tra quelle senza connessione
+    session = sessions_by_token[hash_string(resume_token) & (n_session_buckets - 1)];
+    while (session != NULL && (session->sd >= 0 || strcmp(session->resume_token, resume_token) != 0)) {
+        session = session->next_by_token;
+    }
+
+    // Restituisce il riferimento alla sessione se trovata, altrimenti NULL
+    return session;
+}
+
+/*
+ * Verifica se ci sono utenti attivi.
+ * 
+ * Restituisce:
+ *   - true se ci sono utenti attivi, false altrimenti.
+ */
+bool activeUsers()
+{
+    return n_sessions != 0;
+}
+
+/*
+ * Invia la lista degli utenti in gioco al client.
+ *
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ * 
+ * Restituisce:
+ *   - OK se l'invio della lista è avvenuto con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
+ */
+op_result sendActiveUsers(int sd) 
+{
+    desc_msg msg;
+    op_result ret;
+    game_session* current = sessions_list;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di ricevere la lista degli utenti in gioco\n", sd);
+    #endif
+
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Invia il numero totale di utenti in gioco
+    init_msg(&msg, MSG_LIST_START, n_sessions);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    // Invia l'username di ogni utente
+    while (current != NULL)
+    {
+        init_msg(&msg, MSG_LIST_ITEM, current->username);
+
+        // Invia il messaggio
+        ret = send_to_socket(sd, &msg);
+        if (ret != OK)
+            return ret;
+
+        current = current->next;
+    }
+    return ret;
+}
+
+/*
+ * Invia lo stato della sessione di gioco specificata al client, includendo il tempo rimanente, il numero di token,
+ * il numero di oggetti nello zaino e il numero dell'ultimo messaggio di aiuto.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ *   - session: Il puntatore alla sessione di gioco.
+ * 
+ * Restituisce:
+ *   - OK se lo stato del giocatore è stato inviato con successo al client.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ */
+static op_result sendUserSessionState(int sd, game_session* session) 
+{
+    desc_msg msg;
+
+    #ifdef VERBOSE
+        printf("↳ Invio dello stato della sessione di %s al socket %d\n", session->username, sd);
+    #endif
+
+    // Inizializza il messaggio con le informazioni sullo stato del giocatore
+    init_msg(&msg, MSG_GAME_STATE, get_remaining_time(session), session->token, session->n_bag_objs, session->help_msg_id);
+    
+    // Invia il messaggio al client
+    return send_to_socket(sd, &msg);
+}
+
+/*
+ * Invia al client le informazioni di base sulla sessione di gioco dell'utente specificato.
+ * Include il nome della stanza associata all'utente e le informazioni sulla sessione corrente, come il tempo rimanente,
+ * il numero di token della stanza e quelli ottenuti dall'utente, la dimensione dello zaino e il numero di oggetti in esso contenuti.
+ * Se l'utente specificato non ha una sessione di gioco attiva, viene inviato un messaggio di errore.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ *   - username: Il nome utente del giocatore di cui si vogliono ottenere le informazioni sulla sessione di gioco.
+ * 
+ * Restituisce:
+ *   - OK se le informazioni sono state inviate con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
+ */
+op_result sendUserSessionData(int sd, const char* username) 
+{
+    desc_msg msg;
+    op_result ret;
+    game_session* session;
+    const room_view* view;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di ricevere informazioni sulla sessione di %s\n", sd, username);
+    #endif
+
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Cerca la sessione in base al nome utente specificato
+    session = find_session_by_username(username);
+    if (session == NULL)
+    {
+        // Sessione non trovata
+        #ifdef VERBOSE
+            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
+        #endif
+
+        // Invia messaggio di errore
+        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Sessione trovata
+    // Invio del nome della stanza
+    view = &session->version->view;
+    init_msg(&msg, MSG_GAME_DESCR, room_str(view, view->header->name));
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+    
+    // Invio delle informazioni di base
+    init_msg(&msg, MSG_SU_USER_SESSION_DATA, get_remaining_time(session), (int)view->header->token, session->token, session->dim_bag, session->n_bag_objs);
+    return send_to_socket(sd, &msg);
+}
+
+/*
+ * Invia al client lo stato aggiornato della sessione di gioco dell'utente specificato
+ * e quello degli oggetti bloccati, nascosti o consumabili.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ *   - username: Il nome utente del giocatore di cui si vuole ottenere lo stato degli oggetti.
+ * 
+ * Restituisce:
+ *   - OK se lo stato degli oggetti è stato inviato con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ */
+op_result sendUserSessionObjs(int sd, const char* username) 
+{
+    desc_msg msg;
+    op_result ret;
+    game_session* session;
+    const room_view* view;
+    uint32_t i;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di ricevere lo stato degli oggetti nella sessione di %s\n", sd, username);
+    #endif
+
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Cerca la sessione in base al nome utente specificato
+    session = find_session_by_username(username);
+    if (session == NULL)
+    {
+        // Sessione non trovata
+        #ifdef VERBOSE
+            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
+        #endif
+
+        // Invia messaggio di errore
+        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Sessione trovata
+    // Invio dello stato aggiornato
+    ret = sendUserSessionState(sd, session);
+    if (ret != OK)
+        return ret;
+    
+    // Invia il numero totale di elementi nella lista
+    view = &session->version->view;
+    init_msg(&msg, MSG_LIST_START, (int)view->header->n_special_objs);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    // Invio dello stato degli oggetti bloccati, nascosti o consumabili, nell'ordine delle locazioni
+    init_msg(&msg, MSG_LIST_ITEM, "");
+    for (i = 0; i < view->header->n_objs; i++) 
+    {
+        uint16_t flags = view->objs[i].flags;
+
+        // Verifica se l'oggetto è bloccato, nascosto o consumabile
+        if ((flags & (ROOM_OBJ_LOCKED | ROOM_OBJ_HIDDEN | ROOM_OBJ_CONSUMABLE)) == 0)
+            continue;
+
+        // Costruisce il messaggio con lo stato dell'oggetto
+        sprintf(msg.payload, "%s %d %d %d", 
+            room_str(view, view->obj_texts[i].name),
+            ((flags & ROOM_OBJ_LOCKED) && is_obj_locked(session, i)) ? 1 : 0,
+            ((flags & ROOM_OBJ_HIDDEN) && is_obj_hidden(session, i)) ? 1 : 0,
+            ((flags & ROOM_OBJ_CONSUMABLE) && is_obj_consumed(session, i)) ? 1 : 0
+        );
+
+        // Invia il messaggio
+        ret = send_to_socket(sd, &msg);
+        if (ret != OK)
+            return ret;
+    }
+    return ret;
+}
+
+/*
+ * Invia al client lo stato aggiornato della sessione di gioco dell'utente specificato
+ * e la lista degli oggetti nello zaino del giocatore.
+ * 
+ * Parametri:
+ *   - sd: Il descrittore del socket per la comunicazione con il client.
+ *   - username: Il nome utente del giocatore di cui si vogliono conoscere gli oggetti nello zaino.
+ * 
+ * Restituisce:
+ *   - OK se la lista degli oggetti è stata inviata con successo al client.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ */
+op_result sendUserSessionBag(int sd, const char* username) 
+{
+    desc_msg msg;
+    op_result ret;
+    game_session* session;
+    const room_view* view;
+    uint32_t i;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di ricevere gli oggetti nello zaino di %s\n", sd, username);
+    #endif
+
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Cerca la sessione in base al nome utente specificato
+    session = find_session_by_username(username);
+    if (session == NULL)
+    {
+        // Sessione non trovata
+        #ifdef VERBOSE
+            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
+        #endif
+
+        // Invia messaggio di errore
+        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Sessione trovata
+    // Invio dello stato aggiornato
+    ret = sendUserSessionState(sd, session);
+    if (ret != OK)
+        return ret;
+    
+    // Invio del numero totale di oggetti nello zaino
+    init_msg(&msg, MSG_LIST_START, session->n_bag_objs);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    // Invia i nomi degli oggetti nello zaino
+    view = &session->version->view;
+    for (i = 0; i < view->header->n_objs; i++) 
+    {
+        if (!obj_set_test(session->bag, i))
+            continue;
+        
+        // Invia il nome dell'oggetto
+        init_msg(&msg, MSG_LIST_ITEM, room_str(view, view->obj_texts[i].name));
+        ret = send_to_socket(sd, &msg);
+        if (ret != OK)
+            return ret;
+    }
+    return ret;
+}
+
+/*
+ * Gestisce la modifica del tempo rimanente della sessione di gioco dell'utente specificato.
+ * 
+ * Parametri:
+ *   - sd: Il descrittore del socket per la comunicazione con il client.
+ *   - username: Il nome dell'utente di cui modificare il tempo della sessione.
+ *   - opt: Il carattere che indica l'operazione da eseguire ('+', '-', '=', 'p' per fermare il tempo o 'r' per riavviarlo).
+ *   - seconds: Il numero di secondi da aggiungere, sottrarre o impostare come tempo rimanente della sessione, ignorato con 'p' e 'r'.
+ *
+ * Restituisce:
+ *   - OK se la lista degli oggetti è stata inviata con successo al client.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ */
+op_result alterSessionTime(int sd, const char* username, const char opt, int seconds) 
+{
+    desc_msg msg;
+    game_session* session;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di alterare il tempo rimanente della sessione di %s\n", sd, username);
+    #endif
+
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Cerca la sessione in base al nome utente specificato
+    session = find_session_by_username(username);
+    if (session == NULL)
+    {
+        // Sessione non trovata
+        #ifdef VERBOSE
+            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
+        #endif
+
+        // Invia messaggio di errore
+        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Sessione trovata
+    // Modifica del tempo rimanente
+    switch (opt)
+    {
+        case '+': 
+        {
+            add_remaining_ms(session, (int64_t)seconds * 1000);
+            #ifdef VERBOSE
+                printf("↳ Aggiunti %d secondi. Nuovo tempo rimanente: %lld\n", seconds, (long long)get_remaining_time(session));
+            #endif
+            break;
+        }
+        case '-': 
+        {
+            add_remaining_ms(session, -(int64_t)seconds * 1000);
+            #ifdef VERBOSE
+                printf("↳ Sottratti %d secondi. Nuovo tempo rimanente: %lld\n", seconds, (long long)get_remaining_time(session));
+            #endif
+            break;
+        }
+        case '=': 
+        {
+            add_remaining_ms(session, (int64_t)seconds * 1000 - get_remaining_ms(session));
+            #ifdef VERBOSE
+                printf("↳ Tempo rimanente impostato a: %lld\n", (long long)get_remaining_time(session));
+            #endif
+            break;
+        }
+        case 'p':
+        {
+            pause_session(session, SESSION_PAUSE_SUPERVISOR);
+            #ifdef VERBOSE
+                printf("↳ Tempo fermato. Tempo rimanente: %lld\n", (long long)get_remaining_time(session));
+            #endif
+            break;
+        }
+        case 'r':
+        {
+            unpause_session(session, SESSION_PAUSE_SUPERVISOR);
+            #ifdef VERBOSE
+                printf("↳ Tempo riavviato. Tempo rimanente: %lld\n", (long long)get_remaining_time(session));
+            #endif
+            break;
+        }
+        default: 
+        {
+            #ifdef VERBOSE
+                printf("↳ Operazione non supportata\n");
+            #endif
+            // Invia messaggio di errore
+            init_msg(&msg, MSG_SU_ERR_ALTER_TIME_OPT);
+            return send_to_socket(sd, &msg);
+        }
+    }
+
+    log_time(session);
+
+    // Una sessione senza connessione rimasta senza tempo viene terminata al prossimo controllo
+    if (session->sd < 0 && get_remaining_ms(session) <= 0)
+        park_session(session, game_now());
+
+    // Invio dello stato aggiornato
+    return sendUserSessionState(sd, session);
+}
+
+/*
+ * Imposta il messaggio di aiuto per la sessione di gioco dell'utente specificato.
+ * 
+ * Parametri:
+ *   - sd: Il descrittore del socket per la comunicazione con il client.
+ *   - username: Il nome dell'utente al quale inviare il messaggio di aiuto.
+ *   - help_msg: Il nuovo messaggio di aiuto da impostare.
+ * 
+ * Restituisce:
+ *   - OK se il messaggio di aiuto è stato impostato con successo e lo stato della sessione è stato aggiornato.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ */
+op_result setUserSessionHelp(int sd, const char* username, const char* help_msg) 
+{
+    desc_msg msg;
+    game_session* session;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di impostare il messaggio di aiuto \"%s\" nella sessione di %s\n", sd, help_msg, username);
+    #endif
+
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Cerca la sessione in base al nome utente specificato
+    session = find_session_by_username(username);
+    if (session == NULL)
+    {
+        // Sessione non trovata
+        #ifdef VERBOSE
+            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
+        #endif
+
+        // Invia messaggio di errore
+        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Sessione trovata
+    // Imposta il messaggio di aiuto
+    strncpy(session->help_msg, help_msg, MAX_HELP_DIM);
+    session->help_msg[MAX_HELP_DIM - 1] = '\0';
+    session->help_msg_id++;
+    log_help(session);
+
+    // Invio dello stato aggiornato
+    return sendUserSessionState(sd, session);
+}
+
+//-------------------------//
+
+//---Sessions Checkpoint---//
+
+// Log di checkpoint delle sessioni, disattivato finché restoreSessions non ha ricostruito lo stato salvato
+static checkpoint_log checkpoint = { .fd = -1 };
+
+/*
+ * Inizia un record di checkpoint relativo alla sessione specificata.
+ * 
+ * Restituisce:
+ *   - Il record da completare, o NULL se il checkpoint è disattivato.
+ */
+static checkpoint_record* log_begin(checkpoint_record_type type, game_session* session)
+{
+    if (!checkpoint_enabled(&checkpoint))
+        return NULL;
+
+    checkpoint_begin(&checkpoint, type);
+    record_put_str(&checkpoint.record, session->username);
+    return &checkpoint.record;
+}
+
+// Scrive nel record in costruzione lo stato completo della sessione
+static void put_session(checkpoint_record* record, game_session* session)
+{
+    const room_header* header = session->version->view.header;
+
+    // La room è identificata per nome, perché l'ordine delle room può cambiare tra un avvio e l'altro,
+    // e per immagine, perché lo stato degli oggetti vale solo per l'immagine con cui la partita è stata avviata
+    record_put_str(record, session->version->name);
+    record_put_i64(record, (int64_t)session->version->image_hash);
+    record_put_str(record, session->resume_token);
+    record_put_i64(record, get_remaining_ms(session));
+    record_put_u32(record, session->paused);
+    record_put_u32(record, session->token);
+    record_put_u32(record, session->help_msg_id);
+    record_put_str(record, session->help_msg);
+    record_put_bytes(record, session->obj_state, 4 * header->n_obj_words * sizeof(uint64_t));
+}
+
+static void log_session(game_session* session)
+{
+    checkpoint_record* record = log_begin(CKPT_SESSION, session);
+    if (record == NULL)
+        return;
+    put_session(record, session);
+    checkpoint_commit(&checkpoint);
+}
+
+static void log_stop(game_session* session)
+{
+    if (log_begin(CKPT_STOP, session) != NULL)
+        checkpoint_commit(&checkpoint);
+}
+
+static void log_obj_state(game_session* session, checkpoint_obj_set set, uint32_t obj, bool value)
+{
+    checkpoint_record* record = log_begin(CKPT_OBJ, session);
+    if (record == NULL)
+        return;
+    record_put_u8(record, set);
+    record_put_u32(record, obj);
+    record_put_u8(record, value);
+    checkpoint_commit(&checkpoint);
+}
+
+static void log_token(game_session* session)
+{
+    checkpoint_record* record = log_begin(CKPT_TOKEN, session);
+    if (record == NULL)
+        return;
+    record_put_u32(record, session->token);
+    checkpoint_commit(&checkpoint);
+}
+
+static void log_time(game_session* session)
+{
+    checkpoint_record* record = log_begin(CKPT_TIME, session);
+    if (record == NULL)
+        return;
+    record_put_i64(record, get_remaining_ms(session));
+    record_put_u32(record, session->paused);
+    checkpoint_commit(&checkpoint);
+}
+
+static void log_help(game_session* session)
+{
+    checkpoint_record* record = log_begin(CKPT_HELP, session);
+    if (record == NULL)
+        return;
+    record_put_u32(record, session->help_msg_id);
+    record_put_str(record, session->help_msg);
+    checkpoint_commit(&checkpoint);
+}
+
+/*
+ * Ricrea una sessione a partire dal suo stato completo, come sessione senza connessione in attesa di essere ripresa.
+ * Una sessione già presente con lo stesso username viene sostituita.
+ */
+static void restore_session(checkpoint_record* record, const char* username, const room_name_index* index)
+{
+    char name[MAX_ROOM_NAME_DIM], resume_token[RESUME_TOKEN_DIM];
+    uint64_t image_hash;
+    game_session* session;
+    uint32_t i, n_words;
+    int room;
+
+    record_get_str(record, name, MAX_ROOM_NAME_DIM);
+    image_hash = (uint64_t)record_get_i64(record);
+    record_get_str(record, resume_token, RESUME_TOKEN_DIM);
+    room = record->error ? -1 : find_room_by_name(index, name);
+
+    if (room < 0 || rooms[room].current->image_hash != image_hash) {
+        #ifdef VERBOSE
+            printf("↳ La sessione salvata di %s non corrisponde a nessuna room caricata e viene scartata\n", username);
+        #endif
+        return;
+    }
+
+    stop_session(find_session_by_username(username));
+    if (!session_fits(room)) {
+        #ifdef VERBOSE
+            printf("↳ Limite di sessioni o di memoria raggiunto, la sessione salvata di %s viene scartata\n", username);
+        #endif
+        return;
+    }
+    session = create_session(-1, username, room, resume_token);
+    if (session == NULL)
+        return;
+
+    // L'orologio monotono non prosegue tra un avvio e l'altro: il tempo è salvato come millisecondi rimanenti
+    // e la sessione ripristinata è senza connessione, quindi in pausa
+    session->remaining = record_get_i64(record);
+    session->paused = record_get_u32(record) | SESSION_PAUSE_DETACHED;
+    session->token = record_get_u32(record);
+    session->help_msg_id = record_get_u32(record);
+    record_get_str(record, session->help_msg, MAX_HELP_DIM);
+
+    n_words = session->version->view.header->n_obj_words;
+    record_get_bytes(record, session->obj_state, 4 * n_words * sizeof(uint64_t));
+    for (i = 0; i < n_words; i++)
+        session->n_bag_objs += __builtin_popcountll(session->bag[i]);
+
+    // Un record più lungo del previsto è stato scritto con un formato precedente
+    if (record->error || record->len != record->capacity || session->n_bag_objs > session->dim_bag) {
+        release_session(session);
+        return;
+    }
+    if (!add_session(session))
+        return;
+
+    // La sessione attende di essere ripresa con il suo token, come dopo una disconnessione
+    session->detached_at = game_now();
+    park_session(session, session->detached_at + (int64_t)session_grace_seconds * 1000);
+}
+
+/*
+ * Restituisce:
+ *   - L'indice della room con il nome specificato, -1 se non è caricata.
+ */
+static int find_room_by_name(const room_name_index* index, const char* name)
+{
+    uint32_t slot;
+    int r;
+
+    // Senza indice, ad esempio per memoria esaurita, le room vengono scorse tutte
+    if (index->slots == NULL) {
+        for (r = 0; r < n_rooms; r++)
+            if (strcmp(rooms[r].current->name, name) == 0)
+                return r;
+        return -1;
+    }
+
+    for (slot = (uint32_t)hash_string(name) & index->mask; index->slots[slot] != 0; slot = (slot + 1) & index->mask)
+        if (strcmp(rooms[index->slots[slot] - 1].current->name, name) == 0)
+            return index->slots[slot] - 1;
+    return -1;
+}
+
+/*
+ * Applica un record letto dallo snapshot o dal log allo stato delle sessioni.
+ * ctx è l'indice delle room per nome, usato dai record di sessione completa.
+ */
+static void apply_record(checkpoint_record_type type, checkpoint_record* record, void* ctx)
+{
+    char username[MAX_USR_DIM];
+    game_session* session;
+    uint32_t n_objs;
+
+    record_get_str(record, username, MAX_USR_DIM);
+    if (record->error)
+        return;
+
+    if (type == CKPT_SESSION) {
+        restore_session(record, username, ctx);
+        return;
+    }
+
+    session = find_session_by_username(username);
+    if (session == NULL)
+        return;
+    n_objs = session->version->view.header->n_objs;
+
+    switch (type)
+    {
+        case CKPT_STOP:
+        {
+            stop_session(session);
+            break;
+        }
+        case CKPT_OBJ:
+        {
+            uint8_t set = record_get_u8(record);
+            uint32_t obj = record_get_u32(record);
+            bool value = record_get_u8(record) != 0;
+            uint64_t* sets[] = { session->locked, session->hidden, session->consumed, session->bag };
+
+            if (record->error || set > CKPT_SET_BAG || obj >= n_objs || obj_set_test(sets[set], obj) == value)
+                break;
+            if (value)
+                obj_set_add(sets[set], obj);
+            else
+                obj_set_remove(sets[set], obj);
+            if (set == CKPT_SET_BAG)
+                session->n_bag_objs += value ? 1 : -1;
+            break;
+        }
+        case CKPT_TOKEN:
+        {
+            uint32_t token = record_get_u32(record);
+            if (!record->error)
+                session->token = token;
+            break;
+        }
+        case CKPT_TIME:
+        {
+            int64_t remaining = record_get_i64(record);
+            uint32_t paused = record_get_u32(record);
+            if (!record->error) {
+                session->remaining = remaining;
+                session->paused = paused | SESSION_PAUSE_DETACHED;
+            }
+            break;
+        }
+        case CKPT_HELP:
+        {
+            uint32_t help_msg_id = record_get_u32(record);
+            record_get_str(record, session->help_msg, MAX_HELP_DIM);
+            if (!record->error)
+                session->help_msg_id = help_msg_id;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/*
+ * Scrive lo stato completo di tutte le sessioni in un nuovo snapshot e svuota il log.
+ * 
+ * Restituisce:
+ *   - true se lo snapshot è stato scritto, false altrimenti.
+ */
+static bool write_snapshot()
+{
+    uint64_t start = checkpoint_clock_ns();
+    game_session* session;
+    FILE* fd = checkpoint_snapshot_begin(&checkpoint);
+
+    if (fd == NULL)
+        return false;
+
+    for (session = sessions_list; session != NULL; session = session->next)
+    {
+        checkpoint_begin(&checkpoint, CKPT_SESSION);
+        record_put_str(&checkpoint.record, session->username);
+        put_session(&checkpoint.record, session);
+        checkpoint_snapshot_write(&checkpoint, fd);
+    }
+
+    if (!checkpoint_snapshot_commit(&checkpoint, fd, start))
+        return false;
+
+    #ifdef VERBOSE
+        printf("↳ Snapshot di %d sessioni scritto in %.3f ms; log: %lu record in %lu comandi, per comando in media %.1f us, al massimo %.1f us\n",
+            n_sessions, checkpoint.last_snapshot_ns / 1e6, checkpoint.n_records, checkpoint.n_writes,
+            checkpoint.n_writes > 0 ? checkpoint.write_ns / 1e3 / checkpoint.n_writes : 0.0, checkpoint.max_write_ns / 1e3);
+    #endif
+    return true;
+}
+
+/*
+ * Ricostruisce le sessioni salvate nella cartella di checkpoint e attiva il log.
+ * Le sessioni ricostruite restano senza connessione, in attesa di essere riprese con il loro token
+ * entro il periodo di attesa. Deve essere chiamata una volta all'avvio, dopo initRooms.
+ * 
+ * Restituisce:
+ *   - true se lo stato salvato è stato letto e il log è attivo, false altrimenti (il server funziona senza checkpoint).
+ */
+bool restoreSessions()
+{
+    room_name_index index;
+    bool ok;
+
+    if (!checkpoint_open(&checkpoint, CHECKPOINT_DIR))
+        return false;
+
+    index.slots = index_room_names(&index.mask);
+    ok = checkpoint_replay(&checkpoint, apply_record, &index);
+    free(index.slots);
+    if (!ok)
+        return false;
+
+    #ifdef VERBOSE
+        if (n_sessions > 0)
+            printf("↳ Ripristinate %d sessioni in attesa di essere riprese\n", n_sessions);
+    #endif
+
+    // Il primo snapshot compatta lo stato ricostruito e scarta un eventuale record incompleto in coda al log
+    return write_snapshot();
+}
+
+/*
+ * Scrive uno snapshot se il log è cresciuto oltre CHECKPOINT_SNAPSHOT_BYTES, se dall'ultimo snapshot
+ * sono passati CHECKPOINT_SNAPSHOT_SECONDS secondi o se una scrittura nel log non è andata a buon fine.
+ * Lo snapshot periodico viene scritto anche con il log vuoto se ci sono sessioni, perché il loro tempo rimanente
+ * cambia senza produrre record: dopo un crash il tempo trascorso e non salvato resta limitato all'intervallo tra due snapshot.
+ * Deve essere chiamata periodicamente dal ciclo principale del server.
+ */
+void checkpointSessions()
+{
+    if (!checkpoint_enabled(&checkpoint) && !checkpoint.failed)
+        return;
+
+    if (checkpoint.failed || checkpoint.log_bytes >= CHECKPOINT_SNAPSHOT_BYTES ||
+        ((checkpoint.log_bytes > 0 || n_sessions > 0) && getTimestamp() - checkpoint.last_snapshot >= CHECKPOINT_SNAPSHOT_SECONDS))
+        write_snapshot();
+}
+
+/*
+ * Scrive un ultimo snapshot e chiude il log di checkpoint, all'arresto del server.
+ */
+void closeCheckpoint()
+{
+    if (checkpoint_enabled(&checkpoint))
+        write_snapshot();
+    checkpoint_close(&checkpoint);
+}
+
+//-------------------------//
+
+//---Sessions Events---//
+
+// Registro degli eventi delle sessioni, con la persistenza disattivata finché non viene indicato un file
+static event_log events = { .fd = -1 };
+static game_event* pending_event = NULL;            // Evento del comando in esecuzione
+static game_event_state pending_before;             // Stato della sessione prima del comando
+static uint64_t* pending_objs = NULL;               // Insiemi di oggetti della sessione prima del comando
+static size_t pending_objs_dim = 0;                 // Parole valide in pending_objs
+static size_t pending_objs_capacity = 0;
+
+/*
+ * Calcola lo stato registrato negli eventi per la sessione specificata.
+ * 
+ * Parametri:
+ *   - session: Sessione di gioco, o NULL se la sessione non esiste.
+ *   - state: Stato da riempire; per una sessione inesistente room vale -1 e gli altri campi sono nulli.
+ */
+static void session_event_state(game_session* session, game_event_state* state)
+{
+    const unsigned char* bytes;
+    size_t i, len;
+    uint32_t h = 2166136261u;
+
+    memset(state, 0, sizeof(game_event_state));
+    state->room = -1;
+    if (session == NULL)
+        return;
+
+    state->room = session->room;
+    state->token = session->token;
+    state->n_bag_objs = session->n_bag_objs;
+    state->help_msg_id = session->help_msg_id;
+    state->paused = session->paused;
+    state->remaining = get_remaining_ms(session);
+    strcpy(state->resume_token, session->resume_token);
+
+    // FNV-1a dei quattro insiemi di oggetti
+    bytes = (const unsigned char*)session->obj_state;
+    len = 4 * session->version->view.header->n_obj_words * sizeof(uint64_t);
+    for (i = 0; i < len; i++) {
+        h ^= bytes[i];
+        h *= 16777619u;
+    }
+    state->objs_hash = h;
+}
+
+/*
+ * Inizia l'evento di un comando salvando lo stato della sessione interessata, per calcolare le differenze alla fine.
+ * L'orologio del gioco avanza solo tra un ciclo e l'altro, quindi il comando vede un solo istante.
+ * 
+ * Parametri:
+ *   - type: Tipo di evento.
+ *   - username: Giocatore della sessione interessata, stringa vuota per gli eventi che non riguardano una sessione.
+ *   - args: Argomenti del comando.
+ */
+static void event_begin(game_event_type type, const char* username, const char* args)
+{
+    game_session* session;
+    size_t n_words = 0;
+
+    if (pending_event != NULL)
+        return;
+
+    // I record di checkpoint del comando vengono scritti tutti insieme da event_end
+    checkpoint_batch_begin(&checkpoint);
+    pending_event = event_log_next(&events);
+    pending_event->type = type;
+    pending_event->timestamp = game_now();
+    strncpy(pending_event->username, username, MAX_USR_DIM - 1);
+    strncpy(pending_event->args, args, EVENT_ARGS_DIM - 1);
+
+    session = find_session_by_username(username);
+    session_event_state(session, &pending_before);
+    if (session != NULL)
+        n_words = 4 * session->version->view.header->n_obj_words;
+
+    if (n_words > pending_objs_capacity)
+    {
+        uint64_t* objs = mem_realloc(MEM_EVENTS, pending_objs, pending_objs_capacity * sizeof(uint64_t), n_words * sizeof(uint64_t));
+        if (objs == NULL)
+            n_words = 0;
+        else {
+            pending_objs = objs;
+            pending_objs_capacity = n_words;
+        }
+    }
+    if (n_words > 0)
+        memcpy(pending_objs, session->obj_state, n_words * sizeof(uint64_t));
+    pending_objs_dim = n_words;
+}
+
+/*
+ * Completa l'evento iniziato da event_begin con lo stato risultante della sessione e le differenze
+ * rispetto allo stato precedente, poi lo registra.
+ */
+static void event_end()
+{
+    game_session* session;
+    size_t i, n_words = 0;
+
+    if (pending_event == NULL)
+        return;
+
+    checkpoint_batch_end(&checkpoint);
+    session = find_session_by_username(pending_event->username);
+    session_event_state(session, &pending_event->state);
+    if (session != NULL)
+        n_words = 4 * session->version->view.header->n_obj_words;
+
+    // Una sessione inesistente conta come una sessione con tutti i valori nulli
+    pending_event->d_token = pending_event->state.token - pending_before.token;
+    pending_event->d_bag_objs = pending_event->state.n_bag_objs - pending_before.n_bag_objs;
+    pending_event->d_remaining = pending_event->state.remaining - pending_before.remaining;
+    for (i = 0; i < n_words || i < pending_objs_dim; i++)
+    {
+        uint64_t after = i < n_words ? session->obj_state[i] : 0;
+        uint64_t before = i < pending_objs_dim && pending_before.room == pending_event->state.room ? pending_objs[i] : 0;
+        pending_event->d_objs += __builtin_popcountll(after ^ before);
+    }
+
+    event_log_commit(&events, pending_event);
+    pending_event = NULL;
+}
+
+/*
+ * Attiva il registro degli eventi e registra l'avvio del server. Deve essere chiamata una volta all'avvio,
+ * dopo restoreSessions.
+ * 
+ * Parametri:
+ *   - path: File in cui aggiungere gli eventi, o NULL per conservarli solo in memoria.
+ * 
+ * Restituisce:
+ *   - true se il registro è attivo, false se il file non può essere usato (gli eventi restano comunque in memoria).
+ */
+bool initEvents(const char* path)
+{
+    bool ok = path == NULL || event_log_persist(&events, path, session_grace_seconds);
+
+    event_begin(EV_BOOT, "", "");
+    event_end();
+    return ok;
+}
+
+void closeEvents()
+{
+    event_log_close(&events);
+}
+
+/*
+ * Scrive gli eventi conservati in memoria in un file, che può essere rieseguito con lo strumento replay.
+ * 
+ * Restituisce:
+ *   - true se il file è stato scritto, false altrimenti.
+ */
+bool dumpEvents(const char* path)
+{
+    return event_log_dump(&events, path, session_grace_seconds);
 }
 
 /*
- * Termina una sessione di gioco.
+ * Inizia l'evento del messaggio ricevuto, se il messaggio è un comando che può modificare una sessione.
+ * Va chiamata prima di passare il messaggio al suo gestore, seguita da endEvent dopo il gestore.
  * 
  * Parametri:
- *   - sd: Descrittore del socket associato alla sessione di gioco da terminare.
+ *   - sd: Descrittore del socket da cui è arrivato il messaggio.
+ *   - msg: Messaggio ricevuto.
  */
-static void stop_session(int sd) 
+void beginEvent(int sd, const desc_msg* msg)
 {
-    game_session* current = sessions_list;
-    game_session* previous = NULL;
+    game_conn* conn = get_conn(sd);
+    char username[MAX_USR_DIM];
+    game_event_type type;
 
-    // Cerca la sessione
-    while (current != NULL && current->sd != sd) 
+    if (conn == NULL)
+        return;
+
+    switch (msg->type)
     {
-        previous = current;
-        current = current->next;
+        case MSG_REQ_START_GAME:                    type = EV_START; break;
+        case MSG_REQ_RESUME_GAME:                   type = EV_RESUME; break;
+        case MSG_GAME_CMD_LOOK:                     type = EV_LOOK; break;
+        case MSG_GAME_CMD_OBJS:                     type = EV_OBJS; break;
+        case MSG_GAME_CMD_USE:                      type = EV_USE; break;
+        case MSG_GAME_CMD_TAKE:                     type = EV_TAKE; break;
+        case MSG_GAME_CMD_DROP:                     type = EV_DROP; break;
+        case MSG_GAME_PUZZLE_SOL:                   type = EV_PUZZLE; break;
+        case MSG_GAME_CMD_HELP:                     type = EV_HELP; break;
+        case MSG_GAME_CMD_END:                      type = EV_END; break;
+        case MSG_SU_REQ_USER_SESSION_ALTER_TIME:    type = EV_SU_TIME; break;
+        case MSG_SU_REQ_USER_SESSION_SET_HELP:      type = EV_SU_HELP; break;
+        default:
+            return;
     }
 
-    // Se la sessione esiste, la elimina dalla lista e dealloca la memoria
-    if (current != NULL) 
+    if (type == EV_SU_TIME || type == EV_SU_HELP)
     {
-        if (previous == NULL)
-            sessions_list = current->next;
-        else
-            previous->next = current->next;
-        
-        free(current->bag_objs);
-        free(current->unlocked_objs);
-        free(current->revealed_objs);
-        free(current->consumed_objs);
-        free(current);
-
-        n_sessions--;
+        // Le richieste da supervisore riguardano la sessione del giocatore indicato nel payload;
+        // quelle di una connessione non identificata come supervisore vengono rifiutate senza modificare nulla
+        if (conn->state != CONN_SUPERVISOR)
+            return;
+        memset(username, '\0', 1);
+        sscanf(msg->payload, "%49s", username);
+    }
+    else
+    {
+        // I comandi di gioco riguardano la sessione dell'utente autenticato sulla connessione
+        if (conn->state != CONN_AUTH && conn->state != CONN_IN_GAME)
+            return;
+        strcpy(username, conn->username);
     }
+
+    event_begin(type, username, msg->payload);
+}
+
+void endEvent()
+{
+    event_end();
 }
 
 /*
- * Restituisce il riferimento alla sessione associata al descrittore del socket specificato.
+ * Calcola lo stato attuale della sessione di un giocatore, nella stessa forma registrata negli eventi.
  * 
  * Parametri:
- *   - sd: Descrittore del socket dell'utente.
- * 
- * Restituisce:
- *   - Puntatore alla sessione, o NULL se non trovata.
+ *   - username: Giocatore della sessione.
+ *   - state: Stato da riempire; room vale -1 se il giocatore non ha una sessione.
  */
-static game_session* find_session_by_sd(int sd) 
+void sessionEventState(const char* username, game_event_state* state)
 {
-    game_session* session = sessions_list;
+    session_event_state(find_session_by_username(username), state);
+}
 
-    // Cerca la sessione nella lista
-    while (session != NULL && session->sd != sd) {
-        session = session->next;
-    }
+//-------------------------//
 
-    // Restituisce il riferimento alla sessione se trovata, altrimenti NULL
-    return session;
+//---Game Clock---//
+
+static int64_t clock_now = 0;                       // Istante attuale in ms, aggiornato una volta per ciclo
+static bool clock_virtual = false;                  // L'orologio è virtuale e avanza solo con setVirtualClock
+
+/*
+ * Restituisce l'istante attuale in millisecondi secondo l'orologio del gioco, usato per tutti i tempi delle sessioni.
+ * Il valore è quello letto dall'ultima tickGameClock, senza chiamate di sistema.
+ */
+static int64_t game_now()
+{
+    return clock_now;
 }
 
 /*
- * Restituisce il riferimento alla sessione associata al nome utente specificato.
- * 
- * Parametri:
- *   - username: Nome utente del giocatore.
- * 
- * Restituisce:
- *   - Puntatore alla sessione, o NULL se non trovata.
+ * Aggiorna l'orologio del gioco leggendo l'orologio monotono di sistema, che non risente delle correzioni
+ * dell'ora. Deve essere chiamata all'avvio e poi una volta per ciclo dal ciclo principale del server.
  */
-static game_session* find_session_by_username(const char* username) 
+void tickGameClock()
 {
-    game_session* session = sessions_list;
+    struct timespec ts;
 
-    // Cerca la sessione nella lista
-    while (session != NULL && strcmp(session->username, username) != 0) {
-        session = session->next;
-    }
+    if (clock_virtual)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    clock_now = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    // Restituisce il riferimento alla sessione se trovata, altrimenti NULL
-    return session;
+/*
+ * Sostituisce l'orologio di sistema con un orologio virtuale, fermo all'istante specificato.
+ * Usata dallo strumento replay per rieseguire gli eventi con gli istanti in cui sono stati registrati.
+ * 
+ * Parametri:
+ *   - now: Istante dell'orologio virtuale, in millisecondi.
+ */
+void setVirtualClock(int64_t now)
+{
+    clock_virtual = true;
+    clock_now = now;
 }
 
 /*
- * Verifica se ci sono utenti attivi.
+ * Ferma il tempo della sessione per il motivo specificato. Il tempo resta fermo finché c'è almeno un motivo.
  * 
- * Restituisce:
- *   - true se ci sono utenti attivi, false altrimenti.
+ * Parametri:
+ *   - reason: SESSION_PAUSE_DETACHED o SESSION_PAUSE_SUPERVISOR.
  */
-bool activeUsers()
+static void pause_session(game_session* session, int reason)
 {
-    return n_sessions != 0;
+    if (session->paused == 0)
+        session->remaining = session->deadline - game_now();
+    session->paused |= reason;
+}
+
+// Rimuove un motivo di pausa: se era l'ultimo, il tempo riprende a scorrere da dove si era fermato
+static void unpause_session(game_session* session, int reason)
+{
+    if ((session->paused & reason) == 0)
+        return;
+    session->paused &= ~reason;
+    if (session->paused == 0)
+        session->deadline = game_now() + session->remaining;
+}
+
+// Aggiunge o toglie millisecondi al tempo rimanente, che la sessione sia in pausa o no
+static void add_remaining_ms(game_session* session, int64_t delta)
+{
+    if (session->paused != 0)
+        session->remaining += delta;
+    else
+        session->deadline += delta;
 }
 
+//-------------------------//
+
+//---Memory Stats---//
+
 /*
- * Invia la lista degli utenti in gioco al client.
- *
+ * Invia al client l'uso della memoria del server: memoria allocata per sottosistema, media per sessione,
+ * memoria statica di connessioni ed eventi, limiti impostati e stato del checkpoint.
+ * 
  * Parametri:
  *   - sd: Descrittore del socket per la comunicazione con il client.
  * 
@@ -719,385 +2822,751 @@ bool activeUsers()
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
  *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
  */
-op_result sendActiveUsers(int sd) 
+op_result sendMemoryStats(int sd)
 {
+    char lines[MEM_TAGS + 10][MAX_PAYLOAD_DIM];
     desc_msg msg;
-    op_result ret;
-    game_session* current = sessions_list;
+    op_result ret = OK;
+    game_session* current;
+    size_t session_bytes = 0;
+    int i, n = 0, n_conns = 0;
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di ricevere la lista degli utenti in gioco\n", sd);
+        printf("↳ Richiesta dal socket %d di ricevere l'uso della memoria\n", sd);
     #endif
 
-    // Invia il numero totale di utenti in gioco
-    init_msg(&msg, MSG_LIST_START, n_sessions);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
-
-    // Invia l'username di ogni utente
-    while (current != NULL)
-    {
-        init_msg(&msg, MSG_LIST_ITEM, current->username);
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
 
-        // Invia il messaggio
+    for (current = sessions_list; current != NULL; current = current->next)
+        session_bytes += current->version->pool.block_size;
+    for (i = 0; i < MAX_CONNS; i++)
+        if (conns[i].state != CONN_CLOSED)
+            n_conns++;
+
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Sessioni: %d su %d (senza connessione: %d), partite rifiutate: %lu",
+        n_sessions, max_sessions, n_parked, n_rejected_games);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Room: %d caricate, %d versioni precedenti in uso, %zu KiB mappati (condivisi, fuori dal conteggio)",
+        n_rooms, n_old_versions, mapped_bytes >> 10);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "  Corpi caricati: %d (senza partite: %d), %zu KiB su %zu KiB di budget, %lu rimossi",
+        body_stats.n_loaded, body_stats.n_idle, body_stats.bytes >> 10, room_body_budget >> 10, body_stats.n_evictions);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "  Partite con il corpo già caricato: %.1f%% (%lu su %lu), caricamenti in %.3f ms medi e %.3f ms al massimo, %lu non riusciti",
+        body_stats.n_hits + body_stats.n_loads > 0 ? 100.0 * body_stats.n_hits / (body_stats.n_hits + body_stats.n_loads) : 0.0,
+        body_stats.n_hits, body_stats.n_hits + body_stats.n_loads,
+        body_stats.n_loads > 0 ? body_stats.load_ns / 1e6 / body_stats.n_loads : 0.0, body_stats.max_load_ns / 1e6, body_stats.n_failed);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Memoria allocata: %zu KiB su %zu KiB (picco %zu KiB)",
+        mem_total >> 10, max_memory_bytes >> 10, mem_peak >> 10);
+    for (i = 0; i < MEM_TAGS; i++)
+        snprintf(lines[n++], MAX_PAYLOAD_DIM, "  %s: %zu KiB in %lu allocazioni (picco %zu KiB)",
+            mem_tag_names[i], mem_counters[i].bytes >> 10, mem_counters[i].n_allocs, mem_counters[i].peak >> 10);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Per sessione: %zu B di sessione e oggetti, %zu B di blocchi e indice",
+        n_sessions > 0 ? session_bytes / n_sessions : 0,
+        n_sessions > 0 ? (mem_counters[MEM_SESSIONS].bytes + mem_counters[MEM_INDEX].bytes) / n_sessions : 0);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Connessioni: %d aperte, %zu B ciascuna (tabella statica di %zu KiB)",
+        n_conns, sizeof(game_conn), sizeof(conns) >> 10);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Registro eventi: %zu KiB statici, %llu eventi registrati",
+        sizeof(events) >> 10, (unsigned long long)events.n_events);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Checkpoint: buffer di %zu KiB, %lu record, %lu snapshot, ultimo in %.3f ms",
+        (checkpoint.record.capacity + checkpoint.batch.capacity) >> 10, checkpoint.n_records, checkpoint.n_snapshots,
+        checkpoint.last_snapshot_ns / 1e6);
+    snprintf(lines[n++], MAX_PAYLOAD_DIM, "Log di checkpoint per comando: %lu comandi, in media %.1f us, al massimo %.1f us",
+        checkpoint.n_writes, checkpoint.n_writes > 0 ? checkpoint.write_ns / 1e3 / checkpoint.n_writes : 0.0,
+        checkpoint.max_write_ns / 1e3);
+
+    // Invia il numero di righe e poi ogni riga
+    init_msg(&msg, MSG_LIST_START, n);
+    ret = send_to_socket(sd, &msg);
+    for (i = 0; i < n && ret == OK; i++) {
+        init_msg(&msg, MSG_LIST_ITEM, lines[i]);
         ret = send_to_socket(sd, &msg);
-        if (ret != OK)
-            return ret;
-
-        current = current->next;
     }
     return ret;
 }
 
+//-------------------------//
+
+//---Room Stats---//
+
+static const char* stats_path = NULL;               // File delle statistiche, NULL se non vengono salvate
+static bool stats_dirty = false;                    // Statistiche modificate dall'ultimo salvataggio
+static time_t stats_saved_at = 0;                   // Istante dell'ultimo salvataggio
+
 /*
- * Invia lo stato della sessione di gioco specificata al client, includendo il tempo rimanente, il numero di token,
- * il numero di oggetti nello zaino e il numero dell'ultimo messaggio di aiuto.
- * 
- * Parametri:
- *   - sd: Descrittore del socket per la comunicazione con il client.
- *   - session: Il puntatore alla sessione di gioco.
+ * Legge le statistiche delle room salvate nel file specificato e le salva periodicamente nello stesso file.
+ * Le statistiche vengono associate alle room per nome; quelle di room non più caricate vengono scartate.
+ * Deve essere chiamata una volta all'avvio, dopo initRooms e restoreSessions.
  * 
  * Restituisce:
- *   - OK se lo stato del giocatore è stato inviato con successo al client.
- *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
- *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ *   - true se il file è stato letto o non esiste ancora, false se non è valido (le statistiche ripartono da zero).
  */
-static op_result sendUserSessionState(int sd, game_session* session) 
+bool initRoomStats(const char* path)
 {
-    desc_msg msg;
+    uint32_t* n_live = calloc(n_rooms > 0 ? n_rooms : 1, sizeof(uint32_t));
+    game_session* session;
+    bool ok;
+    int r;
+
+    stats_path = path;
+    stats_saved_at = getTimestamp();
+    ok = read_room_stats(path);
+
+    // Una sessione ripristinata avviata dopo l'ultimo salvataggio non è contata tra le partite avviate:
+    // le partite avviate sono almeno quelle terminate più quelle ancora in corso
+    for (session = sessions_list; n_live != NULL && session != NULL; session = session->next)
+        n_live[session->room]++;
+    for (r = 0; n_live != NULL && r < n_rooms; r++)
+    {
+        room_stats* stats = &rooms[r].stats;
+        if (stats->n_started < count_finished(stats) + n_live[r]) {
+            stats->n_started = count_finished(stats) + n_live[r];
+            stats_dirty = true;
+        }
+    }
+    free(n_live);
+    return ok;
+}
+
+// Legge il file delle statistiche, vedi initRoomStats
+static bool read_room_stats(const char* path)
+{
+    room_stats_header header;
+    room_stats_record record;
+    uint32_t i, slot, mask = 0;
+    int* index;
+    FILE* fd;
+
+    fd = fopen(path, "rb");
+    if (fd == NULL)
+        return errno == ENOENT;
+    if (fread(&header, sizeof(header), 1, fd) != 1 || header.magic != ROOM_STATS_MAGIC ||
+        header.version != ROOM_STATS_VERSION || header.record_size != sizeof(room_stats_record)) {
+        fclose(fd);
+        return false;
+    }
+
+    index = index_room_names(&mask);
+    for (i = 0; i < header.n_records && fread(&record, sizeof(record), 1, fd) == 1; i++)
+    {
+        record.name[MAX_ROOM_NAME_DIM - 1] = '\0';
+        if (index == NULL)
+            continue;
+
+        slot = (uint32_t)hash_string(record.name) & mask;
+        while (index[slot] != 0 && strcmp(rooms[index[slot] - 1].current->name, record.name) != 0)
+            slot = (slot + 1) & mask;
+        if (index[slot] != 0)
+            rooms[index[slot] - 1].stats = record.stats;
+    }
+    free(index);
+    fclose(fd);
 
     #ifdef VERBOSE
-        printf("↳ Invio dello stato della sessione di %s al socket %d\n", session->username, sd);
+        printf("↳ Lette le statistiche di %u room da %s\n", i, path);
     #endif
+    return i == header.n_records;
+}
 
-    // Inizializza il messaggio con le informazioni sullo stato del giocatore
-    init_msg(&msg, MSG_GAME_STATE, get_remaining_time(session), session->token, session->n_bag_objs, session->help_msg_id);
-    
-    // Invia il messaggio al client
-    return send_to_socket(sd, &msg);
+/*
+ * Salva le statistiche se sono cambiate e dall'ultimo salvataggio sono passati ROOM_STATS_FLUSH_SECONDS secondi.
+ * Deve essere chiamata periodicamente dal ciclo principale del server.
+ */
+void flushRoomStats()
+{
+    if (stats_path != NULL && stats_dirty && getTimestamp() - stats_saved_at >= ROOM_STATS_FLUSH_SECONDS)
+        write_room_stats();
 }
 
 /*
- * Invia al client le informazioni di base sulla sessione di gioco dell'utente specificato.
- * Include il nome della stanza associata all'utente e le informazioni sulla sessione corrente, come il tempo rimanente,
- * il numero di token della stanza e quelli ottenuti dall'utente, la dimensione dello zaino e il numero di oggetti in esso contenuti.
- * Se l'utente specificato non ha una sessione di gioco attiva, viene inviato un messaggio di errore.
- * 
- * Parametri:
- *   - sd: Descrittore del socket per la comunicazione con il client.
- *   - username: Il nome utente del giocatore di cui si vogliono ottenere le informazioni sulla sessione di gioco.
+ * Salva le statistiche modificate dall'ultimo salvataggio, all'arresto del server.
+ */
+void closeRoomStats()
+{
+    if (stats_path != NULL && stats_dirty)
+        write_room_stats();
+    stats_path = NULL;
+}
+
+/*
+ * Scrive le statistiche delle room con almeno una partita avviata in un file temporaneo, che poi sostituisce il file
+ * delle statistiche: un arresto durante la scrittura lascia il file precedente intatto.
  * 
  * Restituisce:
- *   - OK se le informazioni sono state inviate con successo.
- *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
- *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
+ *   - true se il file è stato scritto, false altrimenti (le statistiche restano da salvare).
  */
-op_result sendUserSessionData(int sd, const char* username) 
+static bool write_room_stats()
 {
-    desc_msg msg;
-    op_result ret;
-    game_session* session;
+    room_stats_header header = { ROOM_STATS_MAGIC, ROOM_STATS_VERSION, 0, sizeof(room_stats_record) };
+    room_stats_record record;
+    char tmp_path[256];
+    bool ok;
+    FILE* fd;
+    int r;
+
+    stats_saved_at = getTimestamp();
+    for (r = 0; r < n_rooms; r++)
+        if (rooms[r].stats.n_started > 0)
+            header.n_records++;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", stats_path);
+    fd = fopen(tmp_path, "wb");
+    if (fd == NULL)
+        return false;
+
+    ok = fwrite(&header, sizeof(header), 1, fd) == 1;
+    for (r = 0; ok && r < n_rooms; r++)
+    {
+        if (rooms[r].stats.n_started == 0)
+            continue;
+        memset(&record, 0, sizeof(record));
+        snprintf(record.name, sizeof(record.name), "%s", rooms[r].current->name);
+        record.stats = rooms[r].stats;
+        ok = fwrite(&record, sizeof(record), 1, fd) == 1;
+    }
+
+    ok = fclose(fd) == 0 && ok;
+    if (!ok || rename(tmp_path, stats_path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di ricevere informazioni sulla sessione di %s\n", sd, username);
+        printf("↳ Statistiche di %u room salvate in %s\n", header.n_records, stats_path);
     #endif
+    stats_dirty = false;
+    return true;
+}
 
-    // Cerca la sessione in base al nome utente specificato
-    session = find_session_by_username(username);
-    if (session == NULL)
-    {
-        // Sessione non trovata
-        #ifdef VERBOSE
-            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
-        #endif
+// Partite terminate di una room, in qualsiasi modo
+static uint32_t count_finished(const room_stats* stats)
+{
+    uint32_t n = 0;
+    int i;
 
-        // Invia messaggio di errore
-        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
-        return send_to_socket(sd, &msg);
-    }
+    for (i = 0; i < ROOM_OUTCOMES; i++)
+        n += stats->outcomes[i];
+    return n;
+}
 
-    // Sessione trovata
-    // Invio del nome della stanza
-    init_msg(&msg, MSG_GAME_DESCR, rooms[session->room].name);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
-    
-    // Invio delle informazioni di base
-    init_msg(&msg, MSG_SU_USER_SESSION_DATA, get_remaining_time(session), rooms[session->room].token, session->token, session->dim_bag, session->n_bag_objs);
-    return send_to_socket(sd, &msg);
+// Conta l'avvio di una partita nella room specificata
+static void count_start(int room)
+{
+    rooms[room].stats.n_started++;
+    stats_dirty = true;
 }
 
 /*
- * Invia al client lo stato aggiornato della sessione di gioco dell'utente specificato
- * e quello degli oggetti bloccati, nascosti o consumabili.
- * 
- * Parametri:
- *   - sd: Descrittore del socket per la comunicazione con il client.
- *   - username: Il nome utente del giocatore di cui si vuole ottenere lo stato degli oggetti.
- * 
- * Restituisce:
- *   - OK se lo stato degli oggetti è stato inviato con successo.
- *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
- *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ * Conta la fine di una partita, da chiamare prima di terminare la sessione.
+ * Il tempo di gioco di una vittoria è il tempo della room meno il tempo rimanente, quindi conta anche
+ * il tempo aggiunto o tolto da un supervisore e non conta le pause.
  */
-op_result sendUserSessionObjs(int sd, const char* username) 
+static void count_outcome(game_session* session, room_outcome outcome)
 {
-    desc_msg msg;
-    op_result ret;
-    game_session* session;
-    int i;
+    room_stats* stats = &rooms[session->room].stats;
+    int64_t played;
 
-    #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di ricevere lo stato degli oggetti nella sessione di %s\n", sd, username);
-    #endif
+    stats->outcomes[outcome]++;
+    if (outcome == ROOM_OUTCOME_WIN) {
+        played = (int64_t)session->version->view.header->seconds * 1000 - get_remaining_ms(session);
+        stats->win_times[win_time_bucket(played > 0 ? (uint64_t)(played + 500) / 1000 : 0)]++;
+    }
+    stats_dirty = true;
+}
 
-    // Cerca la sessione in base al nome utente specificato
-    session = find_session_by_username(username);
-    if (session == NULL)
+/*
+ * Conta una risposta all'enigma di un oggetto. Gli enigmi più sbagliati sono tenuti con l'algoritmo Space-Saving:
+ * un enigma sbagliato che non è nella tabella piena prende il posto di quello con meno risposte sbagliate,
+ * ereditandone il conteggio come errore massimo. Ogni enigma sbagliato più di 1/ROOM_STATS_PUZZLES delle volte
+ * resta quindi nella tabella, con un conteggio che eccede quello reale di al più error.
+ */
+static void count_puzzle(game_session* session, uint32_t obj, bool solved)
+{
+    room_stats* stats = &rooms[session->room].stats;
+    const char* name = get_obj_name(session, obj);
+    room_puzzle_stats* entry = NULL;
+    room_puzzle_stats* min = &stats->puzzles[0];
+    int i;
+
+    for (i = 0; i < ROOM_STATS_PUZZLES && entry == NULL; i++)
     {
-        // Sessione non trovata
-        #ifdef VERBOSE
-            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
-        #endif
+        if (stats->puzzles[i].name[0] != '\0' && strcmp(stats->puzzles[i].name, name) == 0)
+            entry = &stats->puzzles[i];
+        else if (stats->puzzles[i].failures < min->failures)
+            min = &stats->puzzles[i];
+    }
 
-        // Invia messaggio di errore
-        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
-        return send_to_socket(sd, &msg);
+    if (entry == NULL)
+    {
+        // Le risposte giuste contano solo per gli enigmi già nella tabella
+        if (solved)
+            return;
+        entry = min;
+        snprintf(entry->name, sizeof(entry->name), "%s", name);
+        entry->error = entry->failures;
+        entry->solved = 0;
     }
 
-    // Sessione trovata
-    // Invio dello stato aggiornato
-    ret = sendUserSessionState(sd, session);
-    if (ret != OK)
-        return ret;
-    
-    // Invia il numero totale di elementi nella lista
-    init_msg(&msg, MSG_LIST_START, session->n_special_objects);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
+    if (solved)
+        entry->solved++;
+    else
+        entry->failures++;
+    stats_dirty = true;
+}
 
-    // Invio dello stato degli oggetti bloccati, nascosti o consumabili
-    init_msg(&msg, MSG_LIST_ITEM, "");
-    for (i = 0; i < rooms[session->room].n_locations; i++) 
-    {
-        int j;
-        for (j = 0; j < rooms[session->room].locations[i].n_objs; j++) 
-        {
-            // Verifica se l'oggetto è bloccato, nascosto o consumabile
-            if (rooms[session->room].locations[i].objs[j].isLocked ||
-                rooms[session->room].locations[i].objs[j].isHidden ||
-                rooms[session->room].locations[i].objs[j].consumable) 
-            {
-                // Costruisce il messaggio con lo stato dell'oggetto
-                sprintf(msg.payload, "%s %d %d %d", 
-                    rooms[session->room].locations[i].objs[j].name,
-                    (rooms[session->room].locations[i].objs[j].isLocked && is_obj_locked(session, &rooms[session->room].locations[i].objs[j])) ? 1 : 0,
-                    (rooms[session->room].locations[i].objs[j].isHidden && is_obj_hidden(session, &rooms[session->room].locations[i].objs[j])) ? 1 : 0,
-                    (rooms[session->room].locations[i].objs[j].consumable && is_obj_consumed(session, &rooms[session->room].locations[i].objs[j])) ? 1 : 0
-                );
-
-                // Invia il messaggio
-                ret = send_to_socket(sd, &msg);
-                if (ret != OK)
-                    return ret;
-            }
-        }
+/*
+ * Restituisce l'intervallo dell'istogramma dei tempi di vittoria che contiene i secondi specificati.
+ * I primi 8 intervalli sono larghi un secondo, poi ogni potenza di 2 è divisa in 8 intervalli uguali,
+ * quindi il tempo letto dall'istogramma si discosta da quello reale di meno del 6.25%.
+ */
+static int win_time_bucket(uint64_t seconds)
+{
+    int e, bucket;
+
+    if (seconds < 8)
+        return (int)seconds;
+    e = 63 - __builtin_clzll(seconds);
+    bucket = (e - 2) * 8 + (int)((seconds >> (e - 3)) & 7);
+    return bucket < ROOM_STATS_BUCKETS ? bucket : ROOM_STATS_BUCKETS - 1;
+}
+
+// Restituisce il valore centrale in secondi dell'intervallo specificato dell'istogramma dei tempi di vittoria
+static double win_time_value(int bucket)
+{
+    int shift = bucket / 8 - 1;
+
+    if (bucket < 8)
+        return bucket;
+    return (double)((uint64_t)(8 + bucket % 8) << shift) + (double)(((uint64_t)1 << shift) - 1) / 2;
+}
+
+// Restituisce il percentile specificato dei tempi di vittoria, in secondi, o 0 se non ci sono vittorie
+static double win_time_quantile(const room_stats* stats, uint32_t percent)
+{
+    uint64_t rank = ((uint64_t)stats->outcomes[ROOM_OUTCOME_WIN] * percent + 99) / 100, seen = 0;
+    int b;
+
+    if (rank == 0)
+        rank = 1;
+    for (b = 0; b < ROOM_STATS_BUCKETS; b++) {
+        seen += stats->win_times[b];
+        if (seen >= rank)
+            return win_time_value(b);
     }
-    return ret;
+    return 0;
 }
 
 /*
- * Invia al client lo stato aggiornato della sessione di gioco dell'utente specificato
- * e la lista degli oggetti nello zaino del giocatore.
+ * Invia al client le statistiche di gioco delle room con almeno una partita: partite avviate, percentuali
+ * di vittorie e di tempo scaduto, abbandoni, tempo di vittoria mediano e al 90-esimo percentile ed enigmi più sbagliati.
+ * Le statistiche sono aggiornate a ogni partita, quindi la richiesta non scorre le sessioni.
  * 
  * Parametri:
- *   - sd: Il descrittore del socket per la comunicazione con il client.
- *   - username: Il nome utente del giocatore di cui si vogliono conoscere gli oggetti nello zaino.
+ *   - sd: Descrittore del socket per la comunicazione con il client.
  * 
  * Restituisce:
- *   - OK se la lista degli oggetti è stata inviata con successo al client.
+ *   - OK se l'invio della lista è avvenuto con successo.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
- *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
+ *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
  */
-op_result sendUserSessionBag(int sd, const char* username) 
+op_result sendRoomStats(int sd)
 {
+    char line[MAX_PAYLOAD_DIM];
     desc_msg msg;
     op_result ret;
-    game_session* session;
-    int i;
+    int r, i, j, n = 0;
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di ricevere gli oggetti nello zaino di %s\n", sd, username);
+        printf("↳ Richiesta dal socket %d di ricevere le statistiche delle room\n", sd);
     #endif
 
-    // Cerca la sessione in base al nome utente specificato
-    session = find_session_by_username(username);
-    if (session == NULL)
-    {
-        // Sessione non trovata
-        #ifdef VERBOSE
-            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
-        #endif
-
-        // Invia messaggio di errore
-        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
         return send_to_socket(sd, &msg);
     }
 
-    // Sessione trovata
-    // Invio dello stato aggiornato
-    ret = sendUserSessionState(sd, session);
-    if (ret != OK)
-        return ret;
-    
-    // Invio del numero totale di oggetti nello zaino
-    init_msg(&msg, MSG_LIST_START, session->n_bag_objs);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
+    // Ogni room con almeno una partita occupa due righe
+    for (r = 0; r < n_rooms; r++)
+        if (rooms[r].stats.n_started > 0)
+            n += 2;
 
-    // Invia i nomi degli oggetti nello zaino
-    for (i = 0; i < session->n_bag_objs; i++) 
+    init_msg(&msg, MSG_LIST_START, n);
+    ret = send_to_socket(sd, &msg);
+    for (r = 0; r < n_rooms && ret == OK; r++)
     {
-        if (session->bag_objs[i] == NULL)
+        const room_stats* stats = &rooms[r].stats;
+        const room_puzzle_stats* top[ROOM_STATS_PUZZLES];
+        uint32_t n_finished = count_finished(stats), n_started;
+        int n_top = 0, len;
+
+        if (stats->n_started == 0)
             continue;
-        
-        // Invia il nome dell'oggetto
-        init_msg(&msg, MSG_LIST_ITEM, session->bag_objs[i]->name);
+
+        // initRoomStats fa sì che le partite avviate non siano meno di quelle terminate; il limite evita comunque
+        // partite in corso negative e percentuali oltre il 100%
+        n_started = stats->n_started > n_finished ? stats->n_started : n_finished;
+        snprintf(line, sizeof(line), "%s: %u partite, vinte %.1f%%, tempo scaduto %.1f%%, abbandonate %u, in corso %u, tempo di vittoria mediano %.0f s (90%%: %.0f s)",
+            rooms[r].current->name, n_started,
+            100.0 * stats->outcomes[ROOM_OUTCOME_WIN] / n_started,
+            100.0 * stats->outcomes[ROOM_OUTCOME_TIMEOUT] / n_started,
+            stats->outcomes[ROOM_OUTCOME_QUIT] + stats->outcomes[ROOM_OUTCOME_ABANDONED],
+            n_started - n_finished, win_time_quantile(stats, 50), win_time_quantile(stats, 90));
+        init_msg(&msg, MSG_LIST_ITEM, line);
         ret = send_to_socket(sd, &msg);
         if (ret != OK)
-            return ret;
+            break;
+
+        // Enigmi in ordine di risposte sbagliate decrescenti
+        for (i = 0; i < ROOM_STATS_PUZZLES; i++)
+        {
+            if (stats->puzzles[i].failures == 0)
+                continue;
+            for (j = n_top; j > 0 && top[j - 1]->failures < stats->puzzles[i].failures; j--)
+                top[j] = top[j - 1];
+            top[j] = &stats->puzzles[i];
+            n_top++;
+        }
+
+        len = snprintf(line, sizeof(line), "  Enigmi più sbagliati:%s", n_top == 0 ? " nessuno" : "");
+        for (i = 0; i < n_top && len < (int)sizeof(line); i++)
+            len += snprintf(line + len, sizeof(line) - len, "%s %s %u%s sbagliate e %u giuste", i > 0 ? "," : "",
+                top[i]->name, top[i]->failures - top[i]->error, top[i]->error > 0 ? "+" : "", top[i]->solved);
+        init_msg(&msg, MSG_LIST_ITEM, line);
+        ret = send_to_socket(sd, &msg);
     }
     return ret;
 }
 
+//-------------------------//
+
+//---Supervisor Subscriptions---//
+
+static uint8_t push_buffer[SUBSCRIPTION_BUFFER_DIM]; // Messaggi accorpati per il supervisore in aggiornamento
+static size_t push_size = 0;
+static int64_t last_push = 0;                       // Istante dell'ultimo invio sull'orologio del gioco
+
 /*
- * Gestisce la modifica del tempo rimanente della sessione di gioco dell'utente specificato.
+ * Iscrive il supervisore agli aggiornamenti della sessione di un giocatore. Lo stato completo viene inviato
+ * subito dopo la risposta, poi pushSubscriptions invia solo i cambiamenti. L'iscrizione resta valida anche dopo la fine
+ * della sessione, per le partite successive dello stesso giocatore, finché non viene annullata.
  * 
  * Parametri:
- *   - sd: Il descrittore del socket per la comunicazione con il client.
- *   - username: Il nome dell'utente di cui modificare il tempo della sessione.
- *   - opt: Il carattere che indica l'operazione da eseguire ('+', '-' o '=').
- *   - seconds: Il numero di secondi da aggiungere, sottrarre o impostare come tempo rimanente della sessione.
- *
+ *   - sd: Descrittore del socket per la comunicazione con il supervisore.
+ *   - username: Il nome utente del giocatore da osservare.
+ * 
  * Restituisce:
- *   - OK se la lista degli oggetti è stata inviata con successo al client.
+ *   - OK se la risposta è stata inviata con successo.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
  *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
  */
-op_result alterSessionTime(int sd, const char* username, const char opt, int seconds) 
+op_result subscribeSession(int sd, const char* username)
 {
     desc_msg msg;
-    game_session* session;
+    su_subscription* sub = NULL;
+    op_result ret;
+    int i;
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di alterare il tempo rimanente della sessione di %s\n", sd, username);
+        printf("↳ Richiesta dal socket %d di ricevere gli aggiornamenti della sessione di %s\n", sd, username);
     #endif
 
-    // Cerca la sessione in base al nome utente specificato
-    session = find_session_by_username(username);
-    if (session == NULL)
-    {
-        // Sessione non trovata
-        #ifdef VERBOSE
-            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
-        #endif
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
 
-        // Invia messaggio di errore
+    // Come le altre richieste sulla sessione, l'iscrizione richiede che la sessione esista
+    if (find_session_by_username(username) == NULL) {
         init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
         return send_to_socket(sd, &msg);
     }
 
-    // Sessione trovata
-    // Modifica del tempo rimanente
-    switch (opt)
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
     {
-        case '+': 
-        {
-            session->seconds += seconds;
-            #ifdef VERBOSE
-                printf("↳ Aggiunti %d secondi. Nuovo tempo rimanente: %lld\n", seconds, (long long)get_remaining_time(session));
-            #endif
-            break;
-        }
-        case '-': 
-        {
-            session->seconds -= seconds;
-            #ifdef VERBOSE
-                printf("↳ Sottratti %d secondi. Nuovo tempo rimanente: %lld\n", seconds, (long long)get_remaining_time(session));
-            #endif
-            break;
-        }
-        case '=': 
-        {
-            session->seconds = seconds + (getTimestamp() - session->start_time);
-            #ifdef VERBOSE
-                printf("↳ Tempo rimanente impostato a: %lld\n", (long long)get_remaining_time(session));
-            #endif
+        if (subscriptions[i].active && subscriptions[i].sd == sd && strcmp(subscriptions[i].username, username) == 0) {
+            // Già iscritto: il prossimo invio ripete lo stato completo
+            sub = &subscriptions[i];
+            sub->session = NULL;
             break;
         }
-        default: 
-        {
-            #ifdef VERBOSE
-                printf("↳ Operazione non supportata\n");
-            #endif
-            // Invia messaggio di errore
-            init_msg(&msg, MSG_SU_ERR_ALTER_TIME_OPT);
-            return send_to_socket(sd, &msg);
-        }
+        if (!subscriptions[i].active && sub == NULL)
+            sub = &subscriptions[i];
     }
 
-    // Invio dello stato aggiornato
-    return sendUserSessionState(sd, session);
+    if (sub == NULL) {
+        #ifdef VERBOSE
+            printf("↳ Raggiunto il massimo di %d iscrizioni\n", MAX_SUBSCRIPTIONS);
+        #endif
+        init_msg(&msg, MSG_GAME_ERR_SERVER_FULL);
+        return send_to_socket(sd, &msg);
+    }
+
+    if (!sub->active) {
+        memset(sub, 0, sizeof(su_subscription));
+        sub->active = true;
+        sub->sd = sd;
+        strncpy(sub->username, username, MAX_USR_DIM - 1);
+        n_subscriptions++;
+    }
+
+    init_msg(&msg, MSG_SUCCESS);
+    ret = send_to_socket(sd, &msg);
+
+    // Stato completo, così il supervisore non deve attendere il prossimo invio
+    push_size = 0;
+    if (ret == OK)
+        ret = push_update(sub);
+    if (ret == OK)
+        ret = push_flush(sd);
+    return ret;
 }
 
 /*
- * Imposta il messaggio di aiuto per la sessione di gioco dell'utente specificato.
- * 
- * Parametri:
- *   - sd: Il descrittore del socket per la comunicazione con il client.
- *   - username: Il nome dell'utente al quale inviare il messaggio di aiuto.
- *   - help_msg: Il nuovo messaggio di aiuto da impostare.
+ * Annulla l'iscrizione del supervisore agli aggiornamenti della sessione di un giocatore, o tutte le sue iscrizioni
+ * se username è vuoto. Gli aggiornamenti già inviati possono ancora arrivare prima della risposta.
  * 
  * Restituisce:
- *   - OK se il messaggio di aiuto è stato impostato con successo e lo stato della sessione è stato aggiornato.
+ *   - OK se la risposta è stata inviata con successo.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
  *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
  */
-op_result setUserSessionHelp(int sd, const char* username, const char* help_msg) 
+op_result unsubscribeSession(int sd, const char* username)
 {
     desc_msg msg;
-    game_session* session;
+    int i;
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di impostare il messaggio di aiuto \"%s\" nella sessione di %s\n", sd, help_msg, username);
+        printf("↳ Richiesta dal socket %d di non ricevere più gli aggiornamenti della sessione di %s\n", sd, username);
     #endif
 
-    // Cerca la sessione in base al nome utente specificato
-    session = find_session_by_username(username);
+    // Verifica che la connessione sia di un supervisore
+    if (!check_supervisor(sd)) {
+        init_msg(&msg, MSG_GAME_ERR_CMD_NOT_ALLOWED);
+        return send_to_socket(sd, &msg);
+    }
+
+    if (username[0] == '\0')
+        drop_subscriptions(sd);
+    else
+        for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+            if (subscriptions[i].active && subscriptions[i].sd == sd && strcmp(subscriptions[i].username, username) == 0) {
+                mem_free(MEM_SESSIONS, subscriptions[i].obj_flags, subscriptions[i].n_objs);
+                subscriptions[i].active = false;
+                n_subscriptions--;
+            }
+
+    init_msg(&msg, MSG_SUCCESS);
+    return send_to_socket(sd, &msg);
+}
+
+/*
+ * Invia ai supervisori iscritti i cambiamenti delle sessioni osservate dall'invio precedente.
+ * Gli invii avvengono al più ogni SUBSCRIPTION_TICK_MS, quindi più cambiamenti nel mezzo diventano un solo
+ * aggiornamento, e i messaggi per lo stesso supervisore vengono accorpati in un'unica scrittura sul socket.
+ * Lo stato inviato viene confrontato con quello attuale, quindi una sessione che non è cambiata non costa nessun messaggio.
+ * Deve essere chiamata periodicamente dal ciclo principale del server.
+ * 
+ * Restituisce:
+ *   - true se ci sono supervisori iscritti, quindi il ciclo principale non deve attendere più di SUBSCRIPTION_TICK_MS.
+ *   - false altrimenti.
+ */
+bool pushSubscriptions()
+{
+    bool done[MAX_SUBSCRIPTIONS] = { false };
+    int i, j, sd;
+    op_result ret;
+
+    if (n_subscriptions == 0)
+        return false;
+    if (game_now() - last_push < SUBSCRIPTION_TICK_MS)
+        return true;
+    last_push = game_now();
+
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+    {
+        if (!subscriptions[i].active || done[i])
+            continue;
+
+        // Aggiornamenti di tutte le iscrizioni dello stesso supervisore
+        sd = subscriptions[i].sd;
+        push_size = 0;
+        ret = OK;
+        for (j = i; j < MAX_SUBSCRIPTIONS && ret == OK; j++)
+            if (subscriptions[j].active && subscriptions[j].sd == sd) {
+                done[j] = true;
+                ret = push_update(&subscriptions[j]);
+            }
+        if (ret == OK)
+            ret = push_flush(sd);
+
+        // Il supervisore non riceve più, le sue iscrizioni vengono annullate
+        if (ret != OK)
+            drop_subscriptions(sd);
+    }
+    return n_subscriptions > 0;
+}
+
+/*
+ * Aggiunge ai messaggi per il supervisore l'aggiornamento di un'iscrizione, se la sessione osservata è cambiata.
+ * Per una sessione nuova, o se il supervisore si è appena iscritto, l'aggiornamento contiene lo stato completo.
+ */
+static op_result push_update(su_subscription* sub)
+{
+    desc_msg msg;
+    game_session* session;
+    const room_view* view;
+    time_t remaining_time;
+    uint32_t i, n_changed = 0;
+    uint8_t flags;
+    op_result ret;
+    bool full;
+    int len;
+
+    if (sub->ended) {
+        sub->ended = false;
+        init_msg(&msg, MSG_SU_SESSION_ENDED, sub->username);
+        return push_frame(sub->sd, &msg);
+    }
+
+    session = sub->session != NULL ? sub->session : find_session_by_username(sub->username);
     if (session == NULL)
+        return OK;
+    view = &session->version->view;
+
+    // Una sessione nuova riparte da uno stato vuoto
+    full = sub->session != session;
+    if (full) {
+        if (sub->n_objs != view->header->n_objs) {
+            uint8_t* obj_flags = mem_realloc(MEM_SESSIONS, sub->obj_flags, sub->n_objs, view->header->n_objs);
+            if (obj_flags == NULL && view->header->n_objs > 0)
+                return OK;
+            sub->obj_flags = obj_flags;
+            sub->n_objs = view->header->n_objs;
+        }
+        if (sub->n_objs > 0)
+            memset(sub->obj_flags, 0, sub->n_objs);
+        sub->session = session;
+    }
+
+    remaining_time = get_remaining_time(session);
+    for (i = 0; i < sub->n_objs; i++)
+        if (su_obj_flags(session, i) != sub->obj_flags[i])
+            n_changed++;
+
+    if (!full && n_changed == 0 && remaining_time == sub->remaining_time && session->paused == sub->paused &&
+        session->token == sub->token && session->n_bag_objs == sub->n_bag_objs && session->help_msg_id == sub->help_msg_id)
+        return OK;
+
+    sub->remaining_time = remaining_time;
+    sub->paused = session->paused;
+    sub->token = session->token;
+    sub->n_bag_objs = session->n_bag_objs;
+    sub->help_msg_id = session->help_msg_id;
+
+    msg.type = MSG_SU_SESSION_UPDATE;
+    len = snprintf(msg.payload, MAX_PAYLOAD_DIM, "%s %d %lld %d %d %d %d %d %d %u %u", sub->username, full ? 1 : 0,
+        (long long)remaining_time, session->paused != 0 ? 1 : 0, session->token, (int)view->header->token,
+        session->n_bag_objs, session->dim_bag, session->help_msg_id, sub->n_objs, n_changed);
+    if (full)
+        snprintf(msg.payload + len, MAX_PAYLOAD_DIM - len, " %s", room_str(view, view->header->name));
+    ret = push_frame(sub->sd, &msg);
+
+    // Gli oggetti cambiati riempiono quanti messaggi servono
+    msg.type = MSG_SU_SESSION_OBJS;
+    len = 0;
+    for (i = 0; i < sub->n_objs && ret == OK; i++)
     {
-        // Sessione non trovata
-        #ifdef VERBOSE
-            printf("↳ Non c'è nessuna sessione relativa ad un giocatore con username specificato\n");
-        #endif
+        const char* name;
 
-        // Invia messaggio di errore
-        init_msg(&msg, MSG_SU_ERR_USER_NOT_FOUND);
-        return send_to_socket(sd, &msg);
+        flags = su_obj_flags(session, i);
+        if (flags == sub->obj_flags[i])
+            continue;
+        sub->obj_flags[i] = flags;
+
+        name = room_str(view, view->obj_texts[i].name);
+        if (len > 0 && len + 2 * 12 + strlen(name) + 3 >= MAX_PAYLOAD_DIM) {
+            ret = push_frame(sub->sd, &msg);
+            len = 0;
+        }
+        len += snprintf(msg.payload + len, MAX_PAYLOAD_DIM - len, "%s%u %u %s", len > 0 ? " " : "", i, flags, name);
     }
+    if (len > 0 && ret == OK)
+        ret = push_frame(sub->sd, &msg);
+    return ret;
+}
 
-    // Sessione trovata
-    // Imposta il messaggio di aiuto
-    strncpy(session->help_msg, help_msg, MAX_HELP_DIM);
-    session->help_msg[MAX_HELP_DIM - 1] = '\0';
-    session->help_msg_id++;
+// Restituisce lo stato di un oggetto della sessione come inviato ai supervisori (SU_OBJ_*)
+static uint8_t su_obj_flags(game_session* session, uint32_t obj)
+{
+    uint16_t flags = session->version->view.objs[obj].flags;
+    uint8_t state = 0;
+
+    if (flags & (ROOM_OBJ_LOCKED | ROOM_OBJ_HIDDEN | ROOM_OBJ_CONSUMABLE))
+        state |= SU_OBJ_SPECIAL;
+    if (obj_set_test(session->locked, obj))
+        state |= SU_OBJ_LOCKED;
+    if (obj_set_test(session->hidden, obj))
+        state |= SU_OBJ_HIDDEN;
+    if (obj_set_test(session->consumed, obj))
+        state |= SU_OBJ_CONSUMED;
+    if (obj_set_test(session->bag, obj))
+        state |= SU_OBJ_IN_BAG;
+    return state;
+}
 
-    // Invio dello stato aggiornato
-    return sendUserSessionState(sd, session);
+// Accoda un messaggio per il supervisore, inviando quelli già accodati se il buffer è pieno
+static op_result push_frame(int sd, desc_msg* msg)
+{
+    op_result ret;
+
+    if (push_size + MSG_HEADER_DIM + MAX_PAYLOAD_DIM > SUBSCRIPTION_BUFFER_DIM) {
+        ret = push_flush(sd);
+        if (ret != OK)
+            return ret;
+    }
+    push_size += encode_msg(msg, push_buffer + push_size);
+    return OK;
+}
+
+// Invia al supervisore i messaggi accodati
+static op_result push_flush(int sd)
+{
+    op_result ret = OK;
+
+    if (push_size > 0)
+        ret = send_encoded(sd, push_buffer, push_size);
+    push_size = 0;
+    return ret;
+}
+
+/*
+ * Segnala ai supervisori iscritti che la sessione termina, da chiamare prima di liberarla.
+ */
+static void end_subscriptions(game_session* session)
+{
+    int i;
+
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+        if (subscriptions[i].active && subscriptions[i].session == session) {
+            subscriptions[i].session = NULL;
+            subscriptions[i].ended = true;
+        }
+}
+
+// Annulla tutte le iscrizioni di un supervisore
+static void drop_subscriptions(int sd)
+{
+    int i;
+
+    for (i = 0; i < MAX_SUBSCRIPTIONS; i++)
+        if (subscriptions[i].active && subscriptions[i].sd == sd) {
+            mem_free(MEM_SESSIONS, subscriptions[i].obj_flags, subscriptions[i].n_objs);
+            subscriptions[i].active = false;
+            n_subscriptions--;
+        }
 }
 
 //-------------------------//
@@ -1109,16 +3578,36 @@ op_result setUserSessionHelp(int sd, const char* username, const char* help_msg)
  *   - session: Puntatore alla sessione di gioco per la quale si vuole conoscere il tempo rimanente.
  * 
  * Restituisce:
- *   - Il tempo rimanente della sessione di gioco, espresso in secondi.
+ *   - Il tempo rimanente della sessione di gioco, espresso in millisecondi.
  */
-static time_t get_remaining_time(game_session* session) 
+static int64_t get_remaining_ms(game_session* session)
 {
-    time_t remaining_time;
+    int64_t remaining;
     if (session == NULL)
         return 0;
-    
-    remaining_time = session->seconds - (getTimestamp() - session->start_time);
-    return remaining_time < 0 ? 0 : remaining_time;
+
+    remaining = session->paused != 0 ? session->remaining : session->deadline - game_now();
+    return remaining < 0 ? 0 : remaining;
+}
+
+/*
+ * Restituisce il tempo rimanente della sessione in secondi, come viene inviato ai client.
+ * Il valore è arrotondato per eccesso: una sessione risulta scaduta solo quando non ha più nessun millisecondo.
+ */
+static time_t get_remaining_time(game_session* session) 
+{
+    return (time_t)((get_remaining_ms(session) + 999) / 1000);
+}
+
+/*
+ * Restituisce il nome di un oggetto della room della sessione, o una stringa vuota se l'oggetto non esiste.
+ */
+static const char* get_obj_name(game_session* session, uint32_t obj)
+{
+    const room_view* view = &session->version->view;
+    if (obj == ROOM_NO_OBJ)
+        return "";
+    return room_str(view, view->obj_texts[obj].name);
 }
 
 /*
@@ -1127,18 +3616,9 @@ static time_t get_remaining_time(game_session* session)
  * Restituisce:
  *   - true se l'oggetto è consumato, false altrimenti
  */
-static bool is_obj_consumed(game_session* session, game_obj* obj) 
+static bool is_obj_consumed(game_session* session, uint32_t obj) 
 {
-    if (obj->consumable == false)
-        return false;
-
-    int i = 0;
-    for (; i < session->n_consumable_objs; i++) 
-    {
-        if (session->consumed_objs[i] == obj)
-            return true;
-    }
-    return false;
+    return obj_set_test(session->consumed, obj);
 }
 
 /*
@@ -1147,18 +3627,9 @@ static bool is_obj_consumed(game_session* session, game_obj* obj)
  * Restituisce:
  *   - true se l'oggetto è nello zaino, false altrimenti
  */
-static bool is_obj_taken(game_session* session, game_obj* obj) 
+static bool is_obj_taken(game_session* session, uint32_t obj) 
 {
-    if (obj->takeable == false)
-        return false;
-
-    int i = 0;
-    for (; i < session->dim_bag; i++) 
-    {
-        if (session->bag_objs[i] == obj)
-            return true;
-    }
-    return false;
+    return obj_set_test(session->bag, obj);
 }
 
 /*
@@ -1167,38 +3638,20 @@ static bool is_obj_taken(game_session* session, game_obj* obj)
  * Restituisce:
  *   - true se l'oggetto è bloccato, false altrimenti
  */
-static bool is_obj_locked(game_session* session, game_obj* obj) 
-{
-    if (obj->isLocked == false)
-        return false;
-
-    int i = 0;
-    for (; i < session->n_locked_objs; i++) 
-    {
-        if (session->unlocked_objs[i] == obj)
-            return false;
-    }
-    return true;
+static bool is_obj_locked(game_session* session, uint32_t obj) 
+{
+    return obj_set_test(session->locked, obj);
 }
 
 /*
  * Verifica se il giocatore può vedere o meno un oggetto nascosto
  * 
  * Restituisce:
- *   - true se l'oggetto è visibile, false altrimenti
+ *   - true se l'oggetto è nascosto, false altrimenti
  */
-static bool is_obj_hidden(game_session* session, game_obj* obj) 
+static bool is_obj_hidden(game_session* session, uint32_t obj) 
 {
-    if (obj->isHidden == false)
-        return false;
-
-    int i = 0;
-    for (; i < session->n_hidden_objs; i++) 
-    {
-        if (session->revealed_objs[i] == obj)
-            return false;
-    }
-    return true;
+    return obj_set_test(session->hidden, obj);
 }
 
 /*
@@ -1210,35 +3663,29 @@ static bool is_obj_hidden(game_session* session, game_obj* obj)
  *   - checkVisibility: Se true, controlla se l'oggetto è visibile al giocatore.
  *
  * Restituisce:
- *   - Il puntatore all'oggetto se esiste e, se richiesto, visibile al giocatore.
- *   - NULL se l'oggetto non esiste o, se richiesto, non è visibile al giocatore.
+ *   - L'id dell'oggetto se esiste e, se richiesto, visibile al giocatore.
+ *   - ROOM_NO_OBJ se l'oggetto non esiste o, se richiesto, non è visibile al giocatore.
  *
  * La funzione ricerca l'oggetto nella stanza corrente del giocatore. Se l'oggetto esiste e, se richiesto,
- * è visibile al giocatore, restituisce un puntatore all'oggetto. Se l'oggetto è invisibile al giocatore
- * e il controllo sulla visibilità è attivato, la funzione restituisce NULL.
+ * è visibile al giocatore, ne restituisce l'id. Se l'oggetto è invisibile al giocatore
+ * e il controllo sulla visibilità è attivato, la funzione restituisce ROOM_NO_OBJ.
  */
-static game_obj* find_obj(game_session* session, const char* name, bool checkVisibility) 
+static uint32_t find_obj(game_session* session, const char* name, bool checkVisibility) 
 {
-    int i, j;
+    const room_name_slot* entry;
     if (session == NULL || name == NULL || strlen(name) == 0)
-        return NULL;
+        return ROOM_NO_OBJ;
 
-    for (i = 0; i < rooms[session->room].n_locations; i++) 
-    {
-        for (j = 0; j < rooms[session->room].locations[i].n_objs; j++) 
-        {
-            if (strcmp(rooms[session->room].locations[i].objs[j].name, name) == 0) 
-            {
-                // Oggetto trovato
-                if (checkVisibility && is_obj_hidden(session, &rooms[session->room].locations[i].objs[j]))
-                    // Se l'oggetto è invisibile al giocatore, è come se non esistesse
-                    return NULL;
+    entry = room_find_name(&session->version->view, name);
+    if (entry == NULL || entry->obj == ROOM_NO_OBJ)
+        return ROOM_NO_OBJ;
 
-                return &rooms[session->room].locations[i].objs[j];
-            }
-        }
-    }
-    return NULL;
+    // Oggetto trovato
+    if (checkVisibility && is_obj_hidden(session, entry->obj))
+        // Se l'oggetto è invisibile al giocatore, è come se non esistesse
+        return ROOM_NO_OBJ;
+
+    return entry->obj;
 }
 
 /*
@@ -1246,24 +3693,21 @@ static game_obj* find_obj(game_session* session, const char* name, bool checkVis
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - obj_name: Il nome dell'oggetto da consumare.
+ *   - obj: L'id dell'oggetto da consumare.
  *
  * Restituisce:
  *   - true se l'oggetto è stato consumato con successo.
- *   - false se l'oggetto non è stato trovato, non è consumabile o è già stato consumato.
+ *   - false se l'oggetto non esiste, è nascosto, non è consumabile o è già stato consumato.
  *
- * La funzione cerca l'oggetto nel contesto del giocatore e verifica se può essere consumato.
- * Se l'oggetto è consumabile e non è già stato consumato, lo segna come consumato.
+ * Se l'oggetto è visibile, consumabile e non è già stato consumato, lo segna come consumato.
  */
-static bool consume_obj(game_session* session, const char* obj_name) 
+static bool consume_obj(game_session* session, uint32_t obj) 
 {
-    int i;
-    game_obj* obj = find_obj(session, obj_name, true);
-    if (obj == NULL)
+    if (obj == ROOM_NO_OBJ || is_obj_hidden(session, obj))
         return false;
 
     // Controlla se l'oggetto è consumabile
-    if (obj->consumable == false)
+    if ((session->version->view.objs[obj].flags & ROOM_OBJ_CONSUMABLE) == 0)
         return false;
 
     // Controlla se l'oggetto è consumato
@@ -1274,18 +3718,10 @@ static bool consume_obj(game_session* session, const char* obj_name)
     // Elimina l'oggetto dallo zaino del giocatore, se al suo interno
     drop_obj(session, obj);
 
-    // Inserimento dell'oggetto nel vettore degli oggetti consumati dal giocatore
-    for (i = 0; i < session->n_consumable_objs; i++) 
-    {
-        // Trovo la prima posizione disponibile
-        if (session->consumed_objs[i] == NULL)
-        {
-            session->consumed_objs[i] = obj;
-            return true;
-        }
-    }
-
-    return false;
+    // Inserimento dell'oggetto nell'insieme degli oggetti consumati dal giocatore
+    obj_set_add(session->consumed, obj);
+    log_obj_state(session, CKPT_SET_CONSUMED, obj, true);
+    return true;
 }
 
 /*
@@ -1293,7 +3729,7 @@ static bool consume_obj(game_session* session, const char* obj_name)
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - obj: Il puntatore all'oggetto da aggiungere allo zaino.
+ *   - obj: L'id dell'oggetto da aggiungere allo zaino.
  *
  * Restituisce:
  *   - true se l'oggetto è stato aggiunto con successo allo zaino.
@@ -1303,9 +3739,8 @@ static bool consume_obj(game_session* session, const char* obj_name)
  * Successivamente, controlla se c'è spazio nello zaino del giocatore; se non c'è spazio, restituisce false.
  * Se l'oggetto può essere aggiunto allo zaino, la funzione lo inserisce nel primo slot libero e restituisce true.
  */
-static bool take_obj(game_session* session, game_obj* obj)
+static bool take_obj(game_session* session, uint32_t obj)
 {
-    int i;
     // Controlla se l'oggetto è bloccato
     if (is_obj_locked(session, obj))
         return false;
@@ -1318,18 +3753,15 @@ static bool take_obj(game_session* session, game_obj* obj)
     if (session->n_bag_objs == session->dim_bag)
         return false;
     
-    // Inserimento dell'oggetto nel vettore degli oggetti nello zaino del giocatore
-    for (i = 0; i < session->dim_bag; i++) 
-    {
-        // Trovo la prima posizione disponibile
-        if (session->bag_objs[i] == NULL)
-        {
-            session->bag_objs[i] = obj;
-            session->n_bag_objs++;
-            return true;
-        }
-    }
-    return false;
+    // Controlla se l'oggetto è già nello zaino
+    if (is_obj_taken(session, obj))
+        return false;
+    
+    // Inserimento dell'oggetto nell'insieme degli oggetti nello zaino del giocatore
+    obj_set_add(session->bag, obj);
+    session->n_bag_objs++;
+    log_obj_state(session, CKPT_SET_BAG, obj, true);
+    return true;
 }
 
 /*
@@ -1337,69 +3769,22 @@ static bool take_obj(game_session* session, game_obj* obj)
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - obj: Il puntatore all'oggetto da rimuovere.
+ *   - obj: L'id dell'oggetto da rimuovere.
  *
  * Restituisce:
  *   - true se l'oggetto è stato rimosso con successo dallo zaino.
  *   - false se l'oggetto non è presente nello zaino.
- *
- * La funzione scorre tutti gli oggetti nello zaino del giocatore e cerca l'oggetto da rimuovere.
- * Se l'oggetto è trovato, viene rimosso dallo zaino e la funzione restituisce true.
- * Se l'oggetto non è presente nello zaino, la funzione restituisce false.
- */
-static bool drop_obj(game_session* session, game_obj* obj) 
-{
-    int i;
-    // Scorre tutti gli oggetti nello zaino
-    for (i = 0; i < session->dim_bag; i++) 
-    {
-        if (session->bag_objs[i] != obj)
-            continue;
-        // Oggetto trovato
-        session->bag_objs[i] = NULL;
-        session->n_bag_objs--;
-        return true;
-    }
-    // Oggetti non trovato
-    return false;
-}
-
-/*
- * Sblocca un oggetto per l'utente specificato.
- *
- * Parametri:
- *   - session: Il puntatore alla sessione di gioco.
- *   - obj_name: Il nome dell'oggetto da sbloccare.
- *
- * La funzione cerca l'oggetto nella stanza corrente dell'utente e, se l'oggetto è bloccato, lo sblocca
- * e applica le azioni di sblocco associate all'oggetto.
  */
-static void unlock_obj(game_session* session, const char* obj_name) 
+static bool drop_obj(game_session* session, uint32_t obj) 
 {
-    int i;
-    game_obj* obj = find_obj(session, obj_name, true);
-    if (obj == NULL)
-        return;
-
-    // Controlla se l'oggetto è bloccato
-    if (is_obj_locked(session, obj) == false)
-        // L'oggetto non è bloccato, non c'è nulla da fare
-        return;
-
-    // Inseriemento dell'oggetto nel vettore degli oggetti sbloccati dal giocatore
-    for (i = 0; i < session->n_locked_objs; i++) 
-    {
-        // Trovo la prima posizione disponibile
-        if (session->unlocked_objs[i] == NULL)
-        {
-            session->unlocked_objs[i] = obj;
-            break;
-        }
-    }
+    if (!is_obj_taken(session, obj))
+        // Oggetto non trovato
+        return false;
 
-    // Scorre ed esegue tutte le azioni
-    for (i = 0; i < obj->lock.n_actions; i++)
-        compute_action(session, &obj->lock.actions[i]);
+    obj_set_remove(session->bag, obj);
+    session->n_bag_objs--;
+    log_obj_state(session, CKPT_SET_BAG, obj, false);
+    return true;
 }
 
 /*
@@ -1407,15 +3792,13 @@ static void unlock_obj(game_session* session, const char* obj_name)
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - obj_name: Il nome dell'oggetto da rendere visibile.
+ *   - obj: L'id dell'oggetto da rendere visibile.
  *
- * La funzione cerca l'oggetto nella stanza corrente dell'utente e, se l'oggetto è nascosto, lo rende visibile.
+ * Se l'oggetto è nascosto, lo rende visibile.
  */
-static void reveal_obj(game_session* session, const char* obj_name)
+static void reveal_obj(game_session* session, uint32_t obj)
 {
-    int i;
-    game_obj* obj = find_obj(session, obj_name, false);
-    if (obj == NULL)
+    if (obj == ROOM_NO_OBJ)
         return;
 
     // Controlla se l'oggetto è nascosto
@@ -1423,83 +3806,106 @@ static void reveal_obj(game_session* session, const char* obj_name)
         // L'oggetto non è nascosto, non c'è nulla da fare
         return;
     
-    // Inseriemento dell'oggetto nel vettore degli oggetti visibili al giocatore
-    for (i = 0; i < session->n_hidden_objs; i++) 
-    {
-        // Trovo la prima posizione disponibile
-        if (session->revealed_objs[i] == NULL)
-        {
-            session->revealed_objs[i] = obj;
-            break;
-        }
-    }
+    // Rimozione dell'oggetto dall'insieme degli oggetti nascosti
+    obj_set_remove(session->hidden, obj);
+    log_obj_state(session, CKPT_SET_HIDDEN, obj, false);
 }
 
 /*
- * Esegue l'azione specificata per l'utente nella sessione di gioco corrente.
+ * Esegue il codice compilato di un uso o di uno sblocco per l'utente specificato.
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - action: Il puntatore all'azione da eseguire.
+ *   - first: Indice della prima istruzione nel codice della room.
+ *   - n: Numero di istruzioni.
+ *
+ * Ogni sblocco è seguito dalle istruzioni della sua cascata: se l'oggetto è nascosto o non è bloccato
+ * lo sblocco non ha effetto e la cascata viene saltata, altrimenti l'oggetto viene sbloccato e la cascata
+ * eseguita di seguito, nello stesso ordine in cui lo sarebbero le azioni di sblocco.
  */
-static void compute_action(game_session* session, game_action* action)
+static void run_code(game_session* session, uint32_t first, uint32_t n)
 {
-    switch (action->type)
+    const room_op* code = &session->version->view.code[first];
+    uint32_t pc;
+
+    for (pc = 0; pc < n; pc++)
     {
-        case ACTION_TOKEN:
-        {
-            #ifdef VERBOSE
-                printf("↳ Assegno un token alla sessione del socket %d\n", session->sd);
-            #endif
-            session->token++;
-            break;
-        }
-        case ACTION_UNLOCK:
-        {
-            #ifdef VERBOSE
-                printf("↳ Sblocco l'oggetto \"%s\" per la sessione del socket %d\n", action->obj_name, session->sd);
-            #endif
-            unlock_obj(session, action->obj_name);
-            break;
-        }
-        case ACTION_REVEAL:
+        const room_op* op = &code[pc];
+        switch (op->type)
         {
-            #ifdef VERBOSE
-                printf("↳ Rendo visibile l'oggetto \"%s\" per la sessione del socket %d\n", action->obj_name, session->sd);
-            #endif
-            reveal_obj(session, action->obj_name);
-            break;
-        }
-        case ACTION_CONSUME: 
-        {
-            #ifdef VERBOSE
-                printf("↳ Consumo l'oggetto \"%s\" per la sessione del socket %d\n", action->obj_name, session->sd);
-            #endif
-            consume_obj(session, action->obj_name);
-            break;
+            case ACTION_TOKEN:
+            {
+                #ifdef VERBOSE
+                    printf("↳ Assegno un token alla sessione del socket %d\n", session->sd);
+                #endif
+                session->token++;
+                log_token(session);
+                break;
+            }
+            case ACTION_UNLOCK:
+            {
+                if (is_obj_hidden(session, op->obj) || is_obj_locked(session, op->obj) == false) {
+                    // L'oggetto non può essere sbloccato, la sua cascata viene saltata
+                    pc += op->skip;
+                    break;
+                }
+                #ifdef VERBOSE
+                    printf("↳ Sblocco l'oggetto \"%s\" per la sessione del socket %d\n", get_obj_name(session, op->obj), session->sd);
+                #endif
+                // Rimozione dell'oggetto dall'insieme degli oggetti bloccati
+                obj_set_remove(session->locked, op->obj);
+                log_obj_state(session, CKPT_SET_LOCKED, op->obj, false);
+                break;
+            }
+            case ACTION_REVEAL:
+            {
+                #ifdef VERBOSE
+                    printf("↳ Rendo visibile l'oggetto \"%s\" per la sessione del socket %d\n", get_obj_name(session, op->obj), session->sd);
+                #endif
+                reveal_obj(session, op->obj);
+                break;
+            }
+            case ACTION_CONSUME: 
+            {
+                #ifdef VERBOSE
+                    printf("↳ Consumo l'oggetto \"%s\" per la sessione del socket %d\n", get_obj_name(session, op->obj), session->sd);
+                #endif
+                consume_obj(session, op->obj);
+                break;
+            }
         }
     }
 }
 
 /*
- * Gestisce il caso in cui l'autenticazione dell'utente è avvenuta con successo.
+ * Gestisce il caso in cui l'autenticazione dell'utente è avvenuta con successo,
+ * registrando l'utente sulla connessione.
  * 
  * Parametri:
  *   - sd: Descrittore del socket per la comunicazione con il client.
+ *   - username: Nome dell'utente autenticato.
  * 
  * Restituisce:
  *   - OK se lo stato del giocatore è stato inviato con successo al client.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
  *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
  */
-op_result authUserSuccess(int sd) 
+op_result authUserSuccess(int sd, const char* username) 
 {
     desc_msg msg;
+    game_conn* conn = get_conn(sd);
 
     #ifdef VERBOSE
         printf("↳ Il socket %d si è autenticato con successo, invio della notifica al client\n", sd);
     #endif
 
+    // Registra l'utente autenticato sulla connessione, se non è già in gioco
+    if (conn != NULL && conn->state != CONN_IN_GAME)
+    {
+        snprintf(conn->username, sizeof(conn->username), "%s", username);
+        conn->state = CONN_AUTH;
+    }
+
     // Invia un messaggio di successo al client
     init_msg(&msg, MSG_SUCCESS);
     return send_to_socket(sd, &msg);
@@ -1556,17 +3962,110 @@ op_result authUsernameExists(int sd)
 }
 
 /*
- * Gestisce la disconnessione di un utente terminando una sua eventuale sessione di gioco.
+ * Gestisce la richiesta di una connessione di identificarsi come supervisore.
+ * La richiesta è accettata solo da una connessione non ancora autenticata e locale,
+ * così un client remoto non può osservare o modificare le sessioni degli altri giocatori.
  * 
  * Parametri:
  *   - sd: Descrittore del socket per la comunicazione con il client.
+ * 
+ * Restituisce:
+ *   - OK se la connessione è ora di un supervisore e la conferma è stata inviata al client.
+ *   - AUTH_ERR_NO_AUTH se la richiesta è stata rifiutata.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio del messaggio al client.
  */
-void authUserDisconnected(int sd)
+op_result authSupervisor(int sd)
 {
+    desc_msg msg;
+    op_result ret;
+    game_conn* conn = get_conn(sd);
+
+    if (conn == NULL || (conn->state != CONN_PRE_AUTH && conn->state != CONN_SUPERVISOR) || !is_local_peer(sd))
+    {
+        #ifdef VERBOSE
+            printf("↳ Il socket %d non può identificarsi come supervisore\n", sd);
+        #endif
+        if (conn != NULL)
+            conn->n_errors++;
+
+        init_msg(&msg, MSG_AUTH_ERR_NO_AUTH);
+        ret = send_to_socket(sd, &msg);
+        return ret == OK ? AUTH_ERR_NO_AUTH : ret;
+    }
+
     #ifdef VERBOSE
-        printf("↳ Il socket %d si è disconnesso, l'eventuale sessione viene terminata\n", sd);
+        printf("↳ Il socket %d si è identificato come supervisore\n", sd);
     #endif
-    stop_session(sd);
+    conn->state = CONN_SUPERVISOR;
+
+    init_msg(&msg, MSG_SUCCESS);
+    return send_to_socket(sd, &msg);
+}
+
+/*
+ * Inizializza lo stato di una nuova connessione.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ */
+void authUserConnected(int sd)
+{
+    game_conn* conn = get_conn(sd);
+    if (conn == NULL)
+        return;
+
+    memset(conn, 0, sizeof(game_conn));
+    conn->state = CONN_PRE_AUTH;
+    conn->connected_at = getTimestamp();
+    conn->last_activity = conn->connected_at;
+}
+
+/*
+ * Gestisce la disconnessione di un utente. L'eventuale sessione di gioco viene messa in attesa
+ * di essere ripresa con il suo token, oppure terminata se il periodo di attesa è nullo.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ */
+void authUserDisconnected(int sd)
+{
+    game_conn* conn = get_conn(sd);
+    game_session* session = find_session_by_sd(sd);
+
+    if (session != NULL)
+    {
+        event_begin(EV_DETACH, session->username, "");
+        if (session_grace_seconds > 0)
+        {
+            #ifdef VERBOSE
+                printf("↳ Il socket %d si è disconnesso, la sessione di %s resta in attesa per %d secondi\n", sd, session->username, session_grace_seconds);
+            #endif
+            // La sessione resta in memoria senza connessione
+            session->sd = -1;
+            session->detached_at = game_now();
+            pause_session(session, SESSION_PAUSE_DETACHED);
+            park_session(session, session->detached_at + (int64_t)session_grace_seconds * 1000);
+            log_time(session);
+        }
+        else
+        {
+            #ifdef VERBOSE
+                printf("↳ Il socket %d si è disconnesso, la sessione viene terminata\n", sd);
+            #endif
+            count_outcome(session, ROOM_OUTCOME_ABANDONED);
+            stop_session(session);
+        }
+        event_end();
+    }
+
+    // Le iscrizioni di un supervisore terminano con la sua connessione
+    if (conn != NULL && conn->state == CONN_SUPERVISOR && n_subscriptions > 0)
+        drop_subscriptions(sd);
+
+    // Libera lo stato della connessione
+    if (conn != NULL)
+        memset(conn, 0, sizeof(game_conn));
 }
 
 /*
@@ -1587,6 +4086,7 @@ void authUserDisconnected(int sd)
 static op_result sendGameState(game_session* session) 
 {
     desc_msg msg;
+    const room_view* view = &session->version->view;
 
     // Calcola il tempo rimanente per il giocatore
     time_t remaining_time = get_remaining_time(session);
@@ -1598,7 +4098,7 @@ static op_result sendGameState(game_session* session)
         #endif
         // Il tempo è scaduto, il gioco finisce
         op_result ret;
-        init_msg(&msg, MSG_GAME_END_TIMEOUT, rooms[session->room].timeout_text);
+        init_msg(&msg, MSG_GAME_END_TIMEOUT, room_str(view, view->header->timeout_text));
 
         // Invia il messaggio al client
         ret = send_to_socket(session->sd, &msg);
@@ -1607,18 +4107,19 @@ static op_result sendGameState(game_session* session)
 
         // Termina la sessione di gioco,
         // deallocando tutta la memoria ad assa associata
-        stop_session(session->sd);
+        count_outcome(session, ROOM_OUTCOME_TIMEOUT);
+        stop_session(session);
 
         return GAME_END_TIMEOUT;
     }
-    else if (session->token == rooms[session->room].token) 
+    else if (session->token == (int)view->header->token) 
     {
         #ifdef VERBOSE
             printf("↳ Il giocatore ha ottenuto tutti i token, la sessione viene terminata\n");
         #endif
         // Il giocatore ha ottenuto tutti i token della stanza, ha vinto
         op_result ret;
-        init_msg(&msg, MSG_GAME_END_WIN, rooms[session->room].win_text);
+        init_msg(&msg, MSG_GAME_END_WIN, room_str(view, view->header->win_text));
 
         // Invia il messaggio al client
         ret = send_to_socket(session->sd, &msg);
@@ -1627,7 +4128,8 @@ static op_result sendGameState(game_session* session)
 
         // Termina la sessione di gioco,
         // deallocando tutta la memoria ad assa associata
-        stop_session(session->sd);
+        count_outcome(session, ROOM_OUTCOME_WIN);
+        stop_session(session);
 
         return GAME_END_WIN;
     }
@@ -1636,56 +4138,49 @@ static op_result sendGameState(game_session* session)
 }
 
 /*
- * Invia i nomi delle stanze disponibili e il numero totale di stanze.
+ * Invia una pagina del catalogo delle stanze disponibili, o MSG_ROOM_CATALOG_NOT_MODIFIED se il client chiede la prima
+ * pagina e ha in cache la versione attuale del catalogo.
  *
  * Parametri:
  *   - sd: Descrittore del socket per la comunicazione con il client.
+ *   - version: Versione del catalogo in cache nel client, 0 se non ne ha.
+ *   - page: Numero della pagina richiesta; se non esiste viene inviata la prima.
  *
  * Restituisce:
  *   - OK se l'invio è riuscito.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso.
  *   - NET_ERR_SEND in caso di errori durante l'invio.
  * 
- * La funzione invia inizialmente il numero totale di stanze disponibili con il tipo di messaggio MSG_LIST_START.
- * Successivamente, invia i nomi delle stanze usando MSG_LIST_ITEM.
+ * Le pagine sono codificate quando il catalogo cambia, quindi ogni richiesta costa un solo messaggio già pronto.
+ * Se il catalogo cambia mentre il client legge le pagine, le pagine successive hanno una versione diversa
+ * e il client ricomincia dalla prima.
  */
-op_result sendRoomNames(int sd) 
+op_result sendRoomNames(int sd, uint32_t version, int page) 
 {
-    op_result ret;
+    uint8_t buffer[MSG_HEADER_DIM + MAX_PAYLOAD_DIM];
     desc_msg msg;
-    int i;
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di ottenere le stanze disponibili\n", sd);
+        printf("↳ Richiesta dal socket %d della pagina %d del catalogo delle stanze (versione in cache %u, attuale %u)\n",
+            sd, page, version, catalog.version);
     #endif
 
-    // Invia il numero totale di stanze disponibili
-    init_msg(&msg, MSG_LIST_START, MAX_ROOMS);
-    ret = send_to_socket(sd, &msg);
-    if (ret != OK)
-        return ret;
-
-    // Invia i nomi delle stanze disponibili
-    for (i = 0; i < MAX_ROOMS; i++) 
-    {
-        // Crea il messaggio con il nome della stanza
-        init_msg(&msg, MSG_LIST_ITEM, rooms[i].name);
-        
-        // Invia il messaggio
-        ret = send_to_socket(sd, &msg);
-        if (ret != OK)
-            return ret;
+    // Il client ha già il catalogo attuale, la risposta viene inviata con una sola chiamata come le pagine
+    if (page == 0 && version == catalog.version) {
+        init_msg(&msg, MSG_ROOM_CATALOG_NOT_MODIFIED);
+        return send_encoded(sd, buffer, encode_msg(&msg, buffer));
     }
 
-    return ret;
+    if (page < 0 || page >= catalog.n_pages)
+        page = 0;
+    return send_encoded(sd, catalog.data + catalog.offs[page], catalog.offs[page + 1] - catalog.offs[page]);
 }
 
 /*
- * Avvia la sessione di gioco per il client specificato.
+ * Avvia la sessione di gioco per l'utente autenticato sulla connessione specificata.
  *
  * Parametri:
  *   - sd: Descrittore del socket per la comunicazione con il client.
- *   - username: nome dell'utente.
  *   - room: Indice della stanza in cui far iniziare il gioco.
  *
  * Restituisce:
@@ -1693,22 +4188,38 @@ op_result sendRoomNames(int sd)
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
  *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
  *
- * La funzione verifica se l'indice della stanza è valido. Se l'indice è fuori dai limiti,
- * invia un messaggio di errore al client.
- * Successivamente, controlla se esiste già una sessione per l'username fornito e, in caso affermativo, invia un messaggio di errore.
+ * La funzione verifica che la connessione sia autenticata e che l'indice della stanza sia valido,
+ * inviando un messaggio di errore al client in caso contrario.
+ * Successivamente, controlla se esiste già una sessione per l'utente autenticato e, in caso affermativo, invia un messaggio di errore.
  * Infine, avvia la sessione e invia le informazioni necessarie al client.
  */
-op_result startGame(int sd, const char* username, int room) 
+op_result startGame(int sd, int room) 
 {
     desc_msg msg;
     op_result ret;
+    game_conn* conn = get_conn(sd);
+    game_session* session;
+    const room_view* view;
+    const char* username;
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d con nome utente \"%s\" di avviare una sessione di gioco nella stanza \"%s\"\n", sd, username, rooms[room].name);
+        printf("↳ Richiesta dal socket %d di avviare una sessione di gioco nella stanza %d\n", sd, room);
     #endif
 
+    // Verifica che la connessione sia autenticata e non già in gioco
+    if (conn == NULL || conn->state == CONN_PRE_AUTH || conn->state == CONN_SUPERVISOR) {
+        #ifdef VERBOSE
+            printf("↳ La connessione non è autenticata\n");
+        #endif
+        if (conn != NULL)
+            conn->n_errors++;
+        init_msg(&msg, MSG_AUTH_ERR_NO_AUTH);
+        return send_to_socket(sd, &msg);
+    }
+    username = conn->username;
+
     // Verifica se l'indice della stanza è valido
-    if (room < 0 || room >= MAX_ROOMS) {
+    if (room < 0 || room >= n_rooms) {
         #ifdef VERBOSE
             printf("↳ Indice della stanza non valido\n");
         #endif
@@ -1717,8 +4228,18 @@ op_result startGame(int sd, const char* username, int room)
         return send_to_socket(sd, &msg);
     }
 
+    // Una sessione senza connessione dello stesso utente viene abbandonata in favore della nuova partita
+    session = find_session_by_username(username);
+    if (session != NULL && session->sd < 0) {
+        #ifdef VERBOSE
+            printf("↳ La sessione precedente senza connessione viene terminata\n");
+        #endif
+        count_outcome(session, ROOM_OUTCOME_ABANDONED);
+        stop_session(session);
+    }
+
     // Controlla se esiste già una sessione con lo stesso username
-    if (find_session_by_username(username) != NULL) {
+    if (conn->state == CONN_IN_GAME || find_session_by_username(username) != NULL) {
         #ifdef VERBOSE
             printf("↳ Esiste già una sessione con questo username\n");
         #endif
@@ -1727,6 +4248,20 @@ op_result startGame(int sd, const char* username, int room)
         return send_to_socket(sd, &msg);
     }
 
+    // Verifica che la nuova sessione rientri nei limiti di sessioni e di memoria
+    if (!session_fits(room)) {
+        #ifdef VERBOSE
+            printf("↳ Limite di sessioni o di memoria raggiunto, la partita viene rifiutata\n");
+        #endif
+        n_rejected_games++;
+        init_msg(&msg, MSG_GAME_ERR_SERVER_FULL);
+        return send_to_socket(sd, &msg);
+    }
+
+    #ifdef VERBOSE
+        printf("↳ L'utente \"%s\" entra nella stanza \"%s\"\n", username, rooms[room].current->name);
+    #endif
+
     // Avvia la sessione di gioco
     if (!start_session(sd, username, room)) {
         #ifdef VERBOSE
@@ -1736,19 +4271,21 @@ op_result startGame(int sd, const char* username, int room)
         init_msg(&msg, MSG_GAME_ERR_INIT);
         return send_to_socket(sd, &msg);
     }
+    count_start(room);
 
     #ifdef VERBOSE
         printf("↳ Sessione avviata, invio dei dati iniziali: descrizione della stanza, dimensione zaino e numero di token\n");
     #endif
     
     // Invia le informazioni necessarie per l'inizio del gioco
-    init_msg(&msg, MSG_GAME_INIT, rooms[room].seconds, rooms[room].dim_bag, rooms[room].token);
+    view = &conn->session->version->view;
+    init_msg(&msg, MSG_GAME_INIT, (time_t)view->header->seconds, (int)view->header->dim_bag, (int)view->header->token, conn->session->resume_token);
     ret = send_to_socket(sd, &msg);
     if (ret != OK)
         return ret;
 
     // Invia la storia della room
-    init_msg(&msg, MSG_GAME_DESCR, rooms[room].story);
+    init_msg(&msg, MSG_GAME_DESCR, room_str(view, view->header->story));
     ret = send_to_socket(sd, &msg);
     if (ret != OK)
         return ret;
@@ -1756,6 +4293,75 @@ op_result startGame(int sd, const char* username, int room)
     return ret;
 }
 
+/*
+ * Riprende una sessione di gioco rimasta senza connessione, associandola alla connessione specificata.
+ *
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il client.
+ *   - resume_token: Token di ripresa ricevuto dal client all'avvio della partita.
+ *
+ * Restituisce:
+ *   - OK se la sessione è stata ripresa e le informazioni sono state inviate correttamente al client.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il client.
+ *   - NET_ERR_SEND in caso di errori nell'invio dei messaggi al client.
+ *
+ * Il token autentica la connessione come l'utente proprietario della sessione. Con un unico messaggio
+ * di risposta il client riceve tutto lo stato necessario per continuare a giocare.
+ */
+op_result resumeGame(int sd, const char* resume_token) 
+{
+    desc_msg msg;
+    game_conn* conn = get_conn(sd);
+    game_session* session;
+
+    #ifdef VERBOSE
+        printf("↳ Richiesta dal socket %d di riprendere una sessione di gioco\n", sd);
+    #endif
+
+    // Verifica che la connessione non sia già in gioco o di un supervisore
+    if (conn == NULL || conn->state == CONN_IN_GAME || conn->state == CONN_SUPERVISOR) {
+        #ifdef VERBOSE
+            printf("↳ La connessione non può riprendere una sessione\n");
+        #endif
+        if (conn != NULL)
+            conn->n_errors++;
+        init_msg(&msg, MSG_GAME_ERR_RESUME);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Cerca la sessione e controlla che non sia scaduta
+    session = find_session_by_resume_token(resume_token);
+    if (session == NULL || get_remaining_time(session) <= 0 ||
+        (conn->state == CONN_AUTH && strcmp(conn->username, session->username) != 0)) 
+    {
+        #ifdef VERBOSE
+            printf("↳ Token di ripresa non valido o sessione scaduta\n");
+        #endif
+        conn->n_errors++;
+        init_msg(&msg, MSG_GAME_ERR_RESUME);
+        return send_to_socket(sd, &msg);
+    }
+
+    // Associa la sessione alla nuova connessione
+    session->sd = sd;
+    session->detached_at = 0;
+    unpark_session(session);
+    unpause_session(session, SESSION_PAUSE_DETACHED);
+    log_time(session);
+    snprintf(conn->username, sizeof(conn->username), "%s", session->username);
+    conn->session = session;
+    conn->state = CONN_IN_GAME;
+
+    #ifdef VERBOSE
+        printf("↳ Sessione di %s ripresa sul socket %d\n", session->username, sd);
+    #endif
+
+    // Invia lo stato completo della sessione
+    init_msg(&msg, MSG_GAME_RESUMED, session->room, session->dim_bag, (int)session->version->view.header->token,
+        get_remaining_time(session), session->token, session->n_bag_objs, session->help_msg_id);
+    return send_to_socket(sd, &msg);
+}
+
 /*
  * Gestisce il comando "look" inviato dal client, restituendo la descrizione richiesta.
  *
@@ -1776,7 +4382,8 @@ op_result startGame(int sd, const char* username, int room)
  */
 op_result cmdLook(int sd, const char* what) 
 {
-    int i;
+    const room_name_slot* entry;
+    const room_view* view;
     const char* descr = NULL;
     desc_msg msg;
     op_result ret;
@@ -1800,6 +4407,7 @@ op_result cmdLook(int sd, const char* what)
     ret = sendGameState(session);
     if (ret != OK)
         return ret;
+    view = &session->version->view;
 
     // Gestisce le richieste di descrizione per la stanza, le locazioni e gli oggetti
     if (strlen(what) == 0)
@@ -1807,51 +4415,24 @@ op_result cmdLook(int sd, const char* what)
         #ifdef VERBOSE
             printf("↳ Invio descrizione della stanza\n");
         #endif
-        init_msg(&msg, MSG_GAME_DESCR, rooms[session->room].descr);
+        init_msg(&msg, MSG_GAME_DESCR, room_str(view, view->header->descr));
         return send_to_socket(sd, &msg);
     }
 
-    // Ricerca tra le locazioni e gli oggetti
-    for (i = 0; i < rooms[session->room].n_locations; i++) 
+    // Ricerca tra le locazioni e gli oggetti; se un oggetto e una locazione hanno lo stesso nome,
+    // prevale l'oggetto solo se si trova in una locazione precedente
+    entry = room_find_name(view, what);
+    if (entry != NULL && entry->location != ROOM_NO_OBJ && (entry->obj == ROOM_NO_OBJ || view->objs[entry->obj].location >= entry->location))
     {
-        int j;
-        if (strcmp(rooms[session->room].locations[i].name, what) == 0) 
-        {
-            // Locazione trovata
-            descr = rooms[session->room].locations[i].descr;
-            break;
-        }
-
-        for (j = 0; j < rooms[session->room].locations[i].n_objs; j++) 
-        {
-            if (strcmp(rooms[session->room].locations[i].objs[j].name, what) != 0)
-                continue;
-            
-            // Oggetto trovato
-            if (rooms[session->room].locations[i].objs[j].isHidden)
-            {
-                if (is_obj_hidden(session, &rooms[session->room].locations[i].objs[j])) 
-                {
-                    i = rooms[session->room].n_locations;
-                    break;
-                }
-            }
-
-            if (rooms[session->room].locations[i].objs[j].isLocked) 
-            {
-                if (is_obj_locked(session, &rooms[session->room].locations[i].objs[j]))
-                    descr = rooms[session->room].locations[i].objs[j].locked_descr;
-                else
-                    descr = rooms[session->room].locations[i].objs[j].unlocked_descr;
-            }
-            else
-                descr = rooms[session->room].locations[i].objs[j].unlocked_descr;
-
-            break;
-        }
-
-        if (descr != NULL)
-            break;
+        // Locazione trovata
+        descr = room_str(view, view->locations[entry->location].descr);
+    }
+    else if (entry != NULL && entry->obj != ROOM_NO_OBJ)
+    {
+        // Oggetto trovato, se è nascosto al giocatore è come se non esistesse
+        const room_obj_text* text = &view->obj_texts[entry->obj];
+        if (!is_obj_hidden(session, entry->obj))
+            descr = room_str(view, is_obj_locked(session, entry->obj) ? text->locked_descr : text->unlocked_descr);
     }
 
     // Invia un messaggio di errore se l'oggetto o la locazione richiesta non è presente nella stanza
@@ -1895,7 +4476,9 @@ op_result cmdObjs(int sd)
     desc_msg msg;
     op_result ret;
     game_session* session = find_session_by_sd(sd);
-    int i, sent;
+    const room_view* view;
+    uint32_t i;
+    int sent;
 
     #ifdef VERBOSE
         printf("↳ Richiesta dal socket %d di ricevere la lista di oggetti nello zaino\n", sd);
@@ -1927,13 +4510,14 @@ op_result cmdObjs(int sd)
         return ret;
 
     // Invia gli oggetti
-    for (i = 0, sent = 0; i < session->dim_bag && sent < session->n_bag_objs; i++) 
+    view = &session->version->view;
+    for (i = 0, sent = 0; i < view->header->n_objs && sent < session->n_bag_objs; i++) 
     {
-        if (session->bag_objs[i] == NULL)
+        if (!obj_set_test(session->bag, i))
             continue;
 
         // Crea il messaggio con il nome dell'oggetto
-        init_msg(&msg, MSG_LIST_ITEM, session->bag_objs[i]->name);
+        init_msg(&msg, MSG_LIST_ITEM, room_str(view, view->obj_texts[i].name));
         
         // Invia il messaggio
         ret = send_to_socket(sd, &msg);
@@ -2000,7 +4584,7 @@ op_result cmdUse(int sd, const char* obj1_name, const char* obj2_name)
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - obj: Puntatore all'oggetto che l'utente sta cercando di usare.
+ *   - obj: Id dell'oggetto che l'utente sta cercando di usare, ROOM_NO_OBJ se non trovato.
  *
  * Restituisce:
  *   - OK se l'operazione è stata eseguita con successo.
@@ -2009,16 +4593,17 @@ op_result cmdUse(int sd, const char* obj1_name, const char* obj2_name)
  *   - GAME_END_TIMEOUT se il tempo è scaduto e il gioco è terminato.
  *   - GAME_END_WIN se il giocatore ha ottenuto tutti i token della stanza e il gioco è terminato.
  */
-static op_result cmdUseAlone(game_session* session, game_obj* obj) 
+static op_result cmdUseAlone(game_session* session, uint32_t obj) 
 {
     desc_msg msg;
     op_result ret;
 
-    int i;
-    game_use* use;
+    const room_view* view = &session->version->view;
+    const room_obj* info;
+    const room_use* use;
 
     // Controlla se l'oggetto esiste
-    if (obj == NULL)
+    if (obj == ROOM_NO_OBJ)
     {
         #ifdef VERBOSE
             printf("↳ L'oggetto non esiste o non è visibile al giocatore\n");
@@ -2033,8 +4618,10 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
         return send_to_socket(session->sd, &msg);
     }
 
+    info = &view->objs[obj];
+
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di usare l'oggetto \"%s\"\n", session->sd, obj->name);
+        printf("↳ Richiesta dal socket %d di usare l'oggetto \"%s\"\n", session->sd, get_obj_name(session, obj));
     #endif
 
     // Controlla se l'oggetto è bloccato
@@ -2045,29 +4632,29 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
         if (ret != OK)
             return ret;
 
-        if (obj->lock.type == LOCK_OBJ)
+        if ((info->flags & ROOM_OBJ_LOCK_PUZZLE) == 0)
         {
             // Per sbloccare l'oggetto è necessario l'uso di un altro oggetto
             #ifdef VERBOSE
-                printf("↳ L'oggetto \"%s\" è bloccato da un altro oggetto\n", obj->name);
+                printf("↳ L'oggetto \"%s\" è bloccato da un altro oggetto\n", get_obj_name(session, obj));
             #endif
             init_msg(&msg, MSG_GAME_INF_LOCK_ACTION);
             return send_to_socket(session->sd, &msg);
         }
         
         #ifdef VERBOSE
-            printf("↳ L'oggetto \"%s\" è bloccato da un enigma, invio del testo al client\n", obj->name);
+            printf("↳ L'oggetto \"%s\" è bloccato da un enigma, invio del testo al client\n", get_obj_name(session, obj));
         #endif
         // L'oggetto è bloccato da un enigma
-        init_msg(&msg, MSG_GAME_INF_LOCK_PUZZLE, obj->lock.puzzle.text);
+        init_msg(&msg, MSG_GAME_INF_LOCK_PUZZLE, room_str(view, view->obj_texts[obj].puzzle_text));
         return send_to_socket(session->sd, &msg);
     }
 
     // Controlla se l'oggetto può essere usato
-    if (obj->n_uses == 0) 
+    if (info->n_uses == 0) 
     {
         #ifdef VERBOSE
-            printf("↳ L'oggetto \"%s\" non può essere usato in alcun modo\n", obj->name);
+            printf("↳ L'oggetto \"%s\" non può essere usato in alcun modo\n", get_obj_name(session, obj));
         #endif
         // L'oggetto non può essere usato in alcun modo
         // Invia lo stato aggiornato della sessione al client
@@ -2084,7 +4671,7 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
     if (is_obj_consumed(session, obj)) 
     {
         #ifdef VERBOSE
-            printf("↳ L'oggetto \"%s\" è consumato, pertanto non può essere riutilizzato\n", obj->name);
+            printf("↳ L'oggetto \"%s\" è consumato, pertanto non può essere riutilizzato\n", get_obj_name(session, obj));
         #endif
         // Non può essere usato
         // Invia lo stato aggiornato della sessione al client
@@ -2097,22 +4684,13 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
         return send_to_socket(session->sd, &msg);
     }
     
-    // Scorre tutti i modi d'uso
-    use = NULL;
-    for (i = 0; i < obj->n_uses; i++) 
-    {
-        if (obj->uses[i].type != USE_ALONE)
-            continue;
-
-        // Modo d'uso trovato
-        use = &obj->uses[i];
-        break;
-    }
+    // Cerca il modo d'uso da solo nella tabella degli usi
+    use = room_find_use(view, obj, ROOM_NO_OBJ);
 
     if (use == NULL)
     {
         #ifdef VERBOSE
-            printf("↳ L'oggetto \"%s\" non può essere usato da solo\n", obj->name);
+            printf("↳ L'oggetto \"%s\" non può essere usato da solo\n", get_obj_name(session, obj));
         #endif
         // L'oggetto non può essere usato da solo
         // Invia lo stato aggiornato della sessione al client
@@ -2129,9 +4707,8 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
         printf("↳ Esecuzione di tutte le azioni specificate per l'uso\n");
     #endif
 
-    // Scorre ed esegue tutte le azioni
-    for (i = 0; i < use->n_actions; i++)
-        compute_action(session, &use->actions[i]);
+    // Esegue il codice dell'uso, cascate comprese
+    run_code(session, use->first_op, use->n_ops);
 
     // Invia lo stato aggiornato della sessione al client
     ret = sendGameState(session);
@@ -2139,7 +4716,7 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
         return ret;
 
     // Invia il messaggio
-    init_msg(&msg, MSG_GAME_DESCR, use->use_descr);
+    init_msg(&msg, MSG_GAME_DESCR, room_str(view, use->descr));
     return send_to_socket(session->sd, &msg);
 }
 
@@ -2151,8 +4728,8 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
  *
  * Parametri:
  *   - session: Il puntatore alla sessione di gioco.
- *   - obj1: Puntatore al primo oggetto.
- *   - obj2: Puntatore al secondo oggetto.
+ *   - obj1: Id del primo oggetto, ROOM_NO_OBJ se non trovato.
+ *   - obj2: Id del secondo oggetto, ROOM_NO_OBJ se non trovato.
  *
  * Restituisce:
  *   - OK se l'operazione è stata eseguita con successo.
@@ -2161,17 +4738,18 @@ static op_result cmdUseAlone(game_session* session, game_obj* obj)
  *   - GAME_END_TIMEOUT se il tempo è scaduto e il gioco è terminato.
  *   - GAME_END_WIN se il giocatore ha ottenuto tutti i token della stanza e il gioco è terminato.
  */
-static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj* obj2) 
+static op_result cmdUseCombine(game_session* session, uint32_t obj1, uint32_t obj2) 
 {
     desc_msg msg;
     msg_type msg_ret_type;
     op_result ret;
 
-    int i;
-    game_use* use;
+    const room_view* view = &session->version->view;
+    const room_use* use;
+    uint32_t i;
 
     // Controlla se gli oggetti esistono
-    if (obj1 == NULL || obj2 == NULL)
+    if (obj1 == ROOM_NO_OBJ || obj2 == ROOM_NO_OBJ)
     {
         #ifdef VERBOSE
             printf("↳ Uno degli oggetti non esiste o non è visibile al giocatore\n");
@@ -2181,14 +4759,14 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
     }
 
     #ifdef VERBOSE
-        printf("↳ Richiesta dal socket %d di combinare \"%s\" con \"%s\"\n", session->sd, obj1->name, obj2->name);
+        printf("↳ Richiesta dal socket %d di combinare \"%s\" con \"%s\"\n", session->sd, get_obj_name(session, obj1), get_obj_name(session, obj2));
     #endif
 
     // Controlla se l'oggetto 1 è nello zaino del giocatore
     if (is_obj_taken(session, obj1) == false) 
     {
         #ifdef VERBOSE
-            printf("↳ L'oggetto \"%s\" non è nello zaino del giocatore, pertanto non può essere combinato\n", obj1->name);
+            printf("↳ L'oggetto \"%s\" non è nello zaino del giocatore, pertanto non può essere combinato\n", get_obj_name(session, obj1));
         #endif
         msg_ret_type = MSG_GAME_INF_OBJ_NOT_TAKEN;
         goto end;
@@ -2197,28 +4775,19 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
     // Controlla se l'oggetto 2 è stato consumato
     if (is_obj_consumed(session, obj2)) {
         #ifdef VERBOSE
-            printf("↳ L'oggetto \"%s\" è consumato, pertanto non può essere usato\n", obj2->name);
+            printf("↳ L'oggetto \"%s\" è consumato, pertanto non può essere usato\n", get_obj_name(session, obj2));
         #endif
         msg_ret_type = MSG_GAME_INF_OBJ_CONSUMED;
         goto end;
     }
 
     // Controllo se l'oggetto 1 può essere combinato con l'oggetto 2
-    use = NULL;
-    for (i = 0; i < obj1->n_uses; i++) 
-    {
-        if (obj1->uses[i].type != USE_COMBINE)
-            continue;
-        if (strcmp(obj1->uses[i].otherObj, obj2->name) != 0)
-            continue;
-        use = &obj1->uses[i];
-        break;
-    }
+    use = room_find_use(view, obj1, obj2);
 
     if (use == NULL) {
         // Non è possibile combinare l'oggetto 1 con l'oggetto 2
         #ifdef VERBOSE
-            printf("↳ La combinazione di \"%s\" con \"%s\" non è definita\n", obj1->name, obj2->name);
+            printf("↳ La combinazione di \"%s\" con \"%s\" non è definita\n", get_obj_name(session, obj1), get_obj_name(session, obj2));
         #endif
         msg_ret_type = MSG_GAME_INF_OBJ_NO_USE;
         goto end;
@@ -2228,10 +4797,10 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
     if (is_obj_locked(session, obj2)) 
     {
         // Controllo se l'oggetto 2 è bloccato da un enigma
-        if (obj2->lock.type == LOCK_PUZZLE) 
+        if (view->objs[obj2].flags & ROOM_OBJ_LOCK_PUZZLE) 
         {
             #ifdef VERBOSE
-                printf("↳ L'oggetto \"%s\" è bloccato da un enigma, pertanto non può essere combinato\n", obj2->name);
+                printf("↳ L'oggetto \"%s\" è bloccato da un enigma, pertanto non può essere combinato\n", get_obj_name(session, obj2));
             #endif
 
             // Se l'oggetto 2 è bloccato da un enigma, non è ancora possibile usarlo con l'oggetto 1
@@ -2241,7 +4810,7 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
                 return ret;
 
             // Invia al client l'enigma da risolvere
-            init_msg(&msg, MSG_GAME_INF_LOCK_PUZZLE, obj2->lock.puzzle.text);
+            init_msg(&msg, MSG_GAME_INF_LOCK_PUZZLE, room_str(view, view->obj_texts[obj2].puzzle_text));
             return send_to_socket(session->sd, &msg);
         }
         
@@ -2250,9 +4819,9 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
         bool found = false;
         for (i = 0; i < use->n_actions; i++) 
         {
-            if (use->actions[i].type != ACTION_UNLOCK)
+            if (view->actions[use->first_action + i].type != ACTION_UNLOCK)
                 continue;
-            if (strcmp(use->actions[i].obj_name, obj2->name) != 0)
+            if (view->actions[use->first_action + i].obj != obj2)
                 continue;
             // Azione trovata. L'oggetto 2 viene sbloccato dall'oggetto 1
             found = true;
@@ -2261,7 +4830,7 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
 
         if (found == false) {
             #ifdef VERBOSE
-                printf("↳ L'oggetto \"%s\" è bloccato da un altro oggetto e l'uso con \"%s\" non lo sblocca\n", obj2->name, obj1->name);
+                printf("↳ L'oggetto \"%s\" è bloccato da un altro oggetto e l'uso con \"%s\" non lo sblocca\n", get_obj_name(session, obj2), get_obj_name(session, obj1));
             #endif
             // Azione non trovata. L'uso combinato dell'oggetto 1 con l'oggetto 2, non sblocca l'oggetto 2.
             // Pertanto, non è ancora possibile usarli insieme
@@ -2274,9 +4843,8 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
         printf("↳ Esecuzione di tutte le azioni specificate per l'uso\n");
     #endif
 
-    // Scorre ed esegue tutte le azioni
-    for (i = 0; i < use->n_actions; i++)
-        compute_action(session, &use->actions[i]);
+    // Esegue il codice dell'uso, cascate comprese
+    run_code(session, use->first_op, use->n_ops);
 
     // Invia lo stato aggiornato della sessione al client
     ret = sendGameState(session);
@@ -2284,7 +4852,7 @@ static op_result cmdUseCombine(game_session* session, game_obj* obj1, game_obj*
         return ret;
 
     // Invia il messaggio
-    init_msg(&msg, MSG_GAME_DESCR, use->use_descr);
+    init_msg(&msg, MSG_GAME_DESCR, room_str(view, use->descr));
     return send_to_socket(session->sd, &msg);
 
 end:
@@ -2321,7 +4889,8 @@ op_result cmdTake(int sd, const char* obj_name)
     msg_type msg_ret_type;
     op_result ret;
     game_session* session = find_session_by_sd(sd);
-    game_obj* obj = find_obj(session, obj_name, true);
+    uint32_t obj = find_obj(session, obj_name, true);
+    const room_view* view;
 
     #ifdef VERBOSE
         printf("↳ Richiesta dal socket %d di raccogliere l'oggetto \"%s\"\n", sd, obj_name);
@@ -2338,7 +4907,7 @@ op_result cmdTake(int sd, const char* obj_name)
     }
 
     // Controlla se l'oggetto esiste
-    if (obj == NULL) {
+    if (obj == ROOM_NO_OBJ) {
         #ifdef VERBOSE
             printf("↳ L'oggetto \"%s\" non esiste o non è visibile al giocatore\n", obj_name);
         #endif
@@ -2347,7 +4916,8 @@ op_result cmdTake(int sd, const char* obj_name)
     }
 
     // Controlla se l'oggetto può essere raccolto
-    if (obj->takeable == false) {
+    view = &session->version->view;
+    if ((view->objs[obj].flags & ROOM_OBJ_TAKEABLE) == 0) {
         #ifdef VERBOSE
             printf("↳ L'oggetto \"%s\" non può essere raccolto\n", obj_name);
         #endif
@@ -2386,7 +4956,7 @@ op_result cmdTake(int sd, const char* obj_name)
     // Controlla se l'oggetto è bloccato
     if (is_obj_locked(session, obj))
     {
-        if (obj->lock.type == LOCK_OBJ)
+        if ((view->objs[obj].flags & ROOM_OBJ_LOCK_PUZZLE) == 0)
         {
             // Per sbloccare l'oggetto è necessario l'uso di un altro oggetto
             #ifdef VERBOSE
@@ -2406,7 +4976,7 @@ op_result cmdTake(int sd, const char* obj_name)
             return ret;
         
         // Invia al client l'enigma da risolvere
-        init_msg(&msg, MSG_GAME_INF_LOCK_PUZZLE, obj->lock.puzzle.text);
+        init_msg(&msg, MSG_GAME_INF_LOCK_PUZZLE, room_str(view, view->obj_texts[obj].puzzle_text));
         return send_to_socket(session->sd, &msg);
     }
 
@@ -2451,7 +5021,7 @@ op_result cmdDrop(int sd, const char* obj_name)
     msg_type msg_ret_type;
     op_result ret;
     game_session* session = find_session_by_sd(sd);
-    game_obj* obj = find_obj(session, obj_name, true);
+    uint32_t obj = find_obj(session, obj_name, true);
     
     #ifdef VERBOSE
         printf("↳ Richiesta dal socket %d di rilasciare l'oggetto \"%s\"\n", sd, obj_name);
@@ -2468,7 +5038,7 @@ op_result cmdDrop(int sd, const char* obj_name)
     }
 
     // Controlla se l'oggetto esiste
-    if (obj == NULL) {
+    if (obj == ROOM_NO_OBJ) {
         #ifdef VERBOSE
             printf("↳ L'oggetto \"%s\" non esiste o non è visibile al giocatore\n", obj_name);
         #endif
@@ -2603,11 +5173,12 @@ op_result cmdEnd(int sd)
     }
 
     // Inizializza il messaggio di fine partita
-    init_msg(&msg, MSG_GAME_END_QUIT, rooms[session->room].quit_text);
+    init_msg(&msg, MSG_GAME_END_QUIT, room_str(&session->version->view, session->version->view.header->quit_text));
 
     // Termina la sessione di gioco,
     // deallocando tutta la memoria ad assa associata
-    stop_session(session->sd);
+    count_outcome(session, ROOM_OUTCOME_QUIT);
+    stop_session(session);
 
     #ifdef VERBOSE
         printf("↳ Sessione terminata\n");
@@ -2644,7 +5215,8 @@ op_result checkPuzzleSolution(int sd, const char* obj_name, const char* solution
     op_result ret;
     msg_type msg_res_type;
     game_session* session = find_session_by_sd(sd);
-    game_obj* obj;
+    const room_view* view;
+    uint32_t obj;
 
     #ifdef VERBOSE
         printf("↳ Controllo soluzione enigma per l'oggetto %s\n", obj_name);
@@ -2662,7 +5234,7 @@ op_result checkPuzzleSolution(int sd, const char* obj_name, const char* solution
 
     // Controlla se l'oggetto esiste
     obj = find_obj(session, obj_name, true);
-    if (obj == NULL)
+    if (obj == ROOM_NO_OBJ)
     {
         #ifdef VERBOSE
             printf("↳ L'oggetto \"%s\" non esiste o non è visibile al giocatore\n", obj_name);
@@ -2672,7 +5244,8 @@ op_result checkPuzzleSolution(int sd, const char* obj_name, const char* solution
     }
 
     // Controlla se l'oggetto è bloccato da un enigma
-    if (is_obj_locked(session, obj) == false || obj->lock.type != LOCK_PUZZLE) 
+    view = &session->version->view;
+    if (is_obj_locked(session, obj) == false || (view->objs[obj].flags & ROOM_OBJ_LOCK_PUZZLE) == 0) 
     {
         #ifdef VERBOSE
             printf("↳ L'oggetto \"%s\" non è bloccato da un enigma\n", obj_name);
@@ -2682,13 +5255,14 @@ op_result checkPuzzleSolution(int sd, const char* obj_name, const char* solution
     }
 
     // Controlla se la risposta è giusta
-    if (strcmp(obj->lock.puzzle.solution, solution) == 0) 
+    if (strcmp(room_str(view, view->obj_texts[obj].puzzle_solution), solution) == 0) 
     {
         #ifdef VERBOSE
             printf("↳ Risposta corretta, sblocco di %s\n", obj_name);
         #endif
         // Risposta corretta, sblocca l'oggetto
-        unlock_obj(session, obj_name);
+        count_puzzle(session, obj, true);
+        run_code(session, view->objs[obj].first_unlock_op, view->objs[obj].n_unlock_ops);
 
         // Invia il messaggio di successo
         msg_res_type = MSG_SUCCESS;
@@ -2699,6 +5273,7 @@ op_result checkPuzzleSolution(int sd, const char* obj_name, const char* solution
         printf("↳ Risposta sbagliata\n");
     #endif
     // La risposta è sbagliata
+    count_puzzle(session, obj, false);
     msg_res_type = MSG_GAME_PUZZLE_WRONG;
 
 end:
@@ -1,159 +1,337 @@
 #ifndef GAME_SERVER
 #define GAME_SERVER
 
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
 #include "shared.h"
+#include "room.h"
+#include "roomfile.h"
+#include "checkpoint.h"
+#include "events.h"
 
 #define VERBOSE                                     // Attiva la modalità verbose
 #define BACKLOG             10                      // Dimensione della coda di richieste di connessione
-#define MAX_ROOMS           1                       // Numero di stanze disponibili
-
-typedef enum                                        // Enumeratore che definisce i tipi di blocchi su un oggetto
+#define MAX_ROOMS           4096                    // Numero massimo di stanze caricate
+#define CATALOG_HEADER_DIM  64                      // Byte riservati all'intestazione di una pagina del catalogo delle stanze
+#define ROOMS_DIR           "rooms"                 // Cartella dei file di definizione delle stanze
+#define ROOMS_PACK          "rooms.pack"            // Pacchetto compilato da roomc, preferito alla cartella se esiste
+#define ROOM_RECLAIM_BUDGET_US 200                  // Tempo massimo per iterazione speso a liberare le versioni di room non più usate
+#define ROOM_BODY_BUDGET_BYTES ((size_t)64 << 20) // Immagini caricate oltre le quali quelle senza partite vengono rimosse, dalla meno recente
+#define MAX_CONNS           FD_SETSIZE              // Numero massimo di connessioni, indicizzate per descrittore
+#define MAX_CONN_ERRORS     16                      // Richieste rifiutate dopo le quali la connessione viene chiusa
+#define SESSION_GRACE_SECONDS 60                    // Secondi per cui una sessione senza connessione resta in attesa di essere ripresa
+#define MAX_SUBSCRIPTIONS   64                      // Iscrizioni dei supervisori agli aggiornamenti delle sessioni
+#define SUBSCRIPTION_TICK_MS 250                    // Intervallo minimo tra due invii di aggiornamenti, i cambiamenti nel mezzo vengono accorpati
+#define SUBSCRIPTION_BUFFER_DIM (64 * 1024)         // Buffer in cui vengono accorpati i messaggi per un supervisore
+#define SESSION_INDEX_MIN_BUCKETS 64                // Dimensione iniziale degli indici delle sessioni per username e per token
+#define SESSION_SLAB_DIM    32                      // Sessioni allocate insieme quando il pool di una room è vuoto
+#define MAX_SESSIONS        100000                  // Sessioni oltre le quali le nuove partite vengono rifiutate, se non impostate all'avvio
+#define MAX_MEMORY_BYTES    ((size_t)256 << 20)     // Memoria allocata dal server oltre la quale le nuove partite vengono rifiutate, se non impostata all'avvio
+#define ROOM_STATS_FILE     "room_stats.bin"        // File in cui vengono salvate le statistiche delle room
+#define ROOM_STATS_FLUSH_SECONDS 60                 // Intervallo minimo tra due salvataggi delle statistiche modificate
+#define ROOM_STATS_BUCKETS  240                     // Intervalli dell'istogramma dei tempi di vittoria, fino a 2^32 secondi
+#define ROOM_STATS_PUZZLES  8                       // Enigmi più sbagliati tenuti per ogni room
+#define ROOM_STATS_MAGIC    0x54534d52              // "RMST" in little endian
+#define ROOM_STATS_VERSION  1
+
+#define SESSION_PAUSE_DETACHED   1                  // Il tempo di gioco è fermo perché la sessione è senza connessione
+#define SESSION_PAUSE_SUPERVISOR 2                  // Il tempo di gioco è stato fermato da un supervisore
+
+typedef enum                                        // Sottosistemi a cui viene attribuita la memoria allocata
 {
-    LOCK_OBJ,                                       // Indica se per sbloccare l'oggetto è necessario l'uso di un altro oggetto
-    LOCK_PUZZLE                                     // Indica se per sbloccare l'oggetto è necessario risolvere un enigma
+    MEM_ROOMS,                                      // Immagini compilate delle room
+    MEM_SESSIONS,                                   // Blocchi di sessioni dei pool, con gli insiemi di oggetti
+    MEM_INDEX,                                      // Indici delle sessioni per username e per token di ripresa
+    MEM_EVENTS,                                     // Copie dello stato delle sessioni per il registro degli eventi
+    MEM_TAGS
 }
-game_lock_type;
+mem_tag;
 
-typedef enum                                        // Enumeratore che definisce i tipi di azioni
+typedef struct                                      // Memoria attribuita a un sottosistema
 {
-    ACTION_REVEAL,                                  // Azione che permette di rendere visibile un'oggetto nascosto
-    ACTION_UNLOCK,                                  // Azione che permette di sbloccare un'oggetto bloccato
-    ACTION_CONSUME,                                 // Azione che consuma un oggetto
-    ACTION_TOKEN                                    // Azione che assegna un token al giocatore
+    size_t bytes;                                   // Byte allocati
+    size_t peak;                                    // Massimo di bytes dall'avvio
+    unsigned long n_allocs;                         // Allocazioni ancora attive
 }
-game_action_type;
+mem_counter;
 
-typedef enum                                        // Enumeratore che definisce i tipo di usi possibli
+typedef struct                                      // Pool di sessioni di una room, tutte della stessa dimensione
 {
-    USE_ALONE,                                      // L'oggetto può essere usato da solo
-    USE_COMBINE                                     // L'oggetto può essere combinato con un altro oggetto
+    size_t block_size;                              // Dimensione di una sessione, bit degli oggetti inclusi
+    struct game_session* free_list;                 // Sessioni libere, collegate tramite il campo next
+    void* slabs;                                    // Blocchi allocati, collegati tramite la loro prima parola
+    int n_free;                                     // Sessioni libere
+    int n_slabs;                                    // Blocchi allocati
 }
-game_use_type;
+session_pool;
 
-typedef struct                                      // Struttura che definisce un'azione da eseguire su un oggetto
+typedef struct                                      // Pacchetto di room mappato in memoria
 {
-    game_action_type type;                          // Tipo di azione da eseguire
-    char obj_name[MAX_NAME_DIM];                    // Nome dell'oggetto target (se richiesto)
+    void* base;
+    size_t size;
+    int refs;                                       // Versioni di room con l'immagine nel pacchetto
 }
-game_action;
+room_mapping;
 
-typedef struct                                      // Struttura che definisce un enigma
+typedef struct room_version                         // Versione caricata di una room, condivisa dalle partite avviate con essa
 {
-    char text[MAX_PUZZLE_DIM];                      // Contiene il testo dell'enigma
-    char solution[MAX_PUZZLE_SOL_DIM];              // Contiene la risposta corretta all'enigma
+    // Metadati, sempre in memoria
+    char name[MAX_ROOM_NAME_DIM];                   // Nome della room
+    uint32_t n_objs;                                // Numero di oggetti, per verificare le sessioni salvate
+    uint64_t image_hash;                            // room_image_hash dell'immagine, per riconoscere le room invariate
+    size_t image_size;
+    room_mapping* mapping;                          // Pacchetto che contiene l'immagine, NULL se l'immagine va compilata
+    char* path;                                     // File di definizione da compilare, significativo se mapping = NULL
+
+    // Corpo, caricato alla prima partita e rimosso quando non ha partite e le immagini superano il budget
+    const void* image;                              // Immagine compilata, nel pacchetto o allocata; NULL se allocata e non caricata
+    bool loaded;                                    // view e pool sono utilizzabili
+    bool idle;                                      // Corpo caricato della versione corrente senza partite, nella lista LRU
+    room_view view;                                 // Vista sull'immagine
+    session_pool pool;                              // Sessioni libere per questa versione
+    struct room_version* lru_prev;                  // Corpo senza partite usato meno di recente
+    struct room_version* lru_next;                  // Corpo senza partite usato più di recente
+
+    int refs;                                       // Sessioni che la usano, più uno finché è la versione corrente
+    int number;                                     // Numero della versione, 1 per quella caricata all'avvio
+    struct room_version* next_retired;              // Versione successiva tra quelle in attesa di essere liberate
 }
-game_puzzle;
+room_version;
 
-typedef struct                                      // Struttura che definisce un lock su un oggetto
+typedef enum                                        // Modi in cui termina una partita
 {
-    game_lock_type type;                            // Specifica il tipo di blocco
-    int n_actions;                                  // Numero di azioni
-    game_action* actions;                           // Array di azioni da eseguire una volta sbloccato l'oggetto
-    
-    game_puzzle puzzle;                             // Specifica l'enigma da risolvere, significativo quando type = LOCK_PUZZLE
+    ROOM_OUTCOME_WIN,                               // Il giocatore ha ottenuto tutti i token
+    ROOM_OUTCOME_TIMEOUT,                           // Il tempo è scaduto
+    ROOM_OUTCOME_QUIT,                              // Il giocatore ha abbandonato con il comando end
+    ROOM_OUTCOME_ABANDONED,                         // La connessione è stata persa e la partita non è stata ripresa
+    ROOM_OUTCOMES
 }
-game_lock;
+room_outcome;
 
-typedef struct                                      // Struttura che definisce un modo d'uso di un oggetto
+typedef struct                                      // Enigma tra i più sbagliati di una room
 {
-    game_use_type type;                             // Specifia il tipo di uso
-    char otherObj[MAX_NAME_DIM];                    // Specifica il nome dell'oggetto con il quale è possibile combinarlo, significativo solo se type = USE_COMBINE
-
-    int n_actions;                                  // Numero di azioni
-    game_action* actions;                           // Array di azioni
-
-    char use_descr[MAX_DESCR_DIM];                  // Messaggio dopo aver usato l'oggetto
+    char name[MAX_NAME_DIM];                        // Nome dell'oggetto, stringa vuota se il posto è libero
+    uint32_t failures;                              // Risposte sbagliate, stimate per eccesso di al più error
+    uint32_t error;                                 // Risposte sbagliate attribuite all'enigma che occupava il posto
+    uint32_t solved;                                // Risposte giuste da quando l'enigma è nella tabella
 }
-game_use;
+room_puzzle_stats;
 
-typedef struct                                      // Struttura che definisce un oggetto di gioco
+typedef struct                                      // Statistiche di gioco di una room, aggiornate in tempo costante
 {
-    char name[MAX_NAME_DIM];                        // Nome dell'oggetto
-
-    bool isLocked;                                  // Specifica se l'oggetto è bloccato o meno
-    game_lock lock;                                 // Indica come sbloccare l'oggetto, significativo solo se isLocked = true
+    uint32_t n_started;                             // Partite avviate
+    uint32_t outcomes[ROOM_OUTCOMES];               // Partite terminate, per modo
+    uint32_t win_times[ROOM_STATS_BUCKETS];         // Istogramma logaritmico dei secondi di gioco delle vittorie
+    room_puzzle_stats puzzles[ROOM_STATS_PUZZLES];  // Enigmi più sbagliati, tenuti con l'algoritmo Space-Saving
+}
+room_stats;
 
-    bool isHidden;                                  // Specifica se l'oggetto è visibile o meno 
-    bool takeable;                                  // Indica se è possibile raccogliere l'oggetto
-    bool consumable;                                // Indica che l'oggetto non può essere riottenuto dopo averlo usato, significativo solo se takeable = true
+typedef struct                                      // Intestazione del file delle statistiche
+{
+    uint32_t magic;                                 // ROOM_STATS_MAGIC
+    uint32_t version;                               // ROOM_STATS_VERSION
+    uint32_t n_records;                             // Record room_stats_record che seguono
+    uint32_t record_size;                           // sizeof(room_stats_record) di chi ha scritto il file
+}
+room_stats_header;
 
-    int n_uses;                                     // Numero di usi possibili
-    game_use* uses;                                 // Array di modi d'uso
+typedef struct                                      // Statistiche di una room nel file, associate per nome
+{
+    char name[MAX_ROOM_NAME_DIM];
+    room_stats stats;
+}
+room_stats_record;
 
-    char locked_descr[MAX_DESCR_DIM];               // Descrizione dell'oggetto quando è bloccato
-    char unlocked_descr[MAX_DESCR_DIM];             // Descrizione dell'oggetto quando è sbloccato
+typedef struct                                      // Struttura che definisce una room caricata
+{
+    room_version* current;                          // Versione usata dalle nuove partite
+    room_stats stats;                               // Statistiche di tutte le versioni
 }
-game_obj;
+game_room;
 
-typedef struct                                      // Struttura che definisce una location della room
+typedef struct                                      // Statistiche del caricamento dei corpi delle room
 {
-    char name[MAX_NAME_DIM];                        // Nome della location
-    char descr[MAX_DESCR_DIM];                      // Descrizione della location
+    size_t bytes;                                   // Byte delle immagini caricate
+    int n_loaded;                                   // Corpi caricati, con o senza partite
+    int n_idle;                                     // Corpi caricati senza partite, nella lista LRU
+    unsigned long n_hits;                           // Partite avviate con il corpo già caricato
+    unsigned long n_loads;                          // Partite che hanno caricato il corpo
+    unsigned long n_failed;                         // Caricamenti non riusciti
+    unsigned long n_evictions;                      // Corpi rimossi per rientrare nel budget
+    uint64_t load_ns;                               // Durata totale dei caricamenti
+    uint64_t max_load_ns;                           // Durata del caricamento più lento
+}
+room_body_stats;
 
-    int n_objs;                                     // Numero di oggetti nella location
-    game_obj* objs;                                 // Oggetti nella location
+typedef struct                                      // Catalogo dei nomi delle room, diviso in pagine già codificate
+{
+    uint32_t version;                               // Versione, cambia quando vengono aggiunte room
+    uint8_t* data;                                  // Messaggi MSG_ROOM_CATALOG_PAGE codificati, uno per pagina
+    size_t size;                                    // Byte usati di data, che ne ha uno spazio massimo per pagina
+    size_t* offs;                                   // Inizio di ogni pagina in data, seguito dalla fine dell'ultima
+    int n_pages;
 }
-game_location;
+room_catalog;
 
-typedef struct                                      // Struttura che definisce una room
+typedef struct                                      // Indice delle room per nome, costruito da index_room_names
 {
-    char name[MAX_ROOM_NAME_DIM];                   // Nome della room
-    char story[MAX_DESCR_DIM];                      // Storia del gioco
-    char descr[MAX_DESCR_DIM];                      // Descrizione della room
+    int* slots;                                     // Indici delle room aumentati di uno, NULL se non costruito
+    uint32_t mask;
+}
+room_name_index;
 
-    char timeout_text[MAX_DESCR_DIM];               // Messaggio da mostrare al giocatore quando scade il tempo massimo
-    char quit_text[MAX_DESCR_DIM];                  // Messaggio da mostrare al giocatore quando abbandona la partita
-    char win_text[MAX_DESCR_DIM];                   // Messaggio da mostrare al giocatore quando ottiene tutti i token
+typedef struct                                      // Room lette da un caricamento, in attesa di essere pubblicate
+{
+    const char* pack_path;                          // Pacchetto da mappare, se esiste
+    const char* dir;                                // Cartella dei file di definizione, se il pacchetto non esiste
+    room_version** versions;                        // Versioni nuove o modificate
+    int* slots;                                     // Room sostituita da ogni versione, da n_rooms in poi per le nuove
+    int n_versions;
+    int n_loaded;                                   // Room lette, comprese quelle invariate
+    int n_added;                                    // Room nuove tra le versioni
+    room_mapping* mapping;                          // Pacchetto mappato, NULL se le room sono state compilate
+    bool ok;
+    char error[ROOM_ERROR_DIM];                     // Motivo dell'errore, significativo se ok = false
+}
+room_load;
 
-    int dim_bag;                                    // Dimensione dello zaino del giocatore
-    int token;                                      // Numero di token necessari per vincere
-    time_t seconds;                                 // Tempo in secondi che il giocatore ha a disposizione
-    
-    int n_locations;                                // Numero di locazioni della room
-    game_location* locations;                       // Locations della room
+typedef enum                                        // Stato del ricaricamento delle room
+{
+    ROOM_RELOAD_IDLE,                               // Nessun ricaricamento in corso
+    ROOM_RELOAD_RUNNING,                            // Caricamento in corso in background
+    ROOM_RELOAD_DONE,                               // Nuove versioni pubblicate
+    ROOM_RELOAD_FAILED                              // Caricamento non riuscito, le room restano invariate
 }
-game_room;
+room_reload_state;
 
 typedef struct game_session                         // Struttura che definisce una sessione di gioco
 {
-    int sd;                                         // Socket di comunicazione dell'utente
+    int sd;                                         // Socket di comunicazione dell'utente, -1 se la sessione è senza connessione
     char username[MAX_USR_DIM];                     // Username dell'utente
     int room;                                       // Room nella quale l'utente sta giocando
+    room_version* version;                          // Versione della room con cui è iniziata la partita
+
+    char resume_token[RESUME_TOKEN_DIM];            // Token opaco con il quale il client può riprendere la sessione dopo una disconnessione
+    int64_t detached_at;                            // Istante della disconnessione in ms sull'orologio del gioco, significativo solo se sd = -1
+    int64_t expires_at;                             // Istante in ms in cui la sessione senza connessione viene terminata, significativo solo se sd = -1
 
     int help_msg_id;                                // Numero dell'ultimo messaggio di aiuto inviato
     char help_msg[MAX_HELP_DIM];                    // Messaggio di aiuto inviato dal supervisore
 
-    int n_special_objects;                          // Numero di oggetti bloccati, nascosti e consumabili all'interno della stanza
-    time_t start_time;                              // Timestamp di quando l'utente ha iniziato a giocare, usato per calcolare il tempo rimanente
-    time_t seconds;                                 // Tempo in secondi che il giocatore ha a disposizione
+    int64_t deadline;                               // Istante in ms sull'orologio del gioco in cui il tempo scade, significativo se paused = 0
+    int64_t remaining;                              // Millisecondi rimanenti, significativo se paused != 0
+    int paused;                                     // Motivi per cui il tempo è fermo (SESSION_PAUSE_*), 0 se il tempo scorre
     int token;                                      // Numero di token che il giocatore possiede
 
     int dim_bag;                                    // Dimensione dello zaino
     int n_bag_objs;                                 // Numero di oggetti nello zaino
-    game_obj** bag_objs;                            // Oggetti che il giocatore ha nello zaino
 
-    int n_locked_objs;                              // Numero di oggetti bloccati all'interno della stanza
-    game_obj** unlocked_objs;                       // Oggetti che il giocatore ha sbloccato
+    struct game_session* next;
+    struct game_session* prev;                      // Sessione precedente nella lista, per la rimozione in tempo costante
+    struct game_session* next_by_username;          // Sessione successiva nello stesso bucket dell'indice per username
+    struct game_session* next_by_token;             // Sessione successiva nello stesso bucket dell'indice per token di ripresa
+    struct game_session* next_parked;               // Sessioni senza connessione, in ordine di expires_at
+    struct game_session* prev_parked;
+
+    // Stato degli oggetti, un bit per oggetto indicizzato per id (n_obj_words parole per insieme)
+    uint64_t* locked;                               // Oggetti ancora bloccati
+    uint64_t* hidden;                               // Oggetti ancora nascosti
+    uint64_t* consumed;                             // Oggetti consumati
+    uint64_t* bag;                                  // Oggetti nello zaino
+    uint64_t obj_state[];                           // Spazio dei quattro insiemi, in coda alla sessione
+}
+game_session;
 
-    int n_hidden_objs;                              // Numero di oggetti nascosti all'interno della stanza
-    game_obj** revealed_objs;                       // Oggetti in origine nascosti ma che ora il giocatore può vedere
+typedef struct                                      // Iscrizione di un supervisore agli aggiornamenti della sessione di un giocatore
+{
+    bool active;                                    // Il posto è occupato
+    int sd;                                         // Socket del supervisore
+    char username[MAX_USR_DIM];                     // Giocatore osservato
+    game_session* session;                          // Sessione descritta dall'ultimo invio, NULL se non ce n'è una
+    bool ended;                                     // La sessione è terminata e il supervisore non lo sa ancora
+
+    // Stato inviato con l'ultimo aggiornamento
+    time_t remaining_time;
+    int paused;
+    int token;
+    int n_bag_objs;
+    int help_msg_id;
+    uint8_t* obj_flags;                             // Stato di ogni oggetto (SU_OBJ_*)
+    uint32_t n_objs;
+}
+su_subscription;
 
-    int n_consumable_objs;                          // Numero di oggetti consumabili all'interno della stanza
-    game_obj** consumed_objs;                       // Oggetti che il giocatore ha "consumato"
+typedef enum                                        // Enumeratore che definisce gli stati di una connessione
+{
+    CONN_CLOSED,                                    // Nessuna connessione sul descrittore
+    CONN_PRE_AUTH,                                  // Connessione aperta, utente non ancora autenticato
+    CONN_AUTH,                                      // Utente autenticato, non in gioco
+    CONN_IN_GAME,                                   // Utente autenticato con una sessione di gioco attiva
+    CONN_SUPERVISOR                                 // Connessione di un supervisore
+}
+game_conn_state;
 
-    struct game_session* next;
+typedef struct                                      // Struttura che definisce lo stato di una connessione
+{
+    game_conn_state state;                          // Stato della connessione
+    char username[MAX_USR_DIM];                     // Username dell'utente autenticato, significativo da CONN_AUTH in poi
+    game_session* session;                          // Sessione di gioco associata, significativa solo se state = CONN_IN_GAME
+
+    desc_msg msg;                                   // Buffer per il messaggio in ricezione
+    time_t connected_at;                            // Timestamp di apertura della connessione
+    time_t last_activity;                           // Timestamp dell'ultimo messaggio ricevuto
+    unsigned long n_requests;                       // Numero di richieste ricevute
+    unsigned long n_errors;                         // Numero di richieste rifiutate per stato non valido o token errato
 }
-game_session;
+game_conn;
 
+bool initRooms(const char* pack_path, const char* dir, char* error, size_t error_dim);
+bool reloadRooms(const char* pack_path, const char* dir);
+room_reload_state pollRoomReload(char* msg, size_t msg_dim);
 bool activeUsers();
 
-op_result authUserSuccess(int sd);
+void authUserConnected(int sd);
+op_result authUserSuccess(int sd, const char* username);
 op_result authUserFailed(int sd);
 op_result authUsernameExists(int sd);
+op_result authSupervisor(int sd);
 void authUserDisconnected(int sd);
+desc_msg* connMsgBuffer(int sd);
+bool connTooManyErrors(int sd);
+
+void setSessionGracePeriod(int seconds);
+void setRoomBodyBudget(size_t bytes);
+void setMaxSessions(int sessions);
+void setMaxMemory(size_t bytes);
+void expireSessions();
+
+bool restoreSessions();
+void checkpointSessions();
+void closeCheckpoint();
+
+bool initRoomStats(const char* path);
+void flushRoomStats();
+void closeRoomStats();
+
+bool initEvents(const char* path);
+void closeEvents();
+bool dumpEvents(const char* path);
+void beginEvent(int sd, const desc_msg* msg);
+void endEvent();
+void sessionEventState(const char* username, game_event_state* state);
+
+void tickGameClock();
+void setVirtualClock(int64_t now);
 
-op_result sendRoomNames(int sd);
-op_result startGame(int sd, const char* username, int room);
+op_result sendRoomNames(int sd, uint32_t version, int page);
+op_result startGame(int sd, int room);
+op_result resumeGame(int sd, const char* resume_token);
 
 op_result cmdLook(int sd, const char* what);
 op_result cmdObjs(int sd);
@@ -166,10 +344,15 @@ op_result cmdEnd(int sd);
 op_result checkPuzzleSolution(int sd, const char* obj_name, const char* solution);
 
 op_result sendActiveUsers(int sd);
+op_result sendMemoryStats(int sd);
+op_result sendRoomStats(int sd);
 op_result sendUserSessionData(int sd, const char* username);
 op_result sendUserSessionObjs(int sd, const char* username);
 op_result sendUserSessionBag(int sd, const char* username);
 op_result alterSessionTime(int sd, const char* username, const char opt, int seconds);
 op_result setUserSessionHelp(int sd, const char* username, const char* help_msg);
+op_result subscribeSession(int sd, const char* username);
+op_result unsubscribeSession(int sd, const char* username);
+bool pushSubscriptions();
 
 #endif
\ No newline at end of file
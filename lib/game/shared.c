@@ -18,14 +18,15 @@ void init_msg(desc_msg* msg, msg_type type, ...)
 
     switch (type)
     {
-        case MSG_REQ_START_GAME:
+        case MSG_REQ_ROOM_NAMES:
         {
-            const char* username = va_arg(argList, const char*);
-            int room = va_arg(argList, int);
+            unsigned int version = va_arg(argList, unsigned int);
+            int page = va_arg(argList, int);
 
-            sprintf(msg->payload, "%s %d", username, room);
+            sprintf(msg->payload, "%u %d", version, page);
             break;
         }
+        case MSG_REQ_START_GAME:
         case MSG_GAME_CMD_HELP:
         case MSG_LIST_START: 
         {
@@ -41,6 +42,10 @@ void init_msg(desc_msg* msg, msg_type type, ...)
             sprintf(msg->payload, "%s %d %c", username, seconds, opt);
             break;
         }
+        case MSG_REQ_RESUME_GAME:
+        case MSG_SU_REQ_SUBSCRIBE:
+        case MSG_SU_REQ_UNSUBSCRIBE:
+        case MSG_SU_SESSION_ENDED:
         case MSG_SU_REQ_USER_SESSION_DATA:
         case MSG_SU_REQ_USER_SESSION_OBJS:
         case MSG_SU_REQ_USER_SESSION_BAG:
@@ -82,8 +87,21 @@ void init_msg(desc_msg* msg, msg_type type, ...)
         {
             time_t room_seconds = va_arg(argList, time_t);
             int bag_size = va_arg(argList, int), room_token = va_arg(argList, int);
+            const char* resume_token = va_arg(argList, const char*);
 
-            sprintf(msg->payload, "%lld %d %d", (long long)room_seconds, bag_size, room_token);
+            sprintf(msg->payload, "%lld %d %d %s", (long long)room_seconds, bag_size, room_token, resume_token);
+            break;
+        }
+        case MSG_GAME_RESUMED:
+        {
+            int room = va_arg(argList, int);
+            int bag_size = va_arg(argList, int), room_token = va_arg(argList, int);
+            time_t remaining_time = va_arg(argList, time_t);
+            int user_token = va_arg(argList, int);
+            int objs_in_bag = va_arg(argList, int);
+            int help_msg_id = va_arg(argList, int);
+
+            sprintf(msg->payload, "%d %d %d %lld %d %d %d", room, bag_size, room_token, (long long)remaining_time, user_token, objs_in_bag, help_msg_id);
             break;
         }
         case MSG_GAME_STATE:
@@ -170,6 +188,60 @@ err:
     return NET_ERR_SEND;
 }
 
+/*
+ * Codifica un messaggio nel formato in cui viene inviato sul socket, per inviarlo più volte con send_encoded.
+ *
+ * Parametri:
+ *   - msg: Puntatore al descrittore del messaggio da codificare.
+ *   - buffer: Buffer di almeno MSG_HEADER_DIM + MAX_PAYLOAD_DIM byte.
+ * 
+ * Restituisce:
+ *   - Il numero di byte scritti nel buffer.
+ */
+size_t encode_msg(const desc_msg* msg, uint8_t* buffer)
+{
+    size_t len = strnlen(msg->payload, MAX_PAYLOAD_DIM - 1);
+    uint16_t net_len = htons(len);
+
+    buffer[0] = msg->type;
+    memcpy(buffer + 1, &net_len, sizeof(uint16_t));
+    memcpy(buffer + MSG_HEADER_DIM, msg->payload, len);
+    return MSG_HEADER_DIM + len;
+}
+
+/*
+ * Invia uno o più messaggi già codificati con encode_msg, con una sola chiamata di sistema se il socket lo permette.
+ *
+ * Parametri:
+ *   - sd: Descrittore del socket attraverso il quale inviare i messaggi.
+ *   - buffer: Messaggi codificati.
+ *   - size: Numero di byte da inviare.
+ * 
+ * Restituisce:
+ *   - OK se l'invio è riuscito.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso.
+ *   - NET_ERR_SEND in caso di errore nell'invio.
+ */
+op_result send_encoded(int sd, const uint8_t* buffer, size_t size)
+{
+    ssize_t ret;
+
+    while (size > 0)
+    {
+        ret = send(sd, buffer, size, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EPIPE || errno == ECONNRESET)
+                return NET_ERR_REMOTE_SOCKET_CLOSED;
+            return NET_ERR_SEND;
+        }
+        buffer += ret;
+        size -= ret;
+    }
+    return OK;
+}
+
 /*
  * Riceve un messaggio dal socket specificato e lo memorizza nel descrittore del messaggio fornito.
  *
@@ -180,7 +252,8 @@ err:
  * Restituisce:
  *   - OK se la ricezione è riuscita.
  *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso.
- *   - NET_ERR_RECV in caso di errore nella ricezione.
+ *   - NET_ERR_RECV in caso di errore nella ricezione o se il payload non entra nel buffer del messaggio:
+ *     in entrambi i casi il flusso non è più allineato ai messaggi e la connessione va chiusa.
  */
 op_result receive_from_socket(int sd, desc_msg* msg) 
 {
@@ -207,6 +280,10 @@ op_result receive_from_socket(int sd, desc_msg* msg)
         return OK;
     }
 
+    // Il payload deve lasciare spazio al terminatore, i mittenti ne inviano al più MAX_PAYLOAD_DIM - 1 byte
+    if (len >= MAX_PAYLOAD_DIM)
+        return NET_ERR_RECV;
+
     // Riceve il payload del messaggio
     ret = recv(sd, (void*)msg->payload, len, MSG_WAITALL);
     if (ret <= 0)
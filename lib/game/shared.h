@@ -11,6 +11,7 @@
 #include "../utils.h"
 
 #define MAX_PAYLOAD_DIM     512
+#define MSG_HEADER_DIM      3                       // Tipo (1 byte) e lunghezza del payload (2 byte) di un messaggio sul socket
 #define MAX_USR_DIM         50
 #define MAX_PSW_DIM         50
 
@@ -20,6 +21,14 @@
 #define MAX_PUZZLE_DIM      200
 #define MAX_PUZZLE_SOL_DIM  50
 #define MAX_HELP_DIM        200
+#define RESUME_TOKEN_DIM    33                  // Token di ripresa della sessione: 32 cifre esadecimali più il terminatore
+
+// Stato di un oggetto negli aggiornamenti inviati ai supervisori iscritti a una sessione
+#define SU_OBJ_LOCKED       1                   // L'oggetto è bloccato
+#define SU_OBJ_HIDDEN       2                   // L'oggetto è nascosto
+#define SU_OBJ_CONSUMED     4                   // L'oggetto è stato consumato
+#define SU_OBJ_IN_BAG       8                   // L'oggetto è nello zaino del giocatore
+#define SU_OBJ_SPECIAL      16                  // L'oggetto può essere bloccato, nascosto o consumato
 
 // Enumeratore per i risultati delle operazioni e i tipi di errori.
 typedef enum op_result
@@ -36,6 +45,8 @@ typedef enum op_result
     GAME_ERR_INVALID_ROOM,              // Errore, il numero della stanza non è valido.
     GAME_ERR_CMD_NOT_ALLOWED,           // Errore, esecuzione del comando non consentita.
     GAME_ERR_NOT_FOUND,                 // Errore, l'oggetto o la locazione richiesti non è stato trovato.
+    GAME_ERR_RESUME,                    // Errore, il token di ripresa non è valido o la sessione è scaduta.
+    GAME_ERR_SERVER_FULL,               // Errore, il server ha raggiunto il numero massimo di sessioni o la memoria massima.
 
     GAME_INF_HELP_NO_MSG,               // Notifica l'assenza di messaggio di aiuto.
     GAME_INF_HELP_NO_NEW_MSG,           // Notifica l'assenza di nuovi messaggi di aiuto.
@@ -76,12 +87,13 @@ typedef enum msg_type
     // Payload: username (string), password (string).
     MSG_REQ_LOGIN,
 
-    // Richiesta di elenco dei nomi delle stanze disponibili.
-    // Nessun payload.
+    // Richiesta di una pagina del catalogo delle stanze disponibili. Per la prima pagina il client indica la versione
+    // del catalogo che ha in cache (0 se non ne ha), per le successive quella delle pagine già ricevute.
+    // Payload: versione del catalogo (unsigned int), numero della pagina (int).
     MSG_REQ_ROOM_NAMES,
 
-    // Richiesta di avvio di una partita.
-    // Payload: username (string), numero della stanza (int).
+    // Richiesta di avvio di una partita per l'utente autenticato sulla connessione.
+    // Payload: numero della stanza (int).
     MSG_REQ_START_GAME,
 
     // Errore, credenziali non valide durante login o registrazione.
@@ -105,7 +117,7 @@ typedef enum msg_type
     MSG_LIST_ITEM,
 
     // Trasporta le informazioni necessarie per l'inizializzazione della sessione di gioco.
-    // Payload: tempo totale (time_t), dimensione zaino (int), token della room (int).
+    // Payload: tempo totale (time_t), dimensione zaino (int), token della room (int), token di ripresa (string).
     MSG_GAME_INIT,
 
     // Trasporta una descrizione/testo.
@@ -219,7 +231,7 @@ typedef enum msg_type
     // Notifica di fine gioco per volontà del giocatore.
     // Payload: messaggio di fine gioco per volontà del giocatore (string).
     MSG_GAME_END_QUIT,
-    
+
     // Notifica di completamento del gioco con successo.
     // Payload: messaggio di completamento del gioco (string).
     MSG_GAME_END_WIN,
@@ -241,7 +253,7 @@ typedef enum msg_type
     MSG_SU_REQ_USER_SESSION_BAG,
 
     // Richiesta di modifica del tempo rimanente della sessione di gioco di un utente.
-    // Payload: username del giocatore (string), secondi (int), '+' | '-' | '=' (add, sub, set) (char).
+    // Payload: username del giocatore (string), secondi (int), '+' | '-' | '=' | 'p' | 'r' (add, sub, set, pause, resume) (char).
     MSG_SU_REQ_USER_SESSION_ALTER_TIME,
 
     // Richiesta di impostare un nuovo messaggio di aiuto per la sessione di gioco di un utente.
@@ -262,7 +274,77 @@ typedef enum msg_type
 
     // Notifica il successo di un'operazione.
     // Nessun payload.
-    MSG_SUCCESS
+    MSG_SUCCESS,
+
+    // I tipi seguenti sono stati aggiunti dopo la prima versione del protocollo e restano in coda,
+    // così i valori dei tipi precedenti non cambiano.
+
+    // Richiesta di riprendere una sessione di gioco rimasta senza connessione.
+    // Payload: token di ripresa (string).
+    MSG_REQ_RESUME_GAME,
+
+    // Errore, la richiesta necessita di una connessione autenticata.
+    // Nessun payload.
+    MSG_AUTH_ERR_NO_AUTH,
+
+    // Pagina del catalogo delle stanze.
+    // Payload: versione del catalogo (unsigned int), numero di stanze (int), numero della pagina (int),
+    // numero di pagine (int), indice della prima stanza della pagina (int), poi i nomi delle stanze, ognuno preceduto da '\n'.
+    MSG_ROOM_CATALOG_PAGE,
+
+    // Il catalogo delle stanze non è cambiato rispetto alla versione in cache del client.
+    // Nessun payload.
+    MSG_ROOM_CATALOG_NOT_MODIFIED,
+
+    // Trasporta le informazioni necessarie per riprendere una sessione di gioco.
+    // Payload: numero della stanza (int), dimensione zaino (int), token della room (int),
+    //          tempo rimanente (time_t), token del giocatore (int), numero di oggetti nello zaino (int), numero dell'ultimo messaggio di aiuto (int).
+    MSG_GAME_RESUMED,
+
+    // Errore, il token di ripresa non è valido o la sessione è scaduta.
+    // Nessun payload.
+    MSG_GAME_ERR_RESUME,
+
+    // Errore, il server ha raggiunto il numero massimo di sessioni o la memoria massima e non accetta nuove partite.
+    // Nessun payload.
+    MSG_GAME_ERR_SERVER_FULL,
+
+    // Richiesta di ottenere l'uso della memoria del server, per sottosistema, e i limiti impostati.
+    // Nessun payload.
+    MSG_SU_REQ_MEMORY_STATS,
+
+    // Richiesta di ottenere le statistiche di gioco delle room.
+    // Nessun payload.
+    MSG_SU_REQ_ROOM_STATS,
+
+    // Richiesta di ricevere gli aggiornamenti della sessione di gioco di un utente, finché la richiesta non viene annullata.
+    // Il server risponde con MSG_SUCCESS seguito dallo stato completo, poi invia solo i cambiamenti, accorpati, con MSG_SU_SESSION_UPDATE.
+    // Payload: username del giocatore (string).
+    MSG_SU_REQ_SUBSCRIBE,
+
+    // Richiesta di non ricevere più gli aggiornamenti della sessione di gioco di un utente.
+    // Payload: username del giocatore (string), vuoto per annullare tutte le iscrizioni.
+    MSG_SU_REQ_UNSUBSCRIBE,
+
+    // Aggiornamento della sessione di gioco di un utente osservato, inviato senza richiesta.
+    // Payload: username (string), stato completo (int), tempo rimanente (time_t), tempo fermo (int), token del giocatore (int),
+    // token della room (int), oggetti nello zaino (int), dimensione dello zaino (int), numero dell'ultimo messaggio di aiuto (int),
+    // oggetti della room (int), oggetti cambiati (int) e, se lo stato è completo, nome della room (string fino a fine riga).
+    // Gli oggetti cambiati seguono in messaggi MSG_SU_SESSION_OBJS.
+    MSG_SU_SESSION_UPDATE,
+
+    // Oggetti cambiati di un aggiornamento.
+    // Payload: per ogni oggetto indice (int), stato SU_OBJ_* (int) e nome (string), separati da spazi.
+    MSG_SU_SESSION_OBJS,
+
+    // La sessione di gioco osservata è terminata; l'iscrizione resta valida per una nuova partita dello stesso utente.
+    // Payload: username del giocatore (string).
+    MSG_SU_SESSION_ENDED,
+
+    // Richiesta di identificarsi come supervisore, accettata solo dalle connessioni locali non ancora autenticate.
+    // Le richieste da supervisore sono consentite solo dopo la risposta MSG_SUCCESS.
+    // Nessun payload.
+    MSG_SU_REQ_HELLO
 } msg_type;
 
 typedef struct {                        // Struttura che definisce un messaggio
@@ -272,6 +354,8 @@ typedef struct {                        // Struttura che definisce un messaggio
 
 void init_msg(desc_msg* msg, msg_type type, ...);
 op_result send_to_socket(int sd, desc_msg* msg);
+size_t encode_msg(const desc_msg* msg, uint8_t* buffer);
+op_result send_encoded(int sd, const uint8_t* buffer, size_t size);
 op_result receive_from_socket(int sd, desc_msg* msg);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,864 @@
+#include "solver.h"
+
+#define NODE_WIN            1                       // La partita termina con la vittoria in questo stato
+#define NODE_CAN_WIN        2                       // Da questo stato si può vincere
+
+typedef enum                                        // Lavoro svolto dai thread su un insieme di stati
+{
+    PHASE_SEARCH,                                   // Espansione di un livello della ricerca in ampiezza
+    PHASE_CAN_WIN                                   // Vittoria raggiungibile da uno dei successori
+}
+solver_phase;
+
+typedef struct                                      // Stato visitato, seguito dalle parole dello stato
+{
+    uint64_t parent;                                // Id dello stato da cui è stato raggiunto, SOLVER_NO_NODE per quello iniziale
+    uint32_t obj1;                                  // Comando con cui è stato raggiunto
+    uint32_t obj2;
+    uint32_t level;                                 // Comandi dall'inizio della partita, take e drop esclusi
+    uint32_t progress;                              // Avanzamento, cresce a ogni comando
+    uint8_t cmd;
+    uint8_t flags;                                  // NODE_*, modificati con operazioni atomiche
+    uint64_t state[];
+}
+solver_node;
+
+typedef struct                                      // Parte dell'insieme degli stati visitati
+{
+    pthread_mutex_t lock;                           // Serializza gli inserimenti nella parte
+    char** blocks;                                  // Blocchi di SOLVER_BLOCK_NODES stati, mai spostati
+    uint32_t n_nodes;
+    uint64_t* table;                                // Indirizzamento aperto: 32 bit alti dell'hash e indice + 1, 0 se libera
+    uint32_t table_dim;                             // Potenza di 2
+}
+solver_shard;
+
+typedef struct solver_ctx solver_ctx;
+
+typedef struct                                      // Stato di un thread
+{
+    solver_ctx* ctx;
+    uint64_t* next;                                 // Stati nuovi trovati dal thread, del prossimo livello
+    size_t n_next;
+    size_t next_dim;
+    uint64_t* scratch;                              // Stato successore in costruzione
+    bool found;                                     // Vittoria raggiungibile dallo stato in esame, in PHASE_CAN_WIN
+}
+solver_worker;
+
+struct solver_ctx
+{
+    const room_view* view;
+    uint32_t n_objs;
+    uint32_t n_words;                               // Parole di un insieme di oggetti
+    uint32_t state_words;                           // Tre insiemi e il numero di token
+    uint32_t* active;                               // Oggetti con un uso o bloccati da un enigma, gli unici con comandi
+    uint32_t n_active;
+    size_t node_size;
+    uint32_t max_shard_nodes;
+    uint64_t max_states;
+    size_t max_bytes;
+    atomic_uint_fast64_t n_states;
+    atomic_size_t n_bytes;                          // Byte degli stati, delle tabelle e delle frontiere
+    atomic_bool full;                               // Massimo di stati o di memoria raggiunto, o memoria esaurita
+    atomic_bool memory_limit;                       // La ricerca si è fermata per max_bytes
+
+    solver_shard shards[SOLVER_SHARDS];
+
+    const uint64_t* items;                          // Stati su cui lavorano i thread nella fase corrente
+    size_t n_items;
+    atomic_size_t cursor;                           // Prossimo stato da prendere
+    solver_phase phase;
+
+    int n_threads;
+    solver_worker workers[SOLVER_MAX_THREADS];
+};
+
+static bool init_ctx(solver_ctx* ctx, const room_view* view, int n_threads, uint64_t max_states, size_t max_bytes);
+static bool reserve_bytes(solver_ctx* ctx, size_t size);
+static void free_ctx(solver_ctx* ctx);
+static uint64_t hash_state(const uint64_t* state, uint32_t n);
+static solver_node* get_node(solver_ctx* ctx, uint64_t id);
+static uint64_t find_state(solver_ctx* ctx, const uint64_t* state);
+static uint64_t insert_state(solver_ctx* ctx, const uint64_t* state, const solver_node* parent_node, uint64_t parent,
+    solver_cmd_type cmd, uint32_t obj1, uint32_t obj2);
+static bool grow_table(solver_ctx* ctx, solver_shard* shard);
+static void expand(solver_worker* w, uint64_t id);
+static void step(solver_worker* w, uint64_t id, const solver_node* node, solver_cmd_type cmd, uint32_t obj1, uint32_t obj2,
+    const room_use* use);
+static void run_code(solver_ctx* ctx, uint64_t* state, uint32_t first, uint32_t n);
+static uint32_t progress(solver_ctx* ctx, const uint64_t* state);
+static bool can_carry(solver_ctx* ctx, const uint64_t* state, uint32_t obj);
+static void process(solver_worker* w, uint64_t id);
+static void* work(void* arg);
+static void run_phase(solver_ctx* ctx, const uint64_t* items, size_t n, solver_phase phase);
+static bool find_dead_ends(solver_ctx* ctx);
+static solver_cmd* build_path(solver_ctx* ctx, uint64_t id, uint32_t* len);
+static uint32_t next_use(const solver_node** chain, uint32_t from, uint32_t len, uint32_t obj);
+static double clock_ms();
+
+static inline bool set_test(const uint64_t* set, uint32_t id)
+{
+    return (set[id >> 6] >> (id & 63)) & 1;
+}
+static inline void set_add(uint64_t* set, uint32_t id)
+{
+    set[id >> 6] |= 1ULL << (id & 63);
+}
+static inline void set_remove(uint64_t* set, uint32_t id)
+{
+    set[id >> 6] &= ~(1ULL << (id & 63));
+}
+
+// Insiemi dello stato, nell'ordine in cui sono memorizzati, seguiti dal numero di token
+#define LOCKED(ctx, s)      (s)
+#define HIDDEN(ctx, s)      ((s) + (ctx)->n_words)
+#define CONSUMED(ctx, s)    ((s) + 2 * (ctx)->n_words)
+#define TOKENS(ctx, s)      ((s)[3 * (ctx)->n_words])
+
+/*
+ * Esplora tutti gli stati raggiungibili della room e ne riporta il riepilogo.
+ *
+ * Parametri:
+ *   - view: Vista sull'immagine della room.
+ *   - n_threads: Thread da usare, da 1 a SOLVER_MAX_THREADS.
+ *   - max_states: Stati oltre i quali la ricerca si ferma, lasciando report->complete a false.
+ *   - max_bytes: Memoria oltre la quale la ricerca si ferma, come per max_states.
+ *   - report: Riepilogo da riempire, da liberare con solver_report_free.
+ *
+ * Restituisce:
+ *   - true se la ricerca è stata eseguita, false in caso di errore nell'allocazione di memoria.
+ */
+bool solver_run(const room_view* view, int n_threads, uint64_t max_states, size_t max_bytes, solver_report* report)
+{
+    solver_ctx* ctx = calloc(1, sizeof(solver_ctx));
+    uint64_t* frontier = NULL;
+    uint64_t* initial;
+    uint64_t start_id, win = SOLVER_NO_NODE;
+    size_t n_frontier = 1, i;
+    uint32_t w, k, s;
+    double start;
+    bool ok = true;
+
+    memset(report, 0, sizeof(*report));
+    if (ctx == NULL || !init_ctx(ctx, view, n_threads, max_states, max_bytes)) {
+        if (ctx != NULL)
+            free_ctx(ctx);
+        return false;
+    }
+
+    // Stato iniziale: bloccati e nascosti come definiti dalla room, niente consumato
+    initial = ctx->workers[0].scratch;
+    memset(initial, 0, ctx->state_words * sizeof(uint64_t));
+    memcpy(LOCKED(ctx, initial), view->initial_locked, ctx->n_words * sizeof(uint64_t));
+    memcpy(HIDDEN(ctx, initial), view->initial_hidden, ctx->n_words * sizeof(uint64_t));
+    start_id = insert_state(ctx, initial, NULL, SOLVER_NO_NODE, SOLVER_TAKE, ROOM_NO_OBJ, ROOM_NO_OBJ);
+    frontier = reserve_bytes(ctx, sizeof(uint64_t)) ? malloc(sizeof(uint64_t)) : NULL;
+    if (start_id == SOLVER_NO_NODE || frontier == NULL) {
+        free(frontier);
+        free_ctx(ctx);
+        return false;
+    }
+    frontier[0] = start_id;
+
+    // Ricerca in ampiezza, un livello alla volta
+    start = clock_ms();
+    while (n_frontier > 0 && !atomic_load(&ctx->full))
+    {
+        size_t n_next = 0;
+        uint64_t* next;
+
+        run_phase(ctx, frontier, n_frontier, PHASE_SEARCH);
+
+        for (w = 0; w < (uint32_t)ctx->n_threads; w++)
+            n_next += ctx->workers[w].n_next;
+        next = reserve_bytes(ctx, n_next * sizeof(uint64_t)) ? malloc((n_next > 0 ? n_next : 1) * sizeof(uint64_t)) : NULL;
+        if (next == NULL) {
+            atomic_store(&ctx->full, true);
+            break;
+        }
+        for (w = 0, n_next = 0; w < (uint32_t)ctx->n_threads; w++) {
+            memcpy(next + n_next, ctx->workers[w].next, ctx->workers[w].n_next * sizeof(uint64_t));
+            n_next += ctx->workers[w].n_next;
+            ctx->workers[w].n_next = 0;
+        }
+        free(frontier);
+        atomic_fetch_sub(&ctx->n_bytes, n_frontier * sizeof(uint64_t));
+        frontier = next;
+        n_frontier = n_next;
+    }
+    free(frontier);
+    report->search_ms = clock_ms() - start;
+    report->complete = !atomic_load(&ctx->full);
+    report->memory_limit = atomic_load(&ctx->memory_limit);
+
+    // Vicoli ciechi, solo se la ricerca ha visitato tutti gli stati
+    start = clock_ms();
+    if (report->complete)
+        ok = find_dead_ends(ctx);
+    report->dead_end_ms = clock_ms() - start;
+
+    // Riepilogo, in un'unica scansione di tutti gli stati. Un oggetto può essere raccolto in uno stato in cui la partita
+    // prosegue se è visibile, sbloccato e non consumato: lo zaino si può sempre svuotare per fargli posto
+    report->ever_visible = calloc(ctx->n_words, sizeof(uint64_t));
+    report->ever_unlocked = calloc(ctx->n_words, sizeof(uint64_t));
+    report->ever_taken = calloc(ctx->n_words, sizeof(uint64_t));
+    if (report->ever_visible == NULL || report->ever_unlocked == NULL || report->ever_taken == NULL)
+        ok = false;
+
+    for (s = 0; s < SOLVER_SHARDS && ok; s++)
+    {
+        solver_shard* shard = &ctx->shards[s];
+        for (i = 0; i < shard->n_nodes; i++)
+        {
+            uint64_t id = ((uint64_t)s << 32) | i;
+            solver_node* node = get_node(ctx, id);
+            uint64_t tokens = TOKENS(ctx, node->state);
+
+            report->n_states++;
+            if (tokens > report->max_tokens)
+                report->max_tokens = tokens;
+            if (node->level + 1 > report->n_levels)
+                report->n_levels = node->level + 1;
+            for (k = 0; k < ctx->n_words; k++) {
+                report->ever_visible[k] |= ~HIDDEN(ctx, node->state)[k];
+                report->ever_unlocked[k] |= ~LOCKED(ctx, node->state)[k];
+                if ((node->flags & NODE_WIN) == 0 && tokens <= view->header->token)
+                    report->ever_taken[k] |= ~HIDDEN(ctx, node->state)[k] & ~LOCKED(ctx, node->state)[k] &
+                        ~CONSUMED(ctx, node->state)[k];
+            }
+
+            if (node->flags & NODE_WIN) {
+                report->n_winning++;
+                if (win == SOLVER_NO_NODE || node->level < get_node(ctx, win)->level)
+                    win = id;
+            }
+            if (report->complete && (node->flags & NODE_CAN_WIN) == 0) {
+                report->n_dead++;
+                if (report->dead_end == NULL || node->level < report->dead_end_len) {
+                    free(report->dead_end);
+                    report->dead_end = build_path(ctx, id, &report->dead_end_len);
+                }
+            }
+        }
+    }
+
+    // Gli insiemi riportano solo gli oggetti della room, e solo quelli raccoglibili possono finire nello zaino
+    for (k = 0; k < ctx->n_words * 64 && ok; k++) {
+        if (k >= ctx->n_objs) {
+            set_remove(report->ever_visible, k);
+            set_remove(report->ever_unlocked, k);
+        }
+        if (k >= ctx->n_objs || !(view->objs[k].flags & ROOM_OBJ_TAKEABLE) || view->header->dim_bag == 0)
+            set_remove(report->ever_taken, k);
+    }
+    if (ok && win != SOLVER_NO_NODE)
+        report->solution = build_path(ctx, win, &report->solution_len);
+
+    free_ctx(ctx);
+    if (!ok)
+        solver_report_free(report);
+    return ok;
+}
+
+void solver_report_free(solver_report* report)
+{
+    free(report->solution);
+    free(report->dead_end);
+    free(report->ever_visible);
+    free(report->ever_unlocked);
+    free(report->ever_taken);
+    report->solution = NULL;
+    report->dead_end = NULL;
+    report->ever_visible = NULL;
+    report->ever_unlocked = NULL;
+    report->ever_taken = NULL;
+}
+
+static bool init_ctx(solver_ctx* ctx, const room_view* view, int n_threads, uint64_t max_states, size_t max_bytes)
+{
+    uint32_t s;
+    int t;
+
+    ctx->view = view;
+    ctx->n_objs = view->header->n_objs;
+    ctx->n_words = view->header->n_obj_words > 0 ? view->header->n_obj_words : 1;
+    ctx->state_words = 3 * ctx->n_words + 1;
+    ctx->node_size = sizeof(solver_node) + ctx->state_words * sizeof(uint64_t);
+    ctx->max_states = max_states;
+    ctx->max_bytes = max_bytes;
+    ctx->n_threads = n_threads < 1 ? 1 : n_threads > SOLVER_MAX_THREADS ? SOLVER_MAX_THREADS : n_threads;
+
+    // Gli oggetti senza enigma e senza usi con azioni, come quelli che servono solo a riempire la room,
+    // non hanno comandi che cambiano lo stato: expand non li considera
+    ctx->active = malloc((ctx->n_objs > 0 ? ctx->n_objs : 1) * sizeof(uint32_t));
+    if (ctx->active == NULL)
+        return false;
+    for (s = 0; s < ctx->n_objs; s++)
+    {
+        const room_obj* obj = &view->objs[s];
+        bool active = (obj->flags & ROOM_OBJ_LOCK_PUZZLE) != 0;
+        uint32_t u;
+
+        for (u = 0; u < obj->n_uses && !active; u++)
+            active = view->uses[obj->first_use + u].n_ops > 0;
+        if (active)
+            ctx->active[ctx->n_active++] = s;
+    }
+
+    // Le parti non si riempiono in modo perfettamente uniforme: ognuna può contenere il doppio della media
+    ctx->max_shard_nodes = (uint32_t)((2 * max_states / SOLVER_SHARDS + SOLVER_BLOCK_NODES) / SOLVER_BLOCK_NODES * SOLVER_BLOCK_NODES);
+    for (s = 0; s < SOLVER_SHARDS; s++)
+    {
+        solver_shard* shard = &ctx->shards[s];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->blocks = calloc(ctx->max_shard_nodes / SOLVER_BLOCK_NODES, sizeof(char*));
+        shard->table_dim = 64;
+        shard->table = calloc(shard->table_dim, sizeof(uint64_t));
+        if (shard->blocks == NULL || shard->table == NULL)
+            return false;
+        atomic_fetch_add(&ctx->n_bytes, shard->table_dim * sizeof(uint64_t));
+    }
+
+    for (t = 0; t < ctx->n_threads; t++)
+    {
+        solver_worker* w = &ctx->workers[t];
+        w->ctx = ctx;
+        w->scratch = malloc(ctx->state_words * sizeof(uint64_t));
+        if (w->scratch == NULL)
+            return false;
+    }
+    return true;
+}
+
+static void free_ctx(solver_ctx* ctx)
+{
+    uint32_t s, b;
+    int t;
+
+    for (s = 0; s < SOLVER_SHARDS; s++)
+    {
+        solver_shard* shard = &ctx->shards[s];
+        for (b = 0; shard->blocks != NULL && b < ctx->max_shard_nodes / SOLVER_BLOCK_NODES; b++)
+            free(shard->blocks[b]);
+        free(shard->blocks);
+        free(shard->table);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    for (t = 0; t < ctx->n_threads; t++) {
+        free(ctx->workers[t].next);
+        free(ctx->workers[t].scratch);
+    }
+    free(ctx->active);
+    free(ctx);
+}
+
+/*
+ * Conta size byte nella memoria della ricerca.
+ *
+ * Restituisce:
+ *   - true se la memoria resta entro max_bytes, false altrimenti: la ricerca viene fermata e i byte non vengono contati.
+ */
+static bool reserve_bytes(solver_ctx* ctx, size_t size)
+{
+    if (atomic_fetch_add(&ctx->n_bytes, size) + size <= ctx->max_bytes)
+        return true;
+    atomic_fetch_sub(&ctx->n_bytes, size);
+    atomic_store(&ctx->memory_limit, true);
+    atomic_store(&ctx->full, true);
+    return false;
+}
+
+static uint64_t hash_state(const uint64_t* state, uint32_t n)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        h ^= state[i];
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 31;
+    }
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 29);
+}
+
+// Id di uno stato: indice della parte nei 32 bit alti, indice nella parte in quelli bassi
+static solver_node* get_node(solver_ctx* ctx, uint64_t id)
+{
+    solver_shard* shard = &ctx->shards[id >> 32];
+    uint32_t i = (uint32_t)id;
+
+    return (solver_node*)(shard->blocks[i / SOLVER_BLOCK_NODES] + (size_t)(i % SOLVER_BLOCK_NODES) * ctx->node_size);
+}
+
+/*
+ * Cerca uno stato nell'insieme degli stati visitati, senza lock: va usata solo quando nessun thread inserisce stati.
+ *
+ * Restituisce:
+ *   - L'id dello stato, o SOLVER_NO_NODE se non è stato visitato.
+ */
+static uint64_t find_state(solver_ctx* ctx, const uint64_t* state)
+{
+    uint64_t hash = hash_state(state, ctx->state_words);
+    uint32_t s = hash & (SOLVER_SHARDS - 1), tag = (uint32_t)(hash >> 32), slot;
+    solver_shard* shard = &ctx->shards[s];
+    uint32_t mask = shard->table_dim - 1;
+
+    for (slot = (uint32_t)(hash >> 6) & mask; shard->table[slot] != 0; slot = (slot + 1) & mask)
+    {
+        uint64_t id = ((uint64_t)s << 32) | ((uint32_t)shard->table[slot] - 1);
+        if ((uint32_t)(shard->table[slot] >> 32) == tag &&
+            memcmp(get_node(ctx, id)->state, state, ctx->state_words * sizeof(uint64_t)) == 0)
+            return id;
+    }
+    return SOLVER_NO_NODE;
+}
+
+/*
+ * Inserisce uno stato nell'insieme degli stati visitati, se non è già presente.
+ *
+ * Parametri:
+ *   - state: Stato da inserire.
+ *   - parent_node, parent: Stato da cui è stato raggiunto e suo id, NULL e SOLVER_NO_NODE per quello iniziale.
+ *   - cmd, obj1, obj2: Comando con cui è stato raggiunto.
+ *
+ * Restituisce:
+ *   - L'id dello stato se è nuovo, SOLVER_NO_NODE se era già presente o se l'insieme è pieno.
+ */
+static uint64_t insert_state(solver_ctx* ctx, const uint64_t* state, const solver_node* parent_node, uint64_t parent,
+    solver_cmd_type cmd, uint32_t obj1, uint32_t obj2)
+{
+    uint64_t hash = hash_state(state, ctx->state_words);
+    uint32_t s = hash & (SOLVER_SHARDS - 1), tag = (uint32_t)(hash >> 32), slot, mask;
+    solver_shard* shard = &ctx->shards[s];
+    solver_node* node;
+    uint32_t i;
+
+    pthread_mutex_lock(&shard->lock);
+    mask = shard->table_dim - 1;
+    for (slot = (uint32_t)(hash >> 6) & mask; shard->table[slot] != 0; slot = (slot + 1) & mask)
+    {
+        uint64_t id = ((uint64_t)s << 32) | ((uint32_t)shard->table[slot] - 1);
+        if ((uint32_t)(shard->table[slot] >> 32) == tag &&
+            memcmp(get_node(ctx, id)->state, state, ctx->state_words * sizeof(uint64_t)) == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return SOLVER_NO_NODE;
+        }
+    }
+
+    // Stato nuovo: si ferma se l'insieme è pieno
+    // I blocchi vengono scritti uno stato alla volta, quindi la loro memoria viene contata stato per stato
+    i = shard->n_nodes;
+    if (i == ctx->max_shard_nodes || atomic_fetch_add(&ctx->n_states, 1) >= ctx->max_states || !reserve_bytes(ctx, ctx->node_size)) {
+        atomic_store(&ctx->full, true);
+        pthread_mutex_unlock(&shard->lock);
+        return SOLVER_NO_NODE;
+    }
+    if (i % SOLVER_BLOCK_NODES == 0) {
+        shard->blocks[i / SOLVER_BLOCK_NODES] = malloc(SOLVER_BLOCK_NODES * ctx->node_size);
+        if (shard->blocks[i / SOLVER_BLOCK_NODES] == NULL) {
+            atomic_store(&ctx->full, true);
+            pthread_mutex_unlock(&shard->lock);
+            return SOLVER_NO_NODE;
+        }
+    }
+
+    node = (solver_node*)(shard->blocks[i / SOLVER_BLOCK_NODES] + (size_t)(i % SOLVER_BLOCK_NODES) * ctx->node_size);
+    memcpy(node->state, state, ctx->state_words * sizeof(uint64_t));
+    node->parent = parent;
+    node->cmd = cmd;
+    node->obj1 = obj1;
+    node->obj2 = obj2;
+    node->level = parent_node != NULL ? parent_node->level + 1 : 0;
+    node->progress = progress(ctx, state);
+    // Il server controlla la vittoria dopo ogni comando, con un numero di token esattamente uguale a quello della room
+    node->flags = TOKENS(ctx, state) == ctx->view->header->token ? NODE_WIN : 0;
+
+    shard->table[slot] = ((uint64_t)tag << 32) | (i + 1);
+    shard->n_nodes++;
+    if ((uint64_t)shard->n_nodes * 2 > shard->table_dim && !grow_table(ctx, shard))
+        atomic_store(&ctx->full, true);
+
+    pthread_mutex_unlock(&shard->lock);
+    return ((uint64_t)s << 32) | i;
+}
+
+// Raddoppia la tabella di una parte, con il lock della parte
+static bool grow_table(solver_ctx* ctx, solver_shard* shard)
+{
+    uint32_t dim = shard->table_dim * 2, mask = dim - 1, i, slot;
+    uint64_t* table = reserve_bytes(ctx, dim * sizeof(uint64_t)) ? calloc(dim, sizeof(uint64_t)) : NULL;
+
+    if (table == NULL)
+        return false;
+    for (i = 0; i < shard->table_dim; i++)
+    {
+        uint64_t entry = shard->table[i];
+        uint32_t index = (uint32_t)entry - 1;
+        uint64_t hash;
+
+        if (entry == 0)
+            continue;
+        hash = hash_state(((solver_node*)(shard->blocks[index / SOLVER_BLOCK_NODES] +
+            (size_t)(index % SOLVER_BLOCK_NODES) * ctx->node_size))->state, ctx->state_words);
+        for (slot = (uint32_t)(hash >> 6) & mask; table[slot] != 0; slot = (slot + 1) & mask)
+            ;
+        table[slot] = entry;
+    }
+    free(shard->table);
+    atomic_fetch_sub(&ctx->n_bytes, shard->table_dim * sizeof(uint64_t));
+    shard->table = table;
+    shard->table_dim = dim;
+    return true;
+}
+
+/*
+ * Genera i comandi che cambiano lo stato specificato, con le stesse condizioni dei comandi del server,
+ * e passa ogni successore a step. Gli stati vincenti e quelli con più token del necessario non hanno successori:
+ * nel primo la partita è finita, nel secondo non può più essere vinta.
+ * Take e drop non vengono generati: use <o> <altro> è possibile se o può essere raccolto, vedi can_carry.
+ *
+ * Parametri:
+ *   - w: Thread che esegue l'espansione.
+ *   - id: Id dello stato.
+ */
+static void expand(solver_worker* w, uint64_t id)
+{
+    solver_ctx* ctx = w->ctx;
+    const room_view* view = ctx->view;
+    const solver_node* node = get_node(ctx, id);
+    const uint64_t* state = node->state;
+    uint32_t i, o;
+
+    if ((node->flags & NODE_WIN) || TOKENS(ctx, state) > view->header->token)
+        return;
+
+    for (i = 0; i < ctx->n_active && !w->found; i++)
+    {
+        const room_obj* obj = &view->objs[o = ctx->active[i]];
+        bool locked = set_test(LOCKED(ctx, state), o), consumed = set_test(CONSUMED(ctx, state), o);
+        const room_use* use;
+        uint32_t u;
+
+        // Un oggetto nascosto è come se non esistesse
+        if (set_test(HIDDEN(ctx, state), o))
+            continue;
+
+        // Un oggetto bloccato da un enigma si sblocca rispondendo; use da solo richiede un oggetto sbloccato e non consumato
+        if (locked && (obj->flags & ROOM_OBJ_LOCK_PUZZLE))
+            step(w, id, node, SOLVER_ANSWER, o, ROOM_NO_OBJ, NULL);
+        else if (!locked && !consumed && (use = room_find_use(view, o, ROOM_NO_OBJ)) != NULL && use->n_ops > 0)
+            step(w, id, node, SOLVER_USE, o, ROOM_NO_OBJ, use);
+
+        // use <o> <altro>: o nello zaino, l'altro visibile e non consumato; vale il primo uso per ogni altro oggetto
+        for (u = 0; u < obj->n_uses && can_carry(ctx, state, o) && !w->found; u++)
+        {
+            uint32_t other = view->uses[obj->first_use + u].other_obj, a;
+            bool unlocks = false;
+
+            use = &view->uses[obj->first_use + u];
+            if (use->type != USE_COMBINE || other == ROOM_NO_OBJ || room_find_use(view, o, other) != use || use->n_ops == 0 ||
+                set_test(HIDDEN(ctx, state), other) || set_test(CONSUMED(ctx, state), other))
+                continue;
+
+            // Un oggetto bloccato si può usare solo con l'oggetto che lo sblocca, e mai se bloccato da un enigma
+            if (set_test(LOCKED(ctx, state), other)) {
+                if (view->objs[other].flags & ROOM_OBJ_LOCK_PUZZLE)
+                    continue;
+                for (a = 0; a < use->n_actions && !unlocks; a++)
+                    unlocks = view->actions[use->first_action + a].type == ACTION_UNLOCK &&
+                        view->actions[use->first_action + a].obj == other;
+                if (!unlocks)
+                    continue;
+            }
+            step(w, id, node, SOLVER_USE_WITH, o, other, use);
+        }
+    }
+}
+
+// Applica un comando allo stato di node e passa il successore alla fase corrente
+static void step(solver_worker* w, uint64_t id, const solver_node* node, solver_cmd_type cmd, uint32_t obj1, uint32_t obj2,
+    const room_use* use)
+{
+    solver_ctx* ctx = w->ctx;
+    uint64_t* next = w->scratch;
+    uint64_t new_id;
+
+    memcpy(next, node->state, ctx->state_words * sizeof(uint64_t));
+    if (cmd == SOLVER_ANSWER)
+        run_code(ctx, next, ctx->view->objs[obj1].first_unlock_op, ctx->view->objs[obj1].n_unlock_ops);
+    else
+        run_code(ctx, next, use->first_op, use->n_ops);
+    if (memcmp(next, node->state, ctx->state_words * sizeof(uint64_t)) == 0)
+        return;
+
+    if (ctx->phase == PHASE_CAN_WIN) {
+        // Il successore ha un avanzamento maggiore, quindi è già stato esaminato
+        new_id = find_state(ctx, next);
+        if (new_id != SOLVER_NO_NODE && (get_node(ctx, new_id)->flags & NODE_CAN_WIN))
+            w->found = true;
+        return;
+    }
+
+    new_id = insert_state(ctx, next, node, id, cmd, obj1, obj2);
+    if (new_id == SOLVER_NO_NODE)
+        return;
+    if (w->n_next == w->next_dim) {
+        size_t dim = w->next_dim == 0 ? 1024 : w->next_dim * 2;
+        uint64_t* grown = reserve_bytes(ctx, (dim - w->next_dim) * sizeof(uint64_t)) ? realloc(w->next, dim * sizeof(uint64_t)) : NULL;
+        if (grown == NULL) {
+            atomic_store(&ctx->full, true);
+            return;
+        }
+        w->next = grown;
+        w->next_dim = dim;
+    }
+    w->next[w->n_next++] = new_id;
+}
+
+// Esegue il codice di un uso o di uno sblocco come run_code del server
+static void run_code(solver_ctx* ctx, uint64_t* state, uint32_t first, uint32_t n)
+{
+    const room_op* code = &ctx->view->code[first];
+    uint32_t pc;
+
+    for (pc = 0; pc < n; pc++)
+    {
+        uint32_t obj = code[pc].obj;
+        switch (code[pc].type)
+        {
+            case ACTION_TOKEN:
+                TOKENS(ctx, state)++;
+                break;
+            case ACTION_UNLOCK:
+                if (set_test(HIDDEN(ctx, state), obj) || !set_test(LOCKED(ctx, state), obj))
+                    pc += code[pc].skip;
+                else
+                    set_remove(LOCKED(ctx, state), obj);
+                break;
+            case ACTION_REVEAL:
+                set_remove(HIDDEN(ctx, state), obj);
+                break;
+            case ACTION_CONSUME:
+                // Se l'oggetto è nello zaino ne esce, build_path lo toglie dallo zaino simulato
+                if (!set_test(HIDDEN(ctx, state), obj))
+                    set_add(CONSUMED(ctx, state), obj);
+                break;
+        }
+    }
+}
+
+// Avanzamento di uno stato: oggetti sbloccati, visibili e consumati più i token. Ogni comando lo fa crescere.
+static uint32_t progress(solver_ctx* ctx, const uint64_t* state)
+{
+    uint32_t p = 2 * ctx->n_words * 64, k;
+
+    for (k = 0; k < ctx->n_words; k++)
+        p += __builtin_popcountll(CONSUMED(ctx, state)[k]) - __builtin_popcountll(LOCKED(ctx, state)[k]) -
+            __builtin_popcountll(HIDDEN(ctx, state)[k]);
+    return p + (uint32_t)TOKENS(ctx, state);
+}
+
+/*
+ * Un oggetto può essere nello zaino se è raccoglibile, visibile, sbloccato e non consumato: nessuna azione
+ * blocca o nasconde un oggetto, e lo zaino si può sempre svuotare per fargli posto.
+ * Per questo lo zaino non fa parte dello stato, e gli stati che differiscono solo per il suo contenuto sono uno solo.
+ */
+static bool can_carry(solver_ctx* ctx, const uint64_t* state, uint32_t obj)
+{
+    return (ctx->view->objs[obj].flags & ROOM_OBJ_TAKEABLE) && ctx->view->header->dim_bag > 0 &&
+        !set_test(LOCKED(ctx, state), obj) && !set_test(CONSUMED(ctx, state), obj) && !set_test(HIDDEN(ctx, state), obj);
+}
+
+static void process(solver_worker* w, uint64_t id)
+{
+    solver_node* node = get_node(w->ctx, id);
+
+    switch (w->ctx->phase)
+    {
+        case PHASE_SEARCH:
+            expand(w, id);
+            break;
+
+        case PHASE_CAN_WIN:
+            // Si può vincere da questo stato se ha vinto o se si può vincere da uno dei successori
+            w->found = (node->flags & NODE_WIN) != 0;
+            expand(w, id);
+            if (w->found)
+                __atomic_fetch_or(&node->flags, NODE_CAN_WIN, __ATOMIC_RELAXED);
+            w->found = false;
+            break;
+    }
+}
+
+// Corpo dei thread: prende gli stati della fase corrente SOLVER_CHUNK alla volta
+static void* work(void* arg)
+{
+    solver_worker* w = arg;
+    solver_ctx* ctx = w->ctx;
+    size_t start, end, i;
+
+    while ((start = atomic_fetch_add(&ctx->cursor, SOLVER_CHUNK)) < ctx->n_items && !atomic_load(&ctx->full))
+    {
+        end = start + SOLVER_CHUNK < ctx->n_items ? start + SOLVER_CHUNK : ctx->n_items;
+        for (i = start; i < end; i++)
+            process(w, ctx->items[i]);
+    }
+    return NULL;
+}
+
+// Esegue una fase sugli stati specificati e attende che tutti i thread abbiano finito
+static void run_phase(solver_ctx* ctx, const uint64_t* items, size_t n, solver_phase phase)
+{
+    pthread_t threads[SOLVER_MAX_THREADS];
+    bool started[SOLVER_MAX_THREADS];
+    int n_threads = n < SOLVER_MIN_PARALLEL ? 1 : ctx->n_threads, t;
+
+    ctx->items = items;
+    ctx->n_items = n;
+    ctx->phase = phase;
+    atomic_store(&ctx->cursor, 0);
+
+    // Il thread chiamante lavora come primo thread; se un thread non parte, i suoi stati vengono presi dagli altri
+    for (t = 1; t < n_threads; t++)
+        started[t] = pthread_create(&threads[t], NULL, work, &ctx->workers[t]) == 0;
+    work(&ctx->workers[0]);
+    for (t = 1; t < n_threads; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+}
+
+/*
+ * Marca con NODE_CAN_WIN gli stati da cui si può vincere, esaminandoli in ordine di avanzamento decrescente:
+ * i successori di uno stato hanno un avanzamento maggiore e sono quindi già stati esaminati.
+ *
+ * Restituisce:
+ *   - true in caso di successo, false in caso di errore nell'allocazione di memoria.
+ */
+static bool find_dead_ends(solver_ctx* ctx)
+{
+    uint64_t n_states = atomic_load(&ctx->n_states);
+    uint64_t* order = malloc((n_states > 0 ? n_states : 1) * sizeof(uint64_t));
+    uint64_t* first;
+    uint32_t max_progress = 0, s, i, p;
+
+    if (order == NULL)
+        return false;
+
+    // Ordinamento per conteggio sull'avanzamento
+    for (s = 0; s < SOLVER_SHARDS; s++)
+        for (i = 0; i < ctx->shards[s].n_nodes; i++) {
+            p = get_node(ctx, ((uint64_t)s << 32) | i)->progress;
+            if (p > max_progress)
+                max_progress = p;
+        }
+    first = calloc(max_progress + 2, sizeof(uint64_t));
+    if (first == NULL) {
+        free(order);
+        return false;
+    }
+    for (s = 0; s < SOLVER_SHARDS; s++)
+        for (i = 0; i < ctx->shards[s].n_nodes; i++)
+            first[get_node(ctx, ((uint64_t)s << 32) | i)->progress + 1]++;
+    for (p = 1; p <= max_progress + 1; p++)
+        first[p] += first[p - 1];
+    for (s = 0; s < SOLVER_SHARDS; s++)
+        for (i = 0; i < ctx->shards[s].n_nodes; i++) {
+            uint64_t id = ((uint64_t)s << 32) | i;
+            order[first[get_node(ctx, id)->progress]++] = id;
+        }
+
+    // Dopo il riempimento first[p] è la fine degli stati con avanzamento p
+    for (p = max_progress + 1; p-- > 0; )
+    {
+        uint64_t begin = p > 0 ? first[p - 1] : 0, end = first[p];
+        if (begin == end)
+            continue;
+        run_phase(ctx, order + begin, end - begin, PHASE_CAN_WIN);
+    }
+
+    free(first);
+    free(order);
+    return true;
+}
+
+/*
+ * Ricostruisce la sequenza di comandi che porta allo stato specificato, aggiungendo i take e i drop.
+ * Ogni oggetto viene raccolto subito prima del primo use che lo richiede; se lo zaino è pieno, viene lasciato
+ * l'oggetto che servirà più tardi, così il numero di take è il minimo per quella sequenza di comandi.
+ */
+static solver_cmd* build_path(solver_ctx* ctx, uint64_t id, uint32_t* len)
+{
+    uint32_t level = get_node(ctx, id)->level, dim_bag = ctx->view->header->dim_bag, n_bag = 0, i, b, k;
+    const solver_node** chain = malloc((level > 0 ? level : 1) * sizeof(solver_node*));
+    solver_cmd* path = malloc((3 * level > 0 ? 3 * level : 1) * sizeof(solver_cmd));
+    uint32_t* bag = malloc((dim_bag > 0 ? dim_bag : 1) * sizeof(uint32_t));
+    const solver_node* node = get_node(ctx, id);
+
+    *len = 0;
+    if (chain == NULL || path == NULL || bag == NULL) {
+        free(chain);
+        free(path);
+        free(bag);
+        return NULL;
+    }
+    for (i = level; i-- > 0; node = get_node(ctx, node->parent))
+        chain[i] = node;
+
+    for (i = 0; i < level; i++)
+    {
+        node = chain[i];
+        if (node->cmd == SOLVER_USE_WITH)
+        {
+            for (b = 0; b < n_bag && bag[b] != node->obj1; b++)
+                ;
+            if (b == n_bag) {
+                // Zaino pieno: esce l'oggetto il cui prossimo uso è più lontano
+                if (n_bag == dim_bag) {
+                    uint32_t victim = 0;
+                    for (b = 1; b < n_bag; b++)
+                        if (next_use(chain, i, level, bag[b]) > next_use(chain, i, level, bag[victim]))
+                            victim = b;
+                    path[(*len)++] = (solver_cmd){ SOLVER_DROP, bag[victim], ROOM_NO_OBJ };
+                    bag[victim] = bag[--n_bag];
+                }
+                path[(*len)++] = (solver_cmd){ SOLVER_TAKE, node->obj1, ROOM_NO_OBJ };
+                bag[n_bag++] = node->obj1;
+            }
+        }
+        path[(*len)++] = (solver_cmd){ node->cmd, node->obj1, node->obj2 };
+
+        // Gli oggetti consumati dal comando escono dallo zaino
+        for (b = 0; b < n_bag; )
+        {
+            k = bag[b];
+            if (set_test(CONSUMED(ctx, node->state), k))
+                bag[b] = bag[--n_bag];
+            else
+                b++;
+        }
+    }
+
+    free(chain);
+    free(bag);
+    return path;
+}
+
+// Posizione del primo use <obj> <altro> della sequenza dopo from, len se non ce ne sono
+static uint32_t next_use(const solver_node** chain, uint32_t from, uint32_t len, uint32_t obj)
+{
+    uint32_t i;
+
+    for (i = from; i < len; i++)
+        if (chain[i]->cmd == SOLVER_USE_WITH && chain[i]->obj1 == obj)
+            return i;
+    return len;
+}
+
+static double clock_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
@@ -0,0 +1,85 @@
+#ifndef GAME_SOLVER
+#define GAME_SOLVER
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "room.h"
+
+/*
+ * Risolutore delle room.
+ *
+ * Esplora in ampiezza tutti gli stati raggiungibili di una partita in una room compilata, dove uno stato è dato
+ * dagli insiemi degli oggetti bloccati, nascosti e consumati e dal numero di token. I comandi simulati sono use
+ * con uno o due oggetti e la risposta a un enigma, con le stesse regole del server; look, objs e help non cambiano
+ * lo stato e vengono ignorati.
+ *
+ * Lo zaino non fa parte dello stato: nessuna azione blocca o nasconde un oggetto e lo zaino si può sempre svuotare,
+ * quindi un oggetto visibile, sbloccato e non consumato può sempre essere raccolto per usarlo con un altro.
+ * Gli stati che differiscono solo per lo zaino sono così uno solo, e take e drop vengono aggiunti solo
+ * alle sequenze riportate, quando servono.
+ *
+ * Ogni livello della ricerca viene espanso da più thread, che inseriscono gli stati nuovi in un insieme
+ * degli stati visitati diviso in SOLVER_SHARDS parti, ognuna con il proprio lock. Il primo stato vincente
+ * trovato dà la sequenza per vincere con il minimo di comandi esclusi take e drop.
+ * La ricerca si ferma, incompleta, oltre un massimo di stati o di memoria.
+ *
+ * Finita la ricerca, il risolutore individua i vicoli ciechi, cioè gli stati raggiungibili da cui non si può più
+ * vincere. Sbloccare, rivelare, consumare e ottenere token sono irreversibili, quindi ogni comando fa avanzare
+ * lo stato e gli stati si possono visitare in ordine di avanzamento decrescente.
+ */
+#define SOLVER_SHARDS       64                      // Parti dell'insieme degli stati visitati, potenza di 2
+#define SOLVER_BLOCK_NODES  4096                    // Stati allocati insieme in una parte
+#define SOLVER_CHUNK        64                      // Stati della frontiera presi alla volta da un thread
+#define SOLVER_MIN_PARALLEL 256                     // Stati di un livello sotto i quali non si usano altri thread
+#define SOLVER_MAX_THREADS  64
+#define SOLVER_DEFAULT_MAX_STATES (1ULL << 22)      // Stati oltre i quali la ricerca si ferma
+#define SOLVER_DEFAULT_MAX_BYTES  (1ULL << 30)      // Memoria degli stati e delle frontiere oltre la quale la ricerca si ferma
+#define SOLVER_NO_NODE      UINT64_MAX
+
+typedef enum                                        // Comandi simulati dal risolutore
+{
+    SOLVER_TAKE,
+    SOLVER_DROP,
+    SOLVER_USE,                                     // use <obj1>
+    SOLVER_USE_WITH,                                // use <obj1> <obj2>
+    SOLVER_ANSWER                                   // Risposta corretta all'enigma di obj1
+}
+solver_cmd_type;
+
+typedef struct                                      // Comando di una sequenza
+{
+    uint32_t type;                                  // solver_cmd_type
+    uint32_t obj1;
+    uint32_t obj2;                                  // ROOM_NO_OBJ se il comando ha un solo oggetto
+}
+solver_cmd;
+
+typedef struct                                      // Risultato dell'esplorazione di una room
+{
+    bool complete;                                  // false se la ricerca si è fermata al massimo di stati o di memoria
+    bool memory_limit;                              // La ricerca si è fermata al massimo di memoria
+    uint64_t n_states;                              // Stati raggiungibili
+    uint64_t n_winning;                             // Stati in cui la partita termina con la vittoria
+    uint64_t n_dead;                                // Stati da cui non si può più vincere, significativo se complete
+    uint32_t n_levels;                              // Livelli della ricerca, cioè comandi della sequenza più lunga esclusi take e drop
+    uint32_t max_tokens;                            // Massimo di token ottenuti in uno stato raggiungibile
+
+    solver_cmd* solution;                           // Sequenza di comandi per vincere, NULL se non è stata trovata
+    uint32_t solution_len;
+    solver_cmd* dead_end;                           // Sequenza più breve che porta in un vicolo cieco, NULL se non ce ne sono
+    uint32_t dead_end_len;
+
+    uint64_t* ever_visible;                         // Oggetti visibili in almeno uno stato raggiungibile
+    uint64_t* ever_unlocked;                        // Oggetti sbloccati in almeno uno stato raggiungibile
+    uint64_t* ever_taken;                           // Oggetti che possono essere raccolti in almeno uno stato raggiungibile
+
+    double search_ms;                               // Durata della ricerca in ampiezza
+    double dead_end_ms;                             // Durata della ricerca dei vicoli ciechi
+}
+solver_report;
+
+bool solver_run(const room_view* view, int n_threads, uint64_t max_states, size_t max_bytes, solver_report* report);
+void solver_report_free(solver_report* report);
+
+#endif
@@ -1,6 +1,8 @@
 #include "supervisor.h"
 
 static op_result receive_list(int sd, char*** list, int* n);
+static op_result receive_reply(int sd, desc_msg* msg);
+static bool apply_push(desc_msg* msg);
 
 static op_result receiveState(int sd);
 static op_result reqUserSessionAlterTime(int sd, int seconds, const char opt);
@@ -63,7 +65,7 @@ static op_result receive_list(int sd, char*** list, int* n)
     int i;
 
     // Riceve il numero totale di elementi
-    ret = receive_from_socket(sd, &msg);
+    ret = receive_reply(sd, &msg);
     if (ret != OK)
         return ret;
 
@@ -116,6 +118,110 @@ static op_result receive_list(int sd, char*** list, int* n)
     return ret;
 }
 
+/*
+ * Riceve la risposta a una richiesta. Gli aggiornamenti della sessione osservata che il server ha inviato
+ * prima della risposta vengono applicati e saltati.
+ *
+ * Restituisce:
+ *   - OK se la risposta è stata ricevuta.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_RECV in caso di errore nella ricezione.
+ */
+static op_result receive_reply(int sd, desc_msg* msg)
+{
+    op_result ret;
+
+    while (true)
+    {
+        ret = receive_from_socket(sd, msg);
+        if (ret != OK)
+            return ret;
+
+        switch (msg->type)
+        {
+            case MSG_SU_SESSION_UPDATE:
+            case MSG_SU_SESSION_OBJS:
+            case MSG_SU_SESSION_ENDED: {
+                apply_push(msg);
+                break;
+            }
+            default:
+                return OK;
+        }
+    }
+}
+
+/*
+ * Applica allo stato della sessione osservata un aggiornamento inviato dal server.
+ *
+ * Restituisce:
+ *   - true se lo stato è cambiato, false se il messaggio riguarda un altro utente o non è un aggiornamento.
+ */
+static bool apply_push(desc_msg* msg)
+{
+    char username[MAX_USR_DIM], name[MAX_NAME_DIM];
+    long long remaining_time;
+    int full, paused, len, offset = 0;
+    unsigned int n_objs, n_changed, obj, flags;
+
+    switch (msg->type)
+    {
+        case MSG_SU_SESSION_UPDATE:
+        {
+            if (sscanf(msg->payload, "%49s %d %lld %d %d %d %d %d %d %u %u%n", username, &full, &remaining_time, &paused,
+                    &session.user_token, &session.room_token, &session.n_bag_objs, &session.dim_bag, &session.help_msg_id,
+                    &n_objs, &n_changed, &len) != 11 || strcmp(username, session.username) != 0)
+                return false;
+            session.remaining_time = (time_t)remaining_time;
+            session.paused = paused != 0;
+            session.pending_objs = n_changed;
+            session.ended = false;
+
+            // Nuova partita: nome della stanza e oggetti ripartono da zero
+            if (full) {
+                strncpy(session.room_name, msg->payload[len] == ' ' ? msg->payload + len + 1 : "", MAX_ROOM_NAME_DIM);
+                session.room_name[MAX_ROOM_NAME_DIM - 1] = '\0';
+
+                if (session.n_objs != n_objs) {
+                    free(session.obj_names);
+                    free(session.obj_flags);
+                    session.obj_names = calloc(n_objs, MAX_NAME_DIM);
+                    session.obj_flags = calloc(n_objs, sizeof(uint8_t));
+                    session.n_objs = (session.obj_names != NULL && session.obj_flags != NULL) ? n_objs : 0;
+                }
+                else if (n_objs > 0) {
+                    memset(session.obj_names, 0, n_objs * MAX_NAME_DIM);
+                    memset(session.obj_flags, 0, n_objs);
+                }
+            }
+            return true;
+        }
+        case MSG_SU_SESSION_OBJS:
+        {
+            while (sscanf(msg->payload + offset, "%u %u %19s%n", &obj, &flags, name, &len) == 3)
+            {
+                offset += len;
+                if (session.pending_objs > 0)
+                    session.pending_objs--;
+                if (obj >= session.n_objs)
+                    continue;
+                strcpy(session.obj_names[obj], name);
+                session.obj_flags[obj] = flags;
+            }
+            return true;
+        }
+        case MSG_SU_SESSION_ENDED:
+        {
+            if (strcmp(msg->payload, session.username) != 0)
+                return false;
+            session.ended = true;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
 // Libera la memoria allocata per la ricezione degli item di una lista
 void freeList(char** list, int n) {
     int i;
@@ -144,7 +250,7 @@ static op_result receiveState(int sd)
     desc_msg msg;
     op_result ret;
 
-    ret = receive_from_socket(sd, &msg);
+    ret = receive_reply(sd, &msg);
     if (ret != OK)
         return ret;
     
@@ -170,6 +276,45 @@ static op_result receiveState(int sd)
     return ret;
 }
 
+/*
+ * Identifica la connessione come supervisore: il server accetta le altre richieste solo dopo questa.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ * 
+ * Restituisce:
+ *   - OK se il server ha accettato la connessione come supervisore.
+ *   - AUTH_ERR_NO_AUTH se il server l'ha rifiutata, ad esempio perché non è locale.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione della risposta dal server.
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto non è del tipo atteso.
+ */
+op_result reqHello(int sd)
+{
+    op_result ret;
+    desc_msg msg;
+
+    init_msg(&msg, MSG_SU_REQ_HELLO);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    ret = receive_reply(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    switch (msg.type)
+    {
+        case MSG_SUCCESS:
+            return OK;
+        case MSG_AUTH_ERR_NO_AUTH:
+            return AUTH_ERR_NO_AUTH;
+        default:
+            return ERR_UNEXPECTED_MSG_TYPE;
+    }
+}
+
 /*
  * Richiede al server la lista dei giocatori attivi.
  * Inizializza un messaggio di richiesta al server e lo invia tramite il socket specificato.
@@ -203,6 +348,64 @@ op_result reqActiveUsers(int sd, char*** users_list, int* n)
     return receive_list(sd, users_list, n);
 }
 
+/*
+ * Richiede al server l'uso della memoria, come lista di righe di testo da mostrare.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ *   - lines: Puntatore alla lista di righe, allocata dalla funzione.
+ *   - n: Puntatore al numero di righe.
+ * 
+ * Restituisce:
+ *   - OK se la lista è stata ricevuta con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione della lista dal server.
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto non è del tipo atteso.
+ *   - ERR_OTHER se si verificano altri errori durante la ricezione o l'allocazione di memoria.
+ */
+op_result reqMemoryStats(int sd, char*** lines, int* n) 
+{
+    op_result ret;
+    desc_msg msg;
+
+    init_msg(&msg, MSG_SU_REQ_MEMORY_STATS);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    return receive_list(sd, lines, n);
+}
+
+/*
+ * Richiede al server le statistiche di gioco delle room, come lista di righe di testo da mostrare.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ *   - lines: Puntatore alla lista di righe, allocata dalla funzione.
+ *   - n: Puntatore al numero di righe.
+ * 
+ * Restituisce:
+ *   - OK se la lista è stata ricevuta con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione della lista dal server.
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto non è del tipo atteso.
+ *   - ERR_OTHER se si verificano altri errori durante la ricezione o l'allocazione di memoria.
+ */
+op_result reqRoomStats(int sd, char*** lines, int* n) 
+{
+    op_result ret;
+    desc_msg msg;
+
+    init_msg(&msg, MSG_SU_REQ_ROOM_STATS);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    return receive_list(sd, lines, n);
+}
+
 /*
  * Richiede al server le informazioni di base sulla sessione di gioco dell'utente selezionato.
  * Queste informazioni includono il nome della stanza, il tempo rimanente, il numero di token della stanza
@@ -236,7 +439,7 @@ op_result reqUserSessionData(int sd)
         return ret;
 
     // Riceve il nome della stanza
-    ret = receive_from_socket(sd, &msg);
+    ret = receive_reply(sd, &msg);
     if (ret != OK)
         return ret;
     // Verifica del tipo di messaggio
@@ -357,6 +560,142 @@ op_result reqUserSessionBag(int sd, char*** objs_names, int* n)
     return receive_list(sd, objs_names, n);
 }
 
+/*
+ * Chiede al server di inviare gli aggiornamenti della sessione di gioco dell'utente selezionato, invece di richiederli.
+ * Al ritorno lo stato della sessione, oggetti compresi, è completo; i cambiamenti successivi arrivano
+ * senza richiesta e vanno ricevuti con receiveUpdates quando il socket è pronto in lettura.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ * 
+ * Restituisce:
+ *   - OK se l'iscrizione è riuscita e lo stato è stato ricevuto.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione dei messaggi dal server.
+ *   - SU_ERR_USER_NOT_FOUND se non è stata trovata una sessione legata all'utente selezionato.
+ *   - ERR_UNEXPECTED_MSG_TYPE se viene ricevuto un messaggio inaspettato dal server.
+ *   - ERR_OTHER se il server non accetta altre iscrizioni.
+ */
+op_result reqSubscribe(int sd)
+{
+    op_result ret;
+    desc_msg msg;
+
+    // Controlla se è stato selezionato un utente
+    if (strlen(session.username) == 0)
+        return SU_ERR_USER_NOT_FOUND;
+
+    init_msg(&msg, MSG_SU_REQ_SUBSCRIBE, session.username);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    ret = receive_reply(sd, &msg);
+    if (ret != OK)
+        return ret;
+    switch (msg.type)
+    {
+        case MSG_SUCCESS:
+            break;
+        case MSG_SU_ERR_USER_NOT_FOUND:
+            return SU_ERR_USER_NOT_FOUND;
+        case MSG_GAME_ERR_SERVER_FULL:
+            return ERR_OTHER;
+        default:
+            return ERR_UNEXPECTED_MSG_TYPE;
+    }
+
+    // Stato completo, seguito dagli oggetti
+    ret = receive_from_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+    if (msg.type != MSG_SU_SESSION_UPDATE || !apply_push(&msg))
+        return ERR_UNEXPECTED_MSG_TYPE;
+    while (session.pending_objs > 0)
+    {
+        ret = receive_from_socket(sd, &msg);
+        if (ret != OK)
+            return ret;
+        if (msg.type != MSG_SU_SESSION_OBJS)
+            return ERR_UNEXPECTED_MSG_TYPE;
+        apply_push(&msg);
+    }
+    return OK;
+}
+
+/*
+ * Chiede al server di non inviare più gli aggiornamenti della sessione di gioco dell'utente selezionato.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ * 
+ * Restituisce:
+ *   - OK se l'iscrizione è stata annullata.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione dei messaggi dal server.
+ *   - ERR_UNEXPECTED_MSG_TYPE se viene ricevuto un messaggio inaspettato dal server.
+ */
+op_result reqUnsubscribe(int sd)
+{
+    op_result ret;
+    desc_msg msg;
+
+    init_msg(&msg, MSG_SU_REQ_UNSUBSCRIBE, session.username);
+    ret = send_to_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    ret = receive_reply(sd, &msg);
+    if (ret != OK)
+        return ret;
+    if (msg.type != MSG_SUCCESS)
+        return ERR_UNEXPECTED_MSG_TYPE;
+    return OK;
+}
+
+/*
+ * Riceve un aggiornamento della sessione osservata inviato dal server.
+ * Da chiamare quando il socket è pronto in lettura e non ci sono richieste in attesa di risposta.
+ * 
+ * Parametri:
+ *   - sd: Descrittore del socket per la comunicazione con il server.
+ *   - changed: Impostato a true se lo stato della sessione è cambiato.
+ * 
+ * Restituisce:
+ *   - OK se l'aggiornamento è stato ricevuto.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_RECV in caso di errori nella ricezione dei messaggi dal server.
+ *   - SU_ERR_USER_NOT_FOUND se la sessione di gioco è terminata.
+ *   - ERR_UNEXPECTED_MSG_TYPE se viene ricevuto un messaggio che non è un aggiornamento.
+ */
+op_result receiveUpdates(int sd, bool* changed)
+{
+    op_result ret;
+    desc_msg msg;
+
+    ret = receive_from_socket(sd, &msg);
+    if (ret != OK)
+        return ret;
+
+    switch (msg.type)
+    {
+        case MSG_SU_SESSION_UPDATE:
+        case MSG_SU_SESSION_OBJS:
+        case MSG_SU_SESSION_ENDED: {
+            *changed = apply_push(&msg);
+            break;
+        }
+        default:
+            return ERR_UNEXPECTED_MSG_TYPE;
+    }
+
+    if (session.ended)
+        return SU_ERR_USER_NOT_FOUND;
+    return OK;
+}
+
 /*
  * Richiede al server di aggiungere tempo alla sessione di gioco dell'utente selezionato.
  * 
@@ -415,13 +754,51 @@ op_result reqUserSessionSetTime(int sd, int seconds) {
     return reqUserSessionAlterTime(sd, seconds, '=');
 }
 
+/*
+ * Richiede al server di fermare il tempo della sessione di gioco dell'utente selezionato, finché non viene riavviato.
+ * 
+ * Parametri:
+ *   - sd: Il descrittore del socket per la comunicazione con il server.
+ * 
+ * Restituisce:
+ *   - OK se la richiesta è stata completata con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori durante la ricezione dei dati dal server.
+ *   - SU_ERR_USER_NOT_FOUND se non è stata trovata una sessione legata all'utente selezionato.
+ *   - SU_ERR_ALTER_TIME_OPT se l'opzione specificata per la modifica del tempo rimanente non è supportata dal server
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto non è del tipo atteso.
+ */
+op_result reqUserSessionPauseTime(int sd) {
+    return reqUserSessionAlterTime(sd, 0, 'p');
+}
+
+/*
+ * Richiede al server di riavviare il tempo della sessione di gioco dell'utente selezionato, fermato da un supervisore.
+ * 
+ * Parametri:
+ *   - sd: Il descrittore del socket per la comunicazione con il server.
+ * 
+ * Restituisce:
+ *   - OK se la richiesta è stata completata con successo.
+ *   - NET_ERR_REMOTE_SOCKET_CLOSED se il socket remoto è chiuso durante la comunicazione con il server.
+ *   - NET_ERR_SEND in caso di errori nell'invio della richiesta al server.
+ *   - NET_ERR_RECV in caso di errori durante la ricezione dei dati dal server.
+ *   - SU_ERR_USER_NOT_FOUND se non è stata trovata una sessione legata all'utente selezionato.
+ *   - SU_ERR_ALTER_TIME_OPT se l'opzione specificata per la modifica del tempo rimanente non è supportata dal server
+ *   - ERR_UNEXPECTED_MSG_TYPE se il messaggio ricevuto non è del tipo atteso.
+ */
+op_result reqUserSessionResumeTime(int sd) {
+    return reqUserSessionAlterTime(sd, 0, 'r');
+}
+
 /*
  * Funzione interna utilizzata per richiedere al server di modificare il tempo della sessione di gioco dell'utente selezionato.
  * 
  * Parametri:
  *   - sd: Il descrittore del socket per la comunicazione con il server.
  *   - seconds: Il numero di secondi da aggiungere, sottrarre o impostare come tempo rimanente della sessione.
- *   - opt: Il carattere che indica l'operazione da eseguire ('+', '-' o '=').
+ *   - opt: Il carattere che indica l'operazione da eseguire ('+', '-', '=', 'p' o 'r').
  * 
  * Restituisce:
  *   - OK se la richiesta è stata completata con successo.
@@ -13,6 +13,14 @@ typedef struct                              // Struttura per memorizzare le info
     int n_bag_objs;                         // Numero di oggetti nello zaino del giocatore
     int user_token;                         // Numero di token che il giocatore possiede
     int room_token;                         // Numero di token necessari al giocatore per vincere
+    bool paused;                            // Il tempo del giocatore è fermo
+
+    // Stato degli oggetti, aggiornato dal server dopo reqSubscribe
+    uint32_t n_objs;                        // Numero di oggetti della stanza
+    char (*obj_names)[MAX_NAME_DIM];        // Nomi degli oggetti, vuoti per quelli che il server non ha ancora descritto
+    uint8_t* obj_flags;                     // Stato degli oggetti (SU_OBJ_*)
+    uint32_t pending_objs;                  // Oggetti dell'ultimo aggiornamento non ancora ricevuti
+    bool ended;                             // La sessione di gioco è terminata
 }
 observed_session;
 
@@ -20,14 +28,23 @@ const observed_session* getObservedSession();
 bool selectUser(const char* username);
 void freeList(char** list, int n);
 
+op_result reqHello(int sd);
 op_result reqActiveUsers(int sd, char*** users_list, int* n);
+op_result reqMemoryStats(int sd, char*** lines, int* n);
+op_result reqRoomStats(int sd, char*** lines, int* n);
 op_result reqUserSessionData(int sd);
 op_result reqUserSessionObjs(int sd, char*** objs_list, int* n);
 op_result reqUserSessionBag(int sd, char*** objs_names, int* n);
 
+op_result reqSubscribe(int sd);
+op_result reqUnsubscribe(int sd);
+op_result receiveUpdates(int sd, bool* changed);
+
 op_result reqUserSessionAddTime(int sd, int seconds);
 op_result reqUserSessionSubTime(int sd, int seconds);
 op_result reqUserSessionSetTime(int sd, int seconds);
+op_result reqUserSessionPauseTime(int sd);
+op_result reqUserSessionResumeTime(int sd);
 
 op_result reqUserSessionSetHelp(int sd, const char* help);
 
@@ -7,6 +7,8 @@ const char* SER_START_MENU =    "***************************** SERVER STARTED **
                                 "Comandi:\n"
                                 "> start <%d>\t--> avvia il server di gioco\n"
                                 "> stop\t\t--> termina il server\n"
+                                "> events\t--> salva gli eventi recenti in " EVENT_DUMP_FILE "\n"
+                                "> reload\t--> ricarica le room senza interrompere le partite in corso\n"
                                 "\n**************************************************************************\n";
 #endif
 
@@ -63,16 +65,20 @@ const char* SU_MAIN_MENU_HEADER =   "******************************* SUPERVISOR
                                     "Comandi:\n"
                                     "> look <username>\t--> osserva il giocatore specificato\n"
                                     "> update\t\t--> aggiorna la lista delle sessioni\n"
+                                    "> mem\t\t\t--> mostra l'uso della memoria del server\n"
+                                    "> stats\t\t\t--> mostra le statistiche di gioco delle room\n"
                                     "> quit\t\t\t--> esci\n";
 const char* SU_MAIN_MENU_TRAILER =  "**************************************************************************\n";
 
 const char* SU_LOOK_MENU =  "******************************* SUPERVISOR *******************************\n"
                             "%s sta giocando in \"%s\"\n"
-                            "Tempo rimanente: %d\tToken: %d/%d\tOggetti nello zaino: %d/%d\n\n"
+                            "Tempo rimanente: %d%s\tToken: %d/%d\tOggetti nello zaino: %d/%d\n"
+                            "(aggiornato in tempo reale)\n\n"
                             "Comandi:\n"
                             "> objs\t\t\t\t\t--> stato degli oggetti bloccati della stanza\n"
                             "> bag\t\t\t\t\t--> lista degli oggetti nello zaino del giocatore\n"
                             "> time ((add | sub | set)) <sec>\t--> aggiunge, sottrae o imposta il tempo rimanente\n"
+                            "> time (pause | resume)\t\t\t--> ferma o riavvia il tempo del giocatore\n"
                             "> help\t\t\t\t\t--> invia un messaggio di aiuto al giocatore\n"
                             "> back\t\t\t\t\t--> torna al menu principale\n"
                             "\n**************************************************************************\n";
@@ -0,0 +1,251 @@
+#include "password.h"
+
+typedef struct                                      // Stato del calcolo SHA-256
+{
+    uint32_t h[8];                                  // Stato intermedio
+    unsigned char block[64];                        // Blocco in costruzione
+    size_t block_len;                               // Byte presenti nel blocco
+    uint64_t total_len;                             // Byte elaborati in totale
+}
+sha256_ctx;
+
+static void sha256_init(sha256_ctx* ctx);
+static void sha256_update(sha256_ctx* ctx, const unsigned char* data, size_t len);
+static void sha256_final(sha256_ctx* ctx, unsigned char* digest);
+static void sha256_transform(sha256_ctx* ctx, const unsigned char* block);
+static void to_hex(const unsigned char* bytes, size_t len, char* out);
+static bool equal_const_time(const char* a, const char* b);
+
+static const uint32_t K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_init(sha256_ctx* ctx)
+{
+    ctx->h[0] = 0x6a09e667; ctx->h[1] = 0xbb67ae85; ctx->h[2] = 0x3c6ef372; ctx->h[3] = 0xa54ff53a;
+    ctx->h[4] = 0x510e527f; ctx->h[5] = 0x9b05688c; ctx->h[6] = 0x1f83d9ab; ctx->h[7] = 0x5be0cd19;
+    ctx->block_len = 0;
+    ctx->total_len = 0;
+}
+
+static void sha256_transform(sha256_ctx* ctx, const unsigned char* block)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    for (i = 16; i < 64; i++)
+        w[i] = (ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7] +
+               (ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+
+    a = ctx->h[0]; b = ctx->h[1]; c = ctx->h[2]; d = ctx->h[3];
+    e = ctx->h[4]; f = ctx->h[5]; g = ctx->h[6]; h = ctx->h[7];
+
+    for (i = 0; i < 64; i++)
+    {
+        t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    ctx->h[0] += a; ctx->h[1] += b; ctx->h[2] += c; ctx->h[3] += d;
+    ctx->h[4] += e; ctx->h[5] += f; ctx->h[6] += g; ctx->h[7] += h;
+}
+
+static void sha256_update(sha256_ctx* ctx, const unsigned char* data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = 64 - ctx->block_len;
+        if (n > len)
+            n = len;
+
+        memcpy(ctx->block + ctx->block_len, data, n);
+        ctx->block_len += n;
+        ctx->total_len += n;
+        data += n;
+        len -= n;
+
+        if (ctx->block_len == 64) {
+            sha256_transform(ctx, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+static void sha256_final(sha256_ctx* ctx, unsigned char* digest)
+{
+    uint64_t bits = ctx->total_len * 8;
+    unsigned char pad = 0x80, zero = 0, len_be[8];
+    int i;
+
+    // Padding: un bit a 1, zeri fino a 56 byte modulo 64, lunghezza in bit big-endian
+    sha256_update(ctx, &pad, 1);
+    while (ctx->block_len != 56)
+        sha256_update(ctx, &zero, 1);
+    for (i = 0; i < 8; i++)
+        len_be[i] = (unsigned char)(bits >> (56 - i * 8));
+    sha256_update(ctx, len_be, 8);
+
+    for (i = 0; i < 8; i++) {
+        digest[i * 4] = (unsigned char)(ctx->h[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->h[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->h[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)ctx->h[i];
+    }
+}
+
+static void to_hex(const unsigned char* bytes, size_t len, char* out)
+{
+    static const char digits[] = "0123456789abcdef";
+    size_t i;
+    for (i = 0; i < len; i++) {
+        out[i * 2] = digits[bytes[i] >> 4];
+        out[i * 2 + 1] = digits[bytes[i] & 0x0f];
+    }
+    out[len * 2] = '\0';
+}
+
+/*
+ * Confronta due stringhe scorrendole sempre per intero, così il tempo impiegato non rivela
+ * quanti caratteri iniziali della password coincidono.
+ */
+static bool equal_const_time(const char* a, const char* b)
+{
+    size_t len_a = strlen(a), len_b = strlen(b), n = len_a > len_b ? len_a : len_b, i;
+    unsigned char diff = len_a != len_b;
+
+    for (i = 0; i < n; i++)
+        diff |= (unsigned char)(i < len_a ? a[i] : 0) ^ (unsigned char)(i < len_b ? b[i] : 0);
+    return diff == 0;
+}
+
+/*
+ * Riempie salt con PSW_SALT_BYTES byte casuali letti da /dev/urandom.
+ *
+ * Restituisce:
+ *   - true se il salt è stato generato, false se /dev/urandom non può essere letto: un salt prevedibile
+ *     non viene mai usato.
+ */
+bool password_random_salt(unsigned char* salt)
+{
+    size_t n = 0;
+    FILE* fd = fopen("/dev/urandom", "r");
+
+    if (fd != NULL) {
+        n = fread(salt, 1, PSW_SALT_BYTES, fd);
+        fclose(fd);
+    }
+    return n == PSW_SALT_BYTES;
+}
+
+/*
+ * Calcola la forma cifrata della password con il salt specificato.
+ *
+ * Parametri:
+ *   - password: Password in chiaro.
+ *   - salt: PSW_SALT_BYTES byte di salt.
+ *   - out: Buffer di almeno PSW_HASH_DIM caratteri in cui scrivere il risultato.
+ */
+void password_hash_with_salt(const char* password, const unsigned char* salt, char* out)
+{
+    unsigned char digest[32];
+    sha256_ctx ctx;
+    int i;
+
+    // Primo passo su salt e password
+    sha256_init(&ctx);
+    sha256_update(&ctx, salt, PSW_SALT_BYTES);
+    sha256_update(&ctx, (const unsigned char*)password, strlen(password));
+    sha256_final(&ctx, digest);
+
+    // Passi successivi sul digest precedente e sulla password, per rendere costoso un attacco a forza bruta
+    for (i = 1; i < PSW_HASH_ROUNDS; i++) {
+        sha256_init(&ctx);
+        sha256_update(&ctx, digest, sizeof(digest));
+        sha256_update(&ctx, (const unsigned char*)password, strlen(password));
+        sha256_final(&ctx, digest);
+    }
+
+    strcpy(out, PSW_HASH_PREFIX);
+    to_hex(salt, PSW_SALT_BYTES, out + 3);
+    out[3 + PSW_SALT_BYTES * 2] = '$';
+    to_hex(digest, sizeof(digest), out + 3 + PSW_SALT_BYTES * 2 + 1);
+}
+
+/*
+ * Calcola la forma cifrata della password con un salt casuale.
+ *
+ * Parametri:
+ *   - password: Password in chiaro.
+ *   - out: Buffer di almeno PSW_HASH_DIM caratteri in cui scrivere il risultato.
+ *
+ * Restituisce:
+ *   - true se la password è stata cifrata, false se non è stato possibile generare il salt.
+ */
+bool password_hash(const char* password, char* out)
+{
+    unsigned char salt[PSW_SALT_BYTES];
+
+    if (!password_random_salt(salt))
+        return false;
+    password_hash_with_salt(password, salt, out);
+    return true;
+}
+
+/*
+ * Verifica una password rispetto alla forma memorizzata nel file utenti.
+ *
+ * Parametri:
+ *   - password: Password in chiaro fornita dall'utente.
+ *   - stored: Password memorizzata, cifrata oppure in chiaro.
+ *
+ * Restituisce:
+ *   - true se la password corrisponde, false altrimenti.
+ */
+bool password_verify(const char* password, const char* stored)
+{
+    unsigned char salt[PSW_SALT_BYTES];
+    char computed[PSW_HASH_DIM];
+    unsigned int byte;
+    int i;
+
+    // Password memorizzata in chiaro
+    if (!password_is_hashed(stored))
+        return equal_const_time(password, stored);
+
+    if (strlen(stored) != PSW_HASH_DIM - 1)
+        return false;
+
+    // Recupero del salt
+    for (i = 0; i < PSW_SALT_BYTES; i++) {
+        if (sscanf(stored + 3 + i * 2, "%2x", &byte) != 1)
+            return false;
+        salt[i] = (unsigned char)byte;
+    }
+
+    password_hash_with_salt(password, salt, computed);
+    return equal_const_time(computed, stored);
+}
+
+/*
+ * Restituisce:
+ *   - true se la password memorizzata è cifrata, false se è in chiaro.
+ */
+bool password_is_hashed(const char* stored)
+{
+    return strncmp(stored, PSW_HASH_PREFIX, 3) == 0;
+}
\ No newline at end of file
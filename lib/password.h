@@ -0,0 +1,28 @@
+#ifndef PASSWORD
+#define PASSWORD
+
+#include "utils.h"
+
+/*
+ * Le password vengono memorizzate nel file utenti nel formato "$h$<salt>$<hash>", dove salt è composto da
+ * PSW_SALT_BYTES byte casuali e hash è lo SHA-256 iterato PSW_HASH_ROUNDS volte su salt e password,
+ * entrambi in esadecimale. Le righe con la password in chiaro, scritte dalle versioni precedenti del server,
+ * restano valide.
+ *
+ * Il numero di passi non è memorizzato nella password cifrata, quindi cambiarlo rende non più verificabili
+ * le password già registrate. Ogni calcolo costa circa 8000 blocchi SHA-256: circa 2 ms compilando con -O2,
+ * circa 6 ms senza ottimizzazioni. Il server lo esegue nel ciclo principale a ogni registrazione e a ogni login,
+ * bloccando gli altri client per quel tempo; le importazioni in blocco passano da userimport, che cifra in parallelo.
+ */
+#define PSW_HASH_PREFIX     "$h$"
+#define PSW_SALT_BYTES      8
+#define PSW_HASH_ROUNDS     4096
+#define PSW_HASH_DIM        (3 + PSW_SALT_BYTES * 2 + 1 + 64 + 1)  // Dimensione della password cifrata, incluso il terminatore
+
+bool password_hash(const char* password, char* out);
+void password_hash_with_salt(const char* password, const unsigned char* salt, char* out);
+bool password_verify(const char* password, const char* stored);
+bool password_is_hashed(const char* stored);
+bool password_random_salt(unsigned char* salt);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,478 @@
+#include <sys/stat.h>
+
+#include "userstore.h"
+
+typedef struct                                      // Lavoro assegnato a un thread di caricamento
+{
+    user_store* store;
+    const char* dir;
+    int first, step;                                // Shard first, first + step, ...
+    bool ok;
+}
+load_job;
+
+static user_table* table_new(size_t capacity);
+static void table_free(user_table* table);
+static bool table_insert(user_shard* shard, user_record* record);
+static user_record* record_new(user_shard* shard, const char* username, const char* password);
+static int shard_of(const user_store* store, uint64_t h);
+static bool load_shard(user_store* store, int shard, const char* path, bool legacy);
+static void* load_worker(void* arg);
+static int read_shard_count(const char* dir, int n_shards);
+
+/*
+ * Apre l'archivio utenti nella cartella dir, creandolo se non esiste, e ne carica tutti gli shard in parallelo.
+ *
+ * Parametri:
+ *   - dir: Cartella dell'archivio.
+ *   - n_shards: Numero di shard da usare se l'archivio non esiste ancora, altrimenti viene ignorato.
+ *
+ * Restituisce:
+ *   - true se l'archivio è stato aperto correttamente, false altrimenti.
+ */
+bool userstore_open(user_store* store, const char* dir, int n_shards)
+{
+    pthread_t threads[USERS_MAX_SHARDS];
+    load_job jobs[USERS_MAX_SHARDS];
+    char path[256];
+    int i, n_threads;
+    bool ok = true;
+
+    memset(store, 0, sizeof(user_store));
+
+    // Creazione della cartella e lettura del numero di shard
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+        return false;
+    store->n_shards = read_shard_count(dir, n_shards);
+    if (store->n_shards <= 0)
+        return false;
+
+    for (i = 0; i < store->n_shards; i++)
+    {
+        user_shard* shard = &store->shards[i];
+        atomic_init(&shard->table, table_new(64));
+        pthread_mutex_init(&shard->write_lock, NULL);
+        if (atomic_load(&shard->table) == NULL)
+            ok = false;
+    }
+    if (!ok) {
+        userstore_close(store);
+        return false;
+    }
+
+    // Caricamento parallelo, ogni thread si occupa di uno shard ogni n_threads
+    n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > store->n_shards)
+        n_threads = store->n_shards;
+
+    for (i = 0; i < n_threads; i++)
+    {
+        jobs[i] = (load_job){ .store = store, .dir = dir, .first = i, .step = n_threads, .ok = true };
+        if (pthread_create(&threads[i], NULL, load_worker, &jobs[i]) != 0) {
+            load_worker(&jobs[i]);
+            threads[i] = pthread_self();
+        }
+    }
+    for (i = 0; i < n_threads; i++)
+    {
+        if (!pthread_equal(threads[i], pthread_self()))
+            pthread_join(threads[i], NULL);
+        ok = ok && jobs[i].ok;
+    }
+
+    // Il vecchio file unico viene letto dopo gli shard, i suoi utenti non vengono riscritti
+    if (ok)
+        ok = load_shard(store, -1, USERS_LEGACY_FILE, true);
+
+    // Apertura dei file in append per le nuove registrazioni
+    for (i = 0; ok && i < store->n_shards; i++)
+    {
+        snprintf(path, sizeof(path), "%s/shard-%02d.txt", dir, i);
+        store->shards[i].fd = fopen(path, "a");
+        if (store->shards[i].fd == NULL)
+            ok = false;
+    }
+
+    if (!ok) {
+        userstore_close(store);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Chiude i file degli shard e libera tutta la memoria dell'archivio, tabelle sostituite comprese.
+ */
+void userstore_close(user_store* store)
+{
+    int i;
+
+    for (i = 0; i < store->n_shards; i++)
+    {
+        user_shard* shard = &store->shards[i];
+        user_table* table = atomic_load(&shard->table);
+
+        while (table != NULL) {
+            user_table* retired = table->retired;
+            table_free(table);
+            table = retired;
+        }
+        while (shard->chunks != NULL) {
+            user_chunk* next = shard->chunks->next;
+            free(shard->chunks);
+            shard->chunks = next;
+        }
+        if (shard->fd != NULL)
+            fclose(shard->fd);
+        pthread_mutex_destroy(&shard->write_lock);
+    }
+    memset(store, 0, sizeof(user_store));
+}
+
+/*
+ * Cerca un utente senza prendere alcun lock.
+ *
+ * Restituisce:
+ *   - Il record dell'utente, NULL se l'utente non è registrato.
+ */
+const user_record* userstore_find(user_store* store, const char* username)
+{
+    uint64_t h = hash_string(username);
+    user_shard* shard;
+    user_table* table;
+    user_record* record;
+    size_t i;
+
+    if (store->n_shards == 0)
+        return NULL;
+
+    shard = &store->shards[shard_of(store, h)];
+    table = atomic_load_explicit(&shard->table, memory_order_acquire);
+
+    // Un username escluso dal filtro non è sicuramente registrato
+    if (!bloom_may_contain(&table->filter, h))
+        return NULL;
+
+    for (i = h & (table->capacity - 1); ; i = (i + 1) & (table->capacity - 1))
+    {
+        record = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+        if (record == NULL)
+            return NULL;
+        if (strcmp(record->username, username) == 0)
+            return record;
+    }
+}
+
+/*
+ * Registra un nuovo utente: la riga viene aggiunta al file dello shard e il record pubblicato nell'indice.
+ * La scrittura su file è bufferizzata, userstore_flush la rende persistente.
+ *
+ * Parametri:
+ *   - password: Password già cifrata.
+ *
+ * Restituisce:
+ *   - OK se l'utente è stato registrato.
+ *   - AUTH_ERR_USERNAME_EXISTS se l'username è già registrato.
+ *   - ERR_OTHER in caso di errore di scrittura o di memoria esaurita.
+ */
+op_result userstore_add(user_store* store, const char* username, const char* password)
+{
+    user_shard* shard;
+    user_record* record;
+    op_result ret = OK;
+
+    if (store->n_shards == 0)
+        return ERR_OTHER;
+    shard = &store->shards[shard_of(store, hash_string(username))];
+
+    pthread_mutex_lock(&shard->write_lock);
+
+    // Il controllo va ripetuto sotto lock, un altro scrittore potrebbe aver appena registrato lo stesso username
+    if (userstore_find(store, username) != NULL)
+        ret = AUTH_ERR_USERNAME_EXISTS;
+    else if ((record = record_new(shard, username, password)) == NULL)
+        ret = ERR_OTHER;
+    else if (fprintf(shard->fd, "%s %s\n", username, password) < 0)
+        ret = ERR_OTHER;
+    else if (!table_insert(shard, record))
+        ret = ERR_OTHER;
+
+    pthread_mutex_unlock(&shard->write_lock);
+    return ret;
+}
+
+/*
+ * Sostituisce la password di un utente che proviene dal file legacy, ad esempio per cifrare una password in chiaro.
+ * La riga viene aggiunta al file dello shard: al caricamento successivo l'utente viene trovato negli shard
+ * e la sua riga nel file legacy ignorata. Il record non viene modificato ma sostituito nell'indice da uno nuovo,
+ * così un lettore che sta usando quello vecchio non ne vede mai una versione a metà.
+ *
+ * Parametri:
+ *   - password: Password già cifrata.
+ *
+ * Restituisce:
+ *   - OK se la password è stata sostituita.
+ *   - AUTH_ERR_INVALID_CREDENTIALS se l'username non è registrato.
+ *   - ERR_OTHER in caso di errore di scrittura o di memoria esaurita.
+ */
+op_result userstore_upgrade_password(user_store* store, const char* username, const char* password)
+{
+    uint64_t h = hash_string(username);
+    user_shard* shard;
+    user_table* table;
+    user_record* record;
+    size_t i;
+    op_result ret = AUTH_ERR_INVALID_CREDENTIALS;
+
+    if (store->n_shards == 0)
+        return ERR_OTHER;
+    shard = &store->shards[shard_of(store, h)];
+
+    pthread_mutex_lock(&shard->write_lock);
+
+    table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    for (i = h & (table->capacity - 1); ; i = (i + 1) & (table->capacity - 1))
+    {
+        record = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+        if (record == NULL)
+            break;
+        if (strcmp(record->username, username) != 0)
+            continue;
+
+        if ((record = record_new(shard, username, password)) == NULL)
+            ret = ERR_OTHER;
+        else if (fprintf(shard->fd, "%s %s\n", username, password) < 0)
+            ret = ERR_OTHER;
+        else {
+            atomic_store_explicit(&table->slots[i], record, memory_order_release);
+            ret = OK;
+        }
+        break;
+    }
+
+    pthread_mutex_unlock(&shard->write_lock);
+    return ret;
+}
+
+/*
+ * Scrive su disco le registrazioni ancora nei buffer dei file degli shard.
+ *
+ * Restituisce:
+ *   - true se tutti i file sono stati scritti correttamente, false altrimenti.
+ */
+bool userstore_flush(user_store* store)
+{
+    bool ok = true;
+    int i;
+
+    for (i = 0; i < store->n_shards; i++)
+    {
+        user_shard* shard = &store->shards[i];
+        pthread_mutex_lock(&shard->write_lock);
+        if (shard->fd != NULL && fflush(shard->fd) != 0)
+            ok = false;
+        pthread_mutex_unlock(&shard->write_lock);
+    }
+    return ok;
+}
+
+/*
+ * Restituisce:
+ *   - Il numero di utenti registrati.
+ */
+size_t userstore_count(user_store* store)
+{
+    size_t n = 0;
+    int i;
+
+    for (i = 0; i < store->n_shards; i++)
+        n += store->shards[i].n_users;
+    return n;
+}
+
+//--------Utils---------//
+
+static user_table* table_new(size_t capacity)
+{
+    user_table* table = calloc(1, sizeof(user_table) + capacity * sizeof(_Atomic(user_record*)));
+    if (table == NULL)
+        return NULL;
+    table->capacity = capacity;
+
+    // La tabella non supera mai metà della sua capacità
+    if (!bloom_init(&table->filter, capacity / 2)) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+static void table_free(user_table* table)
+{
+    bloom_free(&table->filter);
+    free(table);
+}
+
+/*
+ * Inserisce un record nell'indice dello shard; va chiamata da chi possiede lo shard in scrittura.
+ * Se la tabella è piena per metà, viene prima sostituita da una copia di capacità doppia.
+ */
+static bool table_insert(user_shard* shard, user_record* record)
+{
+    user_table* table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    uint64_t h = hash_string(record->username);
+    size_t i;
+
+    if ((shard->n_users + 1) * 2 > table->capacity)
+    {
+        user_table* grown = table_new(table->capacity * 2);
+        if (grown == NULL)
+            return false;
+
+        for (i = 0; i < table->capacity; i++)
+        {
+            user_record* r = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+            size_t j;
+            uint64_t rh;
+            if (r == NULL)
+                continue;
+            rh = hash_string(r->username);
+            for (j = rh & (grown->capacity - 1);
+                 atomic_load_explicit(&grown->slots[j], memory_order_relaxed) != NULL;
+                 j = (j + 1) & (grown->capacity - 1));
+            atomic_store_explicit(&grown->slots[j], r, memory_order_relaxed);
+            bloom_add(&grown->filter, rh);
+        }
+
+        // Pubblicazione della nuova tabella, la vecchia resta valida per i lettori in corso
+        grown->retired = table;
+        atomic_store_explicit(&shard->table, grown, memory_order_release);
+        table = grown;
+    }
+
+    // Il filtro viene aggiornato prima di pubblicare il record: chi ha già visto il record nella tabella lo vede anche nel filtro
+    for (i = h & (table->capacity - 1);
+         atomic_load_explicit(&table->slots[i], memory_order_relaxed) != NULL;
+         i = (i + 1) & (table->capacity - 1));
+    bloom_add(&table->filter, h);
+    atomic_store_explicit(&table->slots[i], record, memory_order_release);
+    shard->n_users++;
+    return true;
+}
+
+static user_record* record_new(user_shard* shard, const char* username, const char* password)
+{
+    user_record* record;
+
+    if (shard->chunks == NULL || shard->chunks->used == USERS_CHUNK_RECORDS)
+    {
+        user_chunk* chunk = malloc(sizeof(user_chunk));
+        if (chunk == NULL)
+            return NULL;
+        chunk->used = 0;
+        chunk->next = shard->chunks;
+        shard->chunks = chunk;
+    }
+
+    record = &shard->chunks->records[shard->chunks->used++];
+    snprintf(record->username, MAX_USR_DIM, "%s", username);
+    snprintf(record->password, PSW_HASH_DIM, "%s", password);
+    return record;
+}
+
+/*
+ * Lo shard è scelto con i 32 bit alti dell'hash, la cella della tabella con quelli bassi.
+ */
+static int shard_of(const user_store* store, uint64_t h)
+{
+    return (int)((h >> 32) % (uint64_t)store->n_shards);
+}
+
+/*
+ * Carica un file di utenti nell'indice. Con legacy a true il file è il vecchio archivio unico:
+ * ogni riga va nello shard del proprio username e i duplicati vengono ignorati.
+ */
+static bool load_shard(user_store* store, int shard, const char* path, bool legacy)
+{
+    char buffer[USERS_LINE_DIM];
+    char username[MAX_USR_DIM], password[PSW_HASH_DIM];
+    FILE* fd = fopen(path, "r");
+    bool ok = true;
+
+    if (fd == NULL)
+        // Uno shard ancora vuoto non ha un file
+        return errno == ENOENT;
+
+    while (ok && fgets(buffer, sizeof(buffer), fd) != NULL)
+    {
+        user_shard* target;
+        user_record* record;
+
+        if (sscanf(buffer, "%49s %84s", username, password) != 2)
+            continue;
+
+        if (legacy) {
+            if (userstore_find(store, username) != NULL)
+                continue;
+            target = &store->shards[shard_of(store, hash_string(username))];
+        }
+        else
+            target = &store->shards[shard];
+
+        record = record_new(target, username, password);
+        ok = record != NULL && table_insert(target, record);
+    }
+
+    fclose(fd);
+    return ok;
+}
+
+static void* load_worker(void* arg)
+{
+    load_job* job = arg;
+    char path[256];
+    int i;
+
+    for (i = job->first; job->ok && i < job->store->n_shards; i += job->step)
+    {
+        snprintf(path, sizeof(path), "%s/shard-%02d.txt", job->dir, i);
+        job->ok = load_shard(job->store, i, path, false);
+    }
+    return NULL;
+}
+
+/*
+ * Legge il numero di shard dell'archivio; se l'archivio è nuovo, memorizza n_shards.
+ *
+ * Restituisce:
+ *   - Il numero di shard, -1 in caso di errore.
+ */
+static int read_shard_count(const char* dir, int n_shards)
+{
+    char path[256];
+    int n = -1;
+    FILE* fd;
+
+    snprintf(path, sizeof(path), "%s/shards", dir);
+    fd = fopen(path, "r");
+    if (fd != NULL)
+    {
+        if (fscanf(fd, "%d", &n) != 1 || n <= 0 || n > USERS_MAX_SHARDS)
+            n = -1;
+        fclose(fd);
+        return n;
+    }
+
+    if (n_shards <= 0 || n_shards > USERS_MAX_SHARDS)
+        return -1;
+    fd = fopen(path, "w");
+    if (fd == NULL)
+        return -1;
+    fprintf(fd, "%d\n", n_shards);
+    fclose(fd);
+    return n_shards;
+}
+
+//----------------------//
\ No newline at end of file
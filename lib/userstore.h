@@ -0,0 +1,87 @@
+#ifndef USERSTORE
+#define USERSTORE
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "utils.h"
+#include "bloom.h"
+#include "password.h"
+#include "game/shared.h"
+
+/*
+ * Archivio degli utenti suddiviso in shard in base all'hash dell'username.
+ *
+ * Ogni shard ha il proprio file (USERS_DIR/shard-XX.txt, righe "username password") e il proprio indice in memoria,
+ * una tabella a indirizzamento aperto. Gli shard vengono caricati in parallelo all'avvio.
+ *
+ * Le letture non prendono alcun lock: un record viene pubblicato nella tabella solo quando è completo
+ * (store con semantica release) e la tabella, quando cresce, viene sostituita atomicamente da una copia più grande.
+ * Le tabelle sostituite restano allocate fino alla chiusura dell'archivio, così un lettore che le sta ancora
+ * scorrendo non accede mai a memoria liberata; la loro dimensione complessiva non supera quella della tabella corrente.
+ * Le scritture sono serializzate solo all'interno del singolo shard.
+ *
+ * Ogni tabella ha un filtro di Bloom dimensionato per il massimo di utenti che può contenere, che risponde
+ * "non registrato" senza scorrere la tabella, come durante le ondate di registrazioni di username nuovi.
+ * Il filtro cresce insieme alla tabella, che quando viene sostituita ne ricostruisce uno di capacità doppia.
+ *
+ * Il numero di shard viene fissato alla creazione dell'archivio e memorizzato in USERS_DIR/shards.
+ * Il vecchio file unico (USERS_LEGACY_FILE), se presente, viene letto come uno shard aggiuntivo in sola lettura.
+ */
+#define USERS_DIR               "users"
+#define USERS_LEGACY_FILE       "users.txt"
+#define USERS_SHARDS_DEFAULT    16
+#define USERS_MAX_SHARDS        256
+#define USERS_LINE_DIM          (MAX_USR_DIM + PSW_HASH_DIM + 2)        // Dimensione di una riga di un file shard
+#define USERS_CHUNK_RECORDS     4096                                    // Record allocati insieme
+
+typedef struct                                      // Struttura che definisce un utente registrato
+{
+    char username[MAX_USR_DIM];
+    char password[PSW_HASH_DIM];                    // Password cifrata (o in chiaro, se proveniente dal file legacy)
+}
+user_record;
+
+typedef struct user_table                           // Indice di uno shard
+{
+    size_t capacity;                                // Numero di celle, potenza di 2
+    struct user_table* retired;                     // Tabella sostituita da questa, liberata alla chiusura
+    bloom_filter filter;                            // Username della tabella, per capacity / 2 elementi
+    _Atomic(user_record*) slots[];                  // NULL per le celle libere
+}
+user_table;
+
+typedef struct user_chunk                           // Blocco di record allocati insieme
+{
+    struct user_chunk* next;
+    size_t used;
+    user_record records[USERS_CHUNK_RECORDS];
+}
+user_chunk;
+
+typedef struct                                      // Struttura che definisce uno shard
+{
+    _Atomic(user_table*) table;
+    size_t n_users;                                 // Modificato solo dallo scrittore
+    user_chunk* chunks;
+    FILE* fd;                                       // File dello shard, aperto in append
+    pthread_mutex_t write_lock;                     // Serializza le scritture sullo shard
+}
+user_shard;
+
+typedef struct                                      // Struttura che definisce l'archivio utenti
+{
+    int n_shards;
+    user_shard shards[USERS_MAX_SHARDS];
+}
+user_store;
+
+bool userstore_open(user_store* store, const char* dir, int n_shards);
+void userstore_close(user_store* store);
+const user_record* userstore_find(user_store* store, const char* username);
+op_result userstore_add(user_store* store, const char* username, const char* password);
+op_result userstore_upgrade_password(user_store* store, const char* username, const char* password);
+bool userstore_flush(user_store* store);
+size_t userstore_count(user_store* store);
+
+#endif
\ No newline at end of file
@@ -152,4 +152,27 @@ void pressEnterToContinue()
     printf("\nPremi invio per continuare...");
     fflush(stdout);
     getchar(); // Attendi l'input dell'utente
+}
+
+/*
+ * Calcola l'hash a 64 bit di una stringa (FNV-1a seguito da un passo di mescolamento finale),
+ * in modo che anche i bit bassi e alti del risultato siano distribuiti uniformemente
+ */
+uint64_t hash_string(const char* str)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    // FNV-1a
+    while (*str != '\0') {
+        h ^= (unsigned char)*str++;
+        h *= 0x100000001b3ULL;
+    }
+
+    // Mescolamento finale (splitmix64)
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define UTILS
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,4 +25,6 @@ time_t getTimestamp();
 
 void pressEnterToContinue();
 
+uint64_t hash_string(const char* str);
+
 #endif
\ No newline at end of file
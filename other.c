@@ -85,6 +85,21 @@ static int init_supervisor(int server_port)
         }
     }
 
+    // Il server accetta le richieste da supervisore solo dopo che la connessione si è identificata
+    switch (reqHello(sd))
+    {
+        case OK:
+            break;
+        case AUTH_ERR_NO_AUTH:
+            plog(LOG_CUSTOM_ERROR, "Il server accetta supervisori solo dalla macchina locale");
+            close(sd);
+            exit(EXIT_FAILURE);
+        default:
+            plog(LOG_CUSTOM_ERROR, "Impossibile identificarsi come supervisore");
+            close(sd);
+            exit(EXIT_FAILURE);
+    }
+
     return sd;
 }
 
@@ -103,11 +118,13 @@ static bool main_loop(int sd)
 {
     const observed_session* session = getObservedSession();
     char buffer[MAX_INPUT_DIM * 3], cmd[MAX_INPUT_DIM];
+    bool redraw = true, changed;
+    fd_set read_fds;
+    uint32_t i;
 
-    // Recupero le informazioni di base sulla sessione del giocatore
+    // Recupero le informazioni sulla sessione del giocatore, il server invierà poi i cambiamenti
     plog(LOG_INFO, "Recupero informazioni sul giocatore...");
-    sleep(1);
-    switch (reqUserSessionData(sd))
+    switch (reqSubscribe(sd))
     {
         case OK: {
             break;
@@ -129,114 +146,111 @@ static bool main_loop(int sd)
         }
     }
 
-    // Informazioni ottenute, si trovano nella struttura dati "user"
+    // Informazioni ottenute, si trovano nella struttura dati "session" e vengono aggiornate dal server
     while(true) 
     {
-        system("clear");
-        printf(SU_LOOK_MENU, session->username, session->room_name, session->remaining_time, session->user_token, session->room_token, session->n_bag_objs, session->dim_bag);
-        printf("> ");
-        read_line(buffer, MAX_INPUT_DIM);
+        if (redraw) {
+            system("clear");
+            printf(SU_LOOK_MENU, session->username, session->room_name, (int)session->remaining_time, session->paused ? " (fermo)" : "",
+                session->user_token, session->room_token, session->n_bag_objs, session->dim_bag);
+            printf("> ");
+            fflush(stdout);
+            redraw = false;
+        }
 
-        memset(cmd, '\0', 1);
-        sscanf(buffer, "%s", cmd);
+        // Attende un comando o un aggiornamento della sessione
+        FD_ZERO(&read_fds);
+        FD_SET(STDIN_FILENO, &read_fds);
+        FD_SET(sd, &read_fds);
+        if (select(sd + 1, &read_fds, NULL, NULL, NULL) < 0)
+            continue;
 
-        if (strcmp("back", cmd) == 0)
-        {
-            break;
-        }
-        else if (strcmp("objs", cmd) == 0)
+        if (FD_ISSET(sd, &read_fds))
         {
-            char** objs_list; int n_objs, i;
-            switch (reqUserSessionObjs(sd, &objs_list, &n_objs))
+            switch (receiveUpdates(sd, &changed))
             {
-                case OK: 
-                {
-                    if (n_objs == 0) 
-                    {
-                        plog(LOG_INFO, "Nella stanza non ci sono oggetti");
-                        pressEnterToContinue();
-                    }
-                    else 
-                    {
-                        char obj_name[MAX_NAME_DIM];
-                        int locked_flag, hidden_flag, consumed_flag;
-
-                        // Mostro gli oggetti a video
-                        for (i = 0; i < n_objs; i++) 
-                        {
-                            sscanf(objs_list[i], "%s %d %d %d", obj_name, &locked_flag, &hidden_flag, &consumed_flag);
-                            printf("↳ %-20s [%-10s | %-9s | %-14s]\n", 
-                                obj_name,
-                                locked_flag == 1 ? "bloccato" : "sbloccato",
-                                hidden_flag == 1 ? "nascosto" : "visibile",
-                                consumed_flag == 1 ? "consumato" : "non consumato");
-                        }
-                        pressEnterToContinue();
-                    }
-                    freeList(objs_list, n_objs);
+                case OK: {
+                    redraw = changed;
                     break;
                 }
                 case SU_ERR_USER_NOT_FOUND: {
-                    plog(LOG_INFO, "Mhh... probabilmente il giocatore ha terminato la sua sessione di gioco");
+                    printf("\n");
+                    plog(LOG_INFO, "Il giocatore ha terminato la sua sessione di gioco");
+                    reqUnsubscribe(sd);
                     pressEnterToContinue();
                     return true;
                 }
                 case NET_ERR_REMOTE_SOCKET_CLOSED: {
+                    printf("\n");
                     plog(LOG_CUSTOM_ERROR, "Server disconnesso");
                     pressEnterToContinue();
                     return false;
                 }
                 default: {
-                    plog(LOG_CUSTOM_ERROR, "Si è verificato un problema durante la richiesta");
+                    printf("\n");
+                    plog(LOG_CUSTOM_ERROR, "Si è verificato un problema durante la ricezione degli aggiornamenti");
+                    reqUnsubscribe(sd);
                     pressEnterToContinue();
-                    break;
+                    return true;
                 }
             }
         }
+        if (!FD_ISSET(STDIN_FILENO, &read_fds))
+            continue;
+
+        read_line(buffer, MAX_INPUT_DIM);
+        redraw = true;
+
+        memset(cmd, '\0', 1);
+        sscanf(buffer, "%s", cmd);
+
+        if (strcmp("back", cmd) == 0)
+        {
+            if (reqUnsubscribe(sd) == NET_ERR_REMOTE_SOCKET_CLOSED) {
+                plog(LOG_CUSTOM_ERROR, "Server disconnesso");
+                pressEnterToContinue();
+                return false;
+            }
+            break;
+        }
+        else if (strcmp("objs", cmd) == 0)
+        {
+            int n_objs = 0;
+
+            // Mostro gli oggetti bloccati, nascosti o consumabili a video
+            for (i = 0; i < session->n_objs; i++) 
+            {
+                uint8_t flags = session->obj_flags[i];
+                if (!(flags & SU_OBJ_SPECIAL))
+                    continue;
+                printf("↳ %-20s [%-10s | %-9s | %-14s]\n", 
+                    session->obj_names[i],
+                    (flags & SU_OBJ_LOCKED) ? "bloccato" : "sbloccato",
+                    (flags & SU_OBJ_HIDDEN) ? "nascosto" : "visibile",
+                    (flags & SU_OBJ_CONSUMED) ? "consumato" : "non consumato");
+                n_objs++;
+            }
+            if (n_objs == 0)
+                plog(LOG_INFO, "Nella stanza non ci sono oggetti");
+            pressEnterToContinue();
+        }
         else if (strcmp("bag", cmd) == 0) 
         {
-            char** objs_list; int n_objs, i;
-            switch (reqUserSessionBag(sd, &objs_list, &n_objs))
+            int n_objs = 0;
+
+            // Mostro gli oggetti nello zaino a video
+            for (i = 0; i < session->n_objs; i++) 
             {
-                case OK: 
-                {
-                    if (n_objs == 0) 
-                    {
-                        plog(LOG_INFO, "Lo zaino del giocatore è vuoto");
-                        pressEnterToContinue();
-                    }
-                    else 
-                    {
-                        // Mostro gli oggetti a video
-                        printf("↳ [ ");
-                        for (i = 0; i < n_objs; i++) 
-                        {
-                            if (i == n_objs - 1)
-                                printf("%s ]\n", objs_list[i]);
-                            else
-                                printf("%s, ", objs_list[i]);
-                        }
-                        pressEnterToContinue();
-                    }
-                    freeList(objs_list, n_objs);
-                    break;
-                }
-                case SU_ERR_USER_NOT_FOUND: {
-                    plog(LOG_INFO, "Mhh... probabilmente il giocatore ha terminato la sua sessione di gioco");
-                    pressEnterToContinue();
-                    return true;
-                }
-                case NET_ERR_REMOTE_SOCKET_CLOSED: {
-                    plog(LOG_CUSTOM_ERROR, "Server disconnesso");
-                    pressEnterToContinue();
-                    return false;
-                }
-                default: {
-                    plog(LOG_CUSTOM_ERROR, "Si è verificato un problema durante la richiesta");
-                    pressEnterToContinue();
-                    break;
-                }
+                if (!(session->obj_flags[i] & SU_OBJ_IN_BAG))
+                    continue;
+                printf("%s%s", n_objs == 0 ? "↳ [ " : ", ", session->obj_names[i]);
+                n_objs++;
             }
+            if (n_objs == 0)
+                plog(LOG_INFO, "Lo zaino del giocatore è vuoto");
+            else
+                printf(" ]\n");
+            pressEnterToContinue();
         }
         else if (strcmp("time", cmd) == 0) 
         {
@@ -260,6 +274,10 @@ static bool main_loop(int sd)
                     goto sec_err;
                 ret = reqUserSessionSetTime(sd, seconds);
             }
+            else if (strcmp(opt, "pause") == 0)
+                ret = reqUserSessionPauseTime(sd);
+            else if (strcmp(opt, "resume") == 0)
+                ret = reqUserSessionResumeTime(sd);
             else {
                 plog(LOG_INFO, "Comando non valido");
                 pressEnterToContinue();
@@ -276,6 +294,7 @@ static bool main_loop(int sd)
                 }
                 case SU_ERR_USER_NOT_FOUND: {
                     plog(LOG_INFO, "Mhh... probabilmente il giocatore ha terminato la sua sessione di gioco");
+                    reqUnsubscribe(sd);
                     pressEnterToContinue();
                     return true;
                 }
@@ -316,6 +335,7 @@ static bool main_loop(int sd)
                 }
                 case SU_ERR_USER_NOT_FOUND: {
                     plog(LOG_INFO, "Mhh... probabilmente il giocatore ha terminato la sua sessione di gioco");
+                    reqUnsubscribe(sd);
                     pressEnterToContinue();
                     return true;
                 }
@@ -412,6 +432,66 @@ update:
             freeList(users_list, n);
             goto update;
         }
+        else if (strcmp("mem", cmd) == 0) 
+        {
+            char** lines;
+            int n_lines;
+
+            // Mostra l'uso della memoria del server
+            switch(reqMemoryStats(sd, &lines, &n_lines))
+            {
+                case OK: {
+                    printf("\n");
+                    for (i = 0; i < n_lines; i++)
+                        printf("%s\n", lines[i]);
+                    printf("\n");
+                    freeList(lines, n_lines);
+                    break;
+                }
+                case NET_ERR_REMOTE_SOCKET_CLOSED: {
+                    plog(LOG_CUSTOM_ERROR, "Server disconnesso");
+                    pressEnterToContinue();
+                    freeList(users_list, n);
+                    return false;
+                }
+                default: {
+                    plog(LOG_CUSTOM_ERROR, "Si è verificato un problema durante la richiesta");
+                    break;
+                }
+            }
+            pressEnterToContinue();
+        }
+        else if (strcmp("stats", cmd) == 0) 
+        {
+            char** lines;
+            int n_lines;
+
+            // Mostra le statistiche di gioco delle room
+            switch(reqRoomStats(sd, &lines, &n_lines))
+            {
+                case OK: {
+                    printf("\n");
+                    if (n_lines == 0)
+                        printf("Nessuna partita giocata\n");
+                    for (i = 0; i < n_lines; i++)
+                        printf("%s\n", lines[i]);
+                    printf("\n");
+                    freeList(lines, n_lines);
+                    break;
+                }
+                case NET_ERR_REMOTE_SOCKET_CLOSED: {
+                    plog(LOG_CUSTOM_ERROR, "Server disconnesso");
+                    pressEnterToContinue();
+                    freeList(users_list, n);
+                    return false;
+                }
+                default: {
+                    plog(LOG_CUSTOM_ERROR, "Si è verificato un problema durante la richiesta");
+                    break;
+                }
+            }
+            pressEnterToContinue();
+        }
     }
 }
 
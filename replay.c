@@ -0,0 +1,461 @@
+#define REPLAY_MAX_REPORTED 20                      // Divergenze riportate in dettaglio
+#define REPLAY_MIN_CLIENTS 256                      // Dimensione iniziale della tabella dei giocatori
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "lib/utils.h"
+#include "lib/game/server.h"
+
+/*
+ * Strumento di riesecuzione degli eventi registrati dal server.
+ *
+ * Legge un file di eventi (scritto dal server con l'opzione -e, oppure con il comando "events" da standard input)
+ * e passa ogni comando agli stessi gestori del server, con un orologio virtuale fermo all'istante registrato
+ * per l'evento. Ogni giocatore ha una connessione simulata da una coppia di socket locali, le cui risposte vengono
+ * lette e scartate. Dopo ogni evento lo stato della sessione viene confrontato con quello registrato.
+ *
+ * I token di ripresa generati durante la riesecuzione sono diversi da quelli registrati: le richieste di ripresa
+ * vengono tradotte usando il token registrato all'avvio della sessione.
+ *
+ * Uso: ./replay <file di eventi>
+ */
+
+typedef struct                                      // Giocatore che compare negli eventi
+{
+    char username[MAX_USR_DIM];
+    int sd;                                         // Estremo della connessione usato dal server, -1 se non connesso
+    int peer;                                       // Estremo da cui vengono lette le risposte
+    char recorded_token[RESUME_TOKEN_DIM];          // Token di ripresa registrato per la sessione
+    char replay_token[RESUME_TOKEN_DIM];            // Token di ripresa della stessa sessione nella riesecuzione
+}
+replay_client;
+
+typedef struct                                      // Tabella dei giocatori (indirizzamento aperto)
+{
+    replay_client* clients;                         // Celle, libere se username è vuoto
+    size_t capacity;                                // Potenza di 2
+    size_t n_clients;
+}
+client_table;
+
+static const char* event_names[] = {
+    "BOOT", "START", "RESUME", "DETACH", "EXPIRE", "LOOK", "OBJS", "USE", "TAKE", "DROP", "PUZZLE", "HELP", "END", "SU_TIME", "SU_HELP"
+};
+
+static replay_client* find_client(client_table* table, const char* username);
+static bool grow_table(client_table* table);
+static bool connect_client(replay_client* client);
+static void disconnect_client(replay_client* client);
+static bool open_pair(int* sd, int* peer);
+static size_t drain(int peer);
+static void replay_event(client_table* table, const game_event* event, int* supervisor, int* supervisor_peer);
+static bool same_state(const game_event_state* expected, const game_event_state* actual);
+static void print_divergence(FILE* out, const game_event* event, const game_event_state* actual);
+static double elapsed_seconds(const struct timespec* start);
+
+static size_t n_bytes = 0;                          // Byte delle risposte inviate dai gestori
+
+int main(int argc, char* args[])
+{
+    game_event_file_header header;
+    game_event event;
+    game_event_state actual;
+    client_table table = { 0 };
+    struct timespec start;
+    unsigned long n_events = 0, n_diverged = 0;
+    int64_t last_timestamp = 0, span = 0;
+    int supervisor = -1, supervisor_peer = -1;
+    char error[ROOM_ERROR_DIM];
+    FILE *in, *out;
+
+    if (argc != 2) {
+        printf("Usage:\t%s <events file>\n", args[0]);
+        return 0;
+    }
+
+    in = event_file_open(args[1], &header);
+    if (in == NULL) {
+        printf("Error:\tcannot read the events in %s\n", args[1]);
+        return 1;
+    }
+
+    // I messaggi della modalità verbose dei gestori vengono scartati, il riepilogo va sullo standard output originale
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    if (out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        printf("Error:\tcannot redirect the standard output\n");
+        return 1;
+    }
+
+    if (!initRooms(ROOMS_PACK, ROOMS_DIR, error, sizeof(error))) {
+        fprintf(out, "Error:\t%s\n", error);
+        return 1;
+    }
+    if (!grow_table(&table)) {
+        fprintf(out, "Error:\tinitialization failed\n");
+        return 1;
+    }
+    setSessionGracePeriod(header.grace_seconds);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (event_file_read(in, &event))
+    {
+        // L'orologio monotono riparte a ogni avvio del server: le sessioni vengono sospese all'istante
+        // dell'ultimo evento del vecchio avvio e il tempo registrato somma solo gli intervalli di uno stesso avvio
+        if (n_events > 0 && event.type != EV_BOOT)
+            span += event.timestamp - last_timestamp;
+        last_timestamp = event.timestamp;
+        n_events++;
+
+        if (event.type == EV_BOOT) {
+            replay_event(&table, &event, &supervisor, &supervisor_peer);
+            setVirtualClock(event.timestamp);
+            continue;
+        }
+
+        // L'orologio virtuale resta fermo all'istante dell'evento per tutta la sua esecuzione
+        setVirtualClock(event.timestamp);
+        replay_event(&table, &event, &supervisor, &supervisor_peer);
+
+        sessionEventState(event.username, &actual);
+        if (!same_state(&event.state, &actual)) {
+            if (n_diverged < REPLAY_MAX_REPORTED)
+                print_divergence(out, &event, &actual);
+            n_diverged++;
+        }
+
+        if (event.type == EV_START && event.state.room >= 0 && actual.room >= 0)
+        {
+            // Associazione tra il token registrato e quello generato, per le riprese successive
+            replay_client* client = find_client(&table, event.username);
+            if (client != NULL) {
+                strcpy(client->recorded_token, event.state.resume_token);
+                strcpy(client->replay_token, actual.resume_token);
+            }
+        }
+
+        // Senza una sessione la connessione del giocatore non serve più: verrà riaperta dal prossimo comando
+        if (actual.room < 0) {
+            replay_client* client = find_client(&table, event.username);
+            if (client != NULL)
+                disconnect_client(client);
+        }
+    }
+    fclose(in);
+
+    // Riepilogo
+    {
+        double seconds = elapsed_seconds(&start);
+        double span_seconds = span / 1000.0;
+
+        fprintf(out, "Events replayed:           %lu\n", n_events);
+        fprintf(out, "Diverged:                  %lu\n", n_diverged);
+        fprintf(out, "Players:                   %zu\n", table.n_clients);
+        fprintf(out, "Reply bytes:               %zu\n", n_bytes);
+        fprintf(out, "Recorded span:             %.3f s\n", span_seconds);
+        fprintf(out, "Elapsed:                   %.3f s (%.0f events/s", seconds, seconds > 0 ? n_events / seconds : 0.0);
+        if (seconds > 0 && span_seconds > 0)
+            fprintf(out, ", %.0fx real time", span_seconds / seconds);
+        fprintf(out, ")\n");
+    }
+    fclose(out);
+    return n_diverged == 0 ? 0 : 1;
+}
+
+/*
+ * Esegue un evento con i gestori del server, come farebbe il ciclo principale alla ricezione del comando.
+ */
+static void replay_event(client_table* table, const game_event* event, int* supervisor, int* supervisor_peer)
+{
+    replay_client* client;
+    size_t i;
+
+    switch (event->type)
+    {
+        case EV_BOOT:
+        {
+            // Al riavvio del server tutte le sessioni ripristinate restano senza connessione
+            for (i = 0; i < table->capacity; i++)
+                if (table->clients[i].username[0] != '\0')
+                    disconnect_client(&table->clients[i]);
+            return;
+        }
+        case EV_EXPIRE:
+        {
+            expireSessions();
+            return;
+        }
+        case EV_SU_TIME:
+        case EV_SU_HELP:
+        {
+            char username[MAX_USR_DIM];
+
+            if (*supervisor < 0) {
+                if (!open_pair(supervisor, supervisor_peer))
+                    return;
+                authUserConnected(*supervisor);
+                authSupervisor(*supervisor);
+            }
+
+            // Stessa lettura degli argomenti del ciclo principale del server
+            memset(username, '\0', 1);
+            sscanf(event->args, "%s", username);
+            if (event->type == EV_SU_TIME) {
+                int seconds = -1;
+                sscanf(event->args, "%s %d", username, &seconds);
+                alterSessionTime(*supervisor, username, event->args[0] != '\0' ? event->args[strlen(event->args) - 1] : '\0', seconds);
+            } else {
+                char help_msg[MAX_HELP_DIM];
+                substring(event->args, strlen(username) + 1, MAX_HELP_DIM - 1, help_msg);
+                setUserSessionHelp(*supervisor, username, help_msg);
+            }
+            n_bytes += drain(*supervisor_peer);
+            return;
+        }
+        default:
+            break;
+    }
+
+    client = find_client(table, event->username);
+    if (client == NULL)
+        return;
+
+    if (event->type == EV_DETACH) {
+        disconnect_client(client);
+        return;
+    }
+
+    if (client->sd < 0 && !connect_client(client))
+        return;
+
+    switch (event->type)
+    {
+        case EV_START:
+        {
+            int room = -1;
+            sscanf(event->args, "%d", &room);
+            startGame(client->sd, room);
+            break;
+        }
+        case EV_RESUME:
+        {
+            char resume_token[RESUME_TOKEN_DIM];
+            memset(resume_token, '\0', 1);
+            sscanf(event->args, "%32s", resume_token);
+            if (client->recorded_token[0] != '\0' && strcmp(resume_token, client->recorded_token) == 0)
+                strcpy(resume_token, client->replay_token);
+            resumeGame(client->sd, resume_token);
+            break;
+        }
+        case EV_LOOK:
+        {
+            char what[MAX_NAME_DIM];
+            memset(what, '\0', 1);
+            sscanf(event->args, "%19s", what);
+            cmdLook(client->sd, what);
+            break;
+        }
+        case EV_OBJS:
+        {
+            cmdObjs(client->sd);
+            break;
+        }
+        case EV_USE:
+        {
+            char obj1[MAX_NAME_DIM], obj2[MAX_NAME_DIM];
+            memset(obj1, '\0', 1); memset(obj2, '\0', 1);
+            sscanf(event->args, "%19s %19s", obj1, obj2);
+            cmdUse(client->sd, obj1, obj2);
+            break;
+        }
+        case EV_TAKE:
+        case EV_DROP:
+        {
+            char obj[MAX_NAME_DIM];
+            memset(obj, '\0', 1);
+            sscanf(event->args, "%19s", obj);
+            if (event->type == EV_TAKE)
+                cmdTake(client->sd, obj);
+            else
+                cmdDrop(client->sd, obj);
+            break;
+        }
+        case EV_PUZZLE:
+        {
+            char obj[MAX_NAME_DIM], solution[MAX_PUZZLE_SOL_DIM];
+            memset(obj, '\0', 1); memset(solution, '\0', 1);
+            sscanf(event->args, "%19s %49s", obj, solution);
+            checkPuzzleSolution(client->sd, obj, solution);
+            break;
+        }
+        case EV_HELP:
+        {
+            int last_help_msg_id = 0;
+            sscanf(event->args, "%d", &last_help_msg_id);
+            cmdHelp(client->sd, last_help_msg_id);
+            break;
+        }
+        case EV_END:
+        {
+            cmdEnd(client->sd);
+            break;
+        }
+        default:
+            break;
+    }
+    n_bytes += drain(client->peer);
+}
+
+static bool same_state(const game_event_state* expected, const game_event_state* actual)
+{
+    if (expected->room != actual->room)
+        return false;
+    if (expected->room < 0)
+        return true;
+
+    // Il token di ripresa è casuale e non viene confrontato
+    return expected->token == actual->token && expected->n_bag_objs == actual->n_bag_objs &&
+        expected->help_msg_id == actual->help_msg_id && expected->paused == actual->paused &&
+        expected->remaining == actual->remaining && expected->objs_hash == actual->objs_hash;
+}
+
+static void print_divergence(FILE* out, const game_event* event, const game_event_state* actual)
+{
+    const game_event_state* expected = &event->state;
+    const char* name = event->type >= 0 && event->type <= EV_SU_HELP ? event_names[event->type] : "?";
+
+    fprintf(out, "Event %llu (%s, %s, \"%s\") diverged:\n", (unsigned long long)event->seq, name, event->username, event->args);
+    fprintf(out, "    recorded: room %d, token %d, bag %d, help %d, paused %d, remaining %lld ms, objs %08x\n",
+        expected->room, expected->token, expected->n_bag_objs, expected->help_msg_id,
+        expected->paused, (long long)expected->remaining, expected->objs_hash);
+    fprintf(out, "    replayed: room %d, token %d, bag %d, help %d, paused %d, remaining %lld ms, objs %08x\n",
+        actual->room, actual->token, actual->n_bag_objs, actual->help_msg_id,
+        actual->paused, (long long)actual->remaining, actual->objs_hash);
+}
+
+//-------Clients-------//
+
+static bool open_pair(int* sd, int* peer)
+{
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return false;
+
+    // Il server può indicizzare solo descrittori minori di MAX_CONNS
+    if (fds[0] >= MAX_CONNS) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    *sd = fds[0];
+    *peer = fds[1];
+    return true;
+}
+
+/*
+ * Apre la connessione simulata del giocatore e la autentica, come dopo un login riuscito.
+ */
+static bool connect_client(replay_client* client)
+{
+    if (!open_pair(&client->sd, &client->peer)) {
+        client->sd = -1;
+        return false;
+    }
+
+    authUserConnected(client->sd);
+    authUserSuccess(client->sd, client->username);
+    n_bytes += drain(client->peer);
+    return true;
+}
+
+static void disconnect_client(replay_client* client)
+{
+    if (client->sd < 0)
+        return;
+
+    authUserDisconnected(client->sd);
+    close(client->sd);
+    close(client->peer);
+    client->sd = -1;
+    client->peer = -1;
+}
+
+// Legge e scarta le risposte in attesa, restituendo i byte letti
+static size_t drain(int peer)
+{
+    char buffer[4096];
+    size_t total = 0;
+    ssize_t ret;
+
+    while ((ret = read(peer, buffer, sizeof(buffer))) > 0)
+        total += ret;
+    return total;
+}
+
+//-------Client table-------//
+
+/*
+ * Restituisce il giocatore con lo username specificato, inserendolo se non esiste.
+ *
+ * Restituisce:
+ *   - Il giocatore, o NULL in caso di errore nell'allocazione di memoria.
+ */
+static replay_client* find_client(client_table* table, const char* username)
+{
+    size_t i;
+
+    if ((table->n_clients + 1) * 2 > table->capacity && !grow_table(table))
+        return NULL;
+
+    i = hash_string(username) & (table->capacity - 1);
+    while (table->clients[i].username[0] != '\0' && strcmp(table->clients[i].username, username) != 0)
+        i = (i + 1) & (table->capacity - 1);
+
+    if (table->clients[i].username[0] == '\0')
+    {
+        replay_client* client = &table->clients[i];
+        memset(client, 0, sizeof(replay_client));
+        strncpy(client->username, username, MAX_USR_DIM - 1);
+        client->sd = -1;
+        client->peer = -1;
+        table->n_clients++;
+    }
+    return &table->clients[i];
+}
+
+static bool grow_table(client_table* table)
+{
+    size_t capacity = table->capacity > 0 ? table->capacity * 2 : REPLAY_MIN_CLIENTS, i, j;
+    replay_client* clients = calloc(capacity, sizeof(replay_client));
+
+    if (clients == NULL)
+        return false;
+
+    for (i = 0; i < table->capacity; i++)
+    {
+        if (table->clients[i].username[0] == '\0')
+            continue;
+        j = hash_string(table->clients[i].username) & (capacity - 1);
+        while (clients[j].username[0] != '\0')
+            j = (j + 1) & (capacity - 1);
+        clients[j] = table->clients[i];
+    }
+
+    free(table->clients);
+    table->clients = clients;
+    table->capacity = capacity;
+    return true;
+}
+
+static double elapsed_seconds(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+//----------------------//
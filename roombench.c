@@ -0,0 +1,598 @@
+#define ROOMBENCH_DEFAULT_REPS 100                  // Caricamenti di ogni room se non indicato
+#define ROOMBENCH_USE_SWEEPS   10                   // Passate su tutte le coppie di oggetti per misurare la ricerca degli usi
+#define ROOMBENCH_NAME_SWEEPS  10                   // Passate su tutti i nomi di oggetti e locazioni per misurare la ricerca dei nomi
+#define ROOMBENCH_COMMANDS     20000                // Comandi misurati per ogni numero di sessioni
+#define ROOMBENCH_SESSION_STEPS 6
+#define ROOMBENCH_CHURN_GAMES  10000                // Partite avviate e terminate per misurare le allocazioni
+#define ROOMBENCH_COLD_COMMANDS 200                 // Comandi misurati a cache fredde, ognuno dopo aver svuotato le cache
+#define ROOMBENCH_EVICT_BYTES  (64 << 20)           // Memoria scritta per svuotare le cache, più grande dell'ultimo livello
+#define ROOMBENCH_N_COMMANDS   4
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "lib/utils.h"
+#include "lib/game/roomfile.h"
+#include "lib/game/server.h"
+
+/*
+ * Strumento di misura del caricamento delle room.
+ *
+ * Carica più volte ogni file di definizione di una cartella, come fa il server all'avvio, e misura separatamente
+ * lettura e validazione del file, compilazione dell'immagine e preparazione della vista. Il riepilogo riporta
+ * il tempo medio per room e quello di un caricamento completo della cartella.
+ *
+ * Misura anche la ricerca dell'uso di un comando use su tutte le coppie di oggetti di ogni room, confrontando
+ * la tabella degli usi con la scansione degli usi dell'oggetto. Allo stesso modo cerca il nome di ogni oggetto
+ * e di ogni locazione, più un nome assente, confrontando l'indice dei nomi con la scansione di locazioni e oggetti:
+ * per le room con migliaia di oggetti si può usare una cartella generata da roomgen.
+ *
+ * Infine carica le room con i gestori del server e misura il costo dei comandi di una partita nella prima room,
+ * mentre il numero delle altre sessioni (in attesa di essere riprese) cresce fino a 50000.
+ * Le connessioni sono simulate da coppie di socket locali, come nello strumento replay.
+ * Con tutte le sessioni ancora in attesa, avvia e termina ripetutamente una partita e conta le allocazioni
+ * di memoria per partita: il linker reindirizza malloc, calloc e realloc ai contatori di questo file (-Wl,--wrap).
+ * Misura poi gli stessi comandi a cache calde, ripetendoli di seguito, e a cache fredde, scrivendo prima di ognuno
+ * una zona di memoria più grande dell'ultimo livello di cache. Dove il kernel lo consente riporta anche i cache miss
+ * per comando letti dal contatore hardware (perf_event_open), altrimenti "n/a".
+ *
+ * Uso: ./roombench <cartella delle room> [ripetizioni]
+ */
+
+static void bench_uses(const room_view* view, uint64_t* table_ns, uint64_t* scan_ns, uint64_t* n_lookups, uint64_t* n_found);
+static const room_use* scan_use(const room_view* view, uint32_t obj, uint32_t other_obj);
+static void bench_names(const room_view* view, uint64_t* index_ns, uint64_t* scan_ns, uint64_t* n_lookups);
+static bool scan_name(const room_view* view, const char* name, uint32_t* obj, uint32_t* location);
+static bool bench_sessions(const char* dir, const char* obj_name);
+static void run_command(int c, int sd, int su, const char* obj_name);
+static bool bench_cache(int sd, int peer, int su, int su_peer, const char* obj_name,
+    double ns[2][ROOMBENCH_N_COMMANDS], double misses[2][ROOMBENCH_N_COMMANDS]);
+static int open_miss_counter();
+static uint64_t read_counter(int fd);
+static bool open_pair(int* sd, int* peer);
+static void drain(int peer);
+static uint64_t clock_ns();
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static unsigned long n_allocs = 0;                  // Chiamate a malloc, calloc e realloc
+
+int main(int argc, char* args[])
+{
+    char** paths;
+    char error[ROOM_ERROR_DIM];
+    uint64_t load_ns = 0, compile_ns = 0, attach_ns = 0, max_ns = 0;
+    uint64_t table_ns = 0, scan_ns = 0, n_lookups = 0, n_found = 0;
+    uint64_t name_index_ns = 0, name_scan_ns = 0, n_name_lookups = 0;
+    uint32_t max_objs = 0;
+    size_t image_bytes = 0;
+    unsigned long n_objs = 0;
+    char obj_name[MAX_NAME_DIM] = "";
+    int n_paths, reps = ROOMBENCH_DEFAULT_REPS, i, r;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage:\t%s <rooms dir> [repetitions]\n", args[0]);
+        return 0;
+    }
+    if (argc == 3 && (sscanf(args[2], "%d", &reps) != 1 || reps <= 0)) {
+        printf("Error:\trepetitions not valid\n");
+        return 1;
+    }
+
+    n_paths = room_dir_list(args[1], &paths);
+    if (n_paths <= 0) {
+        printf("Error:\tno room definitions in %s\n", args[1]);
+        return 1;
+    }
+
+    for (r = 0; r < reps; r++)
+    {
+        for (i = 0; i < n_paths; i++)
+        {
+            uint64_t t0 = clock_ns(), t1, t2, t3;
+            game_room_def* def = room_def_load(paths[i], error, sizeof(error));
+            room_view view;
+            size_t size;
+            void* image;
+
+            if (def == NULL) {
+                printf("Error:\t%s\n", error);
+                room_dir_free(paths, n_paths);
+                return 1;
+            }
+            t1 = clock_ns();
+            image = room_compile(def, &size);
+            t2 = clock_ns();
+            if (image == NULL || !room_attach(&view, image, size)) {
+                printf("Error:\t%s: compilation failed\n", paths[i]);
+                room_def_free(def);
+                free(image);
+                room_dir_free(paths, n_paths);
+                return 1;
+            }
+            t3 = clock_ns();
+
+            load_ns += t1 - t0;
+            compile_ns += t2 - t1;
+            attach_ns += t3 - t2;
+            if (t3 - t0 > max_ns)
+                max_ns = t3 - t0;
+            if (r == 0 && i == 0 && view.header->n_objs > 0)
+                snprintf(obj_name, sizeof(obj_name), "%s", room_str(&view, view.obj_texts[0].name));
+            if (r == 0) {
+                image_bytes += size;
+                n_objs += view.header->n_objs;
+                if (view.header->n_objs > max_objs)
+                    max_objs = view.header->n_objs;
+                bench_uses(&view, &table_ns, &scan_ns, &n_lookups, &n_found);
+                bench_names(&view, &name_index_ns, &name_scan_ns, &n_name_lookups);
+            }
+
+            room_def_free(def);
+            free(image);
+        }
+    }
+    room_dir_free(paths, n_paths);
+
+    // Riepilogo
+    {
+        double n_loads = (double)n_paths * reps;
+        double total_ns = load_ns + compile_ns + attach_ns;
+
+        printf("Rooms:                     %d (%lu objects, up to %u per room, %zu image bytes)\n", n_paths, n_objs, max_objs, image_bytes);
+        printf("Repetitions:               %d\n", reps);
+        printf("Read and parse:            %.1f us/room\n", load_ns / n_loads / 1e3);
+        printf("Compile:                   %.1f us/room\n", compile_ns / n_loads / 1e3);
+        printf("Attach:                    %.1f us/room\n", attach_ns / n_loads / 1e3);
+        printf("Slowest room:              %.1f us\n", max_ns / 1e3);
+        printf("Full directory:            %.3f ms (%.0f rooms/s)\n", total_ns / reps / 1e6, n_loads / (total_ns / 1e9));
+        printf("Use lookups:               %llu (%llu found)\n", (unsigned long long)n_lookups, (unsigned long long)n_found);
+        printf("Use lookup, table:         %.1f ns\n", (double)table_ns / n_lookups);
+        printf("Use lookup, scan:          %.1f ns\n", (double)scan_ns / n_lookups);
+        printf("Name lookups:              %llu\n", (unsigned long long)n_name_lookups);
+        printf("Name lookup, index:        %.1f ns\n", (double)name_index_ns / n_name_lookups);
+        printf("Name lookup, scan:         %.1f ns\n", (double)name_scan_ns / n_name_lookups);
+    }
+    return bench_sessions(args[1], obj_name) ? 0 : 1;
+}
+
+/*
+ * Misura i comandi di una partita nella prima room, con un numero crescente di altre sessioni in attesa di essere
+ * riprese. Per ogni comando il tempo comprende la ricerca della sessione (per socket, o per username nel caso
+ * della richiesta del supervisore), l'esecuzione e l'invio della risposta sul socket locale.
+ */
+static bool bench_sessions(const char* dir, const char* obj_name)
+{
+    static const int counts[ROOMBENCH_SESSION_STEPS] = { 0, 10, 100, 1000, 10000, 50000 };
+    static const char* cmd_names[ROOMBENCH_N_COMMANDS] = { "look", "look <obj>", "objs", "su data" };
+    static const char* cache_names[2] = { "hot", "cold" };
+    double results[ROOMBENCH_SESSION_STEPS][ROOMBENCH_N_COMMANDS];
+    double cache_ns[2][ROOMBENCH_N_COMMANDS], cache_misses[2][ROOMBENCH_N_COMMANDS];
+    unsigned long first_allocs = 0, churn_allocs = 0;
+    uint64_t churn_ns = 0;
+    char error[ROOM_ERROR_DIM] = "", username[MAX_USR_DIM];
+    int sd, peer, su, su_peer, saved, n_sessions = 0, step, c, i;
+    bool ok = true;
+
+    // I messaggi della modalità verbose dei gestori vengono scartati
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    if (saved < 0 || freopen("/dev/null", "w", stdout) == NULL) {
+        printf("Error:\tcannot redirect the standard output\n");
+        return false;
+    }
+
+    if (!initRooms(NULL, dir, error, sizeof(error)) || !open_pair(&su, &su_peer)) {
+        ok = false;
+        goto restore;
+    }
+    authUserConnected(su);
+    authSupervisor(su);
+    drain(su_peer);
+    setSessionGracePeriod(SESSION_GRACE_SECONDS);
+
+    for (step = 0; ok && step < ROOMBENCH_SESSION_STEPS; step++)
+    {
+        uint64_t total[ROOMBENCH_N_COMMANDS] = { 0 };
+
+        // Le altre sessioni restano in attesa di essere riprese, la loro connessione viene chiusa
+        for (; ok && n_sessions < counts[step]; n_sessions++)
+        {
+            snprintf(username, sizeof(username), "parked%d", n_sessions);
+            ok = open_pair(&sd, &peer);
+            if (!ok)
+                break;
+            authUserConnected(sd);
+            authUserSuccess(sd, username);
+            ok = startGame(sd, 0) == OK;
+            authUserDisconnected(sd);
+            close(sd);
+            close(peer);
+        }
+        if (!ok)
+            break;
+
+        // Partita misurata
+        ok = open_pair(&sd, &peer);
+        if (!ok)
+            break;
+        authUserConnected(sd);
+        authUserSuccess(sd, "probe");
+        ok = startGame(sd, 0) == OK;
+        drain(peer);
+
+        for (i = 0; ok && i < ROOMBENCH_COMMANDS; i++)
+        {
+            for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+            {
+                uint64_t t0 = clock_ns();
+                run_command(c, sd, su, obj_name);
+                total[c] += clock_ns() - t0;
+                drain(c == 3 ? su_peer : peer);
+            }
+        }
+        for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+            results[step][c] = (double)total[c] / ROOMBENCH_COMMANDS;
+
+        cmdEnd(sd);
+        drain(peer);
+        if (step < ROOMBENCH_SESSION_STEPS - 1) {
+            authUserDisconnected(sd);
+            close(sd);
+            close(peer);
+        }
+    }
+
+    // Partite avviate e terminate sulla stessa connessione: la prima può ancora riempire le cache del server
+    for (i = 0; ok && i <= ROOMBENCH_CHURN_GAMES; i++)
+    {
+        unsigned long allocs = n_allocs;
+        uint64_t t0 = clock_ns();
+
+        ok = startGame(sd, 0) == OK && cmdEnd(sd) == OK;
+        if (i > 0) {
+            churn_ns += clock_ns() - t0;
+            churn_allocs += n_allocs - allocs;
+        }
+        else
+            first_allocs = n_allocs - allocs;
+        drain(peer);
+    }
+    if (ok)
+        ok = bench_cache(sd, peer, su, su_peer, obj_name, cache_ns, cache_misses);
+    if (ok) {
+        authUserDisconnected(sd);
+        close(sd);
+        close(peer);
+    }
+
+restore:
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    if (!ok) {
+        printf("Error:\tsession benchmark failed after %d sessions%s%s\n", n_sessions, error[0] != '\0' ? ": " : "", error);
+        return false;
+    }
+
+    printf("\n%-16s", "Other sessions");
+    for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+        printf("%14s", cmd_names[c]);
+    printf("   (ns per command)\n");
+    for (step = 0; step < ROOMBENCH_SESSION_STEPS; step++)
+    {
+        printf("%-16d", counts[step]);
+        for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+            printf("%14.0f", results[step][c]);
+        printf("\n");
+    }
+    printf("\nStart and end a game:      %.0f ns, %.2f allocations (first game: %lu)\n",
+        (double)churn_ns / ROOMBENCH_CHURN_GAMES, (double)churn_allocs / ROOMBENCH_CHURN_GAMES, first_allocs);
+
+    printf("\n%-16s", "Caches");
+    for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+        printf("%14s", cmd_names[c]);
+    printf("   (ns and cache misses per command)\n");
+    for (i = 0; i < 2; i++)
+    {
+        printf("%-16s", cache_names[i]);
+        for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+            printf("%14.0f", cache_ns[i][c]);
+        printf("\n%-16s", "  misses");
+        for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+        {
+            if (cache_misses[i][c] < 0)
+                printf("%14s", "n/a");
+            else
+                printf("%14.1f", cache_misses[i][c]);
+        }
+        printf("\n");
+    }
+    return true;
+}
+
+static void run_command(int c, int sd, int su, const char* obj_name)
+{
+    switch (c)
+    {
+        case 0: cmdLook(sd, ""); break;
+        case 1: cmdLook(sd, obj_name); break;
+        case 2: cmdObjs(sd); break;
+        case 3: sendUserSessionData(su, "probe"); break;
+    }
+}
+
+/*
+ * Misura i comandi in una nuova partita della sessione sd, a cache calde e a cache fredde.
+ *
+ * Parametri:
+ *   - ns: Tempo medio per comando, [0] a cache calde e [1] a cache fredde.
+ *   - misses: Cache miss medi per comando, negativi se il contatore hardware non è disponibile.
+ *
+ * Restituisce:
+ *   - false se non è stato possibile avviare la partita o allocare la memoria per svuotare le cache.
+ */
+static bool bench_cache(int sd, int peer, int su, int su_peer, const char* obj_name,
+    double ns[2][ROOMBENCH_N_COMMANDS], double misses[2][ROOMBENCH_N_COMMANDS])
+{
+    volatile char* evict = malloc(ROOMBENCH_EVICT_BYTES);
+    int counter = open_miss_counter(), cold, c, i;
+
+    if (evict == NULL || startGame(sd, 0) != OK) {
+        free((void*)evict);
+        if (counter >= 0)
+            close(counter);
+        return false;
+    }
+    drain(peer);
+
+    for (cold = 0; cold < 2; cold++)
+    {
+        int n = cold ? ROOMBENCH_COLD_COMMANDS : ROOMBENCH_COMMANDS;
+
+        for (c = 0; c < ROOMBENCH_N_COMMANDS; c++)
+        {
+            uint64_t total_ns = 0, total_misses = 0;
+
+            // Il primo comando porta in cache i dati della sessione anche nella misura a cache calde
+            run_command(c, sd, su, obj_name);
+            drain(c == 3 ? su_peer : peer);
+
+            for (i = 0; i < n; i++)
+            {
+                uint64_t t0, m0;
+                size_t b;
+
+                if (cold)
+                    for (b = 0; b < ROOMBENCH_EVICT_BYTES; b += 64)
+                        evict[b] = (char)i;
+
+                m0 = read_counter(counter);
+                t0 = clock_ns();
+                run_command(c, sd, su, obj_name);
+                total_ns += clock_ns() - t0;
+                total_misses += read_counter(counter) - m0;
+                drain(c == 3 ? su_peer : peer);
+            }
+            ns[cold][c] = (double)total_ns / n;
+            misses[cold][c] = counter >= 0 ? (double)total_misses / n : -1;
+        }
+    }
+
+    cmdEnd(sd);
+    drain(peer);
+    free((void*)evict);
+    if (counter >= 0)
+        close(counter);
+    return true;
+}
+
+/*
+ * Apre il contatore hardware dei cache miss del processo, solo in spazio utente: con perf_event_paranoid
+ * fino a 2 non servono privilegi.
+ *
+ * Restituisce:
+ *   - Il descrittore del contatore, già avviato, oppure -1 se il kernel o la macchina non lo consentono.
+ */
+static int open_miss_counter()
+{
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // Il contatore parte già avviato, attr.disabled è 0
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd;
+}
+
+static uint64_t read_counter(int fd)
+{
+    uint64_t value = 0;
+
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+static bool open_pair(int* sd, int* peer)
+{
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return false;
+
+    // Il server può indicizzare solo descrittori minori di MAX_CONNS
+    if (fds[0] >= MAX_CONNS) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    *sd = fds[0];
+    *peer = fds[1];
+    return true;
+}
+
+// Legge e scarta le risposte in attesa
+static void drain(int peer)
+{
+    char buffer[4096];
+
+    while (read(peer, buffer, sizeof(buffer)) > 0);
+}
+
+/*
+ * Cerca l'uso di ogni oggetto da solo e combinato con ogni altro oggetto, prima con la tabella degli usi
+ * e poi con la scansione, e somma i tempi.
+ */
+static void bench_uses(const room_view* view, uint64_t* table_ns, uint64_t* scan_ns, uint64_t* n_lookups, uint64_t* n_found)
+{
+    uint32_t n = view->header->n_objs, o1, o2;
+    uint64_t found_table = 0, found_scan = 0, t0;
+    int s;
+
+    t0 = clock_ns();
+    for (s = 0; s < ROOMBENCH_USE_SWEEPS; s++)
+        for (o1 = 0; o1 < n; o1++)
+            for (o2 = 0; o2 <= n; o2++)
+                found_table += room_find_use(view, o1, o2 == n ? ROOM_NO_OBJ : o2) != NULL;
+    *table_ns += clock_ns() - t0;
+
+    t0 = clock_ns();
+    for (s = 0; s < ROOMBENCH_USE_SWEEPS; s++)
+        for (o1 = 0; o1 < n; o1++)
+            for (o2 = 0; o2 <= n; o2++)
+                found_scan += scan_use(view, o1, o2 == n ? ROOM_NO_OBJ : o2) != NULL;
+    *scan_ns += clock_ns() - t0;
+
+    if (found_table != found_scan)
+        printf("Error:\tuse table and scan disagree (%llu vs %llu)\n", (unsigned long long)found_table, (unsigned long long)found_scan);
+    *n_lookups += (uint64_t)ROOMBENCH_USE_SWEEPS * n * (n + 1);
+    *n_found += found_table;
+}
+
+// Ricerca dell'uso scandendo gli usi dell'oggetto, come faceva il server prima della tabella
+static const room_use* scan_use(const room_view* view, uint32_t obj, uint32_t other_obj)
+{
+    const room_obj* info = &view->objs[obj];
+    uint32_t i;
+
+    for (i = 0; i < info->n_uses; i++)
+    {
+        const room_use* use = &view->uses[info->first_use + i];
+        if (other_obj == ROOM_NO_OBJ ? use->type == USE_ALONE : use->type == USE_COMBINE && use->other_obj == other_obj)
+            return use;
+    }
+    return NULL;
+}
+
+/*
+ * Cerca il nome di ogni oggetto, di ogni locazione e un nome assente, prima con l'indice dei nomi
+ * e poi con la scansione, e somma i tempi.
+ */
+static void bench_names(const room_view* view, uint64_t* index_ns, uint64_t* scan_ns, uint64_t* n_lookups)
+{
+    uint32_t n_objs = view->header->n_objs, n = n_objs + view->header->n_locations + 1, i;
+    uint64_t mismatches = 0, t0;
+    const char** names;
+    int s;
+
+    names = malloc(n * sizeof(char*));
+    if (names == NULL)
+        return;
+    for (i = 0; i < n_objs; i++)
+        names[i] = room_str(view, view->obj_texts[i].name);
+    for (i = 0; i < view->header->n_locations; i++)
+        names[n_objs + i] = room_str(view, view->locations[i].name);
+    names[n - 1] = "roombench-absent-name";
+
+    t0 = clock_ns();
+    for (s = 0; s < ROOMBENCH_NAME_SWEEPS; s++)
+        for (i = 0; i < n; i++)
+        {
+            const room_name_slot* slot = room_find_name(view, names[i]);
+            mismatches += (slot == NULL) != (i == n - 1);
+        }
+    *index_ns += clock_ns() - t0;
+
+    t0 = clock_ns();
+    for (s = 0; s < ROOMBENCH_NAME_SWEEPS; s++)
+        for (i = 0; i < n; i++)
+        {
+            uint32_t obj, location;
+            mismatches += scan_name(view, names[i], &obj, &location) != (i != n - 1);
+        }
+    *scan_ns += clock_ns() - t0;
+
+    // Gli esiti delle due ricerche devono coincidere
+    for (i = 0; i < n; i++)
+    {
+        const room_name_slot* slot = room_find_name(view, names[i]);
+        uint32_t obj, location;
+
+        if (scan_name(view, names[i], &obj, &location) != (slot != NULL) ||
+            (slot != NULL && (slot->obj != obj || slot->location != location)))
+            mismatches++;
+    }
+    if (mismatches > 0)
+        printf("Error:	name index and scan disagree on %llu lookups\n", (unsigned long long)mismatches);
+
+    *n_lookups += (uint64_t)ROOMBENCH_NAME_SWEEPS * n;
+    free(names);
+}
+
+// Ricerca del nome confrontandolo con ogni locazione e con ogni oggetto di ogni locazione, come faceva il server prima dell'indice
+static bool scan_name(const room_view* view, const char* name, uint32_t* obj, uint32_t* location)
+{
+    uint32_t l, i;
+
+    *obj = ROOM_NO_OBJ;
+    *location = ROOM_NO_OBJ;
+    for (l = 0; l < view->header->n_locations; l++)
+    {
+        const room_location* loc = &view->locations[l];
+
+        if (*location == ROOM_NO_OBJ && strcmp(room_str(view, loc->name), name) == 0)
+            *location = l;
+        for (i = 0; *obj == ROOM_NO_OBJ && i < loc->n_objs; i++)
+            if (strcmp(room_str(view, view->obj_texts[loc->first_obj + i].name), name) == 0)
+                *obj = loc->first_obj + i;
+    }
+    return *obj != ROOM_NO_OBJ || *location != ROOM_NO_OBJ;
+}
+
+void* __wrap_malloc(size_t size)
+{
+    n_allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    n_allocs++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    n_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+static uint64_t clock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
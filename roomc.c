@@ -0,0 +1,74 @@
+#include "lib/utils.h"
+#include "lib/game/roomfile.h"
+
+/*
+ * Compilatore delle room.
+ *
+ * Legge e valida i file di definizione di una cartella, nello stesso ordine usato dal server, compila ogni room
+ * nella sua immagine e scrive tutte le immagini in un pacchetto. Il server mappa il pacchetto all'avvio e usa
+ * le immagini così come sono, senza leggere i file di definizione.
+ *
+ * Uso: ./roomc <cartella delle room> <pacchetto>
+ */
+
+int main(int argc, char* args[])
+{
+    char** paths;
+    char error[ROOM_ERROR_DIM];
+    void** images;
+    size_t* sizes;
+    size_t total = 0;
+    int n_paths, i, ret = 0;
+
+    if (argc != 3) {
+        printf("Usage:\t%s <rooms dir> <pack file>\n", args[0]);
+        return 0;
+    }
+
+    n_paths = room_dir_list(args[1], &paths);
+    if (n_paths <= 0) {
+        printf("Error:\tno room definitions in %s\n", args[1]);
+        return 1;
+    }
+
+    images = calloc(n_paths, sizeof(void*));
+    sizes = calloc(n_paths, sizeof(size_t));
+    if (images == NULL || sizes == NULL) {
+        printf("Error:\tout of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < n_paths && ret == 0; i++)
+    {
+        game_room_def* def = room_def_load(paths[i], error, sizeof(error));
+        room_view view;
+
+        if (def == NULL) {
+            printf("Error:\t%s\n", error);
+            ret = 1;
+            break;
+        }
+        images[i] = room_compile(def, &sizes[i]);
+        room_def_free(def);
+        if (images[i] == NULL || !room_attach(&view, images[i], sizes[i])) {
+            printf("Error:\t%s: compilation failed\n", paths[i]);
+            ret = 1;
+            break;
+        }
+        total += sizes[i];
+    }
+
+    if (ret == 0 && !room_pack_write(args[2], images, sizes, n_paths)) {
+        printf("Error:\tcannot write %s\n", args[2]);
+        ret = 1;
+    }
+    if (ret == 0)
+        printf("Compiled %d rooms into %s (%zu image bytes)\n", n_paths, args[2], total);
+
+    for (i = 0; i < n_paths; i++)
+        free(images[i]);
+    free(images);
+    free(sizes);
+    room_dir_free(paths, n_paths);
+    return ret;
+}
@@ -0,0 +1,612 @@
+#define ROOMGEN_MAX_ROOMS   4096                    // Room generate al massimo in una volta
+#define ROOMGEN_MAX_OBJS    100000                  // Oggetti massimi di una room generata
+#define ROOMGEN_MAX_LOCATIONS 10000                 // Locazioni massime di una room generata
+#define ROOMGEN_SECONDS     3600                    // Tempo a disposizione nelle room generate
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/utils.h"
+#include "lib/game/roomfile.h"
+
+/*
+ * Generatore di room.
+ *
+ * Scrive nella cartella indicata room valide e vincibili, con il numero di locazioni e di oggetti richiesto,
+ * per misurare il server e gli strumenti su room più grandi di quelle scritte a mano. Ogni token della room
+ * si ottiene in fondo a una catena di lock lunga quanto la profondità richiesta: ogni anello si sblocca con
+ * una chiave da raccogliere, una leva da usare da sola, un enigma o in cascata con l'anello precedente.
+ * Ogni anello dopo il primo resta nascosto finché l'anello precedente non viene sbloccato, quindi la catena
+ * va risolta tutta e in ordine. Gli oggetti restanti sono di contorno, e solo loro vengono nascosti nella
+ * percentuale richiesta; vengono rivelati dai lock delle catene o dagli usi combinati che non servono a vincere,
+ * tanti per ogni oggetto raccoglibile quanti indicati dal fan-out.
+ *
+ * Accanto a ogni room scrive la sequenza di comandi che la vince, con estensione ROOMGEN_SCRIPT_EXT, che non viene
+ * letta dal server. Ogni riga è un comando: take <oggetto>, use <oggetto> [<oggetto>] oppure answer <oggetto> <risposta>
+ * per la risposta all'enigma di un oggetto. Lo stesso seme produce sempre le stesse room.
+ *
+ * Uso: ./roomgen [-n room] [-s seme] [-l locazioni] [-o oggetti] [-t token] [-d profondità] [-H % nascosti]
+ *                [-f fan-out] [-b zaino] <cartella delle room>
+ */
+#define ROOMGEN_SCRIPT_EXT  ".script"
+
+typedef enum                                        // Modo in cui si sblocca un anello di una catena
+{
+    LINK_KEY,                                       // Chiave da raccogliere e usare con il lock
+    LINK_LEVER,                                     // Leva da usare da sola
+    LINK_PUZZLE,                                    // Enigma sul lock
+    LINK_CASCADE                                    // Sbloccato dallo sblocco dell'anello precedente
+}
+gen_link_type;
+
+typedef struct                                      // Azione di un lock o di un modo d'uso
+{
+    int type;                                       // game_action_type
+    int obj;                                        // Oggetto target, -1 per i token
+}
+gen_action;
+
+typedef struct                                      // Modo d'uso di un oggetto
+{
+    int other;                                      // Oggetto con cui combinarlo, -1 se si usa da solo
+    const char* descr;
+    gen_action* actions;
+    int n_actions;
+}
+gen_use;
+
+typedef struct                                      // Oggetto di una room generata
+{
+    char name[MAX_NAME_DIM];
+    const char* text;                               // Descrizione dell'oggetto sbloccato
+    int location;
+    bool hidden;
+    bool takeable;
+    bool consumable;
+    bool locked;
+    bool puzzle;                                    // Il lock è un enigma, significativo se locked
+    int solution;                                   // Risposta all'enigma, significativa se puzzle
+    bool hinted;                                    // La risposta è scritta su un altro oggetto, significativo se puzzle
+    int hint;                                       // Oggetto di cui mostra la risposta all'enigma una volta sbloccato, -1 se nessuno
+    gen_action* lock_actions;
+    int n_lock_actions;
+    gen_use* uses;
+    int n_uses;
+}
+gen_obj;
+
+typedef struct                                      // Parametri della generazione
+{
+    int n_locations;
+    int n_objs;
+    int n_tokens;                                   // Token necessari per vincere, uno per catena
+    int depth;                                      // Anelli di ogni catena
+    int hidden_pct;                                 // Percentuale degli oggetti di contorno nascosti
+    int fan_out;                                    // Usi combinati di ogni oggetto raccoglibile
+    int dim_bag;
+}
+gen_params;
+
+typedef struct                                      // Room in costruzione
+{
+    uint64_t rng;
+    gen_obj* objs;
+    int n_objs;
+    char** script;                                  // Comandi della soluzione
+    int n_script;
+}
+gen_room;
+
+static bool generate_room(const gen_params* params, uint64_t seed, int index, const char* dir);
+static bool build_chains(gen_room* room, const gen_params* params);
+static bool add_filler(gen_room* room, const gen_params* params, int* locks, int n_locks);
+static int add_obj(gen_room* room, const char* kind, const char* text, int location);
+static bool add_action(gen_action** actions, int* n_actions, int type, int obj);
+static gen_use* add_use(gen_obj* obj, int other, const char* descr);
+static bool add_command(gen_room* room, const char* fmt, ...);
+static bool write_room(const gen_room* room, const gen_params* params, const char* name, const char* path);
+static void write_actions(FILE* fd, const gen_room* room, const gen_action* actions, int n);
+static bool write_script(const gen_room* room, const char* name, const char* path);
+static void free_room(gen_room* room);
+static bool grow(void** array, int n, size_t elem_size);
+static uint64_t next_random(uint64_t* state);
+static int random_below(gen_room* room, int n);
+static bool parse_option(const char* value, int min, int max, int* out);
+
+int main(int argc, char* args[])
+{
+    gen_params params = { .n_locations = 10, .n_objs = 40, .n_tokens = 3, .depth = 3, .hidden_pct = 50, .fan_out = 2, .dim_bag = 2 };
+    unsigned long long seed = 1;
+    int n_rooms = 1, i, opt;
+
+    while ((opt = getopt(argc, args, "n:s:l:o:t:d:H:f:b:")) != -1)
+    {
+        bool ok;
+        switch (opt)
+        {
+            case 'n': ok = parse_option(optarg, 1, ROOMGEN_MAX_ROOMS, &n_rooms); break;
+            case 's': ok = sscanf(optarg, "%llu", &seed) == 1; break;
+            case 'l': ok = parse_option(optarg, 1, ROOMGEN_MAX_LOCATIONS, &params.n_locations); break;
+            case 'o': ok = parse_option(optarg, 1, ROOMGEN_MAX_OBJS, &params.n_objs); break;
+            case 't': ok = parse_option(optarg, 1, ROOMGEN_MAX_OBJS, &params.n_tokens); break;
+            case 'd': ok = parse_option(optarg, 1, ROOMGEN_MAX_OBJS, &params.depth); break;
+            case 'H': ok = parse_option(optarg, 0, 100, &params.hidden_pct); break;
+            case 'f': ok = parse_option(optarg, 0, ROOMGEN_MAX_OBJS, &params.fan_out); break;
+            case 'b': ok = parse_option(optarg, 1, ROOMGEN_MAX_OBJS, &params.dim_bag); break;
+            default: ok = false; break;
+        }
+        if (!ok) {
+            printf("Error:\toption -%c not valid\n", opt == '?' ? optopt : opt);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        printf("Usage:\t%s [-n rooms] [-s seed] [-l locations] [-o objects] [-t tokens] [-d lock depth] "
+            "[-H hidden %%] [-f fan-out] [-b bag] <rooms dir>\n", args[0]);
+        return 0;
+    }
+    if (mkdir(args[optind], 0755) != 0 && errno != EEXIST) {
+        printf("Error:\t%s: %s\n", args[optind], strerror(errno));
+        return 1;
+    }
+
+    for (i = 0; i < n_rooms; i++)
+        if (!generate_room(&params, seed, i, args[optind]))
+            return 1;
+    return 0;
+}
+
+/*
+ * Genera una room e la sua soluzione, le scrive nella cartella e verifica che la room si carichi e compili
+ * come farebbe il server.
+ *
+ * Restituisce:
+ *   - true se la room è stata scritta e verificata, false altrimenti con il motivo già stampato.
+ */
+static bool generate_room(const gen_params* params, uint64_t seed, int index, const char* dir)
+{
+    gen_room room = { .rng = seed * 0x9e3779b97f4a7c15ULL + (uint64_t)index + 1 };
+    char name[MAX_ROOM_NAME_DIM], path[512], error[ROOM_ERROR_DIM];
+    game_room_def* def;
+    room_view view;
+    size_t size;
+    void* image;
+    bool ok;
+
+    snprintf(name, sizeof(name), "Generata %llu-%d", (unsigned long long)seed, index);
+    ok = build_chains(&room, params);
+    if (ok && room.n_objs > params->n_objs) {
+        printf("Error:\t%d tokens with lock depth %d need %d objects, only %d requested\n",
+            params->n_tokens, params->depth, room.n_objs, params->n_objs);
+        free_room(&room);
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "%s/gen_%llu_%d" ROOM_FILE_EXT, dir, (unsigned long long)seed, index);
+    ok = ok && write_room(&room, params, name, path);
+    if (!ok) {
+        printf("Error:\t%s: cannot generate the room\n", path);
+        free_room(&room);
+        return false;
+    }
+
+    def = room_def_load(path, error, sizeof(error));
+    image = def != NULL ? room_compile(def, &size) : NULL;
+    room_def_free(def);
+    if (image == NULL || !room_attach(&view, image, size)) {
+        printf("Error:\t%s\n", def == NULL ? error : "generated room does not compile");
+        free(image);
+        free_room(&room);
+        return false;
+    }
+
+    printf("%s: \"%s\" (%u objects, %u locations, %u uses, %u ops, %zu image bytes), solution of %d commands\n",
+        path, name, view.header->n_objs, view.header->n_locations, view.header->n_uses, view.header->n_ops, size, room.n_script);
+    free(image);
+
+    snprintf(path, sizeof(path), "%s/gen_%llu_%d" ROOMGEN_SCRIPT_EXT, dir, (unsigned long long)seed, index);
+    ok = write_script(&room, name, path);
+    if (!ok)
+        printf("Error:\t%s: cannot write the solution\n", path);
+    free_room(&room);
+    return ok;
+}
+
+/*
+ * Costruisce una catena di lock per ogni token, scrivendo la soluzione mentre procede, e aggiunge gli oggetti
+ * di contorno fino al numero richiesto. La soluzione vince le catene una dopo l'altra e ogni chiave viene
+ * consumata appena usata, così lo zaino non contiene mai più di un oggetto.
+ */
+static bool build_chains(gen_room* room, const gen_params* params)
+{
+    int* locks = malloc((size_t)params->n_tokens * params->depth * sizeof(int));
+    int n_locks = 0, c, i;
+    bool ok = locks != NULL;
+
+    for (c = 0; ok && c < params->n_tokens; c++)
+    {
+        int prev = -1;
+
+        for (i = 0; ok && i < params->depth; i++)
+        {
+            // Il primo anello non ha un anello precedente da cui essere sbloccato in cascata
+            gen_link_type type = (gen_link_type)random_below(room, i == 0 ? LINK_CASCADE : LINK_CASCADE + 1);
+            bool last = i == params->depth - 1;
+            int lock, actor = -1;
+
+            if (last)
+                lock = add_obj(room, "teca", "La teca è aperta e brilla di luce propria", random_below(room, params->n_locations));
+            else if (type == LINK_PUZZLE)
+                lock = add_obj(room, "cassaforte", "La cassaforte è aperta", random_below(room, params->n_locations));
+            else if (type == LINK_CASCADE)
+                lock = add_obj(room, "meccanismo", "Gli ingranaggi del meccanismo girano", random_below(room, params->n_locations));
+            else
+                lock = add_obj(room, "serratura", "La serratura è aperta", random_below(room, params->n_locations));
+            if (lock < 0)
+                break;
+            room->objs[lock].locked = true;
+            locks[n_locks++] = lock;
+
+            // Chiavi e leve si sbloccano con il lock stesso, il cui anello le attiva
+            if (type == LINK_KEY) {
+                actor = add_obj(room, "chiave", "Una chiave di ottone", random_below(room, params->n_locations));
+                ok = actor >= 0;
+                if (ok) {
+                    room->objs[actor].takeable = true;
+                    room->objs[actor].consumable = true;
+                }
+            }
+            else if (type == LINK_LEVER) {
+                actor = add_obj(room, "leva", "Una leva arrugginita", random_below(room, params->n_locations));
+                ok = actor >= 0;
+                if (ok)
+                    room->objs[actor].consumable = true;
+            }
+            if (!ok)
+                break;
+
+            // Il lock di un anello successivo al primo viene rivelato dallo sblocco di quello precedente:
+            // senza, una chiave, una leva o un enigma ancora visibili lo sbloccherebbero saltando la catena
+            if (prev >= 0) {
+                room->objs[lock].hidden = true;
+                ok = add_action(&room->objs[prev].lock_actions, &room->objs[prev].n_lock_actions, ACTION_REVEAL, lock);
+            }
+            // Una leva che sbloccasse un lock ancora nascosto verrebbe consumata senza effetto
+            if (ok && prev >= 0 && type == LINK_LEVER) {
+                room->objs[actor].hidden = true;
+                ok = add_action(&room->objs[prev].lock_actions, &room->objs[prev].n_lock_actions, ACTION_REVEAL, actor);
+            }
+            if (!ok)
+                break;
+
+            switch (type)
+            {
+                case LINK_KEY: {
+                    gen_use* use = add_use(&room->objs[actor], lock, "La chiave gira nella serratura");
+                    ok = use != NULL && add_action(&use->actions, &use->n_actions, ACTION_UNLOCK, lock) &&
+                        add_action(&use->actions, &use->n_actions, ACTION_CONSUME, actor) &&
+                        add_command(room, "take %s", room->objs[actor].name) &&
+                        add_command(room, "use %s %s", room->objs[actor].name, room->objs[lock].name);
+                    break;
+                }
+                case LINK_LEVER: {
+                    gen_use* use = add_use(&room->objs[actor], -1, "Si sente uno scatto in lontananza");
+                    ok = use != NULL && add_action(&use->actions, &use->n_actions, ACTION_UNLOCK, lock) &&
+                        add_action(&use->actions, &use->n_actions, ACTION_CONSUME, actor) &&
+                        add_command(room, "use %s", room->objs[actor].name);
+                    break;
+                }
+                case LINK_PUZZLE:
+                    // La risposta è scritta sull'anello precedente, o nell'enigma stesso per il primo anello
+                    room->objs[lock].puzzle = true;
+                    room->objs[lock].solution = 1000 + random_below(room, 9000);
+                    if (prev >= 0) {
+                        room->objs[prev].hint = lock;
+                        room->objs[lock].hinted = true;
+                    }
+                    ok = add_command(room, "answer %s %d", room->objs[lock].name, room->objs[lock].solution);
+                    break;
+                case LINK_CASCADE:
+                    ok = add_action(&room->objs[prev].lock_actions, &room->objs[prev].n_lock_actions, ACTION_UNLOCK, lock);
+                    break;
+            }
+            if (ok && last)
+                ok = add_action(&room->objs[lock].lock_actions, &room->objs[lock].n_lock_actions, ACTION_TOKEN, -1);
+            prev = lock;
+        }
+        ok = ok && i == params->depth;
+    }
+
+    ok = ok && add_filler(room, params, locks, n_locks);
+    free(locks);
+    return ok;
+}
+
+/*
+ * Aggiunge gli oggetti di contorno e gli usi combinati che non servono a vincere. Un oggetto di contorno nascosto
+ * viene rivelato da un lock delle catene o da un uso combinato di un oggetto di contorno visibile con un oggetto
+ * delle catene, che prima o poi diventa utilizzabile: così ogni oggetto può essere rivelato, senza cicli.
+ * Gli usi combinati rivelano soltanto oggetti di contorno, quindi non cambiano la soluzione.
+ */
+static bool add_filler(gen_room* room, const gen_params* params, int* locks, int n_locks)
+{
+    static const char* kinds[] = { "sasso", "libro", "vaso", "quadro", "candela", "moneta" };
+    int first_filler = room->n_objs, i, k;
+
+    while (room->n_objs < params->n_objs)
+    {
+        int obj = add_obj(room, kinds[random_below(room, 6)], "Un oggetto come tanti", random_below(room, params->n_locations));
+        if (obj < 0)
+            return false;
+        room->objs[obj].takeable = random_below(room, 3) == 0;
+        room->objs[obj].hidden = random_below(room, 100) < params->hidden_pct;
+    }
+
+    // Le combinazioni vanno verso oggetti a caso, senza ripetere la stessa coppia
+    for (i = 0; i < room->n_objs; i++)
+    {
+        gen_obj* obj = &room->objs[i];
+        int n_combos = obj->takeable ? params->fan_out : 0, attempts = 0;
+
+        while (n_combos > 0 && attempts++ < 4 * params->fan_out)
+        {
+            int other = random_below(room, room->n_objs);
+            bool taken = other == i;
+
+            for (k = 0; !taken && k < obj->n_uses; k++)
+                taken = obj->uses[k].other == other;
+            if (taken)
+                continue;
+            if (add_use(obj, other, "Non succede nulla di interessante") == NULL)
+                return false;
+            n_combos--;
+        }
+    }
+
+    for (i = first_filler; i < room->n_objs; i++)
+    {
+        int r = first_filler + random_below(room, room->n_objs - first_filler);
+        gen_obj* revealer = &room->objs[r];
+        gen_use* use = NULL;
+
+        if (!room->objs[i].hidden)
+            continue;
+        if (!revealer->hidden && revealer->takeable)
+            for (k = 0; use == NULL && k < revealer->n_uses; k++)
+                if (revealer->uses[k].other < first_filler)
+                    use = &revealer->uses[k];
+
+        if (use != NULL && !add_action(&use->actions, &use->n_actions, ACTION_REVEAL, i))
+            return false;
+        if (use == NULL) {
+            gen_obj* lock = &room->objs[locks[random_below(room, n_locks)]];
+            if (!add_action(&lock->lock_actions, &lock->n_lock_actions, ACTION_REVEAL, i))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Aggiunge un oggetto con il nome formato dal tipo e dall'indice, restituisce il suo indice o -1
+static int add_obj(gen_room* room, const char* kind, const char* text, int location)
+{
+    gen_obj* obj;
+
+    if (!grow((void**)&room->objs, room->n_objs, sizeof(gen_obj)))
+        return -1;
+    obj = &room->objs[room->n_objs];
+    memset(obj, 0, sizeof(gen_obj));
+    snprintf(obj->name, sizeof(obj->name), "%s%d", kind, room->n_objs);
+    obj->text = text;
+    obj->location = location;
+    obj->hint = -1;
+    return room->n_objs++;
+}
+
+static bool add_action(gen_action** actions, int* n_actions, int type, int obj)
+{
+    if (!grow((void**)actions, *n_actions, sizeof(gen_action)))
+        return false;
+    (*actions)[*n_actions].type = type;
+    (*actions)[*n_actions].obj = obj;
+    (*n_actions)++;
+    return true;
+}
+
+static gen_use* add_use(gen_obj* obj, int other, const char* descr)
+{
+    gen_use* use;
+
+    if (!grow((void**)&obj->uses, obj->n_uses, sizeof(gen_use)))
+        return NULL;
+    use = &obj->uses[obj->n_uses++];
+    memset(use, 0, sizeof(gen_use));
+    use->other = other;
+    use->descr = descr;
+    return use;
+}
+
+static bool add_command(gen_room* room, const char* fmt, ...)
+{
+    char line[2 * MAX_NAME_DIM + 16];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (!grow((void**)&room->script, room->n_script, sizeof(char*)))
+        return false;
+    room->script[room->n_script] = strdup(line);
+    return room->script[room->n_script++] != NULL;
+}
+
+/*
+ * Scrive il file di definizione della room, con gli oggetti raggruppati per locazione. Le descrizioni della room
+ * e delle locazioni elencano i nomi finché stanno in MAX_DESCR_DIM.
+ */
+static bool write_room(const gen_room* room, const gen_params* params, const char* name, const char* path)
+{
+    char descr[MAX_DESCR_DIM];
+    size_t len;
+    int l, i, u;
+    FILE* fd = fopen(path, "w");
+
+    if (fd == NULL)
+        return false;
+
+    fprintf(fd, "# Room generata da roomgen: %d locazioni, %d oggetti, %d catene di %d lock\n",
+        params->n_locations, room->n_objs, params->n_tokens, params->depth);
+    fprintf(fd, "room %s\n", name);
+    fprintf(fd, "story Una room generata automaticamente.\\nTrova i %d token nascosti in fondo alle catene di lock.\n", params->n_tokens);
+    len = snprintf(descr, sizeof(descr), "La room ha %d locazioni:", params->n_locations);
+    for (l = 0; l < params->n_locations && len + 20 < sizeof(descr); l++)
+        len += snprintf(descr + len, sizeof(descr) - len, " ++zona%d++", l);
+    fprintf(fd, "descr %s\n", descr);
+    fprintf(fd, "timeout Il tempo è scaduto!\nquit Alla prossima!\nwin Hai vinto!\n");
+    fprintf(fd, "bag %d\ntoken %d\nseconds %d\n", params->dim_bag, params->n_tokens, ROOMGEN_SECONDS);
+
+    for (l = 0; l < params->n_locations; l++)
+    {
+        len = snprintf(descr, sizeof(descr), "Una zona anonima");
+        for (i = 0; i < room->n_objs && len + MAX_NAME_DIM + 8 < sizeof(descr); i++)
+            if (room->objs[i].location == l && !room->objs[i].hidden)
+                len += snprintf(descr + len, sizeof(descr) - len, " **%s**", room->objs[i].name);
+        fprintf(fd, "\nlocation zona%d\n    descr %s\n", l, descr);
+
+        for (i = 0; i < room->n_objs; i++)
+        {
+            const gen_obj* obj = &room->objs[i];
+            if (obj->location != l)
+                continue;
+
+            fprintf(fd, "\n    object %s\n", obj->name);
+            if (obj->hidden)
+                fprintf(fd, "        hidden\n");
+            if (obj->takeable)
+                fprintf(fd, "        takeable\n");
+            if (obj->consumable)
+                fprintf(fd, "        consumable\n");
+            if (obj->hint >= 0)
+                fprintf(fd, "        unlocked %s. Vi è inciso un numero: %d\n", obj->text, room->objs[obj->hint].solution);
+            else
+                fprintf(fd, "        unlocked %s\n", obj->text);
+
+            if (obj->locked) {
+                fprintf(fd, "        locked %s è chiuso\n", obj->name);
+                if (obj->puzzle) {
+                    fprintf(fd, "        lock puzzle\n");
+                    if (obj->hinted)
+                        fprintf(fd, "            puzzle Serve un codice di quattro cifre\n");
+                    else
+                        fprintf(fd, "            puzzle Serve un codice di quattro cifre, scritto sul bordo: %d\n", obj->solution);
+                    fprintf(fd, "            solution %d\n", obj->solution);
+                }
+                else
+                    fprintf(fd, "        lock obj\n");
+                write_actions(fd, room, obj->lock_actions, obj->n_lock_actions);
+            }
+
+            for (u = 0; u < obj->n_uses; u++)
+            {
+                const gen_use* use = &obj->uses[u];
+                fprintf(fd, "        use%s%s\n", use->other >= 0 ? " " : "", use->other >= 0 ? room->objs[use->other].name : "");
+                fprintf(fd, "            descr %s\n", use->descr);
+                write_actions(fd, room, use->actions, use->n_actions);
+            }
+        }
+    }
+
+    return fclose(fd) == 0;
+}
+
+// Scrive le azioni nell'ordine in cui vanno eseguite: prima si rivela un oggetto, poi lo si sblocca
+static void write_actions(FILE* fd, const gen_room* room, const gen_action* actions, int n)
+{
+    static const char* names[] = { "reveal", "unlock", "consume", "token" };
+    int type, k;
+
+    for (type = ACTION_REVEAL; type <= ACTION_TOKEN; type++)
+        for (k = 0; k < n; k++)
+            if (actions[k].type == type && type == ACTION_TOKEN)
+                fprintf(fd, "            action token\n");
+            else if (actions[k].type == type)
+                fprintf(fd, "            action %s %s\n", names[type], room->objs[actions[k].obj].name);
+}
+
+static bool write_script(const gen_room* room, const char* name, const char* path)
+{
+    FILE* fd = fopen(path, "w");
+    int i;
+
+    if (fd == NULL)
+        return false;
+    fprintf(fd, "# Soluzione di \"%s\", un comando per riga\n", name);
+    for (i = 0; i < room->n_script; i++)
+        fprintf(fd, "%s\n", room->script[i]);
+    return fclose(fd) == 0;
+}
+
+static void free_room(gen_room* room)
+{
+    int i, u;
+
+    for (i = 0; i < room->n_objs; i++) {
+        for (u = 0; u < room->objs[i].n_uses; u++)
+            free(room->objs[i].uses[u].actions);
+        free(room->objs[i].uses);
+        free(room->objs[i].lock_actions);
+    }
+    for (i = 0; i < room->n_script; i++)
+        free(room->script[i]);
+    free(room->objs);
+    free(room->script);
+}
+
+/*
+ * Fa spazio per un nuovo elemento in coda a un array di n elementi.
+ * La capacità raddoppia quando n è una potenza di 2, così non serve memorizzarla.
+ */
+static bool grow(void** array, int n, size_t elem_size)
+{
+    void* new_array;
+
+    if (n != 0 && (n & (n - 1)) != 0)
+        return true;
+
+    new_array = realloc(*array, (n == 0 ? 1 : 2 * (size_t)n) * elem_size);
+    if (new_array == NULL)
+        return false;
+    *array = new_array;
+    return true;
+}
+
+// Generatore xorshift64*, indipendente dalla libreria C così che lo stesso seme dia ovunque le stesse room
+static uint64_t next_random(uint64_t* state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static int random_below(gen_room* room, int n)
+{
+    return (int)(next_random(&room->rng) % (uint64_t)n);
+}
+
+static bool parse_option(const char* value, int min, int max, int* out)
+{
+    char* end;
+    long n;
+
+    errno = 0;
+    n = strtol(value, &end, 10);
+    if (value[0] == '\0' || *end != '\0' || errno != 0 || n < min || n > max)
+        return false;
+    *out = (int)n;
+    return true;
+}
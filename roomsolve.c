@@ -0,0 +1,204 @@
+#include <sys/stat.h>
+
+#include "lib/utils.h"
+#include "lib/game/roomfile.h"
+#include "lib/game/solver.h"
+
+/*
+ * Validatore delle room.
+ *
+ * Compila ogni file di definizione, come fa il server, ed esplora tutti gli stati raggiungibili di una partita
+ * con il risolutore, usando tutti i processori disponibili se non indicato. Per ogni room riporta una sequenza
+ * di comandi per vincere, minima nei comandi esclusi take e drop, gli oggetti che non possono mai essere rivelati,
+ * sbloccati o raccolti, i vicoli ciechi con un esempio di comandi che ci portano e il numero di token ottenibili.
+ * L'esplorazione si ferma al massimo di stati o di memoria indicato: in quel caso, se non ha trovato una vittoria,
+ * non si sa se la room possa essere vinta.
+ *
+ * Uso: ./roomsolve <file di definizione | cartella delle room> [thread] [massimo di stati] [massimo di MB]
+ *
+ * Termina con codice 1 se una room non può essere vinta o non può essere esplorata completamente.
+ */
+
+static int solve_room(const char* path, int n_threads, uint64_t max_states, size_t max_bytes);
+static void print_path(const room_view* view, const solver_cmd* path, uint32_t len);
+static void print_objs(const room_view* view, const char* what, const uint64_t* set, uint16_t flags);
+static const char* obj_name(const room_view* view, uint32_t obj);
+
+int main(int argc, char* args[])
+{
+    struct stat st;
+    char** paths;
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n_threads = n_cpus > 0 ? (n_cpus < SOLVER_MAX_THREADS ? (int)n_cpus : SOLVER_MAX_THREADS) : 1;
+    unsigned long long max_states = SOLVER_DEFAULT_MAX_STATES, max_mb = SOLVER_DEFAULT_MAX_BYTES >> 20;
+    int n_paths, i, ret = 0;
+
+    if (argc < 2 || argc > 5) {
+        printf("Usage:\t%s <room file|rooms dir> [threads] [max states] [max MB]\n", args[0]);
+        return 0;
+    }
+    if (argc >= 3 && (sscanf(args[2], "%d", &n_threads) != 1 || n_threads <= 0 || n_threads > SOLVER_MAX_THREADS)) {
+        printf("Error:\tthreads not valid (1-%d)\n", SOLVER_MAX_THREADS);
+        return 1;
+    }
+    if (argc >= 4 && (sscanf(args[3], "%llu", &max_states) != 1 || max_states == 0 || max_states > UINT32_MAX)) {
+        printf("Error:\tmax states not valid\n");
+        return 1;
+    }
+    if (argc == 5 && (sscanf(args[4], "%llu", &max_mb) != 1 || max_mb == 0 || max_mb > (SIZE_MAX >> 20))) {
+        printf("Error:\tmax MB not valid\n");
+        return 1;
+    }
+    if (stat(args[1], &st) != 0) {
+        printf("Error:\t%s: %s\n", args[1], strerror(errno));
+        return 1;
+    }
+
+    if (!S_ISDIR(st.st_mode))
+        return solve_room(args[1], n_threads, max_states, (size_t)max_mb << 20);
+
+    n_paths = room_dir_list(args[1], &paths);
+    if (n_paths <= 0) {
+        printf("Error:\tno room definitions in %s\n", args[1]);
+        return 1;
+    }
+    for (i = 0; i < n_paths; i++)
+        if (solve_room(paths[i], n_threads, max_states, (size_t)max_mb << 20) != 0)
+            ret = 1;
+    room_dir_free(paths, n_paths);
+    return ret;
+}
+
+/*
+ * Compila ed esplora una room, stampandone il riepilogo.
+ *
+ * Restituisce:
+ *   - 0 se la room può essere vinta, 1 altrimenti.
+ */
+static int solve_room(const char* path, int n_threads, uint64_t max_states, size_t max_bytes)
+{
+    char error[ROOM_ERROR_DIM];
+    game_room_def* def = room_def_load(path, error, sizeof(error));
+    solver_report report;
+    room_view view;
+    size_t size;
+    void* image;
+    uint32_t i, n_token_actions = 0;
+    int ret = 0;
+
+    if (def == NULL) {
+        printf("Error:\t%s\n", error);
+        return 1;
+    }
+    image = room_compile(def, &size);
+    room_def_free(def);
+    if (image == NULL || !room_attach(&view, image, size)) {
+        printf("Error:\t%s: compilation failed\n", path);
+        free(image);
+        return 1;
+    }
+    for (i = 0; i < view.header->n_actions; i++)
+        if (view.actions[i].type == ACTION_TOKEN)
+            n_token_actions++;
+
+    printf("%s: \"%s\" (%u objects, bag %u)\n", path, room_str(&view, view.header->name), view.header->n_objs, view.header->dim_bag);
+    if (!solver_run(&view, n_threads, max_states, max_bytes, &report)) {
+        printf("Error:\tout of memory\n");
+        free(image);
+        return 1;
+    }
+
+    printf("  States:         %llu in %u levels, %.1f ms search + %.1f ms dead ends, %d threads%s\n",
+        (unsigned long long)report.n_states, report.n_levels, report.search_ms, report.dead_end_ms, n_threads,
+        report.complete ? "" : report.memory_limit ? " (INCOMPLETE: max memory reached)" : " (INCOMPLETE: max states reached)");
+    printf("  Tokens:         %u needed, %u defined, %u reachable at most\n", view.header->token, n_token_actions, report.max_tokens);
+
+    if (report.solution != NULL) {
+        printf("  Solution:       %u commands\n", report.solution_len);
+        print_path(&view, report.solution, report.solution_len);
+    }
+    else if (report.complete) {
+        printf("  Solution:       NONE, the room cannot be won\n");
+        ret = 1;
+    }
+    else
+        printf("  Solution:       unknown, no win within the explored states\n");
+
+    if (report.complete) {
+        print_objs(&view, "Never visible:", report.ever_visible, 0);
+        print_objs(&view, "Never unlocked:", report.ever_unlocked, 0);
+        print_objs(&view, "Never taken:", report.ever_taken, ROOM_OBJ_TAKEABLE);
+
+        if (report.n_dead == 0)
+            printf("  Dead ends:      none\n");
+        else {
+            printf("  Dead ends:      %llu states, the shortest after %u commands\n", (unsigned long long)report.n_dead, report.dead_end_len);
+            print_path(&view, report.dead_end, report.dead_end_len);
+        }
+    }
+    else
+        ret = 1;
+
+    solver_report_free(&report);
+    free(image);
+    return ret;
+}
+
+// Stampa una sequenza di comandi così come vanno scritti nel client
+static void print_path(const room_view* view, const solver_cmd* path, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        const char* name = obj_name(view, path[i].obj1);
+        switch (path[i].type)
+        {
+            case SOLVER_TAKE:
+                printf("    take %s\n", name);
+                break;
+            case SOLVER_DROP:
+                printf("    drop %s\n", name);
+                break;
+            case SOLVER_USE:
+                printf("    use %s\n", name);
+                break;
+            case SOLVER_USE_WITH:
+                printf("    use %s %s\n", name, obj_name(view, path[i].obj2));
+                break;
+            case SOLVER_ANSWER:
+                printf("    use %s, answer \"%s\"\n", name, room_str(view, view->obj_texts[path[i].obj1].puzzle_solution));
+                break;
+        }
+    }
+}
+
+/*
+ * Stampa gli oggetti che non compaiono nell'insieme specificato.
+ *
+ * Parametri:
+ *   - set: Insieme degli oggetti raggiunti.
+ *   - flags: Se diverso da 0, considera solo gli oggetti che hanno questi flag.
+ */
+static void print_objs(const room_view* view, const char* what, const uint64_t* set, uint16_t flags)
+{
+    uint32_t o;
+    int n = 0;
+
+    for (o = 0; o < view->header->n_objs; o++)
+    {
+        if ((set[o >> 6] >> (o & 63)) & 1 || (view->objs[o].flags & flags) != flags)
+            continue;
+        if (n++ == 0)
+            printf("  %-16s%s", what, obj_name(view, o));
+        else
+            printf(", %s", obj_name(view, o));
+    }
+    if (n > 0)
+        printf("\n");
+}
+
+static const char* obj_name(const room_view* view, uint32_t obj)
+{
+    return obj == ROOM_NO_OBJ ? "?" : room_str(view, view->obj_texts[obj].name);
+}
@@ -4,6 +4,8 @@
 #include <unistd.h>
 
 #include "lib/utils.h"
+#include "lib/password.h"
+#include "lib/userstore.h"
 #include "lib/game/server.h"
 #include "lib/game/ui.h"
 
@@ -29,25 +31,77 @@ static bool check_user(const char* username, const char* password);
 static bool register_user(const char* username, const char* password);
 static bool username_exists(const char* username);
 
+// Archivio degli utenti registrati, caricato in memoria all'avvio
+static user_store users;
+
 int main(int argc, char* args[]) 
 {
     int listener /* Socket di ascolto */, i /* Indice per ciclo for */;
     int server_port;
     char buffer[MAX_INPUT_DIM];
+    char error[ROOM_ERROR_DIM];
+    char reload_msg[ROOM_ERROR_DIM];
 
     fd_set master, read_fds;
     int fdmax = -1;
+    struct timeval timeout;
+    bool subscribed = false;
+    const char* events_path = NULL;
+    int opt;
+
+    // Opzioni: periodo di attesa delle sessioni senza connessione, file degli eventi,
+    // budget in MiB delle immagini delle room senza partite, limiti di sessioni e di memoria in MiB
+    while ((opt = getopt(argc, args, "g:e:b:s:m:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'g':
+                if (!is_number(optarg) || strlen(optarg) > 6) {
+                    printf("Error:\tgrace period not valid\n");
+                    return 0;
+                }
+                setSessionGracePeriod((int)string_to_long(optarg));
+                break;
+            case 'e':
+                events_path = optarg;
+                break;
+            case 'b':
+                if (!is_number(optarg) || strlen(optarg) > 6) {
+                    printf("Error:\troom budget not valid\n");
+                    return 0;
+                }
+                setRoomBodyBudget((size_t)string_to_long(optarg) << 20);
+                break;
+            case 's':
+                if (!is_number(optarg) || strlen(optarg) > 7) {
+                    printf("Error:\tmax sessions not valid\n");
+                    return 0;
+                }
+                setMaxSessions((int)string_to_long(optarg));
+                break;
+            case 'm':
+                if (!is_number(optarg) || strlen(optarg) > 6 || string_to_long(optarg) == 0) {
+                    printf("Error:\tmax memory not valid\n");
+                    return 0;
+                }
+                setMaxMemory((size_t)string_to_long(optarg) << 20);
+                break;
+            default:
+                printf("Usage:\t%s [-g grace seconds] [-e events file] [-b room budget MiB] [-s max sessions] [-m max memory MiB] <port>\n", args[0]);
+                return 0;
+        }
+    }
 
     // Lettura della porta
-    if (argc > 2) {
+    if (optind < argc - 1) {
         printf("Error:\ttoo many arguments\n");
         return 0;
     }
-    if (argc < 2) {
+    if (optind == argc) {
         printf("Error:\tplease specify the server port\n");
         return 0;
     }
-    if (!get_port(args[1], &server_port)) {
+    if (!get_port(args[optind], &server_port)) {
         printf("Error:\tport not valid\n");
         return 0;
     }
@@ -74,11 +128,65 @@ int main(int argc, char* args[])
     listener = init_server(server_port, &master, &fdmax);
     init_fd_set(&read_fds);
 
+    // Preparazione delle stanze
+    if (!initRooms(ROOMS_PACK, ROOMS_DIR, error, sizeof(error))) {
+        plog(LOG_CUSTOM_ERROR, error, 0);
+        close(listener);
+        exit(EXIT_FAILURE);
+    }
+
+    // Caricamento dell'archivio utenti
+    if (!userstore_open(&users, USERS_DIR, USERS_SHARDS_DEFAULT)) {
+        plog(LOG_ERROR, "Caricamento archivio utenti", 0);
+        close(listener);
+        exit(EXIT_FAILURE);
+    }
+
+    // Avvio dell'orologio del gioco, letto dai tempi delle sessioni ripristinate
+    tickGameClock();
+
+    // Ripristino delle sessioni salvate prima dell'ultimo arresto
+    if (!restoreSessions())
+        plog(LOG_CUSTOM_ERROR, "Ripristino delle sessioni non riuscito, il server prosegue senza checkpoint", 0);
+
+    // Lettura delle statistiche delle room, salvate periodicamente
+    if (!initRoomStats(ROOM_STATS_FILE))
+        plog(LOG_CUSTOM_ERROR, "Lettura delle statistiche delle room non riuscita, le statistiche ripartono da zero", 0);
+
+    // Attivazione del registro degli eventi, salvati anche nel file indicato con -e
+    if (!initEvents(events_path))
+        plog(LOG_CUSTOM_ERROR, "Apertura del file di eventi non riuscita, gli eventi restano solo in memoria", 0);
+
     // Main loop
     while (true) 
     {
         read_fds = master;
-        select(fdmax + 1, &read_fds, NULL, NULL, NULL);
+
+        // Il timeout permette di far scadere le sessioni senza connessione anche in assenza di traffico,
+        // ed è più breve se ci sono supervisori iscritti, che ricevono i cambiamenti a ogni SUBSCRIPTION_TICK_MS
+        timeout.tv_sec = subscribed ? 0 : 1;
+        timeout.tv_usec = subscribed ? SUBSCRIPTION_TICK_MS * 1000 : 0;
+        if (select(fdmax + 1, &read_fds, NULL, NULL, &timeout) <= 0)
+            FD_ZERO(&read_fds);
+        tickGameClock();
+        expireSessions();
+        checkpointSessions();
+        flushRoomStats();
+        subscribed = pushSubscriptions();
+
+        // Pubblicazione delle room ricaricate in background, se il caricamento è terminato
+        switch (pollRoomReload(reload_msg, sizeof(reload_msg)))
+        {
+            case ROOM_RELOAD_DONE:
+                plog(LOG_INFO, reload_msg, 0);
+                break;
+            case ROOM_RELOAD_FAILED:
+                plog(LOG_CUSTOM_ERROR, reload_msg, 0);
+                break;
+            default:
+                break;
+        }
+
         for (i = 0; i <= fdmax; i++) 
         {
             if (!FD_ISSET(i, &read_fds))
@@ -96,6 +204,22 @@ int main(int argc, char* args[])
                     
                     plog(LOG_CUSTOM_ERROR, "Impossibile arrestare il server, ci sono ancora utenti in gioco", 0);
                 }
+                else if (strcmp("events", buffer) == 0)
+                {
+                    // L'utente ha richiesto di salvare gli eventi recenti, per rieseguirli con lo strumento replay
+                    if (dumpEvents(EVENT_DUMP_FILE))
+                        plog(LOG_INFO, "Eventi recenti salvati in " EVENT_DUMP_FILE, 0);
+                    else
+                        plog(LOG_ERROR, "Salvataggio degli eventi", 0);
+                }
+                else if (strcmp("reload", buffer) == 0)
+                {
+                    // L'utente ha richiesto di ricaricare le room, le nuove versioni vengono pubblicate a caricamento terminato
+                    if (reloadRooms(ROOMS_PACK, ROOMS_DIR))
+                        plog(LOG_INFO, "Ricaricamento delle room avviato", 0);
+                    else
+                        plog(LOG_CUSTOM_ERROR, "Impossibile avviare il ricaricamento delle room, ce n'è già uno in corso", 0);
+                }
             }
             else if (i == listener) /* Nuova richiesta di connessione */
             {
@@ -103,12 +227,24 @@ int main(int argc, char* args[])
             }
             else /* Socket di comunicazione pronto */
             {
-                desc_msg msg;
-                switch(receive_from_socket(i, &msg))
+                // Il messaggio viene ricevuto nel buffer della connessione
+                desc_msg* msg = connMsgBuffer(i);
+                switch(receive_from_socket(i, msg))
                 {
                     case OK: {
                         // Messaggio ricevuto correttamente
-                        compute(i, &msg);
+                        compute(i, msg);
+                        if (connTooManyErrors(i))
+                        {
+                            // Troppe richieste rifiutate, ad esempio token di ripresa tentati a caso
+                            plog(LOG_SOCKET, "Troppe richieste non valide, connessione chiusa", i);
+
+                            authUserDisconnected(i);
+                            remove_fd_from_set(i, &master);
+                            close(i);
+
+                            printf("\n");
+                        }
                         continue;
                     }
                     case NET_ERR_REMOTE_SOCKET_CLOSED: {
@@ -122,6 +258,17 @@ int main(int argc, char* args[])
                         printf("\n");
                         continue;
                     }
+                    case NET_ERR_RECV: {
+                        // Errore di ricezione o messaggio troppo lungo: il flusso non è più allineato ai messaggi
+                        plog(LOG_SOCKET, "Messaggio non valido, connessione chiusa", i);
+
+                        authUserDisconnected(i);
+                        remove_fd_from_set(i, &master);
+                        close(i);
+
+                        printf("\n");
+                        continue;
+                    }
                     default:
                         continue;
                 }
@@ -139,6 +286,10 @@ quit:
     }
     // Chiudo il descrittore del socket di ascolto
     close(listener);
+    closeCheckpoint();
+    closeRoomStats();
+    closeEvents();
+    userstore_close(&users);
     return 0;
 }
 
@@ -202,6 +353,9 @@ static int accept_request(int listener, fd_set* master, int* fdmax)
     // Aggiunta del descrittore del nuovo socket di comunicazione al master set
     insert_fd_into_set(sd, master, fdmax);
 
+    // Inizializzazione dello stato della connessione
+    authUserConnected(sd);
+
     // Messaggio di Log
     plog(LOG_SOCKET, "Inizializzato", sd);
 
@@ -209,6 +363,9 @@ static int accept_request(int listener, fd_set* master, int* fdmax)
 }
 static void compute(int sd, desc_msg* msg) 
 {
+    // I comandi che possono modificare una sessione vengono registrati nel registro degli eventi
+    beginEvent(sd, msg);
+
     switch (msg->type)
     {
         case MSG_REQ_LOGIN: 
@@ -219,7 +376,7 @@ static void compute(int sd, desc_msg* msg)
             
             plog(LOG_SOCKET, "Richiesta di login", sd);
             if (check_user(username, password)) {
-                if (authUserSuccess(sd) == OK) {
+                if (authUserSuccess(sd, username) == OK) {
                     plog(LOG_ARROW, "OK\n", sd);
                     return;
                 }
@@ -241,7 +398,7 @@ static void compute(int sd, desc_msg* msg)
 
             plog(LOG_SOCKET, "Richiesta di signup", sd);
             if (register_user(username, password)) {
-                if (authUserSuccess(sd) == OK) {
+                if (authUserSuccess(sd, username) == OK) {
                     plog(LOG_ARROW, "OK\n", sd);
                     return;
                 }
@@ -256,8 +413,12 @@ static void compute(int sd, desc_msg* msg)
         }
         case MSG_REQ_ROOM_NAMES:
         {
+            unsigned int version = 0;
+            int page = 0;
+            sscanf(msg->payload, "%u %d", &version, &page);
+
             plog(LOG_SOCKET, "Richiesta nomi delle stanze", sd);
-            if (sendRoomNames(sd) == OK)
+            if (sendRoomNames(sd, version, page) == OK)
                 plog(LOG_ARROW, "OK\n", sd);
             else
                 plog(LOG_ARROW, "ERR\n", sd);
@@ -265,13 +426,24 @@ static void compute(int sd, desc_msg* msg)
         }
         case MSG_REQ_START_GAME: 
         {
-            char username[MAX_USR_DIM];
             int room = -1;
-            memset(username, '\0', 1);
-            sscanf(msg->payload, "%s %d", username, &room);
+            sscanf(msg->payload, "%d", &room);
 
             plog(LOG_SOCKET, "Richiesta di iniziare giocare", sd);
-            if (startGame(sd, username, room) == OK)
+            if (startGame(sd, room) == OK)
+                plog(LOG_ARROW, "OK\n", sd);
+            else
+                plog(LOG_ARROW, "ERR\n", sd);
+            break;
+        }
+        case MSG_REQ_RESUME_GAME:
+        {
+            char resume_token[RESUME_TOKEN_DIM];
+            memset(resume_token, '\0', 1);
+            sscanf(msg->payload, "%32s", resume_token);
+
+            plog(LOG_SOCKET, "Richiesta di riprendere una sessione", sd);
+            if (resumeGame(sd, resume_token) == OK)
                 plog(LOG_ARROW, "OK\n", sd);
             else
                 plog(LOG_ARROW, "ERR\n", sd);
@@ -484,6 +656,15 @@ static void compute(int sd, desc_msg* msg)
             }
             break;
         }
+        case MSG_SU_REQ_HELLO:
+        {
+            plog(LOG_SOCKET, "SU: Richiesta di identificarsi come supervisore", sd);
+            if (authSupervisor(sd) == OK)
+                plog(LOG_ARROW, "OK\n", sd);
+            else
+                plog(LOG_ARROW, "ERR\n", sd);
+            break;
+        }
         case MSG_SU_REQ_ACTIVE_USERS_LIST: 
         {
             plog(LOG_SOCKET, "SU: Richiesta lista degli utenti in gioco", sd);
@@ -500,6 +681,67 @@ static void compute(int sd, desc_msg* msg)
             }
             break;
         }
+        case MSG_SU_REQ_MEMORY_STATS:
+        {
+            plog(LOG_SOCKET, "SU: Richiesta uso della memoria", sd);
+            switch(sendMemoryStats(sd))
+            {
+                case OK: {
+                    plog(LOG_ARROW, "OK\n", sd);
+                    break;
+                }
+                default: {
+                    plog(LOG_ARROW, "ERR\n", sd);
+                    break;
+                }
+            }
+            break;
+        }
+        case MSG_SU_REQ_ROOM_STATS:
+        {
+            plog(LOG_SOCKET, "SU: Richiesta statistiche delle room", sd);
+            switch(sendRoomStats(sd))
+            {
+                case OK: {
+                    plog(LOG_ARROW, "OK\n", sd);
+                    break;
+                }
+                default: {
+                    plog(LOG_ARROW, "ERR\n", sd);
+                    break;
+                }
+            }
+            break;
+        }
+        case MSG_SU_REQ_SUBSCRIBE:
+        case MSG_SU_REQ_UNSUBSCRIBE:
+        {
+            char username[MAX_USR_DIM];
+            op_result ret;
+            memset(username, '\0', 1);
+            sscanf(msg->payload, "%s", username);
+
+            if (msg->type == MSG_SU_REQ_SUBSCRIBE) {
+                plog(LOG_SOCKET, "SU: Iscrizione agli aggiornamenti della sessione", sd);
+                ret = subscribeSession(sd, username);
+            }
+            else {
+                plog(LOG_SOCKET, "SU: Annullamento iscrizione agli aggiornamenti della sessione", sd);
+                ret = unsubscribeSession(sd, username);
+            }
+            switch(ret)
+            {
+                case OK: {
+                    plog(LOG_ARROW, "OK\n", sd);
+                    break;
+                }
+                default: {
+                    plog(LOG_ARROW, "ERR\n", sd);
+                    break;
+                }
+            }
+            break;
+        }
         case MSG_SU_REQ_USER_SESSION_DATA: 
         {
             char username[MAX_USR_DIM];
@@ -606,6 +848,8 @@ static void compute(int sd, desc_msg* msg)
         default:
             break;
     }
+
+    endEvent();
 }
 
 //--------Utils---------//
@@ -667,96 +911,45 @@ static void plog(LOG_TYPE type, const char* msg, int sd)
 
 static bool check_user(const char* username, const char* password) 
 {
-    char buffer[MAX_USR_DIM + MAX_PSW_DIM + 2];
-    char _username[MAX_USR_DIM], _password[MAX_PSW_DIM];
+    const user_record* user = userstore_find(&users, username);
+    char hashed[PSW_HASH_DIM];
 
-    // Apertura del file utenti
-    FILE *fd = fopen("users.txt", "r");
-    if (fd == NULL)
-    {
-        // Il file potrebbe non esistere, proviamo a crearlo
-        fd = fopen("users.txt", "a+");
-        if (fd == NULL)
-            plog(LOG_ERROR, "Apertura file utenti", 0);
-        
-        // Se sono riuscito a creare il file, questo è vuoto, 
-        // quindi l'utente non è sicuramente registrato
+    // La password memorizzata può essere cifrata o in chiaro
+    if (user == NULL || !password_verify(password, user->password))
         return false;
-    }
 
-    // Scorrimento di tutte le righe
-    while (fgets(buffer, sizeof(buffer), fd) != NULL) 
-    {
-        sscanf(buffer, "%s %s", _username, _password);
-        if(strcmp(username, _username) == 0 && strcmp(password, _password) == 0)
-        {
-            fclose(fd);
-            return true;
-        }
+    // Una password ancora in chiaro, proveniente dal file legacy, viene cifrata al primo login riuscito
+    if (!password_is_hashed(user->password)) {
+        if (!password_hash(password, hashed) || userstore_upgrade_password(&users, username, hashed) != OK || !userstore_flush(&users))
+            plog(LOG_ERROR, "Cifratura password legacy", 0);
     }
-
-    // Chiusura del file
-    fclose(fd);
-    return false;
+    return true;
 }
 static bool register_user(const char* username, const char* password) 
 {
+    char hashed[PSW_HASH_DIM];
+
     // Controllo se l'utente già esiste
     if (username_exists(username))
         return false;
 
-    // Apertura del file utenti
-    FILE* fd = fopen("users.txt", "a");
-    if (fd == NULL)
-    {
-        // Il file potrebbe non esistere, proviamo a crearlo
-        fd = fopen("users.txt", "a+");
-        if (fd == NULL) {
-            plog(LOG_ERROR, "Apertura file utenti", 0);
-            return false; /* Non sono riuscito a creare il file, non posso registrare l'utente */
-        }
+    // Registrazione nell'archivio, la password viene memorizzata cifrata (il calcolo blocca il ciclo per qualche ms, vedi password.h)
+    if (!password_hash(password, hashed)) {
+        plog(LOG_ERROR, "Generazione del salt", 0);
+        return false;
     }
-    
-    // Scrittura nel file
-    fprintf(fd, "%s %s\n", username, password);
+    if (userstore_add(&users, username, hashed) != OK)
+        return false;
 
-    // Chiusura del file
-    fclose(fd);
+    if (!userstore_flush(&users)) {
+        plog(LOG_ERROR, "Scrittura archivio utenti", 0);
+        return false;
+    }
     return true;
 }
 static bool username_exists(const char* username) 
 {
-    char buffer[MAX_USR_DIM + MAX_PSW_DIM + 2];
-    char _username[MAX_USR_DIM];
-
-    // Apertura del file utenti
-    FILE *fd = fopen("users.txt", "r");
-    if (fd == NULL)
-    {
-        // Il file potrebbe non esistere, proviamo a crearlo
-        fd = fopen("users.txt", "a+");
-        if (fd == NULL)
-            plog(LOG_ERROR, "Apertura file utenti", 0);
-        
-        // Se sono riuscito a creare il file, questo è vuoto, 
-        // quindi l'utente non è sicuramente registrato
-        return false;
-    }
-
-    // Scorrimento di tutte le righe
-    while (fgets(buffer, sizeof(buffer), fd) != NULL) 
-    {
-        sscanf(buffer, "%s", _username);
-        if(strcmp(username, _username) == 0)
-        {
-            fclose(fd);
-            return true;
-        }
-    }
-    
-    // Chiusura del file
-    fclose(fd);
-    return false;
+    return userstore_find(&users, username) != NULL;
 }
 
 //----------------------//
\ No newline at end of file
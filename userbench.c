@@ -0,0 +1,270 @@
+#define USERBENCH_DEFAULT_USERS 1000000             // Utenti registrati in ogni archivio se non indicato
+#define USERBENCH_LOOKUPS       2000000             // Ricerche per ogni misura
+#define USERBENCH_MAX_READERS   64
+#define USERBENCH_NAMES         (1 << 20)           // Username cercati, preparati prima delle misure
+#define USERBENCH_NAME_DIM      16
+
+#include <sys/stat.h>
+
+#include "lib/utils.h"
+#include "lib/userstore.h"
+
+/*
+ * Strumento di misura dell'archivio utenti.
+ *
+ * Per ogni numero di shard (1, 2, 4, ... fino a USERS_MAX_SHARDS) crea un archivio con lo stesso insieme di utenti,
+ * lo richiude e misura l'apertura, cioè il caricamento parallelo degli shard come all'avvio del server.
+ * Misura poi la velocità delle ricerche di username registrati e non registrati, con un thread
+ * e con un lettore per ogni core disponibile, che cercano contemporaneamente senza lock.
+ * Le ricerche di username non registrati vengono ripetute anche scorrendo direttamente l'indice, senza il filtro
+ * di Bloom, e il riepilogo riporta la frazione di falsi positivi del filtro.
+ *
+ * Gli archivi vengono creati dentro la cartella indicata, che deve essere vuota o non esistere, e rimossi alla fine.
+ *
+ * Uso: ./userbench <cartella di lavoro> [utenti]
+ */
+
+typedef char bench_name[USERBENCH_NAME_DIM];
+
+typedef struct                                      // Ricerche assegnate a un lettore
+{
+    user_store* store;
+    const bench_name* names;
+    size_t first;                                   // Primo indice della sequenza di ricerche del lettore
+    size_t n_lookups;
+    bool plain;                                     // Cerca senza il filtro di Bloom
+    size_t n_found;
+}
+lookup_job;
+
+static bool create_store(const char* dir, int n_shards, size_t n_users);
+static void remove_store(const char* dir, int n_shards);
+static double bench_lookups(user_store* store, const bench_name* names, bool absent, bool plain, int n_readers);
+static void* lookup_worker(void* arg);
+static const user_record* find_plain(user_store* store, const char* username);
+static double false_positives(user_store* store, const bench_name* names);
+static void user_name(char* buffer, size_t i, bool absent);
+static uint64_t clock_ns();
+
+int main(int argc, char* args[])
+{
+    unsigned long long n_users = USERBENCH_DEFAULT_USERS;
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n_readers = n_cpus > 0 ? (n_cpus < USERBENCH_MAX_READERS ? (int)n_cpus : USERBENCH_MAX_READERS) : 1;
+    char dir[32];
+    bench_name* hit_names;
+    bench_name* miss_names;
+    size_t i;
+    int n_shards;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage:\t%s <work dir> [users]\n", args[0]);
+        return 0;
+    }
+    if (argc == 3 && (sscanf(args[2], "%llu", &n_users) != 1 || n_users == 0 || n_users > 1000000000ULL)) {
+        printf("Error:\tusers not valid\n");
+        return 1;
+    }
+
+    // Si lavora dentro la cartella indicata, così non viene letto il file utenti legacy della cartella corrente
+    if ((mkdir(args[1], 0755) != 0 && errno != EEXIST) || chdir(args[1]) != 0) {
+        printf("Error:\t%s: %s\n", args[1], strerror(errno));
+        return 1;
+    }
+
+    // Username cercati, in ordine sparso come le richieste di utenti diversi
+    hit_names = malloc(USERBENCH_NAMES * sizeof(bench_name));
+    miss_names = malloc(USERBENCH_NAMES * sizeof(bench_name));
+    if (hit_names == NULL || miss_names == NULL) {
+        printf("Error:\tout of memory\n");
+        return 1;
+    }
+    for (i = 0; i < USERBENCH_NAMES; i++)
+    {
+        user_name(hit_names[i], (i * 2654435761ULL) % n_users, false);
+        user_name(miss_names[i], (i * 2654435761ULL) % n_users, true);
+    }
+
+    printf("Users:     %llu\n", n_users);
+    printf("Cores:     %ld (lookups with 1 and %d readers)\n\n", n_cpus, n_readers);
+    printf("%-7s %10s %10s %11s %17s %10s %15s %16s\n", "Shards", "Open (ms)", "Hit (M/s)", "Miss (M/s)",
+        "Miss, plain (M/s)", "Filter FP", "Hit, all (M/s)", "Miss, all (M/s)");
+
+    for (n_shards = 1; n_shards <= USERS_MAX_SHARDS; n_shards *= 2)
+    {
+        user_store store;
+        uint64_t t0;
+        double open_ms;
+
+        snprintf(dir, sizeof(dir), "shards-%d", n_shards);
+        if (!create_store(dir, n_shards, n_users)) {
+            printf("Error:\tcannot create the store in %s\n", dir);
+            remove_store(dir, n_shards);
+            return 1;
+        }
+
+        t0 = clock_ns();
+        if (!userstore_open(&store, dir, n_shards)) {
+            printf("Error:\tcannot open the store in %s\n", dir);
+            remove_store(dir, n_shards);
+            return 1;
+        }
+        open_ms = (clock_ns() - t0) / 1e6;
+        if (userstore_count(&store) != n_users)
+            printf("Error:\t%zu users loaded instead of %llu\n", userstore_count(&store), n_users);
+
+        printf("%-7d %10.1f %10.2f %11.2f %17.2f %9.2f%% %15.2f %16.2f\n", n_shards, open_ms,
+            bench_lookups(&store, hit_names, false, false, 1), bench_lookups(&store, miss_names, true, false, 1),
+            bench_lookups(&store, miss_names, true, true, 1), false_positives(&store, miss_names) * 100,
+            bench_lookups(&store, hit_names, false, false, n_readers), bench_lookups(&store, miss_names, true, false, n_readers));
+
+        userstore_close(&store);
+        remove_store(dir, n_shards);
+    }
+    free(hit_names);
+    free(miss_names);
+    return 0;
+}
+
+// Crea un archivio con n_users utenti e lo chiude, lasciando su disco solo i file degli shard
+static bool create_store(const char* dir, int n_shards, size_t n_users)
+{
+    char username[MAX_USR_DIM], password[PSW_HASH_DIM];
+    user_store store;
+    size_t i;
+    bool ok = true;
+
+    if (!userstore_open(&store, dir, n_shards))
+        return false;
+
+    // La password non viene mai verificata, basta che abbia la lunghezza di una password cifrata
+    memset(password, 'a', PSW_HASH_DIM - 1);
+    password[PSW_HASH_DIM - 1] = '\0';
+
+    for (i = 0; ok && i < n_users; i++)
+    {
+        user_name(username, i, false);
+        ok = userstore_add(&store, username, password) == OK;
+    }
+    ok = userstore_flush(&store) && ok;
+    userstore_close(&store);
+    return ok;
+}
+
+static void remove_store(const char* dir, int n_shards)
+{
+    char path[64];
+    int i;
+
+    for (i = 0; i < n_shards; i++)
+    {
+        snprintf(path, sizeof(path), "%s/shard-%02d.txt", dir, i);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/shards", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+/*
+ * Misura le ricerche di USERBENCH_LOOKUPS username, divise tra n_readers thread che cercano contemporaneamente.
+ *
+ * Parametri:
+ *   - absent: Gli username non sono registrati.
+ *   - plain: Cerca scorrendo l'indice senza il filtro di Bloom.
+ *
+ * Restituisce:
+ *   - Milioni di ricerche al secondo.
+ */
+static double bench_lookups(user_store* store, const bench_name* names, bool absent, bool plain, int n_readers)
+{
+    pthread_t threads[USERBENCH_MAX_READERS];
+    lookup_job jobs[USERBENCH_MAX_READERS];
+    size_t n_found = 0, per_reader = USERBENCH_LOOKUPS / n_readers;
+    uint64_t t0;
+    int i;
+
+    t0 = clock_ns();
+    for (i = 0; i < n_readers; i++)
+    {
+        jobs[i] = (lookup_job){ .store = store, .names = names, .first = i * per_reader, .n_lookups = per_reader, .plain = plain };
+        if (pthread_create(&threads[i], NULL, lookup_worker, &jobs[i]) != 0) {
+            lookup_worker(&jobs[i]);
+            threads[i] = pthread_self();
+        }
+    }
+    for (i = 0; i < n_readers; i++)
+    {
+        if (!pthread_equal(threads[i], pthread_self()))
+            pthread_join(threads[i], NULL);
+        n_found += jobs[i].n_found;
+    }
+    t0 = clock_ns() - t0;
+
+    if (n_found != (absent ? 0 : per_reader * n_readers))
+        printf("Error:\t%zu %s usernames found\n", n_found, absent ? "unregistered" : "registered");
+    return (double)per_reader * n_readers / (t0 / 1e3);
+}
+
+static void* lookup_worker(void* arg)
+{
+    lookup_job* job = arg;
+    size_t i;
+
+    for (i = 0; i < job->n_lookups; i++)
+    {
+        const char* username = job->names[(job->first + i) % USERBENCH_NAMES];
+        if ((job->plain ? find_plain(job->store, username) : userstore_find(job->store, username)) != NULL)
+            job->n_found++;
+    }
+    return NULL;
+}
+
+// Ricerca nell'indice dello shard senza consultare il filtro, come faceva l'archivio prima del filtro
+static const user_record* find_plain(user_store* store, const char* username)
+{
+    uint64_t h = hash_string(username);
+    user_shard* shard = &store->shards[(h >> 32) % (uint64_t)store->n_shards];
+    user_table* table = atomic_load_explicit(&shard->table, memory_order_acquire);
+    user_record* record;
+    size_t i;
+
+    for (i = h & (table->capacity - 1); ; i = (i + 1) & (table->capacity - 1))
+    {
+        record = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+        if (record == NULL)
+            return NULL;
+        if (strcmp(record->username, username) == 0)
+            return record;
+    }
+}
+
+/*
+ * Restituisce:
+ *   - La frazione degli username non registrati che il filtro non esclude, e che quindi costano una ricerca nell'indice.
+ */
+static double false_positives(user_store* store, const bench_name* names)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < USERBENCH_NAMES; i++)
+    {
+        uint64_t h = hash_string(names[i]);
+        user_table* table = atomic_load(&store->shards[(h >> 32) % (uint64_t)store->n_shards].table);
+        if (bloom_may_contain(&table->filter, h))
+            n++;
+    }
+    return (double)n / USERBENCH_NAMES;
+}
+
+static void user_name(char* buffer, size_t i, bool absent)
+{
+    snprintf(buffer, USERBENCH_NAME_DIM, "%s%zu", absent ? "guest" : "user", i);
+}
+
+static uint64_t clock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
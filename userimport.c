@@ -0,0 +1,429 @@
+#define IMPORT_BATCH_DIM 65536                      // Utenti cifrati e scritti per ogni lotto
+#define IMPORT_MAX_THREADS 64
+#define IMPORT_LINE_DIM 512
+
+#include <pthread.h>
+
+#include "lib/utils.h"
+#include "lib/password.h"
+#include "lib/userstore.h"
+
+/*
+ * Strumento di importazione massiva degli utenti.
+ *
+ * Legge un file CSV ("username,password") o di testo ("username password"), valida gli username,
+ * scarta i duplicati (sia interni al file sia già presenti nell'archivio utenti), cifra le password in parallelo
+ * su tutti i core disponibili e registra gli utenti direttamente negli shard dell'archivio del server.
+ *
+ * Va eseguito a server fermo: il server carica l'archivio in memoria all'avvio.
+ *
+ * Uso: ./userimport <file da importare> [numero di shard, usato solo se l'archivio non esiste ancora]
+ */
+
+typedef struct                                      // Utente in attesa di essere scritto
+{
+    char username[MAX_USR_DIM];
+    char password[MAX_PSW_DIM];
+    unsigned char salt[PSW_SALT_BYTES];
+    char hashed[PSW_HASH_DIM];
+}
+import_user;
+
+typedef struct                                      // Porzione di un lotto assegnata a un thread
+{
+    import_user* users;
+    size_t n_users;
+}
+import_job;
+
+typedef struct                                      // Insieme degli username già visti (indirizzamento aperto)
+{
+    uint64_t* hashes;                               // Hash degli username, 0 per le celle libere
+    size_t* offsets;                                // Posizione dell'username in names
+    size_t capacity;                                // Numero di celle, potenza di 2
+    size_t n_items;
+    char* names;                                    // Username memorizzati uno dopo l'altro
+    size_t names_dim, names_capacity;
+}
+name_set;
+
+static bool set_init(name_set* set, size_t capacity);
+static void set_free(name_set* set);
+static int set_insert(name_set* set, const char* name);
+
+static bool parse_line(char* line, char* username, char* password);
+static bool valid_field(const char* str, size_t max_dim);
+static void* hash_worker(void* arg);
+static bool hash_batch(import_user* users, size_t n_users, int n_threads, FILE* urandom);
+static bool store_batch(user_store* store, import_user* users, size_t n_users, int n_threads, FILE* urandom);
+static double elapsed_seconds(const struct timespec* start);
+
+int main(int argc, char* args[])
+{
+    size_t n_read = 0, n_invalid = 0, n_dup_input = 0, n_dup_store = 0, n_imported = 0, n_existing, n_batch = 0;
+    char line[IMPORT_LINE_DIM];
+    bool header_checked = false;
+    import_user* batch;
+    user_store store;
+    name_set seen;
+    FILE *in, *urandom;
+    struct timespec start;
+    int n_threads, n_shards = USERS_SHARDS_DEFAULT;
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage:\t%s <input file> [shards]\n", args[0]);
+        return 0;
+    }
+    if (argc == 3) {
+        if (!is_number(args[2]) || strlen(args[2]) > 3 || (n_shards = (int)string_to_long(args[2])) < 1 || n_shards > USERS_MAX_SHARDS) {
+            printf("Error:\tshards must be between 1 and %d\n", USERS_MAX_SHARDS);
+            return 0;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Numero di thread per la cifratura delle password
+    n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > IMPORT_MAX_THREADS)
+        n_threads = IMPORT_MAX_THREADS;
+
+    // Caricamento dell'archivio utenti
+    if (!userstore_open(&store, USERS_DIR, n_shards)) {
+        printf("Error:\tcannot open the user store in %s\n", USERS_DIR);
+        return 1;
+    }
+    n_existing = userstore_count(&store);
+
+    in = fopen(args[1], "r");
+    if (in == NULL) {
+        printf("Error:\tcannot open %s\n", args[1]);
+        userstore_close(&store);
+        return 1;
+    }
+
+    batch = malloc(IMPORT_BATCH_DIM * sizeof(import_user));
+    if (batch == NULL || !set_init(&seen, 1 << 16)) {
+        printf("Error:\tout of memory\n");
+        free(batch);
+        fclose(in);
+        userstore_close(&store);
+        return 1;
+    }
+    urandom = fopen("/dev/urandom", "r");
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        import_user* user = &batch[n_batch];
+
+        // Righe vuote e commenti vengono ignorati
+        trim(line);
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        // Un'eventuale intestazione ("username,password") sulla prima riga viene ignorata
+        if (!header_checked) {
+            header_checked = true;
+            if (strncasecmp(line, "username", 8) == 0 && (line[8] == ',' || isspace((unsigned char)line[8])))
+                continue;
+        }
+
+        n_read++;
+        if (!parse_line(line, user->username, user->password)) {
+            n_invalid++;
+            continue;
+        }
+
+        // Scarto dei duplicati, già registrati o interni al file
+        if (userstore_find(&store, user->username) != NULL) {
+            n_dup_store++;
+            continue;
+        }
+        switch (set_insert(&seen, user->username))
+        {
+            case 1:
+                break;
+            case 0: {
+                n_dup_input++;
+                continue;
+            }
+            default: {
+                printf("Error:\tout of memory\n");
+                goto quit;
+            }
+        }
+
+        n_batch++;
+        if (n_batch == IMPORT_BATCH_DIM)
+        {
+            if (!store_batch(&store, batch, n_batch, n_threads, urandom))
+                goto quit;
+            n_imported += n_batch;
+            n_batch = 0;
+        }
+    }
+
+    // Ultimo lotto
+    if (store_batch(&store, batch, n_batch, n_threads, urandom))
+        n_imported += n_batch;
+
+quit:
+    fclose(in);
+    if (!userstore_flush(&store))
+        printf("Error:\twrite on the user store failed\n");
+    userstore_close(&store);
+    if (urandom != NULL)
+        fclose(urandom);
+    free(batch);
+    set_free(&seen);
+
+    // Riepilogo
+    {
+        double seconds = elapsed_seconds(&start);
+        printf("Users already registered:  %zu\n", n_existing);
+        printf("Lines read:                %zu\n", n_read);
+        printf("Invalid lines:             %zu\n", n_invalid);
+        printf("Duplicates in input:       %zu\n", n_dup_input);
+        printf("Already registered:        %zu\n", n_dup_store);
+        printf("Imported:                  %zu\n", n_imported);
+        printf("Threads:                   %d\n", n_threads);
+        printf("Elapsed:                   %.2f s (%.0f users/s)\n", seconds, seconds > 0 ? n_imported / seconds : 0.0);
+    }
+    return 0;
+}
+
+//-------Name set-------//
+
+static bool set_init(name_set* set, size_t capacity)
+{
+    set->capacity = capacity;
+    set->n_items = 0;
+    set->hashes = calloc(capacity, sizeof(uint64_t));
+    set->offsets = malloc(capacity * sizeof(size_t));
+    set->names_dim = 0;
+    set->names_capacity = capacity * 16;
+    set->names = malloc(set->names_capacity);
+
+    if (set->hashes == NULL || set->offsets == NULL || set->names == NULL) {
+        set_free(set);
+        return false;
+    }
+    return true;
+}
+
+static void set_free(name_set* set)
+{
+    free(set->hashes);
+    free(set->offsets);
+    free(set->names);
+    memset(set, 0, sizeof(name_set));
+}
+
+/*
+ * Inserisce un username nell'insieme, raddoppiando la tabella quando è piena per metà.
+ *
+ * Restituisce:
+ *   - 1 se l'username è stato inserito, 0 se era già presente, -1 se la memoria è esaurita.
+ */
+static int set_insert(name_set* set, const char* name)
+{
+    uint64_t h = hash_string(name) | 1;             // 0 indica una cella libera
+    size_t len = strlen(name) + 1, i;
+
+    for (i = h & (set->capacity - 1); set->hashes[i] != 0; i = (i + 1) & (set->capacity - 1))
+    {
+        if (set->hashes[i] == h && strcmp(set->names + set->offsets[i], name) == 0)
+            return 0;
+    }
+
+    // Copia dell'username nell'area dei nomi
+    if (set->names_dim + len > set->names_capacity)
+    {
+        char* names = realloc(set->names, set->names_capacity * 2);
+        if (names == NULL)
+            return -1;
+        set->names = names;
+        set->names_capacity *= 2;
+    }
+    memcpy(set->names + set->names_dim, name, len);
+    set->hashes[i] = h;
+    set->offsets[i] = set->names_dim;
+    set->names_dim += len;
+    set->n_items++;
+
+    // Raddoppio della tabella
+    if (set->n_items * 2 > set->capacity)
+    {
+        size_t capacity = set->capacity * 2, j, k;
+        uint64_t* hashes = calloc(capacity, sizeof(uint64_t));
+        size_t* offsets = malloc(capacity * sizeof(size_t));
+        if (hashes == NULL || offsets == NULL) {
+            free(hashes);
+            free(offsets);
+            return -1;
+        }
+
+        for (j = 0; j < set->capacity; j++)
+        {
+            if (set->hashes[j] == 0)
+                continue;
+            for (k = set->hashes[j] & (capacity - 1); hashes[k] != 0; k = (k + 1) & (capacity - 1));
+            hashes[k] = set->hashes[j];
+            offsets[k] = set->offsets[j];
+        }
+
+        free(set->hashes);
+        free(set->offsets);
+        set->hashes = hashes;
+        set->offsets = offsets;
+        set->capacity = capacity;
+    }
+    return 1;
+}
+
+//----------------------//
+
+//--------Utils---------//
+
+/*
+ * Separa una riga nei campi username e password, accettando come separatore la virgola (CSV) o gli spazi.
+ *
+ * Restituisce:
+ *   - true se la riga è valida, false altrimenti.
+ */
+static bool parse_line(char* line, char* username, char* password)
+{
+    char* sep = strchr(line, ',');
+    char* pass;
+
+    if (sep != NULL)
+        *sep = '\0';
+    else {
+        sep = line;
+        while (*sep != '\0' && !isspace((unsigned char)*sep))
+            sep++;
+        if (*sep == '\0')
+            return false;
+        *sep = '\0';
+    }
+    pass = sep + 1;
+
+    trimEnd(line);
+    trim(pass);
+    if (!valid_field(line, MAX_USR_DIM) || !valid_field(pass, MAX_PSW_DIM))
+        return false;
+
+    strcpy(username, line);
+    strcpy(password, pass);
+    return true;
+}
+
+/*
+ * Un campo è valido se non è vuoto, entra nei buffer del server e non contiene spazi o caratteri
+ * di controllo, che il server non saprebbe leggere dal file utenti.
+ */
+static bool valid_field(const char* str, size_t max_dim)
+{
+    size_t len = strlen(str), i;
+
+    if (len == 0 || len >= max_dim)
+        return false;
+    for (i = 0; i < len; i++)
+    {
+        if (isspace((unsigned char)str[i]) || iscntrl((unsigned char)str[i]))
+            return false;
+    }
+    return true;
+}
+
+static void* hash_worker(void* arg)
+{
+    import_job* job = arg;
+    size_t i;
+
+    for (i = 0; i < job->n_users; i++)
+        password_hash_with_salt(job->users[i].password, job->users[i].salt, job->users[i].hashed);
+    return NULL;
+}
+
+/*
+ * Cifra le password di un lotto dividendolo in parti uguali tra n_threads thread.
+ * I salt vengono letti da /dev/urandom, aperto una sola volta per tutta l'importazione.
+ *
+ * Restituisce:
+ *   - true se le password sono state cifrate, false se non è stato possibile generare i salt.
+ */
+static bool hash_batch(import_user* users, size_t n_users, int n_threads, FILE* urandom)
+{
+    pthread_t threads[IMPORT_MAX_THREADS];
+    import_job jobs[IMPORT_MAX_THREADS];
+    bool started[IMPORT_MAX_THREADS];
+    size_t per_thread, i;
+    int t;
+
+    if (n_users == 0)
+        return true;
+
+    // Generazione dei salt
+    for (i = 0; i < n_users; i++)
+    {
+        if ((urandom == NULL || fread(users[i].salt, 1, PSW_SALT_BYTES, urandom) != PSW_SALT_BYTES) &&
+            !password_random_salt(users[i].salt))
+            return false;
+    }
+
+    per_thread = (n_users + n_threads - 1) / n_threads;
+    for (t = 0; t < n_threads; t++)
+    {
+        size_t first = t * per_thread;
+        if (first >= n_users)
+            break;
+
+        jobs[t].users = users + first;
+        jobs[t].n_users = first + per_thread > n_users ? n_users - first : per_thread;
+
+        // Se il thread non parte, la sua parte viene cifrata dal thread principale
+        started[t] = pthread_create(&threads[t], NULL, hash_worker, &jobs[t]) == 0;
+        if (!started[t])
+            hash_worker(&jobs[t]);
+    }
+
+    while (--t >= 0)
+    {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    }
+    return true;
+}
+
+/*
+ * Cifra le password di un lotto e registra i suoi utenti nell'archivio.
+ */
+static bool store_batch(user_store* store, import_user* users, size_t n_users, int n_threads, FILE* urandom)
+{
+    size_t i;
+
+    if (!hash_batch(users, n_users, n_threads, urandom)) {
+        printf("Error:\tcannot read /dev/urandom\n");
+        return false;
+    }
+    for (i = 0; i < n_users; i++)
+    {
+        if (userstore_add(store, users[i].username, users[i].hashed) != OK) {
+            printf("Error:\twrite on the user store failed\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+static double elapsed_seconds(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+//----------------------//